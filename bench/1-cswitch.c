@@ -0,0 +1,76 @@
+// context switch cost: ping-pong between <notmain> and a second
+// context, timing each round trip (two switches).
+//   - switchto_cswitch: saves and loads all 17 registers (<switchto.h>).
+//   - rpi_cswitch: the threads package's callee-saved switch.
+//   - rpi_yield: rpi_cswitch plus the run queue.
+#include "rpi.h"
+#include "bench.h"
+#include "rpi-thread.h"
+#include "switchto.h"
+
+enum { N = 512 };
+
+static uint64_t stack[1024];
+#define stack_top (&stack[1024])
+
+/************************************************************
+ * switchto_cswitch.
+ */
+static regs_t main_regs, pong_regs;
+
+static void regs_pong(void) {
+  while (1)
+    switchto_cswitch(&pong_regs, &main_regs);
+}
+
+static void bench_switchto(void) {
+  pong_regs = switchto_mk((uint32_t)regs_pong, stack_top, cpsr_get(), 0);
+  BENCH(N, switchto_cswitch(&main_regs, &pong_regs), "switchto_cswitch/rt");
+}
+
+/************************************************************
+ * rpi_cswitch.
+ */
+static uint32_t *main_sp, *pong_sp;
+
+static void cswitch_pong(void) {
+  while (1)
+    rpi_cswitch(&pong_sp, main_sp);
+}
+
+static void bench_rpi_cswitch(void) {
+  // rpi_cswitch pushes r4-r11 and lr and returns to the popped lr:
+  // a fake frame with lr = <cswitch_pong> starts it.
+  uint32_t *sp = (uint32_t *)stack_top - 9;
+  memset(sp, 0, 9 * 4);
+  sp[8] = (uint32_t)cswitch_pong;
+  pong_sp = sp;
+  BENCH(N, rpi_cswitch(&main_sp, pong_sp), "rpi_cswitch/rt");
+}
+
+/************************************************************
+ * rpi_yield: two threads, one timing.
+ */
+static volatile int done_p;
+
+static void yield_pong(void *arg) {
+  while (!done_p)
+    rpi_yield();
+}
+
+static void yield_ping(void *arg) {
+  BENCH(N, rpi_yield(), "rpi_yield/rt");
+  done_p = 1;
+}
+
+void notmain(void) {
+  bench_init();
+  bench_switchto();
+  bench_rpi_cswitch();
+
+  rpi_fork(yield_ping, 0);
+  rpi_fork(yield_pong, 0);
+  rpi_thread_start();
+
+  printk("SUCCESS: context switch benchmarks\n");
+}
@@ -0,0 +1,50 @@
+// system call round trip: a user-mode loop that does nothing but
+// <swi>, with a handler that returns right away.
+//
+// user mode can't read the cycle counter, so the handler timestamps
+// each entry: the gap between two entries is one full round trip
+// (trap, <full_except>'s save, the handler, <switchto> back to user
+// mode, and the loop's branch).
+#include "rpi.h"
+#include "bench.h"
+#include "full-except.h"
+#include "switchto.h"
+
+enum { N = 512 };
+
+static uint64_t stack[1024];
+static regs_t main_regs;
+static unsigned ntraps;
+static uint32_t last;
+
+static void user_loop(void) {
+  while (1)
+    asm volatile("swi 1" ::: "r0", "memory");
+}
+
+static int syscall_handler(regs_t *r) {
+  uint32_t now = cycle_cnt_read();
+  // the first trap has no previous one to measure from.
+  if (ntraps++)
+    bench_add(now - last);
+  if (ntraps == N + BENCH_WARMUP + 1)
+    switchto(&main_regs);
+  // stamp again on the way out: the time in <bench_add> isn't part
+  // of the round trip.
+  last = cycle_cnt_read();
+  return 0;
+}
+
+void notmain(void) {
+  bench_init();
+  full_except_install(0);
+  full_except_set_syscall(syscall_handler);
+
+  regs_t user = switchto_mk((uint32_t)user_loop, &stack[1024],
+                            cpsr_inherit(USER_MODE, cpsr_get()), 0);
+  bench_start("syscall/rt");
+  switchto_cswitch(&main_regs, &user);
+  bench_done();
+
+  printk("SUCCESS: system call benchmark\n");
+}
@@ -0,0 +1,27 @@
+// <uart_put8>: into an empty tx fifo (the cost of the call) and
+// back to back (the fifo is full, so it's the baud rate).  the bytes
+// are spaces, and a newline ends each run so the results parse.
+#include "rpi.h"
+#include "bench.h"
+
+enum { N = 256 };
+
+void notmain(void) {
+  bench_init();
+
+  bench_start("uart_put8/empty");
+  for (unsigned i = 0; i < N + BENCH_WARMUP; i++) {
+    uart_flush_tx();
+    bench_add(TIME_CYC(uart_put8(' ')));
+  }
+  uart_put8('\n');
+  bench_done();
+
+  bench_start("uart_put8/full");
+  for (unsigned i = 0; i < N + BENCH_WARMUP; i++)
+    bench_add(TIME_CYC(uart_put8(' ')));
+  uart_put8('\n');
+  bench_done();
+
+  printk("SUCCESS: uart benchmark\n");
+}
@@ -0,0 +1,37 @@
+// <memcpy> and <memset> across sizes and alignments, and <kmalloc>.
+//
+// names are <op>/<nbytes>/a<offset>: the destination (and for memcpy
+// the source) start <offset> bytes past a word boundary.
+#include "rpi.h"
+#include "bench.h"
+
+enum { N = 256, MAXBYTES = 4096 };
+
+static uint32_t dst[MAXBYTES / 4 + 1], src[MAXBYTES / 4 + 1];
+
+static const unsigned sizes[] = {4, 16, 64, 256, 1024, 4096};
+#define NSIZES (sizeof sizes / sizeof sizes[0])
+
+void notmain(void) {
+  bench_init();
+  kmalloc_init(32);
+
+  for (unsigned i = 0; i < NSIZES; i++) {
+    unsigned n = sizes[i];
+    for (unsigned off = 0; off < 4; off++) {
+      void *d = (char *)dst + off;
+      const void *s = (char *)src + off;
+      BENCH(N, memcpy(d, s, n), "memcpy/%d/a%d", n, off);
+      BENCH(N, memset(d, 0x5a, n), "memset/%d/a%d", n, off);
+    }
+  }
+
+  // kmalloc zeroes, so it's size dependent too.
+  for (unsigned i = 0; i < NSIZES; i++) {
+    unsigned n = sizes[i];
+    BENCH(N, kmalloc(n), "kmalloc/%d", n);
+  }
+  BENCH(N, kmalloc_aligned(64, 64), "kmalloc_aligned/64");
+
+  printk("SUCCESS: memory benchmarks\n");
+}
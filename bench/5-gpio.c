@@ -0,0 +1,37 @@
+// driving and setting up eight pins (20..27) one at a time against
+// the mask calls, which take a bank (or a function select register)
+// per access.
+//
+// the pins are driven: don't run this with anything on them.
+#include "rpi.h"
+#include "bench.h"
+
+enum { N = 256, LO = 20, NPIN = 8 };
+#define PINS (((1ULL << NPIN) - 1) << LO)
+
+static void write_each(unsigned v) {
+  for (unsigned i = 0; i < NPIN; i++)
+    gpio_write(LO + i, (v >> i) & 1);
+}
+
+static void output_each(void) {
+  for (unsigned i = 0; i < NPIN; i++)
+    gpio_set_output(LO + i);
+}
+
+void notmain(void) {
+  bench_init();
+
+  BENCH(N, output_each(), "gpio_set_output/x%d", NPIN);
+  BENCH(N, gpio_set_function_mask(PINS, GPIO_FUNC_OUTPUT),
+        "gpio_set_function_mask/%d", NPIN);
+
+  unsigned v = 0;
+  BENCH(N, write_each(v++), "gpio_write/x%d", NPIN);
+  BENCH(N, gpio_write_mask(PINS, (uint64_t)v++ << LO), "gpio_write_mask/%d",
+        NPIN);
+
+  gpio_write_mask(PINS, 0);
+  gpio_set_function_mask(PINS, GPIO_FUNC_INPUT);
+  printk("SUCCESS: gpio benchmark\n");
+}
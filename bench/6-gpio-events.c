@@ -0,0 +1,84 @@
+// edge events (<gpio-events.h>) through a loopback: we drive pin 16,
+// which is jumpered to pin 17, and capture both edges of 17.
+//   - every toggle must give exactly one event for 17 with the level
+//     we drove.  we time the write to the event's cycle stamp: the
+//     interrupt entry and <gpio_events_interrupt>.
+//   - toggling more than the ring holds without popping must keep
+//     the oldest events and count the rest as lost.
+//
+// needs the jumper: without it there are no events and we panic.
+#include "rpi.h"
+#include "bench.h"
+#include "full-except.h"
+#include "gpio-events.h"
+#include "rpi-interrupts.h"
+
+enum { OUT = 16, IN = 17, N = 64, TIMEOUT_USEC = 1000 };
+
+static volatile unsigned nint;
+
+// libpi's full-except trampoline calls this for every interrupt.
+void int_vector(unsigned pc) {
+  if (!gpio_events_interrupt())
+    panic("interrupt that isn't a gpio event: pc=%x\n", pc);
+  nint++;
+}
+
+// drive <v> and wait for the handler to see it.
+static void toggle(unsigned v) {
+  unsigned n = nint;
+  gpio_write(OUT, v);
+  uint32_t start = timer_get_usec();
+  while (nint == n)
+    if (timer_get_usec() - start > TIMEOUT_USEC)
+      panic("no event on pin %d: is it jumpered to pin %d?\n", IN, OUT);
+}
+
+void notmain(void) {
+  bench_init();
+  full_except_install(0);
+  gpio_set_output(OUT);
+  gpio_write(OUT, 0);
+  gpio_events_init(1ULL << IN, 1ULL << IN);
+  enable_interrupts();
+
+  // rising first, then alternating.
+  gpio_ev_t e;
+  bench_start("gpio_event/edge");
+  for (unsigned i = 0; i < N + BENCH_WARMUP; i++) {
+    unsigned v = ~i & 1;
+    uint32_t start = cycle_cnt_read();
+    toggle(v);
+    if (!gpio_events_pop(&e))
+      panic("toggle %d: the handler ran but there's no event\n", i);
+    if (e.pin != IN || e.level != v)
+      panic("toggle %d: pin=%d level=%d, expected pin=%d level=%d\n", i,
+            e.pin, e.level, IN, v);
+    if (gpio_events_pop(&e))
+      panic("toggle %d: more than one event\n", i);
+    bench_add(e.cyc - start);
+  }
+  bench_done();
+
+  // nobody pops: the ring keeps the oldest and counts the rest.
+  enum { NHELD = GPIO_EV_N - 1, NTOGGLE = GPIO_EV_N + 16 };
+  unsigned lost = gpio_events_lost();
+  for (unsigned i = 0; i < NTOGGLE; i++)
+    toggle(~i & 1);
+  if (gpio_events_lost() - lost != NTOGGLE - NHELD)
+    panic("lost %d events, expected %d\n", gpio_events_lost() - lost,
+          NTOGGLE - NHELD);
+  for (unsigned i = 0; i < NHELD; i++) {
+    if (!gpio_events_pop(&e))
+      panic("only %d events held, expected %d\n", i, NHELD);
+    if (e.pin != IN || e.level != (~i & 1))
+      panic("held event %d: pin=%d level=%d\n", i, e.pin, e.level);
+  }
+  if (gpio_events_pop(&e))
+    panic("more events than the ring holds\n");
+
+  disable_interrupts();
+  gpio_write(OUT, 0);
+  gpio_set_input(OUT);
+  printk("SUCCESS: gpio events\n");
+}
@@ -0,0 +1,42 @@
+// kernel benchmarks: <eqx_fork>, <eqx_exec_internal> of a small
+// program image and <pi_sd_read> of 1, 8, 64 and 512 sectors.
+//
+// nothing is run or freed: each fork and exec just adds a thread to
+// the run queue (exec also takes a data section and an asid), so the
+// counts stay small.  asids run 1..63, so <NEXEC> plus the warmup
+// execs must stay under 63.  the code section is only loaded by the
+// first exec: after that it comes from the exec cache.
+#include "rpi.h"
+#include "bench.h"
+#include "os.h"
+#include "fs/pi-sd.h"
+#include "user-progs/byte-array-0-printk-hello.h"
+
+enum { NFORK = 64, NEXEC = 48 };
+_Static_assert(NEXEC + BENCH_WARMUP < 63, "each exec takes an asid");
+
+static void do_nothing(void *arg) {}
+
+void notmain(void) {
+  bench_init();
+  // exec's trace would be most of what we time.
+  eqx_verbose(0);
+  eqx_config_t c = {.ramMB = 512, .vm_use_pin_p = 1};
+  eqx_init_config(c);
+
+  BENCH(NFORK, eqx_fork(do_nothing, 0), "eqx_fork");
+  BENCH(NEXEC, eqx_exec_internal(&bytes_0_printk_hello), "eqx_exec/%d",
+        bytes_0_printk_hello.nbytes);
+
+  pi_sd_init();
+  static const struct {
+    unsigned nsec, n;
+  } reads[] = {{1, 128}, {8, 128}, {64, 32}, {512, 16}};
+  void *buf = kmalloc(512 * 512);
+  for (unsigned i = 0; i < sizeof reads / sizeof reads[0]; i++) {
+    unsigned nsec = reads[i].nsec;
+    BENCH(reads[i].n, pi_sd_read(buf, 0, nsec), "pi_sd_read/%d", nsec);
+  }
+
+  printk("SUCCESS: kernel benchmarks\n");
+}
@@ -0,0 +1,48 @@
+// eqx system call round trip, with and without the fast path
+// (<eqx_fast_syscalls>): a user thread that does <N> calls in a
+// loop and returns.
+//
+// each sample is one <eqx_run_threads> of such a thread divided by
+// <N>, so the thread's fork, first switch and exit are spread over
+// the calls.  get_pid can take the fast path; get_cpsr always takes
+// the full one and shows what the trap costs without it.
+#include "rpi.h"
+#include "bench.h"
+#include "os.h"
+
+enum { N = 1024, NRUN = 16 };
+
+static uint32_t sysno;
+
+static void user_loop(void *arg) {
+  for (unsigned i = 0; i < N; i++) {
+    register uint32_t r0 asm("r0") = sysno;
+    asm volatile("swi 1" : "+r"(r0) : : "r1", "r2", "r3", "r12", "lr",
+                 "memory");
+  }
+}
+
+static void run(uint32_t no, const char *name, int fast_p) {
+  sysno = no;
+  eqx_fast_syscalls(fast_p);
+  bench_start("eqx_syscall/%s/%s", name, fast_p ? "fast" : "full");
+  for (unsigned i = 0; i < NRUN + BENCH_WARMUP; i++) {
+    eqx_fork(user_loop, 0);
+    uint32_t s = cycle_cnt_read();
+    eqx_run_threads();
+    bench_add((cycle_cnt_read() - s) / N);
+  }
+  bench_done();
+}
+
+void notmain(void) {
+  bench_init();
+  eqx_verbose(0);
+  eqx_init();
+
+  run(EQX_SYS_GET_PID, "get_pid", 0);
+  run(EQX_SYS_GET_PID, "get_pid", 1);
+  run(EQX_SYS_GET_CPSR, "get_cpsr", 1);
+
+  printk("SUCCESS: eqx system call benchmark\n");
+}
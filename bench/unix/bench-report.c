@@ -0,0 +1,25 @@
+// usage: bench-report <run.log> <out.csv> [<baseline.csv> [<pct>]]
+//
+// pull the "BENCH:" lines out of <run.log> into <out.csv>.  if the
+// baseline exists, print the comparison and exit 1 if any median got
+// more than <pct> percent (default 5) slower.
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "libunix.h"
+#include "pi-bench.h"
+
+int main(int argc, char *argv[]) {
+  if (argc < 3 || argc > 5)
+    die("usage: %s <run.log> <out.csv> [<baseline.csv> [<pct>]]\n", argv[0]);
+  const char *base = argc > 3 ? argv[3] : 0;
+  unsigned pct = argc > 4 ? atoi(argv[4]) : 5;
+
+  if (base && access(base, R_OK) < 0) {
+    output("no baseline <%s>: just writing <%s>\n", base, argv[2]);
+    base = 0;
+  }
+  unsigned nslower = pi_bench_report(stdout, argv[1], argv[2], base, pct);
+  return nslower != 0;
+}
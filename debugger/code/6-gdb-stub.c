@@ -0,0 +1,23 @@
+// run fib() under gdb: start the unix side with the gdb bridge
+// (libunix/pi-gdb.h) and attach with
+//      gdb-multiarch 6-gdb-stub.elf -ex 'target remote /dev/pts/N'
+#include "gdb-stub.h"
+
+int fib(int n) {
+  if (n <= 1)
+    return n;
+  return fib(n - 1) + fib(n - 2);
+}
+
+int fib_caller(void) { return fib(10); }
+
+void notmain(void) {
+  debugger_init();
+  gdb_init();
+
+  output("about to run fib() under gdb!\n");
+  uint32_t ret = gdb_stub_run((void *)fib_caller, 0);
+  output("done fib()=%d!\n", ret);
+  assert(ret == 55);
+  trace("SUCCESS\n");
+}
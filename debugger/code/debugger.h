@@ -7,255 +7,423 @@
 #include "mini-step.h"
 #include "mini-watch.h"
 #include "rpi.h"
-static unsigned hist_n, pc_min, pc_max;
-static volatile unsigned *hist;
+#include "pc-prof.h"
+#include "uart-frame.h"
+#include "dbg-proto.h"
+#include "dbg-trace.h"
+#include "dbg-cond.h"
+#include "libc/crc.h"
 
 void gdb_step_handler(void *data, step_fault_t *s);
 void gdb_watch_handler(void *data, watch_fault_t *w);
 
+// exact (every instruction) profile by single stepping: slow.  the
+// histogram is <pc-prof.h>'s, so the same libunix fold works on it;
+// for a cheap statistical profile call <pc_prof_sample> from a timer
+// interrupt instead.
 static void gprof_init(void) {
   kmalloc_init(4);
-  pc_min = (unsigned)__code_start__;
-  pc_max = (unsigned)__code_end__;
-  unsigned code_size = (pc_max - pc_min) / 4 + 1;
-  assert(pc_min <= pc_max);
-  hist_n = (unsigned)kmalloc(code_size);
+  pc_prof_init((uint32_t)__code_start__, (uint32_t)__code_end__);
 }
 
 static void gprof_inc(unsigned pc) {
-  assert(pc >= pc_min && pc <= pc_max);
-  ((unsigned *)hist_n)[(pc - pc_min) / 4]++;
+  assert(pc >= (unsigned)__code_start__ && pc < (unsigned)__code_end__);
+  pc_prof_sample(pc, 0);
 }
 
-static void gprof_dump(unsigned min_val) {
-  unsigned length = (pc_max - pc_min) / 4 + 1;
-  for (int i = 0; i < length; i++) {
-    unsigned *hist = (unsigned *)hist_n;
-    unsigned count = hist[i];
-    if (count > min_val) {
-      printk("%x, %u\n", pc_min + i * 4, count);
-    }
-  }
-}
+static void gprof_dump(unsigned min_val) { pc_prof_dump(min_val); }
 
 static void gprof_step_handler(void *data, step_fault_t *s) {
   uint32_t *regs = s->regs->regs;
-  unsigned pc = regs[15];
-  gprof_inc(pc);
+  pc_prof_sample(regs[15], regs[14]);
 }
 
 static void gdb_init(void) {
-  kmalloc_init(4);
-  pc_min = (unsigned)__code_start__;
-  pc_max = (unsigned)__code_end__;
-  unsigned code_size = (pc_max - pc_min) / 4 + 1;
-  assert(pc_min <= pc_max);
+  gprof_init();
   mini_bp_init();
   mini_watch_init();
 }
 
-enum debugger_action {
-  ADD_BP,
-  REMOVE_BP,
-  STEP,
-  CONTINUE,
-  EXIT,
-  ADD_WP,
-  REMOVE_WP,
-  WRITE_REG,
-  READ_ADDR,
-  WRITE_ADDR
-};
-
-static int should_disable_stepping = 0;
-static int stop_asking_for_input = 0;
-static unsigned bp_to_reenable = 0; // If we step when pc is at a breakpoint, we
-                                    // disable it and set this variable
-// static unsigned wp_to_reenable = 0; //If we step when pc is at a watchpoint,
-// we disable it and set this variable static int hit_wp_fault = 0; //If we hit
-// a watchpoint fault on the previous step
-
-static unsigned gdb_handle_input(char *buf, uint32_t pc) {
-  // First character is the action
-  enum debugger_action action = buf[0];
-  if (action == STEP) {
-    if (mini_bp_is_breakpoint((void *)pc)) {
-      bp_to_reenable = pc;
-      mini_bp_disable((void *)pc);
-    }
-    return 1;
+// debugger side of <dbg-proto.h>: runs in the single-step (and break
+// and watchpoint) handler.  the program only runs between stops; while
+// stopped we block in <dbg_cmd_loop> on unix's commands.
+static struct {
+  unsigned mode;     // DBG_STEP, DBG_TRACE, DBG_UNTIL or DBG_CONTINUE.
+  uint32_t nleft;    // instructions left for DBG_STEP/DBG_TRACE.
+  uint32_t until_pc; // for DBG_UNTIL.
+  uint32_t nsteps;   // instructions since the last stop.
+  int started_p;     // have we sent the first stop?
+
+  // registers as of the last report: deltas are against these.
+  uint32_t last[DBG_NREGS];
+
+  // pending DBG_TRACE_ENTS message, sent with one write when the
+  // buffer fills or we stop.
+  struct {
+    dbg_hdr_t h;
+    uint32_t nent, nbytes;
+    uint8_t data[DBG_TRACE_BUF];
+  } trace;
+
+  // a watchpoint fired on the last instruction.  mini-watch disarmed
+  // it so the access could finish: the next step decides whether to
+  // stop (with the new value in memory) and puts it back.
+  int wp_hit_p;
+  uint32_t wp_hit_addr;
+} dbg;
+
+// DBG_COND_SET: a break or watchpoint with a condition.  it's checked
+// right in the handler and we only stop when it holds, so a
+// conditional point in a hot loop costs a few dozen instructions a hit
+// instead of a round trip to unix.
+typedef struct {
+  uint32_t kind;    // DBG_COND_BP or DBG_COND_WP.
+  uint32_t addr;    // of the point.  0 = slot is free.
+  uint32_t ignore;  // times it holds before we stop.
+  uint32_t reached; // times the point was hit: DBG_C_HITS.
+  uint32_t n;       // bytes of <code>: 0 = always true.
+  uint8_t code[DBG_COND_MAX];
+} dbg_cond_t;
+
+static dbg_cond_t dbg_conds[DBG_NBP + DBG_NWP];
+
+static dbg_cond_t *dbg_cond_find(uint32_t kind, uint32_t addr) {
+  for (int i = 0; i < DBG_NBP + DBG_NWP; i++)
+    if (dbg_conds[i].addr == addr && dbg_conds[i].kind == kind)
+      return &dbg_conds[i];
+  return 0;
+}
+
+static void dbg_cond_clear(uint32_t kind, uint32_t addr) {
+  dbg_cond_t *c = dbg_cond_find(kind, addr);
+  if (c)
+    c->addr = 0;
+}
+
+// loads are from inside the fault handler: only ram (device reads
+// can have side effects) and not a word we're watching, which would
+// fault again.
+static uint32_t dbg_cond_load(uint32_t addr, int *ok) {
+  if (addr % 4 || addr >= 0x20000000) {
+    *ok = 0;
+    return 0;
   }
-  if (action == CONTINUE) {
-    stop_asking_for_input = 1;
-    // If we're on a breakpoint, we need to disable it now and reenable it on
-    // the next step
-    if (mini_bp_is_breakpoint((void *)pc)) {
-      bp_to_reenable = pc;
-      mini_bp_disable((void *)pc);
+  for (int i = 0; i < DBG_NWP; i++)
+    if (which_wp_on[i] && (uint32_t)wp_addr[i] == addr) {
+      *ok = 0;
+      return 0;
     }
+  return *(volatile uint32_t *)addr;
+}
+
+// do we stop at this hit of the point at <addr>?
+static int dbg_cond_stop(uint32_t kind, uint32_t addr, const uint32_t *regs) {
+  dbg_cond_t *c = dbg_cond_find(kind, addr);
+  if (!c)
     return 1;
-  }
-  if (action == ADD_BP) {
-    // bytes 1-4 is the address
-    unsigned addr = ((int)buf[4] << 24) | ((int)buf[3] << 16) |
-                    ((int)buf[2] << 8) | (int)buf[1];
-    mini_bp_addr((unsigned *)addr, gdb_step_handler, 0);
+  c->reached++;
+  // a bad program or load stops: never stopping would be worse.
+  if (c->n && !dbg_cond_eval(c->code, c->n, regs, c->reached, dbg_cond_load))
     return 0;
-  }
-  if (action == REMOVE_BP) {
-    unsigned addr = ((int)buf[4] << 24) | ((int)buf[3] << 16) |
-                    ((int)buf[2] << 8) | (int)buf[1];
-    mini_bp_disable((unsigned *)addr);
-    return 0;
-  }
-  if (action == ADD_WP) {
-    unsigned addr = ((int)buf[4] << 24) | ((int)buf[3] << 16) |
-                    ((int)buf[2] << 8) | (int)buf[1];
-    mini_watch_addr((unsigned *)addr, gdb_watch_handler, 0);
+  if (c->ignore) {
+    c->ignore--;
     return 0;
   }
-  if (action == REMOVE_WP) {
-    unsigned addr = ((int)buf[4] << 24) | ((int)buf[3] << 16) |
-                    ((int)buf[2] << 8) | (int)buf[1];
-    mini_watch_disable((unsigned *)addr);
-    return 0;
-  }
-  if (action == READ_ADDR) {
-    unsigned addr = ((int)buf[4] << 24) | ((int)buf[3] << 16) |
-                    ((int)buf[2] << 8) | (int)buf[1];
-    delay_ms(5);
-    printk("PI: Value at address %x: %x\n", addr, GET32(addr));
-    delay_ms(5);
-    return 0;
-  }
-  if (action == WRITE_ADDR) {
-    unsigned addr = ((int)buf[4] << 24) | ((int)buf[3] << 16) |
-                    ((int)buf[2] << 8) | (int)buf[1];
-    unsigned val = ((int)buf[8] << 24) | ((int)buf[7] << 16) |
-                   ((int)buf[6] << 8) | (int)buf[5];
-    delay_ms(5);
-    printk("PI: Writing value %x to address %x\n", val, addr);
-    delay_ms(5);
-    PUT32(addr, val);
-    return 0;
-  }
-  if (action == WRITE_REG) {
-    unsigned reg = ((int)buf[4] << 24) | ((int)buf[3] << 16) |
-                   ((int)buf[2] << 8) | (int)buf[1];
-    unsigned val = ((int)buf[8] << 24) | ((int)buf[7] << 16) |
-                   ((int)buf[6] << 8) | (int)buf[5];
-    delay_ms(5);
-    printk("PI: Writing value %x to register %x\n", val, reg);
-    delay_ms(5);
+  return 1;
+}
+
+// If we resume when pc is at a breakpoint, we disable it and set this
+// variable so the next step puts it back.
+static unsigned bp_to_reenable = 0;
+
+// call before resuming at <pc>.
+static void bp_step_over(uint32_t pc) {
+  if (mini_bp_is_breakpoint((void *)pc)) {
+    bp_to_reenable = pc;
+    mini_bp_disable((void *)pc);
   }
-  delay_ms(5);
-  printk("PI: Received unimplemented command %u\n", action);
-  delay_ms(5);
-  return 0;
 }
 
-void gdb_step_handler(void *data, step_fault_t *s) {
-  uint32_t *regs = s->regs->regs;
-  unsigned pc = regs[15];
+// call at the top of the step handler <h>.
+static void bp_step_over_done(step_handler_t h) {
   // Reenable the breakpoint we disabled
   if (bp_to_reenable) {
-    mini_bp_addr((unsigned *)bp_to_reenable, gdb_step_handler, 0);
+    mini_bp_addr((unsigned *)bp_to_reenable, h, 0);
     bp_to_reenable = 0;
   }
-  // If we're not on a breakpoint or watchpoint, and we're not asking for input,
-  // we can continue
-  if (stop_asking_for_input && !mini_bp_is_breakpoint((void *)pc)) {
-    return;
-  }
-  // In a situation where we need input; we're going to re-disable
-  // stop_asking_for_input in case the user wants to continue single stepping
-  stop_asking_for_input = 0;
-
-  // Serialize and send the debugger state
-  // Broken up into 64 byte packets, each one labled _D_S_n__ + 56 bytes (14
-  // registers worth) where n is 0,1,...
-  char buf0[64] = "_D_S_0__";
-  buf0[5] = 0;
-  // Copy each register value into the buffer
-  for (int i = 0; i < 14; i++) {
-    unsigned *reg_ptr = (unsigned *)((char *)buf0 + 8 + i * 4);
-    // printk("PI: reg %d: %x\n", i, regs[i]);
-    *reg_ptr = regs[i]; // Store the register value at current position
-  }
-  for (int i = 0; i < 64; i++) {
-    uart_put8(buf0[i]);
+}
+
+static void dbg_send(unsigned op, const void *data, unsigned nbytes) {
+  // one uart_frame_write per message: each write costs an ack.
+  static uint8_t buf[sizeof(dbg_hdr_t) + FRAME_MAXLEN];
+  assert(nbytes <= FRAME_MAXLEN);
+  dbg_hdr_t h = {.op = op, .nbytes = nbytes};
+  memcpy(buf, &h, sizeof h);
+  memcpy(buf + sizeof h, data, nbytes);
+  if (!uart_frame_write(buf, sizeof h + nbytes))
+    panic("debugger: unix stopped acking\n");
+}
+
+static void dbg_send_err(uint32_t err) { dbg_send(DBG_ERR, &err, sizeof err); }
+
+// append the registers that changed since the last report to <out>:
+// returns the bitmap and updates <dbg.last>.
+static uint32_t dbg_delta(uint32_t *out, unsigned *n, const uint32_t *regs) {
+  uint32_t mask = 0;
+  for (unsigned i = 0; i < DBG_NREGS; i++) {
+    // everything is new in the first report.
+    if (dbg.started_p && regs[i] == dbg.last[i])
+      continue;
+    mask |= 1 << i;
+    out[(*n)++] = regs[i];
+    dbg.last[i] = regs[i];
   }
-  delay_ms(5);
-  char buf1[64] = "_D_S_1__";
-  buf1[5] = 1;
-  for (int i = 14; i < 17; i++) {
-    unsigned *reg_ptr = (unsigned *)((char *)buf1 + 8 + (i - 14) * 4);
-    // printk("PI: reg %d: %x\n", i, regs[i]);
-    *reg_ptr = regs[i]; // Store the register value at current position
+  return mask;
+}
+
+static void dbg_trace_flush(void) {
+  if (!dbg.trace.nent)
+    return;
+  unsigned n = 8 + dbg.trace.nbytes;
+  dbg.trace.h = (dbg_hdr_t){.op = DBG_TRACE_ENTS, .nbytes = n};
+  if (!uart_frame_write(&dbg.trace, sizeof dbg.trace.h + n))
+    panic("debugger: unix stopped acking\n");
+  dbg.trace.nent = dbg.trace.nbytes = 0;
+}
+
+// runs every traced instruction: no uart traffic until the buffer is
+// full.
+static void dbg_trace_add(const uint32_t *regs) {
+  if (dbg.trace.nbytes + DBG_TRACE_ENT_MAX > DBG_TRACE_BUF)
+    dbg_trace_flush();
+  uint8_t *p = &dbg.trace.data[dbg.trace.nbytes];
+  dbg.trace.nbytes += dbg_trace_enc(p, dbg.last, regs);
+  dbg.trace.nent++;
+}
+
+static void dbg_send_points(void) {
+  uint32_t p[DBG_NBP + DBG_NWP];
+  for (int i = 0; i < DBG_NBP; i++)
+    p[i] = which_bp_on[i + 1] ? (uint32_t)bp_addr_list[i + 1] : 0;
+  for (int i = 0; i < DBG_NWP; i++)
+    p[DBG_NBP + i] = which_wp_on[i] ? (uint32_t)wp_addr[i] : 0xffffffff;
+  // the one that fired is still set as far as unix is concerned.
+  if (dbg.wp_hit_p)
+    for (int i = 0; i < DBG_NWP; i++)
+      if (p[DBG_NBP + i] == 0xffffffff) {
+        p[DBG_NBP + i] = dbg.wp_hit_addr & ~3;
+        break;
+      }
+  dbg_send(DBG_POINTS, p, sizeof p);
+}
+
+static void dbg_send_stop(unsigned reason, uint32_t addr, const uint32_t *regs) {
+  dbg_trace_flush();
+
+  uint32_t buf[sizeof(dbg_stop_t) / 4 + DBG_NREGS];
+  unsigned n = sizeof(dbg_stop_t) / 4;
+  dbg_stop_t *s = (void *)buf;
+  s->reason = reason;
+  s->addr = addr;
+  s->nsteps = dbg.nsteps;
+  s->mask = dbg_delta(buf, &n, regs);
+  dbg_send(DBG_STOP, buf, n * 4);
+}
+
+// get the next command's payload.  returns 0 (after draining it) if
+// it doesn't fit in <buf>.
+static int dbg_recv_payload(void *buf, unsigned max, unsigned nbytes) {
+  if (nbytes <= max) {
+    uart_frame_read(buf, nbytes);
+    return 1;
   }
-  for (int i = 0; i < 64; i++) {
-    uart_put8(buf1[i]);
+  uint8_t junk[64];
+  while (nbytes) {
+    unsigned n = nbytes < sizeof junk ? nbytes : sizeof junk;
+    uart_frame_read(junk, n);
+    nbytes -= n;
   }
-  delay_ms(5);
-  char buf2[64] = "_D_S_2__";
-  buf2[5] = 2;
-  // send breakpoints
-  for (int i = 0; i < 5; i++) {
-    unsigned *bp_ptr = (unsigned *)((char *)buf2 + 8 + i * 4);
-    if (which_bp_on[i + 1]) {
-      *bp_ptr = (unsigned)bp_addr_list[i + 1];
-    } else {
-      *bp_ptr = 0;
+  return 0;
+}
+
+// handle commands until one resumes the program.
+static void dbg_cmd_loop(regs_t *r) {
+  static uint32_t buf[(12 + DBG_MEM_MAX) / 4];
+  while (1) {
+    dbg_hdr_t h;
+    uart_frame_read(&h, sizeof h);
+    if (!dbg_recv_payload(buf, sizeof buf, h.nbytes)) {
+      dbg_send_err(DBG_E_TOO_BIG);
+      continue;
     }
-  }
-  for (int i = 0; i < 64; i++) {
-    uart_put8(buf2[i]);
-  }
-  delay_ms(5);
-  char buf3[64] = "_D_S_3__";
-  buf3[5] = 3;
-  // send watchpoints
-  for (int i = 0; i < 2; i++) {
-    unsigned *wp_ptr = (unsigned *)((char *)buf3 + 8 + i * 4);
-    if (which_wp_on[i]) {
-      *wp_ptr = (unsigned)wp_addr[i];
-    } else {
-      *wp_ptr = 0xffffffff;
+
+    switch (h.op) {
+    case DBG_STEP:
+    case DBG_TRACE:
+      dbg.mode = h.op;
+      dbg.nleft = buf[0] ? buf[0] : 1;
+      return;
+    case DBG_UNTIL:
+      dbg.mode = h.op;
+      dbg.until_pc = buf[0];
+      return;
+    case DBG_CONTINUE:
+      dbg.mode = h.op;
+      return;
+
+    case DBG_BP_SET:
+      mini_bp_addr((void *)buf[0], gdb_step_handler, 0);
+      dbg_send_points();
+      break;
+    case DBG_BP_CLR:
+      mini_bp_disable((void *)buf[0]);
+      dbg_cond_clear(DBG_COND_BP, buf[0]);
+      dbg_send_points();
+      break;
+    case DBG_WP_SET:
+      mini_watch_addr((void *)buf[0], gdb_watch_handler, 0);
+      dbg_send_points();
+      break;
+    case DBG_WP_CLR:
+      // the one that just fired is disarmed already: just don't put
+      // it back.
+      if (dbg.wp_hit_p && (dbg.wp_hit_addr & ~3) == (buf[0] & ~3))
+        dbg.wp_hit_p = 0;
+      else
+        mini_watch_disable((void *)buf[0]);
+      dbg_cond_clear(DBG_COND_WP, buf[0] & ~3);
+      dbg_send_points();
+      break;
+
+    case DBG_COND_SET: {
+      uint32_t kind = buf[0], addr = buf[1], n = buf[3];
+      if (kind == DBG_COND_WP)
+        addr &= ~3;
+      // replace the point's condition, else take any free slot.
+      dbg_cond_t *c = dbg_cond_find(kind, addr);
+      for (int i = 0; !c && i < DBG_NBP + DBG_NWP; i++)
+        if (!dbg_conds[i].addr)
+          c = &dbg_conds[i];
+      if (h.nbytes < 16 || kind > DBG_COND_WP || !addr || !c ||
+          n > DBG_COND_MAX || h.nbytes != 16 + n) {
+        dbg_send_err(DBG_E_BAD_COND);
+        break;
+      }
+      c->kind = kind;
+      c->addr = addr;
+      c->ignore = buf[2];
+      c->reached = 0;
+      c->n = n;
+      memcpy(c->code, &buf[4], n);
+      dbg_send(DBG_OK, 0, 0);
+      break;
     }
-  }
-  for (int i = 0; i < 64; i++) {
-    uart_put8(buf3[i]);
-  }
-  delay_ms(5);
-  // end transmission
-  char buf9[64] = "_D_S_9__";
-  buf9[5] = 9;
-  for (int i = 0; i < 64; i++) {
-    uart_put8(buf9[i]);
-  }
-  delay_ms(5);
-  char read_buf[100];
-  while (1) {
-    // Read until get a \0
-    uint8_t bytes = uart_get8();
-    for (int i = 0; i < bytes; i++) {
-      read_buf[i] = uart_get8();
+
+    case DBG_REG_WRITE:
+      if (buf[0] >= DBG_NREGS) {
+        dbg_send_err(DBG_E_BAD_REG);
+        break;
+      }
+      r->regs[buf[0]] = buf[1];
+      dbg_send(DBG_OK, 0, 0);
+      break;
+
+    case DBG_MEM_READ: {
+      uint32_t addr = buf[0], n = buf[1];
+      if (n > DBG_MEM_MAX) {
+        dbg_send_err(DBG_E_TOO_BIG);
+        break;
+      }
+      uint32_t m[3] = {addr, n, our_crc32((void *)addr, n)};
+      // header and bytes go as one message: the bytes straight from
+      // memory.
+      dbg_hdr_t rh = {.op = DBG_MEM, .nbytes = sizeof m + n};
+      if (!uart_frame_write(&rh, sizeof rh) || !uart_frame_write(m, sizeof m) ||
+          !uart_frame_write((void *)addr, n))
+        panic("debugger: unix stopped acking\n");
+      break;
+    }
+    case DBG_MEM_WRITE: {
+      uint32_t addr = buf[0], n = buf[1], crc = buf[2];
+      void *data = &buf[3];
+      if (n != h.nbytes - 12)
+        dbg_send_err(DBG_E_TOO_BIG);
+      else if (our_crc32(data, n) != crc)
+        dbg_send_err(DBG_E_BAD_CRC);
+      else {
+        memcpy((void *)addr, data, n);
+        dbg_send(DBG_OK, 0, 0);
+      }
+      break;
     }
-    read_buf[bytes] = 0;
-    if (gdb_handle_input(read_buf, pc)) {
+    default:
+      dbg_send_err(DBG_E_BAD_OP);
       break;
     }
   }
 }
 
+// report the stop, take commands and set up to resume.
+static void dbg_stop(unsigned reason, uint32_t addr, regs_t *r) {
+  // the stop has to be the last thing we send before listening: the
+  // frame layer is one sender at a time.
+  if (!dbg.started_p)
+    dbg_send_points();
+  dbg_send_stop(reason, addr, r->regs);
+  dbg.started_p = 1;
+  dbg.nsteps = 0;
+
+  dbg_cmd_loop(r);
+
+  // resuming from a breakpoint: step over it and put it back after.
+  bp_step_over(r->regs[15]);
+}
+
+void gdb_step_handler(void *data, step_fault_t *s) {
+  uint32_t *regs = s->regs->regs;
+  unsigned pc = regs[15];
+  bp_step_over_done(gdb_step_handler);
+
+  unsigned reason = 0;
+  uint32_t addr = 0;
+  if (!dbg.started_p)
+    reason = DBG_STOP_START;
+  else {
+    dbg.nsteps++;
+    if (dbg.wp_hit_p &&
+        dbg_cond_stop(DBG_COND_WP, dbg.wp_hit_addr & ~3, regs)) {
+      reason = DBG_STOP_WP;
+      addr = dbg.wp_hit_addr;
+    } else if (mini_bp_is_breakpoint((void *)pc) &&
+               dbg_cond_stop(DBG_COND_BP, pc, regs))
+      reason = DBG_STOP_BP;
+    else if (dbg.mode == DBG_UNTIL && pc == dbg.until_pc)
+      reason = DBG_STOP_UNTIL;
+    else if ((dbg.mode == DBG_STEP || dbg.mode == DBG_TRACE) && !--dbg.nleft)
+      reason = DBG_STOP_STEP;
+
+    // the stop carries the last instruction's registers.
+    if (dbg.mode == DBG_TRACE && !reason)
+      dbg_trace_add(regs);
+  }
+  if (reason)
+    dbg_stop(reason, addr, s->regs);
+  else
+    // a breakpoint whose condition failed: run past it.
+    bp_step_over(pc);
+
+  // after the stop: unix may have read the word, or cleared it.
+  if (dbg.wp_hit_p) {
+    mini_watch_addr((void *)dbg.wp_hit_addr, gdb_watch_handler, 0);
+    dbg.wp_hit_p = 0;
+  }
+}
+
+// the access hasn't happened yet: note it and stop after it has (see
+// <dbg.wp_hit_p>), so the condition and unix see the new value.
 void gdb_watch_handler(void *data, watch_fault_t *w) {
-  delay_ms(5);
-  printk("PI: Watchpoint fault at location %x\n", w->fault_addr);
-  delay_ms(5);
-  printk("PI: Faulting instruction: %x\n", w->fault_pc);
-  delay_ms(5);
-  step_fault_t s = step_fault_mk(w->fault_pc, w->regs);
-  gdb_step_handler(0, &s);
+  dbg.wp_hit_p = 1;
+  dbg.wp_hit_addr = (uint32_t)w->fault_addr;
 }
 
 void debugger_init(void) {
@@ -0,0 +1,507 @@
+#ifndef __GDB_STUB_H__
+#define __GDB_STUB_H__
+// gdb remote serial protocol stub: an alternative to the <debugger.h>
+// protocol that lets a real gdb drive mini-step and mini-watch.  on
+// unix run the pty bridge (libunix/pi-gdb.h) and point gdb at it:
+//
+//      gdb-multiarch prog.elf -ex 'target remote /dev/pts/N'
+//
+// packet bodies come and go as DBG_GDB messages over the frame layer;
+// the bridge does gdb's $...#cs framing and acks.  handled:
+//   ? g G p P m M         registers (r0-r15, cpsr) and memory.
+//   Z0/Z1 z0/z1           breakpoints: mini_bp_addr.
+//   Z2/Z3/Z4 z2/z3/z4     write/read/access watchpoints: mini_watch_addr.
+//   s c vCont             resume.  everything runs under mismatch
+//                         stepping, so "s" is just stopping at the
+//                         next instruction.
+//   qSupported, qXfer     target.xml and a memory map, so gdb knows
+//                         the register layout and not to touch the
+//                         peripherals.
+//   D k                   detach (run free) and kill (reboot).
+// anything else gets the empty "not supported" reply.
+//
+// the pi only listens while stopped, so gdb can't interrupt a
+// "continue": set a breakpoint first.
+#include "debugger.h"
+
+static void gdb_rsp_step_handler(void *data, step_fault_t *s);
+static void gdb_rsp_watch_handler(void *data, watch_fault_t *w);
+
+// gdb only reads ram: the peripherals start here and reads have side
+// effects (e.g., popping the uart fifo).
+enum { GDB_MEM_END = 0x20000000 };
+
+static struct {
+  int started_p;  // sent the first stop?
+  int step_p;     // stop at the next instruction.
+  int detached_p; // gdb left: run to the end without stopping.
+
+  // gdb's watchpoints: type 2 (write), 3 (read) or 4 (access); 0 is
+  // free.  the hardware fires on any access and mini-watch disarms it
+  // after; <gdb_watch_sync> re-arms on the next instruction.
+  struct {
+    uint32_t addr, type;
+  } watch[DBG_NWP];
+  // watchpoint mini-watch disarms once our handler returns.
+  uint32_t watch_hit;
+
+  char stop[32]; // last stop reply, for '?'.
+  char in[DBG_GDB_MAX + 1];
+  struct {
+    dbg_hdr_t h;
+    char s[DBG_GDB_MAX + 1];
+  } out;
+} gdb;
+
+static const char gdb_target_xml[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target><architecture>arm</architecture>"
+    "<feature name=\"org.gnu.gdb.arm.core\">"
+    "<reg name=\"r0\" bitsize=\"32\"/><reg name=\"r1\" bitsize=\"32\"/>"
+    "<reg name=\"r2\" bitsize=\"32\"/><reg name=\"r3\" bitsize=\"32\"/>"
+    "<reg name=\"r4\" bitsize=\"32\"/><reg name=\"r5\" bitsize=\"32\"/>"
+    "<reg name=\"r6\" bitsize=\"32\"/><reg name=\"r7\" bitsize=\"32\"/>"
+    "<reg name=\"r8\" bitsize=\"32\"/><reg name=\"r9\" bitsize=\"32\"/>"
+    "<reg name=\"r10\" bitsize=\"32\"/><reg name=\"r11\" bitsize=\"32\"/>"
+    "<reg name=\"r12\" bitsize=\"32\"/>"
+    "<reg name=\"sp\" bitsize=\"32\" type=\"data_ptr\"/>"
+    "<reg name=\"lr\" bitsize=\"32\"/>"
+    "<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\"/>"
+    "<reg name=\"cpsr\" bitsize=\"32\"/>"
+    "</feature></target>";
+
+static const char gdb_memory_map[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE memory-map PUBLIC \"+//IDN gnu.org//DTD GDB Memory Map V1.0//EN\""
+    " \"http://sourceware.org/gdb/gdb-memory-map.dtd\">"
+    "<memory-map><memory type=\"ram\" start=\"0x0\" length=\"0x20000000\"/>"
+    "</memory-map>";
+
+/**********************************************************************
+ * hex helpers: gdb sends numbers as plain hex and register and memory
+ * contents as hex bytes in memory order.
+ */
+static const char gdb_hexdig[] = "0123456789abcdef";
+
+static int gdb_hexval(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// parse a hex number at *p and advance past it.
+static uint32_t gdb_num(const char **p) {
+  uint32_t x = 0;
+  int v;
+  while ((v = gdb_hexval(**p)) >= 0) {
+    x = x << 4 | v;
+    (*p)++;
+  }
+  return x;
+}
+
+// the single character separator gdb puts between fields.
+static int gdb_sep(const char **p, char c) {
+  if (**p != c)
+    return 0;
+  (*p)++;
+  return 1;
+}
+
+// copy <s> to <out>: returns the end.
+static char *gdb_puts(char *out, const char *s) {
+  while ((*out = *s++))
+    out++;
+  return out;
+}
+
+static char *gdb_put_num(char *out, uint32_t x) {
+  int shift = 28;
+  while (shift > 0 && !(x >> shift))
+    shift -= 4;
+  for (; shift >= 0; shift -= 4)
+    *out++ = gdb_hexdig[(x >> shift) & 0xf];
+  *out = 0;
+  return out;
+}
+
+static char *gdb_put_bytes(char *out, const void *data, unsigned n) {
+  const uint8_t *p = data;
+  for (unsigned i = 0; i < n; i++) {
+    *out++ = gdb_hexdig[p[i] >> 4];
+    *out++ = gdb_hexdig[p[i] & 0xf];
+  }
+  *out = 0;
+  return out;
+}
+
+// returns 0 if there weren't <n> bytes of hex.
+static int gdb_get_bytes(const char **p, void *data, unsigned n) {
+  uint8_t *d = data;
+  for (unsigned i = 0; i < n; i++) {
+    int hi = gdb_hexval((*p)[0]), lo;
+    if (hi < 0 || (lo = gdb_hexval((*p)[1])) < 0)
+      return 0;
+    d[i] = hi << 4 | lo;
+    *p += 2;
+  }
+  return 1;
+}
+
+static int gdb_mem_ok(uint32_t addr, uint32_t n) {
+  return addr < GDB_MEM_END && n <= GDB_MEM_END - addr;
+}
+
+/**********************************************************************
+ * transport.
+ */
+static void gdb_send(const char *s) {
+  unsigned n = strlen(s);
+  assert(n <= DBG_GDB_MAX);
+  if (s != gdb.out.s)
+    memcpy(gdb.out.s, s, n);
+  gdb.out.h = (dbg_hdr_t){.op = DBG_GDB, .nbytes = n};
+  if (!uart_frame_write(&gdb.out, sizeof gdb.out.h + n))
+    panic("gdb stub: unix stopped acking\n");
+}
+
+// next packet into <gdb.in>, 0-terminated.
+static void gdb_recv(void) {
+  while (1) {
+    dbg_hdr_t h;
+    uart_frame_read(&h, sizeof h);
+    if (dbg_recv_payload(gdb.in, DBG_GDB_MAX, h.nbytes) && h.op == DBG_GDB) {
+      gdb.in[h.nbytes] = 0;
+      return;
+    }
+    // a packet gdb never sends or an old debugger.h client: "E01"
+    // is the best we can do.
+    gdb_send("E01");
+  }
+}
+
+/**********************************************************************
+ * break and watchpoints.
+ */
+static int gdb_wp_armed(uint32_t addr) {
+  for (int i = 0; i < DBG_NWP; i++)
+    if (which_wp_on[i] && (uint32_t)wp_addr[i] == addr)
+      return 1;
+  return 0;
+}
+
+// put back any of gdb's watchpoints mini-watch disarmed.
+static void gdb_watch_sync(void) {
+  gdb.watch_hit = 0;
+  for (int i = 0; i < DBG_NWP; i++) {
+    uint32_t addr = gdb.watch[i].addr;
+    if (gdb.watch[i].type && !gdb_wp_armed(addr))
+      mini_watch_addr((void *)addr, gdb_rsp_watch_handler, 0);
+  }
+}
+
+static int gdb_watch_find(uint32_t addr) {
+  for (int i = 0; i < DBG_NWP; i++)
+    if (gdb.watch[i].type && gdb.watch[i].addr == addr)
+      return i;
+  return -1;
+}
+
+// Z<type>,<addr>,<kind> and z...: returns 0 if we can't.
+static int gdb_point(uint32_t type, uint32_t addr, int insert_p) {
+  // software or hardware breakpoint: both are the hardware ones.
+  if (type <= 1) {
+    int on_p = mini_bp_is_breakpoint((void *)addr);
+    if (insert_p && !on_p) {
+      if (mini_bp_enabled() == DBG_NBP)
+        return 0;
+      mini_bp_addr((void *)addr, gdb_rsp_step_handler, 0);
+    } else if (!insert_p && on_p)
+      mini_bp_disable((void *)addr);
+    return 1;
+  }
+  if (type > 4)
+    return 0;
+
+  // the hardware watches the whole word.
+  addr &= ~3;
+  int i = gdb_watch_find(addr);
+  if (!insert_p) {
+    if (i < 0)
+      return 1;
+    gdb.watch[i].type = 0;
+    // the one that just fired is being disarmed already.
+    if (gdb_wp_armed(addr) && addr != gdb.watch_hit)
+      mini_watch_disable((void *)addr);
+    return 1;
+  }
+
+  if (i >= 0) {
+    // e.g., a read and a write watch on the same word.
+    if (gdb.watch[i].type != type)
+      gdb.watch[i].type = 4;
+    return 1;
+  }
+  for (i = 0; i < DBG_NWP && gdb.watch[i].type; i++)
+    ;
+  if (i == DBG_NWP)
+    return 0;
+  gdb.watch[i].addr = addr;
+  gdb.watch[i].type = type;
+  // if both hardware slots are busy (one about to be freed) this waits
+  // for <gdb_watch_sync>.
+  if (!gdb_wp_armed(addr) && mini_watch_enabled() < DBG_NWP)
+    mini_watch_addr((void *)addr, gdb_rsp_watch_handler, 0);
+  return 1;
+}
+
+static void gdb_detach(void) {
+  for (int i = 1; i <= DBG_NBP; i++)
+    if (which_bp_on[i])
+      mini_bp_disable(bp_addr_list[i]);
+  for (int i = 0; i < DBG_NWP; i++)
+    if (gdb.watch[i].type)
+      gdb_point(gdb.watch[i].type, gdb.watch[i].addr, 0);
+  gdb.detached_p = 1;
+}
+
+/**********************************************************************
+ * packets.
+ */
+
+// qXfer:<object>:read:<annex>:<off>,<len> for a fixed document.
+static void gdb_xfer(char *out, const char *doc, const char *p) {
+  uint32_t off = gdb_num(&p), len = 0;
+  if (gdb_sep(&p, ','))
+    len = gdb_num(&p);
+  uint32_t n = strlen(doc);
+  if (off >= n) {
+    strcpy(out, "l");
+    return;
+  }
+  if (len > n - off)
+    len = n - off;
+  if (len > DBG_GDB_MAX - 1)
+    len = DBG_GDB_MAX - 1;
+  // neither document has a character that needs escaping.
+  out[0] = off + len == n ? 'l' : 'm';
+  memcpy(out + 1, doc + off, len);
+  out[len + 1] = 0;
+}
+
+// the part after the last <c> (no strrchr in libpi).
+static const char *gdb_after(const char *s, char c) {
+  const char *last = s;
+  for (; *s; s++)
+    if (*s == c)
+      last = s + 1;
+  return last;
+}
+
+static int gdb_prefix(const char *s, const char *prefix) {
+  return strncmp(s, prefix, strlen(prefix)) == 0;
+}
+
+static void gdb_query(char *out, const char *p) {
+  if (gdb_prefix(p, "qSupported")) {
+    out = gdb_put_num(gdb_puts(out, "PacketSize="), DBG_GDB_MAX);
+    strcpy(out, ";qXfer:features:read+;qXfer:memory-map:read+"
+                ";QStartNoAckMode+");
+  } else if (gdb_prefix(p, "qXfer:features:read:target.xml:"))
+    gdb_xfer(out, gdb_target_xml, gdb_after(p, ':'));
+  else if (gdb_prefix(p, "qXfer:memory-map:read::"))
+    gdb_xfer(out, gdb_memory_map, gdb_after(p, ':'));
+  else if (strcmp(p, "qAttached") == 0)
+    strcpy(out, "1");
+  // one thread.
+  else if (strcmp(p, "qC") == 0)
+    strcpy(out, "QC1");
+  else if (strcmp(p, "qfThreadInfo") == 0)
+    strcpy(out, "m1");
+  else if (strcmp(p, "qsThreadInfo") == 0)
+    strcpy(out, "l");
+}
+
+// handle packets until one resumes the program.
+static void gdb_cmd_loop(regs_t *r) {
+  while (1) {
+    gdb_recv();
+    const char *p = gdb.in;
+    char *out = gdb.out.s;
+    uint32_t addr, n;
+    *out = 0;
+
+    switch (*p++) {
+    case '?':
+      strcpy(out, gdb.stop);
+      break;
+    case 'g':
+      gdb_put_bytes(out, r->regs, DBG_NREGS * 4);
+      break;
+    case 'G':
+      strcpy(out, gdb_get_bytes(&p, r->regs, DBG_NREGS * 4) ? "OK" : "E01");
+      break;
+    case 'p':
+      n = gdb_num(&p);
+      if (n < DBG_NREGS)
+        gdb_put_bytes(out, &r->regs[n], 4);
+      else
+        strcpy(out, "E01");
+      break;
+    case 'P':
+      n = gdb_num(&p);
+      if (n < DBG_NREGS && gdb_sep(&p, '=') &&
+          gdb_get_bytes(&p, &r->regs[n], 4))
+        strcpy(out, "OK");
+      else
+        strcpy(out, "E01");
+      break;
+
+    case 'm':
+      addr = gdb_num(&p);
+      n = gdb_sep(&p, ',') ? gdb_num(&p) : 0;
+      if (n * 2 <= DBG_GDB_MAX && gdb_mem_ok(addr, n))
+        gdb_put_bytes(out, (void *)addr, n);
+      else
+        strcpy(out, "E01");
+      break;
+    case 'M':
+      addr = gdb_num(&p);
+      n = gdb_sep(&p, ',') ? gdb_num(&p) : 0;
+      // a bad byte part way leaves the ones before it written, which
+      // is what gdb assumes anyway on an error.
+      if (gdb_sep(&p, ':') && gdb_mem_ok(addr, n) &&
+          gdb_get_bytes(&p, (void *)addr, n))
+        strcpy(out, "OK");
+      else
+        strcpy(out, "E01");
+      break;
+
+    case 'Z':
+    case 'z': {
+      uint32_t type = gdb_num(&p);
+      addr = gdb_sep(&p, ',') ? gdb_num(&p) : 0;
+      if (type > 4)
+        break;
+      strcpy(out, gdb_point(type, addr, gdb.in[0] == 'Z') ? "OK" : "E01");
+      break;
+    }
+
+    case 's':
+    case 'c':
+      if (*p)
+        r->regs[15] = gdb_num(&p);
+      gdb.step_p = gdb.in[0] == 's';
+      return;
+    case 'v':
+      if (strcmp(p, "Cont?") == 0)
+        strcpy(out, "vCont;c;C;s;S");
+      else if (gdb_prefix(p, "Cont;")) {
+        // one thread: the first action is the one.  a signal to
+        // deliver (C/S) is ignored.
+        char a = p[5];
+        if (a == 's' || a == 'S' || a == 'c' || a == 'C') {
+          gdb.step_p = a == 's' || a == 'S';
+          return;
+        }
+        strcpy(out, "E01");
+      }
+      break;
+
+    case 'q':
+      gdb_query(out, p - 1);
+      break;
+    case 'H': // set thread: there's only one.
+    case 'T': // thread alive.
+      strcpy(out, "OK");
+      break;
+
+    case 'D':
+      gdb_detach();
+      gdb_send("OK");
+      return;
+    case 'k':
+      // gdb doesn't wait for an answer.
+      clean_reboot();
+    }
+    gdb_send(out);
+  }
+}
+
+// report a stop and take packets until gdb resumes us.
+static void gdb_stop(regs_t *r, const char *reply) {
+  assert(strlen(reply) < sizeof gdb.stop);
+  strcpy(gdb.stop, reply);
+  gdb_send(reply);
+  gdb.started_p = 1;
+
+  gdb_cmd_loop(r);
+
+  // gdb usually takes its breakpoints out before resuming, but not
+  // with "breakpoint always-inserted".
+  bp_step_over(r->regs[15]);
+}
+
+static void gdb_rsp_step_handler(void *data, step_fault_t *s) {
+  regs_t *r = s->regs;
+  bp_step_over_done(gdb_rsp_step_handler);
+  gdb_watch_sync();
+  if (gdb.detached_p)
+    return;
+
+  if (!gdb.started_p || gdb.step_p ||
+      mini_bp_is_breakpoint((void *)r->regs[15]))
+    gdb_stop(r, "S05");
+}
+
+static void gdb_rsp_watch_handler(void *data, watch_fault_t *w) {
+  uint32_t addr = (uint32_t)w->fault_addr;
+  int i = gdb_watch_find(addr & ~3);
+  gdb.watch_hit = addr & ~3;
+  if (i < 0 || gdb.detached_p)
+    return;
+
+  // the hardware can't tell reads from writes: filter here.
+  const char *kind;
+  switch (gdb.watch[i].type) {
+  case 2:
+    if (w->is_load_p)
+      return;
+    kind = "T05watch:";
+    break;
+  case 3:
+    if (!w->is_load_p)
+      return;
+    kind = "T05rwatch:";
+    break;
+  default:
+    kind = "T05awatch:";
+    break;
+  }
+  char reply[32];
+  strcpy(gdb_put_num(gdb_puts(reply, kind), addr), ";");
+  gdb_stop(w->regs, reply);
+}
+
+// run <fn>(<arg>) under gdb: stops before the first instruction and
+// waits for gdb.  call <debugger_init> and <gdb_init> first.
+// returns <fn>'s result.
+static uint32_t gdb_stub_run(void (*fn)(void *), void *arg) {
+  mini_step_init(gdb_rsp_step_handler, 0);
+  uint32_t ret = mini_step_run(fn, arg);
+
+  // gdb is waiting on the resume that ran us off the end.
+  if (!gdb.detached_p) {
+    char reply[4] = "W";
+    gdb_put_bytes(reply + 1, &ret, 1);
+    gdb_send(reply);
+  }
+  return ret;
+}
+
+#endif
@@ -25,8 +25,11 @@ static watch_handler_t watchpt_handler[2];
 static void *watchpt_data[2];
 static int num_watchpoints = 0;
 
-// Tells you which watchpoint is the one looking at this address
+// Tells you which watchpoint is the one looking at this address.
+// watchpoints cover the whole word, so a byte access anywhere in it
+// matches.
 static int which_wp(void *addr) {
+  addr = (void *)((unsigned)addr & ~0b11);
   for (int i = 0; i < 2; i++) {
     if (which_wp_on[i] && wp_addr[i] == addr) {
       return i;
@@ -95,7 +98,6 @@ static int mini_watch_load_fault(void) { return datafault_from_ld(); }
 // handler.
 void watchpt_fault(regs_t *r) {
   void *fault_addr = (void *)cp15_far_get();
-  printk("[watchpt_fault] Got watchpoint fault on address %x\n", fault_addr);
   int triggered_watchpoint = which_wp(fault_addr);
 
   // watchpt handler.
@@ -156,8 +158,8 @@ void mini_watch_addr(void *addr, watch_handler_t h, void *data) {
   b = bits_set(b, 1, 2, 0b11); // for both user and privileged
   b = bits_set(b, 5, 8, 0b1111);
   b = bit_set(b, 0);
-  wp_val_set(num_watchpoints, addr);
-  wp_ctrl_set(num_watchpoints, b);
+  wp_val_set(this_wp_index, addr);
+  wp_ctrl_set(this_wp_index, b);
 
   watchpt_handler[this_wp_index] = h;
   watchpt_data[this_wp_index] = data;
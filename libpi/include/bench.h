@@ -0,0 +1,59 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+// micro-benchmark harness on top of <cycle-count.h>.
+//
+// <TIME_CYC> gives one number, which on real hardware is noisy: the
+// first runs pay for cold caches and the tlb, and any run can be hit
+// by an interrupt or a uart stall.  here we time an operation many
+// times and report the distribution:
+//   - the first <BENCH_WARMUP> samples are thrown away.
+//   - the cost of an empty <TIME_CYC> (measured by <bench_init>) is
+//     subtracted from every sample.
+//   - outliers are rejected with a tukey fence: anything above
+//     q3 + 3*(q3-q1) is dropped.  the spread is clamped to at least
+//     median/16 so that an operation that always takes exactly the
+//     same time doesn't reject its slightly slower runs.
+//   - min, median and p99 are over what's left.
+//
+// each result is one line:
+//      BENCH:<name>,<min>,<median>,<p99>,<n>,<nrejected>
+// which libunix/pi-bench.c turns into a csv and diffs against a
+// baseline.  names shouldn't have commas in them.
+#include "rpi.h"
+#include "cycle-count.h"
+
+enum {
+  BENCH_WARMUP = 8,
+  BENCH_MAX_SAMPLES = 1024,
+};
+
+typedef struct {
+  char name[64];
+  uint32_t min, median, p99, max;
+  unsigned n, nreject;
+} bench_res_t;
+
+// enables the cycle counter and measures the timing overhead.
+void bench_init(void);
+
+// start a new benchmark.  there's only one sample buffer, so finish
+// one before starting the next.  <fmt> is printk's.
+void bench_start(const char *fmt, ...);
+// add one sample, in raw cycles.
+void bench_add(uint32_t cyc);
+// compute, print and return the result.
+bench_res_t bench_done(void);
+
+// the empty <TIME_CYC> subtracted from each sample.
+uint32_t bench_overhead(void);
+
+// time <n> runs of <stmt> (plus the warm-up).
+#define BENCH(_n, _stmt, _fmt, _args...)                                       \
+  ({                                                                           \
+    bench_start(_fmt, ##_args);                                                \
+    for (unsigned _i = 0; _i < (_n) + BENCH_WARMUP; _i++)                      \
+      bench_add(TIME_CYC(_stmt));                                              \
+    bench_done();                                                              \
+  })
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef __BOOT_CHUNK_H__
+#define __BOOT_CHUNK_H__
+// pi side of the chunked upload in <boot-proto.h>: call from a
+// bootloader, then jump to the returned address.  the unix side is
+// <libunix/pi-boot.h>.
+#include "boot-proto.h"
+
+// receive an image that must land in [lo,hi).  blocks until a
+// complete image with a good crc is in memory (a bad one makes us
+// wait for unix to start over).  returns its address; its size is
+// written to <nbytes>.
+//
+// don't print while this runs: unix skips it, but it costs resends.
+uint32_t boot_chunk_get(uint32_t lo, uint32_t hi, uint32_t *nbytes);
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef __DBG_PROTO_H__
+#define __DBG_PROTO_H__
+// debugger wire protocol, on top of the reliable byte stream of the
+// framed uart protocol (<frame-proto.h>: uart_frame_write/read on the
+// pi, pi_frame_write/read on unix).  shared verbatim between libpi and
+// libunix: if you change one, copy it to the other.
+//
+// every message is a dbg_hdr_t followed by <nbytes> of payload.  the
+// pi only listens while the program is stopped:
+//
+//   unix                                 pi
+//                                   <-   DBG_POINTS (first stop only)
+//                                   <-   DBG_STOP {stop, values}
+//   DBG_MEM_READ {addr,n}           ->
+//                                   <-   DBG_MEM {addr,n,crc} bytes
+//   DBG_BP_SET {addr}               ->
+//                                   <-   DBG_POINTS {bp[], wp[]}
+//   DBG_STEP {n}                    ->   (runs)
+//                                   <-   DBG_TRACE_ENTS ... (if tracing)
+//                                   <-   DBG_STOP
+//
+// registers are sent as deltas: a bitmap of the ones that changed
+// since the last report followed by just their values.  single
+// stepping changes one or two, so a step costs a few words instead of
+// all 17.  stepping N instructions, running to a pc and tracing are
+// done on the pi: no round trip per instruction.  traced instructions
+// are compressed further (<dbg-trace.h>) and buffered on the pi until
+// the buffer fills or it stops.  break and watchpoint conditions are
+// checked on the pi too (<dbg-cond.h>).
+#include "frame-proto.h"
+
+enum { DBG_NREGS = 17 }; // r0-r15 + cpsr, same order as regs_t.
+enum { DBG_NBP = 5, DBG_NWP = 2 };
+
+// largest memory read or write in one message.
+enum { DBG_MEM_MAX = 4096 };
+
+// baud the unix side asks for once it has the pi's attention.
+enum { DBG_FAST_BAUD = 921600 };
+
+typedef struct {
+  uint32_t op;     // DBG_* below.
+  uint32_t nbytes; // of payload that follows.
+} dbg_hdr_t;
+
+// unix -> pi.  the resume ops (STEP, TRACE, UNTIL, CONTINUE) are
+// answered by the next DBG_STOP; all others get exactly one reply.
+enum {
+  DBG_STEP = 1,     // {u32 n}: run n instructions.
+  DBG_TRACE,        // {u32 n}: same, reporting every one in DBG_TRACE_ENTS.
+  DBG_UNTIL,        // {u32 pc}: run until about to execute <pc>.
+  DBG_CONTINUE,     // {}: run until a break or watchpoint.
+  DBG_BP_SET,       // {u32 addr}  -> DBG_POINTS
+  DBG_BP_CLR,       // {u32 addr}  -> DBG_POINTS
+  DBG_WP_SET,       // {u32 addr}  -> DBG_POINTS
+  DBG_WP_CLR,       // {u32 addr}  -> DBG_POINTS
+  DBG_REG_WRITE,    // {u32 reg, u32 val}  -> DBG_OK / DBG_ERR
+  DBG_MEM_READ,     // {u32 addr, u32 n}   -> DBG_MEM / DBG_ERR
+  DBG_MEM_WRITE,    // {u32 addr, u32 n, u32 crc} bytes -> DBG_OK / DBG_ERR
+  DBG_COND_SET,     // {u32 kind, u32 addr, u32 ignore, u32 n} code
+                    //   -> DBG_OK / DBG_ERR.  see <dbg-cond.h>.
+
+  // pi -> unix.
+  DBG_STOP = 0x20, // dbg_stop_t, then one u32 per bit set in <mask>.
+  DBG_TRACE_ENTS,  // u32 nent, u32 nbytes, then <dbg-trace.h> entries.
+  DBG_POINTS,      // u32 bp[DBG_NBP] (0 = off), u32 wp[DBG_NWP] (~0 = off)
+  DBG_MEM,         // {u32 addr, u32 n, u32 crc}, then n bytes.
+  DBG_OK,          // {}
+  DBG_ERR,         // {u32 DBG_E_*}
+
+  // both ways, when the pi runs debugger/code/gdb-stub.h instead: the
+  // body of one gdb remote serial protocol packet, without the $, #
+  // and checksum (the frame layer has its own).  see <pi-gdb.h>.
+  DBG_GDB = 0x40,
+};
+
+// largest DBG_GDB body.
+enum { DBG_GDB_MAX = 4096 };
+
+// why we stopped.
+enum {
+  DBG_STOP_START = 1, // first instruction.
+  DBG_STOP_STEP,      // did the N instructions asked for.
+  DBG_STOP_UNTIL,     // reached the <DBG_UNTIL> pc.
+  DBG_STOP_BP,        // breakpoint.
+  DBG_STOP_WP,        // watchpoint: <addr> is the data address.  we
+                      // stop once the access is done.
+};
+
+// DBG_COND_SET: the point stops only when its condition holds, and
+// then not the first <ignore> times.  n = 0 is no condition.  it's
+// dropped when the point is cleared.
+enum { DBG_COND_BP = 0, DBG_COND_WP = 1 };
+
+enum {
+  DBG_E_BAD_OP = 1,
+  DBG_E_BAD_REG,
+  DBG_E_TOO_BIG, // more than DBG_MEM_MAX bytes.
+  DBG_E_BAD_CRC, // memory write payload didn't match its crc.
+  DBG_E_BAD_COND, // DBG_COND_SET malformed or out of slots.
+};
+
+typedef struct {
+  uint32_t reason; // DBG_STOP_*
+  uint32_t addr;   // watchpoint data address, else 0.
+  uint32_t nsteps; // instructions run since the last stop.
+  uint32_t mask;   // bit i set: regs[i] changed and follows.
+} dbg_stop_t;
+
+// no libgcc on the pi, so no __builtin_popcount.
+static inline unsigned dbg_nbits(uint32_t mask) {
+  unsigned n = 0;
+  for (; mask; mask &= mask - 1)
+    n++;
+  return n;
+}
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef __DBG_TRACE_H__
+#define __DBG_TRACE_H__
+// compressed instruction trace: the payload of DBG_TRACE_ENTS
+// (<dbg-proto.h>).  shared verbatim between libpi and libunix: if you
+// change one, copy it to the other.
+//
+// one entry per executed instruction: its pc and the registers that
+// changed, both against the registers as of the entry before.  most
+// instructions fall through and write one register by a small amount,
+// so the common entry is two bytes instead of a mask and two words.
+//
+//   tag byte:
+//     bits 7:6  pc:   DBG_TR_SEQ   pc+4
+//                     DBG_TR_NEAR  pc+4 + 4*int8, one byte follows
+//                     DBG_TR_FAR   the new pc, four bytes follow
+//     bits 5:0  regs: 0            none changed
+//                     1..17        just register (n-1)
+//                     DBG_TR_MASK  a 3 byte mask of them follows
+//   then each changed register, lowest first, as a varint (7 bits a
+//   byte, low first, top bit = more): zigzag(new - old) so small
+//   changes either way are one byte, except cpsr, which is
+//   (new ^ old) rotated so the flags land in the low bits.
+//
+// the pc (r15) is never in the register part.
+#include "dbg-proto.h"
+
+enum { DBG_TR_SEQ = 0, DBG_TR_NEAR = 1, DBG_TR_FAR = 2 };
+enum { DBG_TR_MASK = 63 };
+
+// biggest entry: tag, far pc, mask, 16 five byte varints.
+enum { DBG_TRACE_ENT_MAX = 1 + 4 + 3 + 16 * 5 };
+
+// the pi buffers this much trace before sending it.
+enum { DBG_TRACE_BUF = 16 * 1024 };
+
+static inline uint32_t dbg_tr_delta(unsigned reg, uint32_t old, uint32_t new) {
+  if (reg == 16) {
+    uint32_t x = old ^ new;
+    return x >> 28 | x << 4;
+  }
+  uint32_t d = new - old;
+  return d << 1 ^ -(d >> 31);
+}
+
+static inline uint32_t dbg_tr_undelta(unsigned reg, uint32_t old, uint32_t x) {
+  if (reg == 16)
+    return old ^ (x << 28 | x >> 4);
+  return old + (x >> 1 ^ -(x & 1));
+}
+
+// append entry for <regs> to <out>, updating <last> to match.  returns
+// the bytes used (at most DBG_TRACE_ENT_MAX).
+static inline unsigned dbg_trace_enc(uint8_t *out, uint32_t *last,
+                                     const uint32_t *regs) {
+  uint8_t *p = out + 1;
+  unsigned tag;
+
+  uint32_t pc = regs[15], next = last[15] + 4;
+  int32_t off = (int32_t)(pc - next) / 4;
+  if (pc == next)
+    tag = DBG_TR_SEQ << 6;
+  else if (((pc - next) & 3) == 0 && off >= -128 && off <= 127) {
+    tag = DBG_TR_NEAR << 6;
+    *p++ = off;
+  } else {
+    tag = DBG_TR_FAR << 6;
+    for (unsigned i = 0; i < 4; i++)
+      *p++ = pc >> (8 * i);
+  }
+  last[15] = pc;
+
+  uint32_t mask = 0;
+  unsigned n = 0, reg = 0;
+  for (unsigned i = 0; i < DBG_NREGS; i++) {
+    if (i == 15 || regs[i] == last[i])
+      continue;
+    mask |= 1 << i;
+    n++;
+    reg = i;
+  }
+  if (n == 1)
+    tag |= reg + 1;
+  else if (n) {
+    tag |= DBG_TR_MASK;
+    *p++ = mask;
+    *p++ = mask >> 8;
+    *p++ = mask >> 16;
+  }
+  out[0] = tag;
+
+  for (unsigned i = 0; mask; i++, mask >>= 1) {
+    if (!(mask & 1))
+      continue;
+    uint32_t x = dbg_tr_delta(i, last[i], regs[i]);
+    for (; x >= 0x80; x >>= 7)
+      *p++ = x | 0x80;
+    *p++ = x;
+    last[i] = regs[i];
+  }
+  return p - out;
+}
+
+// apply the entry at <in> to <regs>.  returns the bytes used.
+static inline unsigned dbg_trace_dec(const uint8_t *in, uint32_t *regs) {
+  const uint8_t *p = in + 1;
+  unsigned tag = in[0];
+
+  switch (tag >> 6) {
+  case DBG_TR_SEQ:
+    regs[15] += 4;
+    break;
+  case DBG_TR_NEAR:
+    regs[15] += 4 + 4 * (int8_t)*p++;
+    break;
+  default:
+    regs[15] = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+    p += 4;
+    break;
+  }
+
+  uint32_t mask;
+  unsigned r = tag & 63;
+  if (!r)
+    return p - in;
+  if (r == DBG_TR_MASK) {
+    mask = p[0] | p[1] << 8 | p[2] << 16;
+    p += 3;
+  } else
+    mask = 1 << (r - 1);
+
+  for (unsigned i = 0; mask; i++, mask >>= 1) {
+    if (!(mask & 1))
+      continue;
+    uint32_t x = 0;
+    for (unsigned shift = 0;; shift += 7) {
+      x |= (uint32_t)(*p & 0x7f) << shift;
+      if (!(*p++ & 0x80))
+        break;
+    }
+    regs[i] = dbg_tr_undelta(i, regs[i], x);
+  }
+  return p - in;
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef __FRAME_PROTO_H__
+#define __FRAME_PROTO_H__
+// wire format for framed, crc-checked transfers between unix and the
+// pi over the uart.  this file is shared verbatim between libpi and
+// libunix: if you change one, copy it to the other.
+//
+// each frame is:
+//      FRAME_MAGIC (u32)
+//      frame_hdr_t (type, seq, len)
+//      payload     (<len> bytes, len <= FRAME_MAXLEN)
+//      crc         (u32: our_crc32 of hdr + payload)
+// all fields are little-endian.  the magic lets the receiver resync
+// past anything that isn't a frame (boot messages, printk output).
+//
+// the protocol is stop-and-wait: every data frame is acked (or nak'd
+// on a bad crc) before the next one goes out, and only one side sends
+// data at a time.  frames are large enough that the ack turnaround is
+// small compared to the time on the wire.
+#include <stdint.h>
+
+enum { FRAME_MAGIC = 0x454d5246 }; // "FRME"
+enum { FRAME_MAXLEN = 1024 };
+
+typedef struct {
+  uint8_t type;
+  uint8_t seq;
+  uint16_t len;
+} frame_hdr_t;
+_Static_assert(sizeof(frame_hdr_t) == 4, "frame header should be 4 bytes");
+
+// magic + header + crc.
+enum { FRAME_OVERHEAD = 4 + sizeof(frame_hdr_t) + 4 };
+
+enum {
+  FRAME_DATA = 1, // payload for the application.
+  FRAME_ACK,      // frame <seq> received ok.
+  FRAME_NAK,      // frame <seq> had a bad crc: resend.
+  FRAME_BAUD_REQ, // payload = u32 baud: switch after acking.
+  FRAME_BAUD_ACK, // payload = u32 baud: switching now.
+  FRAME_BAUD_NAK, // payload = u32 current baud: can't do that rate.
+  FRAME_PING,     // answered with a ping: confirms a baud switch.
+};
+// only data frames use up a sequence number: control frames carry the
+// sender's current one so replies can be matched, and every reply type
+// is distinct so a late one can't be mistaken for a data ack.
+
+// result of receiving a single frame.
+enum { FRAME_BAD = -1, FRAME_TIMEOUT = 0, FRAME_OK = 1 };
+
+// how long to wait for an ack beyond the time the frame itself takes
+// on the wire, and how many times to resend before giving up.
+enum { FRAME_TIMEOUT_USEC = 100 * 1000, FRAME_RETRIES = 8 };
+
+// after acking a baud switch, how long the responder waits for a ping
+// at the new rate before falling back to the old one.  has to be
+// longer than the initiator will keep pinging.
+enum { FRAME_BAUD_TIMEOUT_USEC = 2 * FRAME_RETRIES * FRAME_TIMEOUT_USEC };
+
+// the default rate everyone starts at (and the bootloader expects).
+enum { FRAME_DEFAULT_BAUD = 115200 };
+
+// usec for <n> payload bytes to go over the wire at <baud> using 8n1
+// (10 bits per byte).  baud is assumed to be >= 1000.
+static inline unsigned frame_wire_usec(unsigned baud, unsigned n) {
+  return (n + FRAME_OVERHEAD) * 10 * 1000 / (baud / 1000);
+}
+
+#endif
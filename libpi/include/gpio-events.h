@@ -0,0 +1,40 @@
+#ifndef __GPIO_EVENTS_H__
+#define __GPIO_EVENTS_H__
+// capture gpio edges from the interrupt handler into a ring of
+// timestamped events, so input changes aren't lost between polls.
+//
+// like <pc-prof.h>, we don't own the interrupt vector: the caller's
+// handler calls <gpio_events_interrupt>, and code outside the
+// handler pops the events.  the ring is a single producer /
+// single consumer <gen_circular_T>, so popping doesn't need
+// interrupts off.
+#include "rpi.h"
+
+// size of the ring: it holds <GPIO_EV_N>-1 events.
+enum { GPIO_EV_N = 256 };
+
+typedef struct {
+  uint32_t cyc;   // cycle counter when the handler saw the event.
+  uint32_t usec;  // <timer_get_usec> at the same time.
+  uint32_t pin;
+  uint32_t level; // the pin's level then: 1 = it rose, 0 = it fell
+                  // (unless it changed again in between).
+} gpio_ev_t;
+
+// set the pins in <rising> | <falling> to input and capture their
+// rising and falling edges (bit <i> = pin <i>, see <gpio_write_mask>).
+// empties the ring.  the caller enables interrupts.
+void gpio_events_init(uint64_t rising, uint64_t falling);
+
+// call from the interrupt handler.  if a pin we capture has an event,
+// push one per pin (in pin order), clear them, and return 1.  returns
+// 0 if the interrupt wasn't ours.
+int gpio_events_interrupt(void);
+
+// pop the oldest event into <e>: 0 if there isn't one.
+int gpio_events_pop(gpio_ev_t *e);
+
+// events dropped because the ring was full.
+unsigned gpio_events_lost(void);
+
+#endif
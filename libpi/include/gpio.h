@@ -102,4 +102,32 @@ int gpio_event_detected(unsigned pin);
 // p96: have to write a 1 to the pin to clear the event.
 void gpio_event_clear(unsigned pin);
 
+/*****************************************************************
+ * many pins at once: bit <i> of <pins> is gpio pin <i> (0..53).
+ * the set, clear, level and event registers take a whole bank (32
+ * pins) per access, so these cost one or two accesses however many
+ * pins there are, rather than one (or a read-modify-write) per pin.
+ * unlike the single-pin calls, any pin can be used: pins 32..53 are
+ * the sd card and friends, so be careful.
+ */
+
+// pins in <pins> whose bit in <val> is 1 go high, the rest low.
+void gpio_write_mask(uint64_t pins, uint64_t val);
+
+// the level of each pin in <pins>; other bits are 0.
+uint64_t gpio_read_mask(uint64_t pins);
+
+// set every pin in <pins> to <function>: one read-modify-write per
+// function select register (ten pins each) with a pin in <pins>.
+void gpio_set_function_mask(uint64_t pins, gpio_func_t function);
+
+// detect rising edges on <rising> and falling edges on <falling>, in
+// addition to whatever is already set up, and enable the gpio
+// interrupt for each bank with a pin in them (GPIO_INT0 for pins
+// 0..31, GPIO_INT1 for 32..53).
+void gpio_int_edge_mask(uint64_t rising, uint64_t falling);
+
+// which pins in <pins> have an event: clears them.
+uint64_t gpio_event_take_mask(uint64_t pins);
+
 #endif
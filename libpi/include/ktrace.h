@@ -0,0 +1,100 @@
+#ifndef __KTRACE_H__
+#define __KTRACE_H__
+// binary kernel trace ring.
+//
+// printk tracing formats text and spins on the uart inside the
+// code we are trying to observe, which changes the timing enough
+// to hide scheduling and i/o bugs.  instead each event is a fixed
+// 16-byte record (cycle count, event id, two payload words) dropped
+// into a static ring.  the ring is shipped in one binary blob with
+// <ktrace_dump> and decoded on the unix side (libunix/ktrace-decode.c).
+//
+// cost:
+//   - compiled out entirely with -DKTRACE_OFF.
+//   - otherwise, when disabled: one load and a not-taken branch.
+//   - when enabled: a cycle counter read and four stores.
+//
+// concurrency: single producer.  every emitter runs with interrupts
+// off (exception handlers, or kernel code before <eqx_run_threads>
+// enables them) so there is no lock: we fill the slot and then bump
+// <head>.  when full we overwrite the oldest entry.
+#include "rpi.h"
+#include "cycle-count.h"
+
+// define the event id enums.
+enum {
+#define XX(name, str, a0_str, a1_str) name,
+#define KTRACE_GET_EVENTS
+#include "ktrace-events.h"
+#undef KTRACE_GET_EVENTS
+#undef XX
+  KT_NEVENTS
+};
+
+typedef struct {
+  uint32_t cyc;    // cycle counter when emitted.
+  uint32_t id;     // KT_* event id.
+  uint32_t a0, a1; // event specific payload.
+} ktrace_ent_t;
+_Static_assert(sizeof(ktrace_ent_t) == 16, "wire format is 16 bytes");
+
+enum {
+  // must be a power of two.
+  KTRACE_NENT = 1024,
+  // "KTRC": start of a dump on the uart.
+  KTRACE_MAGIC = 0x4b545243,
+};
+_Static_assert((KTRACE_NENT & (KTRACE_NENT - 1)) == 0, "not a power of 2");
+
+typedef struct {
+  // total number of events ever emitted: never wraps back.
+  volatile uint32_t head;
+  ktrace_ent_t ents[KTRACE_NENT];
+} ktrace_ring_t;
+
+extern ktrace_ring_t ktrace_ring;
+extern int ktrace_on_p;
+
+static inline void ktrace_emit(uint32_t id, uint32_t a0, uint32_t a1) {
+  uint32_t n = ktrace_ring.head;
+  ktrace_ent_t *e = &ktrace_ring.ents[n & (KTRACE_NENT - 1)];
+  e->cyc = cycle_cnt_read();
+  e->id = id;
+  e->a0 = a0;
+  e->a1 = a1;
+  // publish after the record is written.
+  gcc_mb();
+  ktrace_ring.head = n + 1;
+}
+
+#ifdef KTRACE_OFF
+#define ktrace(id, a0, a1)                                                     \
+  do {                                                                         \
+  } while (0)
+#else
+#define ktrace(id, a0, a1)                                                     \
+  do {                                                                         \
+    if (unlikely(ktrace_on_p))                                                 \
+      ktrace_emit(id, (uint32_t)(a0), (uint32_t)(a1));                         \
+  } while (0)
+#endif
+
+// clear the ring, start the cycle counter and enable tracing.
+void ktrace_init(void);
+
+// turn tracing on (1) or off (0): returns the previous value.
+int ktrace_enable(int on_p);
+
+// drop all recorded events.
+void ktrace_reset(void);
+
+// number of events currently held in the ring.
+unsigned ktrace_nevents(void);
+
+// ship the ring over the uart.  format (all little-endian words):
+//   KTRACE_MAGIC, sizeof(ktrace_ent_t), nent, ndropped,
+//   nent entries (oldest first), crc32 of the entries.
+// tracing is paused while dumping.
+void ktrace_dump(void);
+
+#endif
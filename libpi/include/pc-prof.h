@@ -0,0 +1,68 @@
+#ifndef __PC_PROF_H__
+#define __PC_PROF_H__
+// statistical pc-sampling profiler.
+//
+// the single-step profiler (gprof_* in debugger/code/debugger.h) takes
+// a mismatch fault on every instruction: the program runs orders of
+// magnitude slower and the profile mostly measures the fault path.
+// instead, whatever periodic interrupt the caller already has (e.g.,
+// the arm timer in <interrupt_full_except>) hands us the interrupted
+// <pc> and <lr> and we bump two histograms:
+//   - <pc>: where time is spent (flat profile).
+//   - <lr>: which call site the interrupted function was called from,
+//     so the unix side can also charge time to callers.  this is only
+//     right when the function hasn't reused <lr> yet (leaf code, or
+//     the prologue): treat it as a hint, not a call graph.
+//
+// one counter per instruction word in [lo, hi); samples outside are
+// counted in <nmiss>.  <pc_prof_dump> prints the non-zero buckets as
+// "PCPROF:" lines which libunix/pi-prof.c folds with the .list file.
+//
+// cost when off: one load and a not-taken branch.
+#include "rpi.h"
+
+typedef struct {
+  uint32_t lo, hi;
+  uint32_t nsamples, nmiss;
+  uint32_t *pc_hist, *lr_hist; // (hi-lo)/4 entries each.
+} pc_prof_t;
+
+extern pc_prof_t pc_prof;
+extern int pc_prof_on_p;
+
+// record one sample.  call with interrupts off.
+static inline void pc_prof_sample(uint32_t pc, uint32_t lr) {
+  if (likely(!pc_prof_on_p))
+    return;
+  pc_prof.nsamples++;
+
+  // unsigned compare also rejects addresses below <lo>.
+  uint32_t nbytes = pc_prof.hi - pc_prof.lo;
+  if (pc - pc_prof.lo >= nbytes) {
+    pc_prof.nmiss++;
+    return;
+  }
+  pc_prof.pc_hist[(pc - pc_prof.lo) / 4]++;
+  if (lr - pc_prof.lo < nbytes)
+    pc_prof.lr_hist[(lr - pc_prof.lo) / 4]++;
+}
+
+// allocate (kmalloc) histograms for the code in [lo, hi) and enable
+// sampling.  can be called again to profile a different range.
+void pc_prof_init(uint32_t lo, uint32_t hi);
+
+// turn sampling on (1) or off (0): returns the previous value.
+int pc_prof_enable(int on_p);
+
+// zero the counts, keep the range.
+void pc_prof_reset(void);
+
+// print the profile: sampling is paused while dumping.
+//   PCPROF:begin lo=<hex> hi=<hex> nsamples=<n> nmiss=<n>
+//   PCPROF:pc <hex addr> <count>       (one per non-zero bucket)
+//   PCPROF:lr <hex addr> <count>
+//   PCPROF:end
+// buckets with count <= <min_count> are skipped.
+void pc_prof_dump(unsigned min_count);
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef __PERF_H__
+#define __PERF_H__
+// hardware counter accounting on top of <armv6-pmu.h>.
+//
+// the arm1176 pmu has a cycle counter and two event counters, so at
+// most two events can be counted at once: <perf_init> picks one of
+// the <PERF_GROUP_*> pairs.  the counters are free running and global;
+// everything here works on snapshots (<perf_read>) and adds the
+// difference between two of them to a <perf_acc_t>.  the kernel uses
+// that to virtualize them per thread and per system call.
+//
+// this file also owns the accumulators for the fixed kernel paths
+// (sd card, fat32) so that libfs can charge to them without knowing
+// about the os.  path totals are inclusive: fat32 reads include the
+// sd reads they do.
+//
+// the counters are 32 bits: cycles wrap after ~6 seconds at 700MHz,
+// so a single interval has to be shorter than that.  the sums are
+// 64 bits so totals over a whole run are right.
+#include "rpi.h"
+#include "armv6-pmu.h"
+
+// which pair of events counters 0 and 1 count.
+enum {
+  PERF_GROUP_CACHE, // icache miss, dcache miss.
+  PERF_GROUP_TLB,   // main tlb miss, instructions.
+  PERF_NGROUPS
+};
+
+// a raw snapshot of the counters.
+typedef struct {
+  uint32_t cyc, ev0, ev1;
+} perf_cnt_t;
+
+// accumulated deltas.
+typedef struct {
+  uint32_t n; // number of intervals added.
+  uint64_t cyc, ev0, ev1;
+} perf_acc_t;
+
+// kernel paths with their own accumulator.
+enum {
+  PERF_SD_READ,
+  PERF_SD_WRITE,
+  PERF_FAT32_READDIR,
+  PERF_FAT32_READ,
+  PERF_NPATHS
+};
+
+extern int perf_on_p;
+extern perf_acc_t perf_paths[PERF_NPATHS];
+
+static inline perf_cnt_t perf_read(void) {
+  return (perf_cnt_t){
+      .cyc = pmu_cycle_get(),
+      .ev0 = pmu_event0_get(),
+      .ev1 = pmu_event1_get(),
+  };
+}
+
+// add [start, end) to <a>.
+static inline void perf_acc_add(perf_acc_t *a, perf_cnt_t start,
+                                perf_cnt_t end) {
+  a->n++;
+  // the 32-bit difference is right across a wrap.
+  a->cyc += (uint32_t)(end.cyc - start.cyc);
+  a->ev0 += (uint32_t)(end.ev0 - start.ev0);
+  a->ev1 += (uint32_t)(end.ev1 - start.ev1);
+}
+
+// add [start, now) to <a>; returns now.
+static inline perf_cnt_t perf_acc(perf_acc_t *a, perf_cnt_t start) {
+  perf_cnt_t now = perf_read();
+  perf_acc_add(a, start, now);
+  return now;
+}
+
+// bracket a kernel path:
+//    perf_path_begin(s);
+//    ... read the sd card ...
+//    perf_path_end(PERF_SD_READ, s);
+// costs a load and a not-taken branch when perf is off.
+#define perf_path_begin(_s)                                                    \
+  perf_cnt_t _s = unlikely(perf_on_p) ? perf_read() : (perf_cnt_t){0}
+#define perf_path_end(_path, _s)                                               \
+  do {                                                                         \
+    if (unlikely(perf_on_p))                                                   \
+      perf_acc(&perf_paths[_path], _s);                                        \
+  } while (0)
+
+// program the pmu to count <group>, zero the path totals and
+// start accounting.
+void perf_init(unsigned group);
+
+// names of the two events being counted.
+const char *perf_ev0_str(void);
+const char *perf_ev1_str(void);
+
+// print the column header and one row per accumulator.
+void perf_print_hdr(const char *what);
+void perf_print(const char *name, perf_acc_t *a);
+
+// print the kernel path totals (skips ones never hit).
+void perf_paths_dump(void);
+
+#endif
@@ -83,6 +83,13 @@ int uart_can_putc(void);
 // flush out the tx fifo
 void uart_flush_tx(void);
 
+// 1 if the mini-uart can run at <baud>, 0 otherwise.
+int uart_baud_ok(unsigned baud);
+// switch to <baud> (after flushing tx).  returns 0 if unsupported.
+int uart_set_baud(unsigned baud);
+// current baud rate.
+unsigned uart_get_baud(void);
+
 // forcibly disable the uart.
 void hw_uart_disable(void);
 
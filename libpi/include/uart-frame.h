@@ -0,0 +1,35 @@
+#ifndef __UART_FRAME_H__
+#define __UART_FRAME_H__
+// framed, crc-checked transfers over the mini-uart.  the wire format
+// is in <frame-proto.h>; the unix side is <libunix/pi-frame.h>.
+//
+// use for bulk data (logs, traces, memory dumps): you get a checksum
+// and resend per frame, and can switch to a much faster baud rate
+// than the 115200 everything boots at.
+//
+// don't mix printk output with frames while the unix side is in the
+// middle of a read: it gets skipped, but costs a resend.
+#include "frame-proto.h"
+
+// send a single frame.  no ack.
+void uart_frame_send(unsigned type, unsigned seq, const void *data, unsigned n);
+
+// receive a single frame into <h> and <buf> (which must hold
+// FRAME_MAXLEN bytes).  <usec>=0 means wait forever.
+// returns FRAME_OK, FRAME_TIMEOUT or FRAME_BAD.
+int uart_frame_recv(frame_hdr_t *h, void *buf, uint32_t usec);
+
+// reliably send <n> bytes, split into as many frames as needed.
+// returns 1 on success, 0 if the other side stopped acking.
+int uart_frame_write(const void *data, unsigned n);
+
+// read exactly <n> bytes from incoming data frames.  blocks.  baud
+// switch requests and pings from unix are handled in here.
+void uart_frame_read(void *data, unsigned n);
+
+// handle a control frame (baud switch request, ping) that showed up
+// while running your own protocol on top of <uart_frame_recv>.
+// returns 1 if <h> was one, 0 otherwise.
+int uart_frame_ctl(frame_hdr_t *h, const void *payload);
+
+#endif
@@ -50,13 +50,63 @@ static uint32_t crc32_tab[] = {
     0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
     0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d};
 
-uint32_t our_crc32_inc(const void *buf, unsigned size, uint32_t crc) {
-  const uint8_t *p = buf;
+// crc32_tab8[k][b] is the crc of byte <b> followed by <k> zero bytes,
+// so 8 table lookups fold 8 bytes at once (intel's "slice-by-8").
+// built from crc32_tab on first use: 8KB of bss rather than 8KB of
+// table in the source.
+static uint32_t crc32_tab8[8][256];
+static int crc32_tab8_init_p;
+
+static void crc32_tab8_init(void) {
+  for (unsigned i = 0; i < 256; i++) {
+    uint32_t c = crc32_tab8[0][i] = crc32_tab[i];
+    for (unsigned k = 1; k < 8; k++)
+      c = crc32_tab8[k][i] = (c >> 8) ^ crc32_tab[c & 0xff];
+  }
+  crc32_tab8_init_p = 1;
+}
 
-  crc = crc ^ ~0U;
+// the <_raw> routines work on the un-inverted crc.
+static uint32_t crc32_byte_raw(const uint8_t *p, unsigned size, uint32_t crc) {
   while (size--)
     crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
-  return crc ^ ~0U;
+  return crc;
+}
+
+static uint32_t crc32_slice8_raw(const uint8_t *p, unsigned size,
+                                 uint32_t crc) {
+  if (!crc32_tab8_init_p)
+    crc32_tab8_init();
+
+  // word loads need alignment on the pi.
+  for (; size && ((uintptr_t)p & 3); size--)
+    crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+  // little-endian: the low byte of each word comes first.
+  const uint32_t *w = (const void *)p;
+  for (; size >= 8; size -= 8) {
+    uint32_t a = *w++ ^ crc, b = *w++;
+    crc = crc32_tab8[7][a & 0xff] ^ crc32_tab8[6][(a >> 8) & 0xff] ^
+          crc32_tab8[5][(a >> 16) & 0xff] ^ crc32_tab8[4][a >> 24] ^
+          crc32_tab8[3][b & 0xff] ^ crc32_tab8[2][(b >> 8) & 0xff] ^
+          crc32_tab8[1][(b >> 16) & 0xff] ^ crc32_tab8[0][b >> 24];
+  }
+  return crc32_byte_raw((const void *)w, size, crc);
+}
+
+uint32_t our_crc32_inc_byte(const void *buf, unsigned size, uint32_t crc) {
+  return ~crc32_byte_raw(buf, size, ~crc);
+}
+
+uint32_t our_crc32_inc_slice8(const void *buf, unsigned size, uint32_t crc) {
+  return ~crc32_slice8_raw(buf, size, ~crc);
+}
+
+// short buffers aren't worth the alignment fixup.
+uint32_t our_crc32_inc(const void *buf, unsigned size, uint32_t crc) {
+  if (size < 16)
+    return our_crc32_inc_byte(buf, size, crc);
+  return our_crc32_inc_slice8(buf, size, crc);
 }
 
 uint32_t our_crc32(const void *buf, unsigned size) {
@@ -5,4 +5,9 @@
 uint32_t our_crc32(const void *buf, unsigned size);
 uint32_t our_crc32_inc(const void *buf, unsigned size, uint32_t crc);
 
+// the implementations <our_crc32_inc> picks between: all give the
+// same answer, exported so they can be checked against each other.
+uint32_t our_crc32_inc_byte(const void *buf, unsigned size, uint32_t crc);
+uint32_t our_crc32_inc_slice8(const void *buf, unsigned size, uint32_t crc);
+
 #endif
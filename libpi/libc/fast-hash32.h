@@ -66,12 +66,26 @@ static inline uint32_t fast_hash_inc32(const void *_data, uint32_t len,
   len >>= 2;
 
   /* Main loop */
-  for (; len > 0; len--) {
-    hash += get16bits(data);
-    tmp = (get16bits(data + 2) << 11) ^ hash;
-    hash = (hash << 16) ^ tmp;
-    data += 2 * sizeof(uint16_t);
-    hash += hash >> 11;
+  if (((uintptr_t)data & 3) == 0) {
+    // aligned: one word load instead of four byte loads.  the low
+    // half is the first get16bits since we're little-endian.
+    const uint32_t *w = (const void *)data;
+    for (; len > 0; len--) {
+      uint32_t x = *w++;
+      hash += x & 0xffff;
+      tmp = ((x >> 16) << 11) ^ hash;
+      hash = (hash << 16) ^ tmp;
+      hash += hash >> 11;
+    }
+    data = (const void *)w;
+  } else {
+    for (; len > 0; len--) {
+      hash += get16bits(data);
+      tmp = (get16bits(data + 2) << 11) ^ hash;
+      hash = (hash << 16) ^ tmp;
+      data += 2 * sizeof(uint16_t);
+      hash += hash >> 11;
+    }
   }
 
   /* Handle end cases */
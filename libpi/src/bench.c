@@ -0,0 +1,85 @@
+// micro-benchmark harness: see <bench.h>
+#include "rpi.h"
+#include "bench.h"
+
+static uint32_t overhead;
+
+static struct {
+  bench_res_t r;
+  unsigned nseen; // including the warm-up.
+  unsigned n;
+  uint32_t samples[BENCH_MAX_SAMPLES];
+} b;
+
+void bench_init(void) {
+  cycle_cnt_init();
+  // the smallest empty measurement: what every sample pays.
+  uint32_t min = ~0;
+  for (unsigned i = 0; i < 64; i++) {
+    uint32_t t = TIME_CYC(gcc_mb());
+    if (t < min)
+      min = t;
+  }
+  overhead = min;
+}
+
+uint32_t bench_overhead(void) { return overhead; }
+
+void bench_start(const char *fmt, ...) {
+  memset(&b.r, 0, sizeof b.r);
+  va_list args;
+  va_start(args, fmt);
+  vsnprintk(b.r.name, sizeof b.r.name, fmt, args);
+  va_end(args);
+  b.nseen = b.n = 0;
+}
+
+void bench_add(uint32_t cyc) {
+  if (b.nseen++ < BENCH_WARMUP)
+    return;
+  if (b.n == BENCH_MAX_SAMPLES)
+    panic("bench <%s>: more than %d samples\n", b.r.name, BENCH_MAX_SAMPLES);
+  b.samples[b.n++] = cyc > overhead ? cyc - overhead : 0;
+}
+
+// the samples are smallish and this runs between measurements.
+static void sort(uint32_t *v, unsigned n) {
+  for (unsigned i = 1; i < n; i++) {
+    uint32_t x = v[i];
+    unsigned j = i;
+    for (; j && v[j - 1] > x; j--)
+      v[j] = v[j - 1];
+    v[j] = x;
+  }
+}
+
+bench_res_t bench_done(void) {
+  bench_res_t *r = &b.r;
+  unsigned n = b.n;
+  if (!n)
+    panic("bench <%s>: no samples past the warm-up\n", r->name);
+  uint32_t *s = b.samples;
+  sort(s, n);
+
+  uint32_t q1 = s[n / 4], q3 = s[(3 * n) / 4], med = s[n / 2];
+  uint32_t spread = q3 - q1;
+  if (spread < med / 16)
+    spread = med / 16;
+  uint32_t fence = q3 + 3 * spread;
+
+  // sorted: the outliers are a suffix.
+  unsigned m = n;
+  while (m > 1 && s[m - 1] > fence)
+    m--;
+
+  r->n = m;
+  r->nreject = n - m;
+  r->min = s[0];
+  r->median = s[m / 2];
+  r->p99 = s[(m * 99) / 100];
+  r->max = s[m - 1];
+
+  output("BENCH:%s,%d,%d,%d,%d,%d\n", r->name, r->min, r->median, r->p99,
+         r->n, r->nreject);
+  return *r;
+}
@@ -0,0 +1,97 @@
+// chunked image upload: see <boot-proto.h> and <boot-chunk.h>.
+#include "rpi.h"
+#include "boot-chunk.h"
+#include "uart-frame.h"
+#include "libc/crc.h"
+
+static void boot_error(unsigned seq, uint32_t code) {
+  uart_frame_send(BOOT_ERROR, seq, &code, sizeof code);
+}
+
+// send the crc of every chunk currently at <addr>.
+static void send_hashes(unsigned seq, const boot_hello_t *b) {
+  const uint8_t *p = (const void *)b->addr;
+  unsigned n = boot_nchunks(b->nbytes);
+
+  for (unsigned first = 0; first < n; first += BOOT_HASHES_PER_FRAME) {
+    uint32_t msg[2 + BOOT_HASHES_PER_FRAME];
+    unsigned m = n - first;
+    if (m > BOOT_HASHES_PER_FRAME)
+      m = BOOT_HASHES_PER_FRAME;
+
+    msg[0] = first;
+    msg[1] = m;
+    for (unsigned i = 0; i < m; i++) {
+      unsigned idx = first + i;
+      msg[2 + i] = our_crc32(p + idx * BOOT_CHUNK_NBYTES,
+                             boot_chunk_nbytes(b->nbytes, idx));
+    }
+    uart_frame_send(BOOT_HASHES, seq, msg, (2 + m) * 4);
+  }
+}
+
+uint32_t boot_chunk_get(uint32_t lo, uint32_t hi, uint32_t *nbytes) {
+  static uint8_t buf[FRAME_MAXLEN];
+
+  boot_hello_t b = {0};
+  // chunks taken in order since the last hello.
+  unsigned count = 0;
+
+  while (1) {
+    frame_hdr_t h;
+    if (uart_frame_recv(&h, buf, 0) != FRAME_OK) {
+      // go-back-n: tell unix where to resume.
+      if (b.nbytes)
+        uart_frame_send(BOOT_CHUNK_ACK, count, 0, 0);
+      continue;
+    }
+    if (uart_frame_ctl(&h, buf))
+      continue;
+
+    switch (h.type) {
+    case BOOT_HELLO:
+      if (h.len != sizeof b)
+        break;
+      memcpy(&b, buf, sizeof b);
+      if (b.addr < lo || b.addr >= hi || b.nbytes > hi - b.addr) {
+        boot_error(h.seq, BOOT_BAD_ADDR);
+        b.nbytes = 0;
+        break;
+      }
+      count = 0;
+      send_hashes(h.seq, &b);
+      break;
+
+    case BOOT_CHUNK: {
+      if (!b.nbytes)
+        break;
+      uint32_t idx;
+      memcpy(&idx, buf, sizeof idx);
+      // bad index or length is the same as a bad crc: resend.
+      if (h.seq != (count & 0xff) || idx >= boot_nchunks(b.nbytes) ||
+          h.len != 4 + boot_chunk_nbytes(b.nbytes, idx)) {
+        uart_frame_send(BOOT_CHUNK_ACK, count, 0, 0);
+        break;
+      }
+      memcpy((uint8_t *)b.addr + idx * BOOT_CHUNK_NBYTES, buf + 4, h.len - 4);
+      count++;
+      uart_frame_send(BOOT_CHUNK_ACK, count, 0, 0);
+      break;
+    }
+
+    case BOOT_DONE: {
+      if (!b.nbytes)
+        break;
+      uint32_t crc = our_crc32((const void *)b.addr, b.nbytes);
+      uart_frame_send(BOOT_DONE, h.seq, &crc, sizeof crc);
+      if (crc != b.crc)
+        break;
+      uart_flush_tx();
+      *nbytes = b.nbytes;
+      return b.addr;
+    }
+    default:
+      break;
+    }
+  }
+}
@@ -0,0 +1,53 @@
+// gpio edges into a ring of timestamped events: see <gpio-events.h>
+#include "rpi.h"
+#include "cycle-count.h"
+#include "gpio-events.h"
+#include "circular-T.h"
+
+gen_circular_T(gpio_evq, gpio_evq_t, gpio_ev_t, GPIO_EV_N)
+
+static gpio_evq_t evq;
+static uint64_t ev_pins;
+
+void gpio_events_init(uint64_t rising, uint64_t falling) {
+  uint64_t pins = rising | falling;
+  demand(pins, "no pins to capture\n");
+
+  // stop capturing while we reset the ring.
+  ev_pins = 0;
+  gcc_mb();
+  evq = gpio_evq_mk();
+
+  gpio_set_function_mask(pins, GPIO_FUNC_INPUT);
+  // drop anything left over from before.
+  gpio_event_take_mask(pins);
+  ev_pins = pins;
+  gcc_mb();
+  gpio_int_edge_mask(rising, falling);
+}
+
+int gpio_events_interrupt(void) {
+  dev_barrier();
+  uint64_t ev = ev_pins ? gpio_event_take_mask(ev_pins) : 0;
+  if (!ev)
+    return 0;
+
+  gpio_ev_t e = {.cyc = cycle_cnt_read(), .usec = timer_get_usec()};
+  uint64_t level = gpio_read_mask(ev);
+  for (unsigned pin = 0; ev; pin++, ev >>= 1, level >>= 1) {
+    if (!(ev & 1))
+      continue;
+    e.pin = pin;
+    e.level = level & 1;
+    if (!gpio_evq_push(&evq, e))
+      evq.overflow++;
+  }
+  dev_barrier();
+  return 1;
+}
+
+int gpio_events_pop(gpio_ev_t *e) {
+  return gpio_evq_pop_nonblk(&evq, e);
+}
+
+unsigned gpio_events_lost(void) { return evq.overflow; }
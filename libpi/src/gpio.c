@@ -9,6 +9,7 @@
  * See rpi.h in this directory for the definitions.
  */
 #include "rpi.h"
+#include "rpi-interrupts.h"
 
 // see broadcomm documents for magic addresses.
 //
@@ -23,8 +24,16 @@ enum {
   gpio_set0 = (GPIO_BASE + 0x1C),
   gpio_clr0 = (GPIO_BASE + 0x28),
   gpio_lev0 = (GPIO_BASE + 0x34),
+  gpio_eds0 = (GPIO_BASE + 0x40),
   gpio_ren0 = (GPIO_BASE + 0x4C),
-  gpio_fen0 = (GPIO_BASE + 0x58)
+  gpio_fen0 = (GPIO_BASE + 0x58),
+
+  // pins 0..53: bank 0 is 0..31, bank 1 the rest.
+  GPIO_NPINS = 54,
+  // bcm2835 p113: gpio_int[0] (bank 0) is irq 49, gpio_int[1]
+  // (bank 1) is irq 50.
+  GPIO_INT0_BIT = 1 << (GPIO_INT0 - 32),
+  GPIO_INT1_BIT = 1 << (GPIO_INT1 - 32),
 
   // <you may need other values.>
 };
@@ -171,3 +180,87 @@ int gpio_read(unsigned pin) {
 
   return DEV_VAL32(v);
 }
+
+//
+// many pins at once: see <gpio.h>
+//
+
+static void pins_check(uint64_t pins) {
+  if (pins >> GPIO_NPINS)
+    panic("pin mask %x%x has pins past %d\n", (uint32_t)(pins >> 32),
+          (uint32_t)pins, GPIO_NPINS - 1);
+}
+
+// write <v> to the bank-0 and bank-1 registers at <addr>, skipping a
+// bank with no bits set.
+static void put_banks(uint32_t addr, uint64_t v) {
+  if ((uint32_t)v)
+    PUT32(addr, v);
+  if (v >> 32)
+    PUT32(addr + 4, v >> 32);
+}
+
+// read the banks at <addr> that have a bit in <pins>.
+static uint64_t get_banks(uint32_t addr, uint64_t pins) {
+  uint64_t v = 0;
+  if ((uint32_t)pins)
+    v |= GET32(addr);
+  if (pins >> 32)
+    v |= (uint64_t)GET32(addr + 4) << 32;
+  return v;
+}
+
+void gpio_write_mask(uint64_t pins, uint64_t val) {
+  pins_check(pins);
+  put_banks(gpio_set0, pins & val);
+  put_banks(gpio_clr0, pins & ~val);
+}
+
+uint64_t gpio_read_mask(uint64_t pins) {
+  pins_check(pins);
+  return get_banks(gpio_lev0, pins) & pins;
+}
+
+void gpio_set_function_mask(uint64_t pins, gpio_func_t function) {
+  pins_check(pins);
+  if (function >= 8)
+    panic("bad function %d\n", function);
+
+  // each fsel register holds ten pins: one read-modify-write for
+  // each register with a pin in <pins>.
+  for (unsigned reg = 0; reg * 10 < GPIO_NPINS; reg++) {
+    uint32_t mask = 0, bits = 0;
+    for (unsigned i = 0; i < 10; i++) {
+      if (!((pins >> (reg * 10 + i)) & 1))
+        continue;
+      mask |= 0b111 << (3 * i);
+      bits |= function << (3 * i);
+    }
+    if (!mask)
+      continue;
+    uint32_t addr = GPIO_fsel0 + GPIO_fsel_offset * reg;
+    PUT32(addr, (GET32(addr) & ~mask) | bits);
+  }
+}
+
+void gpio_int_edge_mask(uint64_t rising, uint64_t falling) {
+  pins_check(rising | falling);
+  dev_barrier();
+  // or in: keep the pins already set up.
+  if (rising)
+    put_banks(gpio_ren0, get_banks(gpio_ren0, rising) | rising);
+  if (falling)
+    put_banks(gpio_fen0, get_banks(gpio_fen0, falling) | falling);
+  dev_barrier();
+  uint64_t pins = rising | falling;
+  PUT32(IRQ_Enable_2, ((uint32_t)pins ? GPIO_INT0_BIT : 0) |
+                          (pins >> 32 ? GPIO_INT1_BIT : 0));
+  dev_barrier();
+}
+
+uint64_t gpio_event_take_mask(uint64_t pins) {
+  uint64_t ev = get_banks(gpio_eds0, pins) & pins;
+  // write 1 to clear.
+  put_banks(gpio_eds0, ev);
+  return ev;
+}
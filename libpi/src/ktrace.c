@@ -0,0 +1,64 @@
+// binary kernel trace ring: see <ktrace.h>
+#include "rpi.h"
+#include "ktrace.h"
+#include "libc/crc.h"
+
+ktrace_ring_t ktrace_ring;
+int ktrace_on_p = 0;
+
+void ktrace_reset(void) {
+  ktrace_ring.head = 0;
+  gcc_mb();
+}
+
+void ktrace_init(void) {
+  cycle_cnt_init();
+  ktrace_reset();
+  ktrace_on_p = 1;
+}
+
+int ktrace_enable(int on_p) {
+  int old = ktrace_on_p;
+  ktrace_on_p = on_p;
+  gcc_mb();
+  return old;
+}
+
+unsigned ktrace_nevents(void) {
+  uint32_t head = ktrace_ring.head;
+  return head < KTRACE_NENT ? head : KTRACE_NENT;
+}
+
+static void ktrace_put32(uint32_t x) {
+  uart_put8(x & 0xff);
+  uart_put8((x >> 8) & 0xff);
+  uart_put8((x >> 16) & 0xff);
+  uart_put8((x >> 24) & 0xff);
+}
+
+void ktrace_dump(void) {
+  int old = ktrace_enable(0);
+
+  uint32_t head = ktrace_ring.head;
+  uint32_t n = ktrace_nevents();
+  uint32_t first = head - n;
+
+  ktrace_put32(KTRACE_MAGIC);
+  ktrace_put32(sizeof(ktrace_ent_t));
+  ktrace_put32(n);
+  ktrace_put32(first);
+
+  uint32_t crc = 0;
+  for (uint32_t i = first; i < head; i++) {
+    ktrace_ent_t *e = &ktrace_ring.ents[i & (KTRACE_NENT - 1)];
+    crc = our_crc32_inc(e, sizeof *e, crc);
+
+    const uint8_t *p = (const void *)e;
+    for (unsigned j = 0; j < sizeof *e; j++)
+      uart_put8(p[j]);
+  }
+  ktrace_put32(crc);
+  uart_flush_tx();
+
+  ktrace_enable(old);
+}
@@ -0,0 +1,62 @@
+// statistical pc-sampling profiler: see <pc-prof.h>
+#include "rpi.h"
+#include "pc-prof.h"
+
+pc_prof_t pc_prof;
+int pc_prof_on_p = 0;
+
+void pc_prof_init(uint32_t lo, uint32_t hi) {
+  demand(lo < hi, "empty range [%x,%x)\n", lo, hi);
+  demand(lo % 4 == 0 && hi % 4 == 0, "range [%x,%x) not word aligned\n", lo,
+         hi);
+  pc_prof_enable(0);
+
+  uint32_t n = (hi - lo) / 4;
+  // re-init with a range that fits: reuse the old buckets.
+  if (!pc_prof.pc_hist || n > (pc_prof.hi - pc_prof.lo) / 4) {
+    pc_prof.pc_hist = kmalloc(n * sizeof pc_prof.pc_hist[0]);
+    pc_prof.lr_hist = kmalloc(n * sizeof pc_prof.lr_hist[0]);
+  }
+  pc_prof.lo = lo;
+  pc_prof.hi = hi;
+  pc_prof_reset();
+  pc_prof_enable(1);
+}
+
+int pc_prof_enable(int on_p) {
+  int old = pc_prof_on_p;
+  pc_prof_on_p = on_p;
+  gcc_mb();
+  return old;
+}
+
+void pc_prof_reset(void) {
+  uint32_t n = (pc_prof.hi - pc_prof.lo) / 4;
+  memset(pc_prof.pc_hist, 0, n * sizeof pc_prof.pc_hist[0]);
+  memset(pc_prof.lr_hist, 0, n * sizeof pc_prof.lr_hist[0]);
+  pc_prof.nsamples = pc_prof.nmiss = 0;
+  gcc_mb();
+}
+
+static void pc_prof_dump_hist(const char *kind, uint32_t *hist,
+                              unsigned min_count) {
+  uint32_t n = (pc_prof.hi - pc_prof.lo) / 4;
+  for (uint32_t i = 0; i < n; i++)
+    if (hist[i] > min_count)
+      printk("PCPROF:%s %x %d\n", kind, pc_prof.lo + i * 4, hist[i]);
+}
+
+void pc_prof_dump(unsigned min_count) {
+  if (!pc_prof.pc_hist)
+    panic("pc_prof_dump: profiler was never initialized\n");
+  int old = pc_prof_enable(0);
+
+  printk("PCPROF:begin lo=%x hi=%x nsamples=%d nmiss=%d\n", pc_prof.lo,
+         pc_prof.hi, pc_prof.nsamples, pc_prof.nmiss);
+  pc_prof_dump_hist("pc", pc_prof.pc_hist, min_count);
+  pc_prof_dump_hist("lr", pc_prof.lr_hist, min_count);
+  printk("PCPROF:end\n");
+  uart_flush_tx();
+
+  pc_prof_enable(old);
+}
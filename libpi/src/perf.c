@@ -0,0 +1,97 @@
+// hardware counter accounting: see <perf.h>
+#include "rpi.h"
+#include "perf.h"
+
+int perf_on_p = 0;
+perf_acc_t perf_paths[PERF_NPATHS];
+
+static unsigned perf_group;
+
+static const char *path_names[PERF_NPATHS] = {
+    [PERF_SD_READ] = "sd read",
+    [PERF_SD_WRITE] = "sd write",
+    [PERF_FAT32_READDIR] = "fat32 readdir",
+    [PERF_FAT32_READ] = "fat32 read",
+};
+
+void perf_init(unsigned group) {
+  switch (group) {
+  case PERF_GROUP_CACHE:
+    pmu_icache_miss_on(0);
+    pmu_dcache_miss_on(1);
+    break;
+  case PERF_GROUP_TLB:
+    pmu_tlb_miss_on(0);
+    pmu_inst_cnt_on(1);
+    break;
+  default:
+    panic("illegal perf group=%d\n", group);
+  }
+  perf_group = group;
+  memset(perf_paths, 0, sizeof perf_paths);
+  perf_on_p = 1;
+}
+
+const char *perf_ev0_str(void) {
+  return perf_group == PERF_GROUP_CACHE ? pmu_icache_miss_str()
+                                        : pmu_tlb_miss_str();
+}
+const char *perf_ev1_str(void) {
+  return perf_group == PERF_GROUP_CACHE ? pmu_dcache_miss_str()
+                                        : pmu_inst_cnt_str();
+}
+
+void perf_print_hdr(const char *what) {
+  printk("PERF:%s: calls, cycles, cyc/call, %s, %s\n", what, perf_ev0_str(),
+         perf_ev1_str());
+}
+
+// printk has no 64-bit decimal, and we don't link libgcc's 64-bit
+// divide: these get by with subtraction and constant shifts.
+
+// <x> in decimal into <buf> (21 bytes).
+static const char *u64_str(char *buf, uint64_t x) {
+  uint64_t pow10[20] = {1};
+  unsigned n = 1;
+  for (; n < 20 && pow10[n - 1] * 10 <= x; n++)
+    pow10[n] = pow10[n - 1] * 10;
+
+  char *s = buf;
+  while (n--) {
+    char d = '0';
+    for (; x >= pow10[n]; x -= pow10[n])
+      d++;
+    *s++ = d;
+  }
+  *s = 0;
+  return buf;
+}
+
+// <x> / <d>, by long division.
+static uint64_t u64_div(uint64_t x, uint32_t d) {
+  uint64_t q = 0, r = 0;
+  for (unsigned i = 0; i < 64; i++) {
+    r = r << 1 | x >> 63;
+    x <<= 1;
+    q <<= 1;
+    if (r >= d) {
+      r -= d;
+      q |= 1;
+    }
+  }
+  return q;
+}
+
+void perf_print(const char *name, perf_acc_t *a) {
+  char cyc[21], per[21], ev0[21], ev1[21];
+  printk("PERF:  %s: n=%u cyc=%s (%s/call) ev0=%s ev1=%s\n", name, a->n,
+         u64_str(cyc, a->cyc), u64_str(per, a->n ? u64_div(a->cyc, a->n) : 0),
+         u64_str(ev0, a->ev0), u64_str(ev1, a->ev1));
+}
+
+void perf_paths_dump(void) {
+  perf_print_hdr("kernel paths (inclusive)");
+  for (unsigned i = 0; i < PERF_NPATHS; i++)
+    if (perf_paths[i].n)
+      perf_print(path_names[i], &perf_paths[i]);
+}
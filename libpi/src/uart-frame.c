@@ -0,0 +1,214 @@
+// framed uart protocol: see <uart-frame.h> and <frame-proto.h>.
+#include "rpi.h"
+#include "uart-frame.h"
+#include "libc/crc.h"
+
+// next seq we send and the next one we expect.
+static uint8_t tx_seq, rx_seq;
+
+// current incoming data frame: <rx_off> bytes of <rx_len> consumed.
+static uint8_t rx_buf[FRAME_MAXLEN];
+static unsigned rx_off, rx_len;
+
+static void frame_put32(uint32_t x) {
+  uart_put8(x & 0xff);
+  uart_put8((x >> 8) & 0xff);
+  uart_put8((x >> 16) & 0xff);
+  uart_put8((x >> 24) & 0xff);
+}
+
+static void put_bytes(const void *data, unsigned n) {
+  const uint8_t *p = data;
+  for (unsigned i = 0; i < n; i++)
+    uart_put8(p[i]);
+}
+
+// get a byte; returns 0 if more than <usec> passed since <start>.
+static int get8_by(uint8_t *b, uint32_t start, uint32_t usec) {
+  while (!uart_has_data())
+    if (usec && timer_get_usec() - start >= usec)
+      return 0;
+  *b = uart_get8();
+  return 1;
+}
+
+static int get_bytes_by(void *data, unsigned n, uint32_t start,
+                        uint32_t usec) {
+  uint8_t *p = data;
+  for (unsigned i = 0; i < n; i++)
+    if (!get8_by(&p[i], start, usec))
+      return 0;
+  return 1;
+}
+
+void uart_frame_send(unsigned type, unsigned seq, const void *data,
+                     unsigned n) {
+  assert(n <= FRAME_MAXLEN);
+  frame_hdr_t h = {.type = type, .seq = seq, .len = n};
+
+  uint32_t crc = our_crc32_inc(&h, sizeof h, 0);
+  crc = our_crc32_inc(data, n, crc);
+
+  frame_put32(FRAME_MAGIC);
+  put_bytes(&h, sizeof h);
+  put_bytes(data, n);
+  frame_put32(crc);
+}
+
+int uart_frame_recv(frame_hdr_t *h, void *buf, uint32_t usec) {
+  uint32_t start = timer_get_usec();
+
+  // slide a 4-byte window until we hit the magic: anything before it
+  // isn't ours.
+  uint32_t w = 0;
+  for (unsigned n = 1;; n++) {
+    uint8_t b;
+    if (!get8_by(&b, start, usec))
+      return FRAME_TIMEOUT;
+    w = (w >> 8) | (uint32_t)b << 24;
+    if (n >= 4 && w == FRAME_MAGIC)
+      break;
+  }
+
+  if (!get_bytes_by(h, sizeof *h, start, usec))
+    return FRAME_TIMEOUT;
+  if (h->len > FRAME_MAXLEN)
+    return FRAME_BAD;
+
+  uint32_t crc;
+  if (!get_bytes_by(buf, h->len, start, usec) ||
+      !get_bytes_by(&crc, sizeof crc, start, usec))
+    return FRAME_TIMEOUT;
+
+  uint32_t exp = our_crc32_inc(h, sizeof *h, 0);
+  if (crc != our_crc32_inc(buf, h->len, exp))
+    return FRAME_BAD;
+  return FRAME_OK;
+}
+
+// send <data> as frame <type> and wait for the matching ack, resending
+// on a nak or timeout.
+static int send_acked(unsigned type, const void *data, unsigned n) {
+  uint32_t usec = FRAME_TIMEOUT_USEC + frame_wire_usec(uart_get_baud(), n);
+
+  for (unsigned i = 0; i < FRAME_RETRIES; i++) {
+    uart_frame_send(type, tx_seq, data, n);
+
+    uint32_t start = timer_get_usec();
+    uint32_t left = usec;
+    frame_hdr_t h;
+    while (1) {
+      static uint8_t reply[FRAME_MAXLEN];
+      int r = uart_frame_recv(&h, reply, left);
+      if (r == FRAME_TIMEOUT)
+        break;
+      if (r == FRAME_OK) {
+        if (h.type == FRAME_NAK)
+          break;
+        if (h.type == FRAME_ACK && h.seq == tx_seq) {
+          tx_seq++;
+          return 1;
+        }
+      }
+      // stale ack or garbage: keep waiting out the rest of the timeout.
+      uint32_t t = timer_get_usec() - start;
+      if (t >= usec)
+        break;
+      left = usec - t;
+    }
+  }
+  return 0;
+}
+
+int uart_frame_write(const void *data, unsigned n) {
+  const uint8_t *p = data;
+  while (n) {
+    unsigned len = n < FRAME_MAXLEN ? n : FRAME_MAXLEN;
+    if (!send_acked(FRAME_DATA, p, len))
+      return 0;
+    p += len;
+    n -= len;
+  }
+  return 1;
+}
+
+// unix asked us to switch to a new baud rate.  ack at the old rate,
+// switch, then wait for a ping at the new one.  if none shows up,
+// the switch didn't work on the other end: go back.
+static void baud_req(frame_hdr_t *h, const void *payload) {
+  uint32_t old = uart_get_baud(), baud;
+  if (h->len != sizeof baud)
+    return;
+  memcpy(&baud, payload, sizeof baud);
+
+  if (!uart_baud_ok(baud)) {
+    uart_frame_send(FRAME_BAUD_NAK, h->seq, &old, sizeof old);
+    return;
+  }
+  uart_frame_send(FRAME_BAUD_ACK, h->seq, &baud, sizeof baud);
+  uart_set_baud(baud);
+
+  uint32_t start = timer_get_usec();
+  while (timer_get_usec() - start < FRAME_BAUD_TIMEOUT_USEC) {
+    frame_hdr_t p;
+    if (uart_frame_recv(&p, rx_buf, FRAME_TIMEOUT_USEC) == FRAME_OK &&
+        p.type == FRAME_PING) {
+      uart_frame_send(FRAME_PING, p.seq, 0, 0);
+      return;
+    }
+  }
+  uart_set_baud(old);
+}
+
+int uart_frame_ctl(frame_hdr_t *h, const void *payload) {
+  switch (h->type) {
+  case FRAME_BAUD_REQ:
+    baud_req(h, payload);
+    return 1;
+  case FRAME_PING:
+    uart_frame_send(FRAME_PING, h->seq, 0, 0);
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+// block until the next new data frame is in <rx_buf>.
+static void next_data_frame(void) {
+  while (1) {
+    frame_hdr_t h;
+    int r = uart_frame_recv(&h, rx_buf, 0);
+    if (r != FRAME_OK) {
+      uart_frame_send(FRAME_NAK, h.seq, 0, 0);
+      continue;
+    }
+
+    if (h.type != FRAME_DATA) {
+      uart_frame_ctl(&h, rx_buf);
+      continue;
+    }
+    uart_frame_send(FRAME_ACK, h.seq, 0, 0);
+    // our ack got lost and they resent: already have it.
+    if (h.seq != rx_seq)
+      continue;
+    rx_seq++;
+    rx_off = 0;
+    rx_len = h.len;
+    return;
+  }
+}
+
+void uart_frame_read(void *data, unsigned n) {
+  uint8_t *p = data;
+  while (n) {
+    if (rx_off == rx_len)
+      next_data_frame();
+    unsigned len = rx_len - rx_off;
+    if (len > n)
+      len = n;
+    memcpy(p, &rx_buf[rx_off], len);
+    rx_off += len;
+    p += len;
+    n -= len;
+  }
+}
@@ -118,6 +118,29 @@ enum {
 //*****************************************************
 // the rest you should implement.
 
+// the mini-uart runs off the 250MHz core clock:
+//    baud = sys_clock / (8 * (baud_reg + 1))
+enum { UART_SYS_CLOCK = 250 * 1000 * 1000, UART_DEFAULT_BAUD = 115200 };
+
+static unsigned uart_baud = UART_DEFAULT_BAUD;
+
+// returns the baud register value for <baud>, or -1 if the closest
+// rate we can generate is more than 2% off (about the most 8n1 can
+// tolerate) or doesn't fit in the 16-bit register.
+static int uart_baud_reg(unsigned baud) {
+  if (!baud || baud > UART_SYS_CLOCK / 8)
+    return -1;
+  // round to nearest.
+  unsigned div = (UART_SYS_CLOCK + 4 * baud) / (8 * baud);
+  if (!div || div > 0x10000)
+    return -1;
+  unsigned actual = UART_SYS_CLOCK / (8 * div);
+  unsigned err = actual > baud ? actual - baud : baud - actual;
+  if (err * 50 > baud)
+    return -1;
+  return div - 1;
+}
+
 // assumes new_value has length n_bits, and lowest_bit_idx is the index of the
 // lowest bit eg. it would be 1 if we wanted to write 3-1
 
@@ -161,8 +184,9 @@ void uart_init(void) {
   PUT32(aux_mu_iir_reg, 0b110);
   // set to 8 bits instead of 7
   PUT32(aux_mu_lcr_reg, 0b11);
-  // write to the baud reg
-  PUT32(aux_mu_baud_reg, 270);
+  // write to the baud reg: 270 for 115200
+  PUT32(aux_mu_baud_reg, uart_baud_reg(UART_DEFAULT_BAUD));
+  uart_baud = UART_DEFAULT_BAUD;
   // // we don't need this MCR reg, so set it to 0
   // PUT32(aux_mu_mcr_reg, 0);
   // disable interrupts
@@ -250,3 +274,27 @@ void uart_flush_tx(void) {
   while (!uart_tx_is_empty())
     rpi_wait();
 }
+
+// 1 if the mini-uart can run at <baud>, 0 otherwise.
+int uart_baud_ok(unsigned baud) { return uart_baud_reg(baud) >= 0; }
+
+unsigned uart_get_baud(void) { return uart_baud; }
+
+// switch to <baud> after draining anything still going out at the
+// old rate.  returns 0 (and leaves the rate alone) if <baud> isn't
+// one we can generate.
+int uart_set_baud(unsigned baud) {
+  int reg = uart_baud_reg(baud);
+  if (reg < 0)
+    return 0;
+  uart_flush_tx();
+
+  dev_barrier();
+  PUT32(aux_mu_cntl_reg, 0);
+  PUT32(aux_mu_baud_reg, reg);
+  PUT32(aux_mu_cntl_reg, 0b11);
+  dev_barrier();
+
+  uart_baud = baud;
+  return 1;
+}
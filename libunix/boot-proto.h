@@ -0,0 +1,61 @@
+#ifndef __BOOT_PROTO_H__
+#define __BOOT_PROTO_H__
+// chunked, resumable upload of a program image, on top of the framed
+// uart protocol in <frame-proto.h>.  shared verbatim between libpi and
+// libunix: if you change one, copy it to the other.
+//
+//   unix                                 pi
+//   BOOT_HELLO {addr,nbytes,crc}    ->
+//                                   <-   BOOT_HASHES {first,n,crc[n]}
+//                                        (as many frames as it takes)
+//   BOOT_CHUNK {idx,data}           ->   (up to BOOT_WINDOW unacked)
+//                                   <-   BOOT_CHUNK_ACK (seq=count)
+//   BOOT_DONE                       ->
+//                                   <-   BOOT_DONE {crc of image}
+//
+// the pi sends the crc of every chunk already sitting at <addr>.
+// after a reboot that's the image we sent last time, so only chunks
+// that changed --- or that the program wrote to, e.g., .data --- get
+// resent.  recomputing beats keeping a table: a table goes stale as
+// soon as the program runs.
+//
+// chunks are go-back-n: the seq of each chunk frame is its position
+// in the send order (mod 256) and the pi acks with the count it has
+// taken in order.  on a bad crc or a skipped chunk the pi re-acks
+// its count and unix resends from there.  acks have no payload so the
+// pi isn't stuck in uart_put8 long enough to overflow its rx fifo.
+#include "frame-proto.h"
+
+enum { BOOT_CHUNK_NBYTES = 512 };
+enum { BOOT_WINDOW = 8 };
+enum { BOOT_HASHES_PER_FRAME = (FRAME_MAXLEN - 8) / 4 };
+
+// frame types: kept out of the range used by <frame-proto.h>.
+enum {
+  BOOT_HELLO = 0x10,
+  BOOT_HASHES,
+  BOOT_CHUNK,
+  BOOT_CHUNK_ACK,
+  BOOT_DONE,
+  BOOT_ERROR, // payload = u32 error code below.
+};
+
+enum {
+  BOOT_BAD_ADDR = 1, // image doesn't fit where the loader allows.
+};
+
+typedef struct {
+  uint32_t addr, nbytes, crc;
+} boot_hello_t;
+
+static inline unsigned boot_nchunks(unsigned nbytes) {
+  return (nbytes + BOOT_CHUNK_NBYTES - 1) / BOOT_CHUNK_NBYTES;
+}
+
+// bytes in chunk <idx> of an <nbytes> image: last one can be short.
+static inline unsigned boot_chunk_nbytes(unsigned nbytes, unsigned idx) {
+  unsigned off = idx * BOOT_CHUNK_NBYTES;
+  return nbytes - off < BOOT_CHUNK_NBYTES ? nbytes - off : BOOT_CHUNK_NBYTES;
+}
+
+#endif
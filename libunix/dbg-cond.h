@@ -0,0 +1,137 @@
+#ifndef __DBG_COND_H__
+#define __DBG_COND_H__
+// break and watchpoint conditions, evaluated on the pi (DBG_COND_SET
+// in <dbg-proto.h>).  shared verbatim between libpi and libunix: if
+// you change one, copy it to the other.
+//
+// a condition is a little stack machine program: one opcode byte,
+// then a register number byte (DBG_C_REG) or a 4-byte little-endian
+// word (DBG_C_IMM).  the value left on top at the end decides it.
+// unix compiles them from C-ish expressions (libunix/pi-cond.h); the
+// pi only ever runs them, so that side stays a loop and a switch.
+//
+// comparisons are unsigned: these are register values.  no divide:
+// there's no libgcc on the pi.
+#include "dbg-proto.h"
+
+enum {
+  DBG_C_REG = 1, // u8 reg: push regs[reg].
+  DBG_C_IMM,     // u32: push it.
+  DBG_C_HITS,    // push how many times the point was reached, this
+                 // time included.
+  DBG_C_LOAD,    // pop an address, push the word there.
+
+  // unary: replace the top.
+  DBG_C_NOT, // !x
+  DBG_C_NEG, // -x
+  DBG_C_INV, // ~x
+
+  // binary: pop b, pop a, push (a op b).
+  DBG_C_ADD,
+  DBG_C_SUB,
+  DBG_C_MUL,
+  DBG_C_AND,
+  DBG_C_OR,
+  DBG_C_XOR,
+  DBG_C_SHL,
+  DBG_C_SHR,
+  DBG_C_EQ,
+  DBG_C_NE,
+  DBG_C_LT,
+  DBG_C_LE,
+  DBG_C_GT,
+  DBG_C_GE,
+  DBG_C_LAND,
+  DBG_C_LOR,
+};
+
+enum { DBG_COND_MAX = 64 };  // bytes of code.
+enum { DBG_COND_STACK = 8 }; // deepest stack a program may use.
+
+// read the word at <addr>.  set *ok to 0 if you won't.
+typedef uint32_t (*dbg_cond_load_fn)(uint32_t addr, int *ok);
+
+// run <code>: 1 if true, 0 if false, -1 if it's malformed or a load
+// was refused.  callers should stop on -1: better than silently
+// never stopping.
+static inline int dbg_cond_eval(const uint8_t *code, unsigned n,
+                                const uint32_t *regs, uint32_t hits,
+                                dbg_cond_load_fn load) {
+  uint32_t st[DBG_COND_STACK], a, b;
+  unsigned sp = 0;
+  int ok = 1;
+
+  for (unsigned pc = 0; pc < n;) {
+    unsigned op = code[pc++];
+    // operands.
+    if (op <= DBG_C_LOAD) {
+      if (op == DBG_C_LOAD) {
+        if (!sp)
+          return -1;
+        st[sp - 1] = load(st[sp - 1], &ok);
+        if (!ok)
+          return -1;
+        continue;
+      }
+      if (sp == DBG_COND_STACK)
+        return -1;
+      switch (op) {
+      case DBG_C_REG:
+        if (pc >= n || code[pc] >= DBG_NREGS)
+          return -1;
+        st[sp++] = regs[code[pc++]];
+        break;
+      case DBG_C_IMM:
+        if (pc + 4 > n)
+          return -1;
+        st[sp++] = code[pc] | code[pc + 1] << 8 | code[pc + 2] << 16 |
+                   (uint32_t)code[pc + 3] << 24;
+        pc += 4;
+        break;
+      case DBG_C_HITS:
+        st[sp++] = hits;
+        break;
+      default:
+        return -1;
+      }
+      continue;
+    }
+
+    if (op <= DBG_C_INV) {
+      if (!sp)
+        return -1;
+      a = st[sp - 1];
+      st[sp - 1] = op == DBG_C_NOT ? !a : op == DBG_C_NEG ? -a : ~a;
+      continue;
+    }
+
+    if (sp < 2)
+      return -1;
+    b = st[--sp];
+    a = st[sp - 1];
+    switch (op) {
+    case DBG_C_ADD: a = a + b; break;
+    case DBG_C_SUB: a = a - b; break;
+    case DBG_C_MUL: a = a * b; break;
+    case DBG_C_AND: a = a & b; break;
+    case DBG_C_OR: a = a | b; break;
+    case DBG_C_XOR: a = a ^ b; break;
+    case DBG_C_SHL: a = b < 32 ? a << b : 0; break;
+    case DBG_C_SHR: a = b < 32 ? a >> b : 0; break;
+    case DBG_C_EQ: a = a == b; break;
+    case DBG_C_NE: a = a != b; break;
+    case DBG_C_LT: a = a < b; break;
+    case DBG_C_LE: a = a <= b; break;
+    case DBG_C_GT: a = a > b; break;
+    case DBG_C_GE: a = a >= b; break;
+    case DBG_C_LAND: a = a && b; break;
+    case DBG_C_LOR: a = a || b; break;
+    default:
+      return -1;
+    }
+    st[sp - 1] = a;
+  }
+  return sp == 1 ? st[0] != 0 : -1;
+}
+
+#endif
@@ -1,4 +1,6 @@
 // http://www.azillionmonkeys.com/qed/hash.html
+#include <string.h>
+
 #include "libunix.h"
 
 #undef get16bits
@@ -24,12 +26,15 @@ uint32_t fast_hash_inc(const void *_data, uint32_t len, uint32_t hash) {
   rem = len & 3;
   len >>= 2;
 
-  /* Main loop */
+  /* Main loop: one word load per iteration.  the low half is the
+   * first get16bits since we're little-endian. */
   for (; len > 0; len--) {
-    hash += get16bits(data);
-    tmp = (get16bits(data + 2) << 11) ^ hash;
+    uint32_t x;
+    memcpy(&x, data, sizeof x);
+    hash += x & 0xffff;
+    tmp = ((x >> 16) << 11) ^ hash;
     hash = (hash << 16) ^ tmp;
-    data += 2 * sizeof(uint16_t);
+    data += sizeof x;
     hash += hash >> 11;
   }
 
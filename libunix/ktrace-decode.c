@@ -0,0 +1,195 @@
+// decode the binary trace ring dumped by the pi's <ktrace_dump>.
+#include <string.h>
+
+#include "libunix.h"
+#include "pi-ktrace.h"
+
+static const char *ev_names[] = {
+#define XX(name, str, a0_str, a1_str) [name] = str,
+#define KTRACE_GET_EVENTS
+#include "ktrace-events.h"
+#undef KTRACE_GET_EVENTS
+#undef XX
+};
+static const char *ev_a0[] = {
+#define XX(name, str, a0_str, a1_str) [name] = a0_str,
+#define KTRACE_GET_EVENTS
+#include "ktrace-events.h"
+#undef KTRACE_GET_EVENTS
+#undef XX
+};
+static const char *ev_a1[] = {
+#define XX(name, str, a0_str, a1_str) [name] = a1_str,
+#define KTRACE_GET_EVENTS
+#include "ktrace-events.h"
+#undef KTRACE_GET_EVENTS
+#undef XX
+};
+
+const char *pi_ktrace_name(uint32_t id) {
+  if (id >= KT_NEVENTS)
+    return "unknown";
+  return ev_names[id];
+}
+
+pi_ktrace_t pi_ktrace_read(int fd, FILE *echo) {
+  // the magic arrives little-endian: shift bytes in at the top of a
+  // 4-byte window.
+  uint32_t w = 0;
+  for (unsigned n = 1;; n++) {
+    uint8_t b = get_uint8(fd);
+    // the byte falling out of the window can't be part of the magic.
+    if (echo && n > 4)
+      fputc(w & 0xff, echo);
+    w = (w >> 8) | (uint32_t)b << 24;
+    if (n >= 4 && w == KTRACE_MAGIC)
+      break;
+  }
+
+  uint32_t ent_nbytes = get_uint32(fd);
+  if (ent_nbytes != sizeof(pi_ktrace_ent_t))
+    panic("ktrace: entry size=%u, expected %zu\n", ent_nbytes,
+          sizeof(pi_ktrace_ent_t));
+
+  pi_ktrace_t t = {0};
+  t.nent = get_uint32(fd);
+  t.ndropped = get_uint32(fd);
+  t.ents = calloc(t.nent + 1, sizeof *t.ents);
+  read_exact(fd, t.ents, t.nent * sizeof *t.ents);
+
+  uint32_t crc = get_uint32(fd);
+  uint32_t have = our_crc32(t.ents, t.nent * sizeof *t.ents);
+  if (crc != have)
+    panic("ktrace: crc mismatch: pi sent %x, computed %x\n", crc, have);
+  return t;
+}
+
+// a dump bigger than this is garbage, not a trace.
+enum { SCAN_MAXENT = 1 << 20, SCAN_HDR = 3 * 4 };
+
+static uint32_t le32(const uint8_t *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// <s->dump> holds a whole dump: check it and print it.
+static void scan_done(pi_ktrace_scan_t *s, FILE *trace, unsigned cyc_per_usec) {
+  const uint8_t *p = s->dump;
+  pi_ktrace_t t = {.nent = le32(p + 4), .ndropped = le32(p + 8)};
+  unsigned nbytes = t.nent * sizeof *t.ents;
+  uint32_t crc = le32(p + SCAN_HDR + nbytes);
+  uint32_t have = our_crc32(p + SCAN_HDR, nbytes);
+  if (crc != have)
+    fprintf(trace, "ktrace: crc mismatch: pi sent %x, computed %x\n", crc,
+            have);
+  else {
+    t.ents = calloc(t.nent + 1, sizeof *t.ents);
+    memcpy(t.ents, p + SCAN_HDR, nbytes);
+    pi_ktrace_print(trace, &t, cyc_per_usec);
+    pi_ktrace_free(&t);
+  }
+  s->ndumps++;
+}
+
+unsigned pi_ktrace_scan(pi_ktrace_scan_t *s, const uint8_t *buf, unsigned n,
+                        uint8_t *text, FILE *trace, unsigned cyc_per_usec) {
+  // the magic as it arrives: little-endian.
+  static const uint8_t magic[4] = {KTRACE_MAGIC & 0xff,
+                                   (KTRACE_MAGIC >> 8) & 0xff,
+                                   (KTRACE_MAGIC >> 16) & 0xff,
+                                   KTRACE_MAGIC >> 24};
+  unsigned ntext = 0;
+  for (unsigned i = 0; i < n; i++) {
+    uint8_t b = buf[i];
+    if (!s->in_dump_p) {
+      if (b == magic[s->nmagic]) {
+        if (++s->nmagic < 4)
+          continue;
+        s->nmagic = 0;
+        s->in_dump_p = 1;
+        s->ndump = 0;
+        s->dump_nbytes = SCAN_HDR;
+        s->dump = realloc(s->dump, SCAN_HDR);
+        continue;
+      }
+      // no byte of the magic repeats, so a mismatch can only restart
+      // the match at <b>.
+      memcpy(text + ntext, magic, s->nmagic);
+      ntext += s->nmagic;
+      s->nmagic = b == magic[0];
+      if (!s->nmagic)
+        text[ntext++] = b;
+      continue;
+    }
+
+    s->dump[s->ndump++] = b;
+    if (s->ndump < s->dump_nbytes)
+      continue;
+    if (s->ndump == SCAN_HDR) {
+      uint32_t ent_nbytes = le32(s->dump), nent = le32(s->dump + 4);
+      if (ent_nbytes != sizeof(pi_ktrace_ent_t) || nent > SCAN_MAXENT) {
+        fprintf(trace, "ktrace: bad dump: entry size=%u, nent=%u\n",
+                ent_nbytes, nent);
+        s->in_dump_p = 0;
+        continue;
+      }
+      s->dump_nbytes = SCAN_HDR + nent * ent_nbytes + 4;
+      s->dump = realloc(s->dump, s->dump_nbytes);
+      continue;
+    }
+    scan_done(s, trace, cyc_per_usec);
+    s->in_dump_p = 0;
+  }
+  return ntext;
+}
+
+void pi_ktrace_print(FILE *out, pi_ktrace_t *t, unsigned cyc_per_usec) {
+  if (!t->nent) {
+    fprintf(out, "ktrace: no events\n");
+    return;
+  }
+  if (t->ndropped)
+    fprintf(out, "ktrace: %u oldest events were overwritten\n", t->ndropped);
+
+  unsigned counts[KT_NEVENTS + 1] = {0};
+
+  // the 32-bit cycle counter wraps every few seconds: widen it by
+  // assuming no two adjacent events are a full wrap apart.
+  uint64_t now = 0, start = 0, prev = 0;
+  uint32_t last_cyc = t->ents[0].cyc;
+  for (unsigned i = 0; i < t->nent; i++) {
+    pi_ktrace_ent_t *e = &t->ents[i];
+    now += (uint32_t)(e->cyc - last_cyc);
+    last_cyc = e->cyc;
+    if (!i)
+      start = prev = now;
+
+    uint32_t id = e->id < KT_NEVENTS ? e->id : KT_NEVENTS;
+    counts[id]++;
+
+    const char *a0 = id < KT_NEVENTS ? ev_a0[id] : "a0";
+    const char *a1 = id < KT_NEVENTS ? ev_a1[id] : "a1";
+    if (cyc_per_usec)
+      fprintf(out, "%12.3fus (+%9.3f) %-12s %s=%u %s=%u\n",
+              (double)(now - start) / cyc_per_usec,
+              (double)(now - prev) / cyc_per_usec, pi_ktrace_name(e->id), a0,
+              e->a0, a1, e->a1);
+    else
+      fprintf(out, "%12llu (+%9llu) %-12s %s=%u %s=%u\n",
+              (unsigned long long)(now - start),
+              (unsigned long long)(now - prev), pi_ktrace_name(e->id), a0,
+              e->a0, a1, e->a1);
+    prev = now;
+  }
+
+  fprintf(out, "---- %u events ----\n", t->nent);
+  for (unsigned i = 0; i <= KT_NEVENTS; i++)
+    if (counts[i])
+      fprintf(out, "  %-12s %u\n", i < KT_NEVENTS ? ev_names[i] : "unknown",
+              counts[i]);
+}
+
+void pi_ktrace_free(pi_ktrace_t *t) {
+  free(t->ents);
+  t->ents = 0;
+  t->nent = 0;
+}
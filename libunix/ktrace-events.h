@@ -0,0 +1,25 @@
+// event ids for the binary kernel trace ring (see <ktrace.h>).
+//
+// the unix-side decoder keeps a copy in <libunix/ktrace-events.h>:
+// only ever append, never renumber, or old dumps decode wrong.
+//
+//  XX(enum name, printable name, name of a0, name of a1)
+#ifdef KTRACE_GET_EVENTS
+XX(KT_NONE, "none", "a0", "a1")
+// scheduling.
+XX(KT_IRQ_TIMER, "irq-timer", "tid", "next")
+XX(KT_SCHED_RUN, "sched-run", "tid", "pc")
+XX(KT_SYSCALL, "syscall", "tid", "sysno")
+XX(KT_EXIT, "exit", "tid", "code")
+XX(KT_FORK, "fork", "parent", "child")
+XX(KT_EXEC, "exec", "tid", "nbytes")
+// i/o.
+XX(KT_SD_READ, "sd-read", "lba", "nsec")
+XX(KT_SD_WRITE, "sd-write", "lba", "nsec")
+XX(KT_FAT_CLUSTER, "fat-cluster", "cluster", "lba")
+// free for ad-hoc client use.
+XX(KT_USER, "user", "a0", "a1")
+// blocking primitives: <obj> is the sysno << 16 | object id.
+XX(KT_BLOCK, "block", "tid", "obj")
+XX(KT_WAKE, "wake", "tid", "waker")
+#endif
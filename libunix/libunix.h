@@ -46,6 +46,8 @@ int open_tty_n(const char *device, int maxattempts);
 
 // used to set a tty to the 8n1 protocol needed by the tty-serial.
 int set_tty_to_8n1(int fd, unsigned speed, double timeout);
+// change the baud rate of a tty setup by <set_tty_to_8n1>.
+int set_tty_speed(int fd, unsigned speed);
 
 // returns 1 if the tty is not there, 0 otherwise.
 // used to detect when the user pulls the tty-serial device out.
@@ -60,6 +62,13 @@ int tty_gone(const char *ttyname);
 uint32_t our_crc32(const void *buf, unsigned size);
 // our_crc32_inc(buf,size,0) is the same as our_crc32
 uint32_t our_crc32_inc(const void *buf, unsigned size, uint32_t crc);
+// the implementations <our_crc32_inc> picks between: all give the
+// same answer, exported so they can be checked against each other.
+uint32_t our_crc32_inc_byte(const void *buf, unsigned size, uint32_t crc);
+uint32_t our_crc32_inc_slice8(const void *buf, unsigned size, uint32_t crc);
+// x86 carry-less multiply version: only call if <our_crc32_pclmul_ok>.
+int our_crc32_pclmul_ok(void);
+uint32_t our_crc32_inc_pclmul(const void *buf, unsigned size, uint32_t crc);
 
 // fill in <fmt,..> using <...> and strcat it to <dst>
 char *strcatf(char *dst, const char *fmt, ...);
@@ -95,6 +104,9 @@ char *name_lookup(const char *path, const char *name);
 void pi_echo(int unix_fd, int pi_fd, const char *portname);
 void pi_echo_debug(int unix_fd, int pi_fd, const char *portname,
                    const char *progname);
+// same, but for a pi running debugger/code/gdb-stub.h: bridges it to
+// a pty for gdb.  see <pi-gdb.h>.
+void pi_echo_gdb(int pi_fd, const char *portname, const char *progname);
 
 int exists(const char *name);
 
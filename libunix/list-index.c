@@ -0,0 +1,188 @@
+// index of an objdump .list file: see <list-index.h>.
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "libunix.h"
+#include "list-index.h"
+
+// instruction lines look like "    8574:\te92d4800 \tpush\t{fp, lr}"
+// (the address is right-justified, so its width varies).
+int list_line_is_inst(const char *line, uint32_t *addr) {
+  const char *p = line;
+  while (*p == ' ')
+    p++;
+  if (p == line || !isxdigit(*p))
+    return 0;
+
+  char *end;
+  unsigned long a = strtoul(p, &end, 16);
+  if (*end != ':')
+    return 0;
+  *addr = a;
+  return 1;
+}
+
+// function headers look like "00008574 <fib>:".  returns a copy of
+// the name.
+static char *line_is_fn(const char *line, uint32_t *addr) {
+  if (!isxdigit(line[0]))
+    return 0;
+
+  char *end;
+  unsigned long a = strtoul(line, &end, 16);
+  if (end[0] != ' ' || end[1] != '<')
+    return 0;
+  const char *name = end + 2, *close = strchr(name, '>');
+  if (!close || close[1] != ':')
+    return 0;
+  *addr = a;
+  return strndup(name, close - name);
+}
+
+static int fn_cmp(const void *a, const void *b) {
+  uint32_t x = ((const list_fn_t *)a)->addr, y = ((const list_fn_t *)b)->addr;
+  return x < y ? -1 : x > y;
+}
+static int inst_cmp(const void *a, const void *b) {
+  uint32_t x = ((const list_inst_t *)a)->addr,
+           y = ((const list_inst_t *)b)->addr;
+  return x < y ? -1 : x > y;
+}
+
+// parse into <ix>, which has <path> set and everything else zero.
+static int list_parse(list_index_t *ix) {
+  struct stat st;
+  if (stat(ix->path, &st) < 0)
+    return 0;
+  unsigned nbytes;
+  if (!(ix->text = read_file(&nbytes, ix->path)))
+    return 0;
+  ix->mtime = st.st_mtime;
+  ix->size = st.st_size;
+  ix->ino = st.st_ino;
+
+  // split into lines; upper bounds for the tables are the line count.
+  unsigned maxlines = 1;
+  for (unsigned i = 0; i < nbytes; i++)
+    maxlines += ix->text[i] == '\n';
+  ix->lines = calloc(maxlines, sizeof *ix->lines);
+  ix->fns = calloc(maxlines, sizeof *ix->fns);
+  ix->insts = calloc(maxlines, sizeof *ix->insts);
+
+  char *p = ix->text;
+  while (*p) {
+    char *nl = strchr(p, '\n');
+    if (nl)
+      *nl = 0;
+    unsigned line = ix->nlines++;
+    ix->lines[line] = p;
+
+    uint32_t addr;
+    char *name;
+    if ((name = line_is_fn(p, &addr)))
+      ix->fns[ix->nfns++] =
+          (list_fn_t){.addr = addr, .name = name, .first_line = line};
+    else if (list_line_is_inst(p, &addr))
+      ix->insts[ix->ninsts++] = (list_inst_t){.addr = addr, .line = line};
+
+    if (!nl)
+      break;
+    p = nl + 1;
+  }
+
+  // a function runs up to the next header, less any trailing blank
+  // lines or section banners.
+  for (unsigned i = 0; i < ix->nfns; i++) {
+    list_fn_t *f = &ix->fns[i];
+    unsigned end = i + 1 < ix->nfns ? ix->fns[i + 1].first_line : ix->nlines;
+    while (end > f->first_line + 1) {
+      const char *l = ix->lines[end - 1];
+      if (*l && strncmp(l, "Disassembly of section", 22) != 0)
+        break;
+      end--;
+    }
+    f->nlines = end - f->first_line;
+  }
+
+  // objdump output is already sorted within a section, but sections
+  // aren't necessarily in address order.
+  qsort(ix->fns, ix->nfns, sizeof *ix->fns, fn_cmp);
+  qsort(ix->insts, ix->ninsts, sizeof *ix->insts, inst_cmp);
+  return 1;
+}
+
+// free everything but the struct and path.
+static void list_clear(list_index_t *ix) {
+  for (unsigned i = 0; i < ix->nfns; i++)
+    free((char *)ix->fns[i].name);
+  free(ix->lines);
+  free(ix->fns);
+  free(ix->insts);
+  free(ix->text);
+
+  char *path = ix->path;
+  memset(ix, 0, sizeof *ix);
+  ix->path = path;
+}
+
+list_index_t *list_index_load(const char *path) {
+  list_index_t *ix = calloc(1, sizeof *ix);
+  ix->path = strdup(path);
+  if (!list_parse(ix)) {
+    list_index_free(ix);
+    return 0;
+  }
+  return ix;
+}
+
+int list_index_refresh(list_index_t *ix) {
+  struct stat st;
+  if (stat(ix->path, &st) < 0)
+    return 0;
+  if (st.st_mtime == ix->mtime && st.st_size == ix->size &&
+      st.st_ino == ix->ino)
+    return 0;
+
+  list_clear(ix);
+  if (!list_parse(ix))
+    output("UNIX: could not re-read <%s>\n", ix->path);
+  return 1;
+}
+
+const list_fn_t *list_index_fn(const list_index_t *ix, uint32_t addr) {
+  // last function with fn.addr <= addr.
+  unsigned lo = 0, hi = ix->nfns;
+  while (lo < hi) {
+    unsigned mid = lo + (hi - lo) / 2;
+    if (ix->fns[mid].addr <= addr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo ? &ix->fns[lo - 1] : 0;
+}
+
+int list_index_line(const list_index_t *ix, uint32_t addr) {
+  unsigned lo = 0, hi = ix->ninsts;
+  while (lo < hi) {
+    unsigned mid = lo + (hi - lo) / 2;
+    if (ix->insts[mid].addr < addr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo < ix->ninsts && ix->insts[lo].addr == addr)
+    return ix->insts[lo].line;
+  return -1;
+}
+
+void list_index_free(list_index_t *ix) {
+  if (!ix)
+    return;
+  list_clear(ix);
+  free(ix->path);
+  free(ix);
+}
@@ -0,0 +1,58 @@
+#ifndef __LIST_INDEX_H__
+#define __LIST_INDEX_H__
+// index of an objdump .list file: parse it once into address-sorted
+// tables of functions and instructions so a debugger can map a pc to
+// its function and line with a binary search instead of rescanning
+// the file on every step.
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef struct {
+  uint32_t addr;
+  const char *name;
+  // lines [first_line, first_line+nlines) are this function: the
+  // "<name>:" header followed by its instructions.
+  unsigned first_line, nlines;
+} list_fn_t;
+
+typedef struct {
+  uint32_t addr;
+  unsigned line;
+} list_inst_t;
+
+typedef struct {
+  char *path;
+  // what the file looked like when we parsed it.
+  time_t mtime;
+  off_t size;
+  ino_t ino;
+
+  char *text;   // the whole file; each line is 0-terminated in place.
+  char **lines; // lines[i] points into <text>, no trailing newline.
+  unsigned nlines;
+
+  list_fn_t *fns; // sorted by address.
+  unsigned nfns;
+  list_inst_t *insts; // sorted by address.
+  unsigned ninsts;
+} list_index_t;
+
+// parse <path>.  returns 0 if it can't be read.
+list_index_t *list_index_load(const char *path);
+
+// re-parse if the file changed since we last did (a rebuild while
+// the debugger is up).  returns 1 if it did.
+int list_index_refresh(list_index_t *ix);
+
+// function containing <addr>, or 0 if it's before the first one.
+const list_fn_t *list_index_fn(const list_index_t *ix, uint32_t addr);
+
+// line of the instruction at <addr>, or -1.
+int list_index_line(const list_index_t *ix, uint32_t addr);
+
+// if <line> is an instruction, return 1 and its address in <addr>.
+int list_line_is_inst(const char *line, uint32_t *addr);
+
+void list_index_free(list_index_t *ix);
+
+#endif
@@ -0,0 +1,164 @@
+// micro-benchmark results: see <pi-bench.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libunix.h"
+#include "pi-bench.h"
+
+#define BENCH "BENCH:"
+#define CSV_HDR "name,min,median,p99,n,nreject"
+
+static void bench_add(pi_bench_set_t *s, const pi_bench_t *b) {
+  pi_bench_t *old = (pi_bench_t *)pi_bench_find(s, b->name);
+  if (old) {
+    *old = *b;
+    return;
+  }
+  if (s->n == s->cap) {
+    s->cap = s->cap ? s->cap * 2 : 64;
+    s->v = realloc(s->v, s->cap * sizeof *s->v);
+    if (!s->v)
+      sys_die(realloc, "out of memory");
+  }
+  s->v[s->n++] = *b;
+}
+
+// <name>,<min>,<median>,<p99>,<n>,<nreject>
+static int bench_parse(const char *line, pi_bench_t *b) {
+  memset(b, 0, sizeof *b);
+  const char *comma = strchr(line, ',');
+  if (!comma || comma == line || comma - line >= sizeof b->name)
+    return 0;
+  memcpy(b->name, line, comma - line);
+  return sscanf(comma + 1, "%u,%u,%u,%u,%u", &b->min, &b->median, &b->p99,
+                &b->n, &b->nreject) == 5;
+}
+
+unsigned pi_bench_read(FILE *in, FILE *echo, pi_bench_set_t *s) {
+  char line[1024];
+  unsigned n = 0;
+  while (fgets(line, sizeof line, in)) {
+    // the pi may prefix its output: look for the tag anywhere.
+    char *p = strstr(line, BENCH);
+    if (!p) {
+      if (echo)
+        fputs(line, echo);
+      continue;
+    }
+    pi_bench_t b;
+    if (!bench_parse(p + strlen(BENCH), &b))
+      panic("bad benchmark line: <%s>\n", line);
+    bench_add(s, &b);
+    n++;
+  }
+  return n;
+}
+
+void pi_bench_write_csv(FILE *out, const pi_bench_set_t *s) {
+  fprintf(out, "%s\n", CSV_HDR);
+  for (unsigned i = 0; i < s->n; i++) {
+    const pi_bench_t *b = &s->v[i];
+    fprintf(out, "%s,%u,%u,%u,%u,%u\n", b->name, b->min, b->median, b->p99,
+            b->n, b->nreject);
+  }
+}
+
+unsigned pi_bench_read_csv(FILE *in, pi_bench_set_t *s) {
+  char line[1024];
+  unsigned n = 0;
+  while (fgets(line, sizeof line, in)) {
+    if (prefix_cmp(line, CSV_HDR) || line[0] == '\n')
+      continue;
+    pi_bench_t b;
+    if (!bench_parse(line, &b))
+      panic("bad csv line: <%s>\n", line);
+    bench_add(s, &b);
+    n++;
+  }
+  return n;
+}
+
+const pi_bench_t *pi_bench_find(const pi_bench_set_t *s, const char *name) {
+  for (unsigned i = 0; i < s->n; i++)
+    if (strcmp(s->v[i].name, name) == 0)
+      return &s->v[i];
+  return 0;
+}
+
+static double change(uint32_t old, uint32_t new) {
+  if (!old)
+    return new ? 100 : 0;
+  return 100.0 * ((double)new - old) / old;
+}
+
+unsigned pi_bench_diff(FILE *out, const pi_bench_set_t *base,
+                       const pi_bench_set_t *cur, unsigned pct) {
+  fprintf(out, "%-32s %9s %9s %8s %9s %9s\n", "benchmark", "base med",
+          "median", "change", "base p99", "p99");
+
+  unsigned nslower = 0;
+  for (unsigned i = 0; i < cur->n; i++) {
+    const pi_bench_t *c = &cur->v[i], *b = pi_bench_find(base, c->name);
+    if (!b) {
+      fprintf(out, "%-32s %9s %9u %8s %9s %9u  (new)\n", c->name, "-",
+              c->median, "", "-", c->p99);
+      continue;
+    }
+    double d = change(b->median, c->median);
+    const char *mark = "";
+    if (d > pct) {
+      mark = "  SLOWER";
+      nslower++;
+    } else if (d < -(double)pct)
+      mark = "  faster";
+    fprintf(out, "%-32s %9u %9u %+7.1f%% %9u %9u%s\n", c->name, b->median,
+            c->median, d, b->p99, c->p99, mark);
+  }
+  for (unsigned i = 0; i < base->n; i++)
+    if (!pi_bench_find(cur, base->v[i].name))
+      fprintf(out, "%-32s %9u %9s %8s %9u %9s  (gone)\n", base->v[i].name,
+              base->v[i].median, "-", "", base->v[i].p99, "-");
+
+  fprintf(out, "%u of %u benchmarks more than %u%% slower\n", nslower,
+          cur->n, pct);
+  return nslower;
+}
+
+static FILE *open_or_die(const char *path, const char *mode) {
+  FILE *f = fopen(path, mode);
+  if (!f)
+    sys_die(fopen, "can't open <%s>", path);
+  return f;
+}
+
+unsigned pi_bench_report(FILE *out, const char *log_path,
+                         const char *csv_path, const char *base_path,
+                         unsigned pct) {
+  pi_bench_set_t cur = {0}, base = {0};
+
+  FILE *in = open_or_die(log_path, "r");
+  unsigned n = pi_bench_read(in, 0, &cur);
+  fclose(in);
+  if (!n)
+    panic("no benchmark results in <%s>\n", log_path);
+
+  FILE *csv = open_or_die(csv_path, "w");
+  pi_bench_write_csv(csv, &cur);
+  fclose(csv);
+
+  unsigned nslower = 0;
+  if (base_path) {
+    in = open_or_die(base_path, "r");
+    pi_bench_read_csv(in, &base);
+    fclose(in);
+    nslower = pi_bench_diff(out, &base, &cur, pct);
+  }
+  pi_bench_free(&cur);
+  pi_bench_free(&base);
+  return nslower;
+}
+
+void pi_bench_free(pi_bench_set_t *s) {
+  free(s->v);
+  memset(s, 0, sizeof *s);
+}
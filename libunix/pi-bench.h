@@ -0,0 +1,49 @@
+#ifndef __PI_BENCH_H__
+#define __PI_BENCH_H__
+// unix side of the pi's micro-benchmarks (libpi/include/bench.h):
+// pull the "BENCH:" lines out of a run's output, save them as a csv
+// and compare them against a stored baseline csv.
+//
+// the csv is the pi's line without the tag, with a header:
+//      name,min,median,p99,n,nreject
+#include <stdio.h>
+#include <stdint.h>
+
+typedef struct {
+  char name[64];
+  uint32_t min, median, p99;
+  unsigned n, nreject;
+} pi_bench_t;
+
+typedef struct {
+  pi_bench_t *v;
+  unsigned n, cap;
+} pi_bench_set_t;
+
+// add every "BENCH:" line in <in> to <s>; other lines are echoed to
+// <echo> if non-null.  a name seen twice keeps the last result.
+// returns how many lines were read.
+unsigned pi_bench_read(FILE *in, FILE *echo, pi_bench_set_t *s);
+
+// csv i/o.  <pi_bench_read_csv> returns the number of rows.
+void pi_bench_write_csv(FILE *out, const pi_bench_set_t *s);
+unsigned pi_bench_read_csv(FILE *in, pi_bench_set_t *s);
+
+const pi_bench_t *pi_bench_find(const pi_bench_set_t *s, const char *name);
+
+// print <cur> next to <base> and return the number of benchmarks
+// whose median got more than <pct> percent slower.  benchmarks in
+// only one of them are listed but aren't regressions.
+unsigned pi_bench_diff(FILE *out, const pi_bench_set_t *base,
+                       const pi_bench_set_t *cur, unsigned pct);
+
+// read the run in <log_path> and write it to <csv_path>.  if
+// <base_path> is non-null, diff against it.  returns the number of
+// regressions.
+unsigned pi_bench_report(FILE *out, const char *log_path,
+                         const char *csv_path, const char *base_path,
+                         unsigned pct);
+
+void pi_bench_free(pi_bench_set_t *s);
+
+#endif
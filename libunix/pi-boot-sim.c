@@ -0,0 +1,92 @@
+// unix stand-in for the pi's <boot_chunk_get> (libpi/src/boot-chunk.c):
+// keep the two in sync.
+#include <string.h>
+
+#include "libunix.h"
+#include "pi-boot.h"
+
+static void send_hashes(pi_frame_t *f, unsigned seq, const boot_hello_t *b,
+                        const uint8_t *p) {
+  unsigned n = boot_nchunks(b->nbytes);
+
+  for (unsigned first = 0; first < n; first += BOOT_HASHES_PER_FRAME) {
+    uint32_t msg[2 + BOOT_HASHES_PER_FRAME];
+    unsigned m = n - first;
+    if (m > BOOT_HASHES_PER_FRAME)
+      m = BOOT_HASHES_PER_FRAME;
+
+    msg[0] = first;
+    msg[1] = m;
+    for (unsigned i = 0; i < m; i++) {
+      unsigned idx = first + i;
+      msg[2 + i] = our_crc32(p + idx * BOOT_CHUNK_NBYTES,
+                             boot_chunk_nbytes(b->nbytes, idx));
+    }
+    pi_frame_send(f, BOOT_HASHES, seq, msg, (2 + m) * 4);
+  }
+}
+
+uint32_t pi_boot_sim(pi_frame_t *f, uint8_t *mem, uint32_t lo, uint32_t hi,
+                     unsigned drop_every, uint32_t *nbytes) {
+  uint8_t buf[FRAME_MAXLEN];
+  boot_hello_t b = {0};
+  unsigned count = 0, nchunk = 0;
+
+  while (1) {
+    frame_hdr_t h;
+    if (pi_frame_recv(f, &h, buf, 0) != FRAME_OK) {
+      if (b.nbytes)
+        pi_frame_send(f, BOOT_CHUNK_ACK, count, 0, 0);
+      continue;
+    }
+    if (pi_frame_ctl(f, &h, buf))
+      continue;
+
+    switch (h.type) {
+    case BOOT_HELLO:
+      if (h.len != sizeof b)
+        break;
+      memcpy(&b, buf, sizeof b);
+      if (b.addr < lo || b.addr >= hi || b.nbytes > hi - b.addr) {
+        uint32_t code = BOOT_BAD_ADDR;
+        pi_frame_send(f, BOOT_ERROR, h.seq, &code, sizeof code);
+        b.nbytes = 0;
+        break;
+      }
+      count = 0;
+      send_hashes(f, h.seq, &b, mem + (b.addr - lo));
+      break;
+
+    case BOOT_CHUNK: {
+      if (!b.nbytes)
+        break;
+      uint32_t idx;
+      memcpy(&idx, buf, sizeof idx);
+      if (h.seq != (count & 0xff) || idx >= boot_nchunks(b.nbytes) ||
+          h.len != 4 + boot_chunk_nbytes(b.nbytes, idx) ||
+          (drop_every && ++nchunk % drop_every == 0)) {
+        pi_frame_send(f, BOOT_CHUNK_ACK, count, 0, 0);
+        break;
+      }
+      memcpy(mem + (b.addr - lo) + idx * BOOT_CHUNK_NBYTES, buf + 4,
+             h.len - 4);
+      count++;
+      pi_frame_send(f, BOOT_CHUNK_ACK, count, 0, 0);
+      break;
+    }
+
+    case BOOT_DONE: {
+      if (!b.nbytes)
+        break;
+      uint32_t crc = our_crc32(mem + (b.addr - lo), b.nbytes);
+      pi_frame_send(f, BOOT_DONE, h.seq, &crc, sizeof crc);
+      if (crc != b.crc)
+        break;
+      *nbytes = b.nbytes;
+      return b.addr;
+    }
+    default:
+      break;
+    }
+  }
+}
@@ -0,0 +1,140 @@
+// unix side of the chunked image upload: see <pi-boot.h>.
+#include <string.h>
+
+#include "libunix.h"
+#include "pi-boot.h"
+
+// send hello and collect the crc of every chunk the pi has at <addr>.
+static void get_hashes(pi_frame_t *f, const boot_hello_t *b,
+                       uint32_t *hashes) {
+  unsigned n = boot_nchunks(b->nbytes);
+  unsigned usec = FRAME_TIMEOUT_USEC + frame_wire_usec(f->baud, FRAME_MAXLEN);
+  uint32_t buf[FRAME_MAXLEN / 4];
+
+  for (unsigned i = 0; i < FRAME_RETRIES; i++) {
+    pi_frame_send(f, BOOT_HELLO, f->tx_seq, b, sizeof *b);
+
+    unsigned got = 0;
+    frame_hdr_t h;
+    while (got < n && pi_frame_recv(f, &h, buf, usec) == FRAME_OK) {
+      if (h.type == BOOT_ERROR)
+        panic("pi rejected image at %x, nbytes=%d: error=%d\n", b->addr,
+              b->nbytes, buf[0]);
+      // a frame went missing: start over.
+      if (h.type != BOOT_HASHES || buf[0] != got)
+        break;
+      memcpy(&hashes[got], &buf[2], buf[1] * 4);
+      got += buf[1];
+    }
+    if (got == n)
+      return;
+  }
+  panic("pi never answered hello\n");
+}
+
+static void send_chunk(pi_frame_t *f, unsigned pos, unsigned idx,
+                       const uint8_t *code, unsigned nbytes) {
+  uint8_t buf[4 + BOOT_CHUNK_NBYTES];
+  unsigned n = boot_chunk_nbytes(nbytes, idx);
+
+  memcpy(buf, &idx, 4);
+  memcpy(buf + 4, code + idx * BOOT_CHUNK_NBYTES, n);
+  pi_frame_send(f, BOOT_CHUNK, pos & 0xff, buf, 4 + n);
+}
+
+// go-back-n over the <nneed> chunks in <need>.
+static void send_chunks(pi_frame_t *f, const unsigned *need, unsigned nneed,
+                        const uint8_t *code, unsigned nbytes,
+                        pi_boot_stats_t *s) {
+  unsigned usec = FRAME_TIMEOUT_USEC +
+                  BOOT_WINDOW * frame_wire_usec(f->baud, 4 + BOOT_CHUNK_NBYTES);
+
+  // <base> is the pi's count, <next> the next position to send,
+  // <rewound> the base we last went back to on a duplicate ack.
+  unsigned base = 0, next = 0, rewound = ~0, ntimeout = 0;
+  while (base < nneed) {
+    for (; next < nneed && next - base < BOOT_WINDOW; next++) {
+      send_chunk(f, next, need[next], code, nbytes);
+      s->nsent++;
+    }
+
+    frame_hdr_t h;
+    uint8_t buf[FRAME_MAXLEN];
+    int r = pi_frame_recv(f, &h, buf, usec);
+    if (r == FRAME_TIMEOUT) {
+      if (++ntimeout > FRAME_RETRIES)
+        panic("pi stopped acking chunks at %d of %d\n", base, nneed);
+      next = base;
+      continue;
+    }
+    if (r != FRAME_OK || h.type != BOOT_CHUNK_ACK)
+      continue;
+
+    unsigned count = base + ((h.seq - base) & 0xff);
+    if (count > next)
+      continue;
+    if (count > base) {
+      base = count;
+      ntimeout = 0;
+    } else if (base < next && rewound != base) {
+      // pi dropped <base>: everything after it is getting re-acked
+      // with the same count, only go back once.
+      rewound = base;
+      next = base;
+    }
+  }
+}
+
+// returns the crc the pi computed over the image, or panics.
+static uint32_t send_done(pi_frame_t *f) {
+  unsigned usec = FRAME_TIMEOUT_USEC + frame_wire_usec(f->baud, 4);
+  for (unsigned i = 0; i < FRAME_RETRIES; i++) {
+    pi_frame_send(f, BOOT_DONE, f->tx_seq, 0, 0);
+
+    frame_hdr_t h;
+    uint32_t crc;
+    while (pi_frame_recv(f, &h, &crc, usec) == FRAME_OK)
+      if (h.type == BOOT_DONE && h.len == sizeof crc)
+        return crc;
+  }
+  panic("pi never answered done\n");
+}
+
+int pi_boot_upload(pi_frame_t *f, uint32_t addr, const void *code,
+                   unsigned nbytes, pi_boot_stats_t *s) {
+  demand(nbytes, "empty image?");
+  pi_boot_stats_t stats;
+  if (!s)
+    s = &stats;
+  memset(s, 0, sizeof *s);
+
+  boot_hello_t b = {.addr = addr, .nbytes = nbytes,
+                    .crc = our_crc32(code, nbytes)};
+  unsigned n = boot_nchunks(nbytes);
+  uint32_t *hashes = calloc(n, sizeof *hashes);
+  unsigned *need = calloc(n, sizeof *need);
+  s->nchunks = n;
+
+  // a bad final crc means something got past the per-chunk checks:
+  // the second pass's hashes will show what.
+  int ok = 0;
+  for (unsigned pass = 0; pass < 2 && !ok; pass++) {
+    get_hashes(f, &b, hashes);
+
+    unsigned nneed = 0;
+    const uint8_t *p = code;
+    for (unsigned i = 0; i < n; i++)
+      if (hashes[i] != our_crc32(p + i * BOOT_CHUNK_NBYTES,
+                                 boot_chunk_nbytes(nbytes, i)))
+        need[nneed++] = i;
+    if (!pass)
+      s->nsame = n - nneed;
+
+    send_chunks(f, need, nneed, code, nbytes, s);
+    ok = send_done(f) == b.crc;
+  }
+
+  free(hashes);
+  free(need);
+  return ok;
+}
@@ -0,0 +1,28 @@
+#ifndef __PI_BOOT_H__
+#define __PI_BOOT_H__
+// unix side of the chunked image upload in <boot-proto.h>; the pi
+// side is <libpi/include/boot-chunk.h>.
+#include "pi-frame.h"
+#include "boot-proto.h"
+
+typedef struct {
+  unsigned nchunks; // chunks in the image.
+  unsigned nsame;   // already on the pi: not sent.
+  unsigned nsent;   // chunk frames sent, including resends.
+} pi_boot_stats_t;
+
+// upload <nbytes> of <code> to <addr> on the pi, sending only the
+// chunks that differ from what's already there.  returns 1 once the
+// pi has checked the crc of the whole image, 0 if it never matched.
+// stats go in <s> if non-null.
+int pi_boot_upload(pi_frame_t *f, uint32_t addr, const void *code,
+                   unsigned nbytes, pi_boot_stats_t *s);
+
+// a unix stand-in for the pi's <boot_chunk_get>, for testing the
+// upload without hardware.  <mem> plays the pi's memory [lo,hi).
+// if <drop_every> is non-zero every that-many-th chunk is treated as
+// if it had a bad crc.  returns the image address, size in <nbytes>.
+uint32_t pi_boot_sim(pi_frame_t *f, uint8_t *mem, uint32_t lo, uint32_t hi,
+                     unsigned drop_every, uint32_t *nbytes);
+
+#endif
@@ -1,6 +1,8 @@
 #include "libunix.h"
 #include <ctype.h>
 
+#include "pi-ktrace.h"
+
 // hack-y state machine to indicate when we've seen the special string
 // 'DONE!!!' from the pi telling us to shutdown.
 int pi_done(unsigned char *s) {
@@ -39,9 +41,11 @@ void remove_nonprint(uint8_t *buf, int n) {
 void pi_cat(int fd, const char *portname) {
   output("listening on ttyusb=<%s>\n", portname);
 
+  // binary trace dumps (<ktrace_dump>) get decoded, not echoed.
+  pi_ktrace_scan_t kt = {0};
   while (1) {
-    unsigned char buf[4096];
-    int n = read(fd, buf, sizeof buf - 1);
+    unsigned char raw[4096], buf[sizeof raw + 4];
+    int n = read(fd, raw, sizeof raw);
 
     if (!n) {
       // this isn't the program's fault.  so we exit(0).
@@ -52,6 +56,7 @@ void pi_cat(int fd, const char *portname) {
     } else if (n < 0) {
       sys_die(read, "pi connection closed.  cleaning up\n");
     } else {
+      n = pi_ktrace_scan(&kt, raw, n, buf, stderr, PI_KTRACE_CYC_PER_USEC);
       buf[n] = 0;
 
       // if you keep getting "" "" "" it's b/c of the GET_CODE message from
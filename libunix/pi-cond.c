@@ -0,0 +1,179 @@
+// condition compiler: see <pi-cond.h>.  precedence climbing straight
+// into stack code.
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libunix.h"
+#include "pi-cond.h"
+
+typedef struct {
+  const char *s; // what's left of the expression.
+  uint8_t *code;
+  unsigned n;
+  unsigned depth, max_depth; // of the pi's stack.
+  char *err;
+  unsigned errlen;
+} cc_t;
+
+static int cc_err(cc_t *c, const char *msg) {
+  // just the first one.
+  if (!*c->err)
+    snprintf(c->err, c->errlen, "%s at <%s>", msg, *c->s ? c->s : "end");
+  return 0;
+}
+
+// emit <op> which leaves the stack <push> deeper (-1 for binary ops).
+static int emit(cc_t *c, unsigned op, int push) {
+  if (c->n == DBG_COND_MAX)
+    return cc_err(c, "too long");
+  c->code[c->n++] = op;
+  c->depth += push;
+  if (c->depth > c->max_depth)
+    c->max_depth = c->depth;
+  if (c->max_depth > DBG_COND_STACK)
+    return cc_err(c, "too deeply nested");
+  return 1;
+}
+
+static int emit8(cc_t *c, uint8_t x) {
+  if (c->n == DBG_COND_MAX)
+    return cc_err(c, "too long");
+  c->code[c->n++] = x;
+  return 1;
+}
+
+static void skip_ws(cc_t *c) {
+  while (isspace(*c->s))
+    c->s++;
+}
+
+static int reg_num(const char *name, unsigned len) {
+  static const struct {
+    const char *name;
+    unsigned reg;
+  } alias[] = {
+      {"fp", 11}, {"ip", 12}, {"sp", 13}, {"lr", 14}, {"pc", 15}, {"cpsr", 16},
+  };
+  for (unsigned i = 0; i < sizeof alias / sizeof alias[0]; i++)
+    if (strlen(alias[i].name) == len && !strncmp(name, alias[i].name, len))
+      return alias[i].reg;
+
+  if (len < 2 || len > 3 || name[0] != 'r')
+    return -1;
+  unsigned r = 0;
+  for (unsigned i = 1; i < len; i++) {
+    if (!isdigit(name[i]))
+      return -1;
+    r = r * 10 + name[i] - '0';
+  }
+  return r < 16 ? r : -1;
+}
+
+static int cc_expr(cc_t *c, unsigned min_prec);
+
+static int cc_unary(cc_t *c) {
+  skip_ws(c);
+  char ch = *c->s;
+
+  switch (ch) {
+  case '!':
+  case '-':
+  case '~':
+  case '*':
+    c->s++;
+    if (!cc_unary(c))
+      return 0;
+    return emit(c, ch == '!'   ? DBG_C_NOT
+                   : ch == '-' ? DBG_C_NEG
+                   : ch == '~' ? DBG_C_INV
+                               : DBG_C_LOAD,
+                0);
+  case '(':
+    c->s++;
+    if (!cc_expr(c, 1))
+      return 0;
+    skip_ws(c);
+    if (*c->s != ')')
+      return cc_err(c, "expected ')'");
+    c->s++;
+    return 1;
+  }
+
+  if (isdigit(ch)) {
+    char *end;
+    uint32_t x = strtoul(c->s, &end, 0);
+    c->s = end;
+    if (!emit(c, DBG_C_IMM, 1))
+      return 0;
+    for (unsigned i = 0; i < 4; i++)
+      if (!emit8(c, x >> (8 * i)))
+        return 0;
+    return 1;
+  }
+
+  if (isalpha(ch)) {
+    const char *name = c->s;
+    while (isalnum(*c->s))
+      c->s++;
+    unsigned len = c->s - name;
+    if (len == 4 && !strncmp(name, "hits", 4))
+      return emit(c, DBG_C_HITS, 1);
+    int r = reg_num(name, len);
+    if (r < 0) {
+      c->s = name;
+      return cc_err(c, "unknown name");
+    }
+    return emit(c, DBG_C_REG, 1) && emit8(c, r);
+  }
+  return cc_err(c, "expected a value");
+}
+
+// two character operators first so "<" doesn't match "<=".
+static const struct {
+  const char *s;
+  unsigned prec, op;
+} binops[] = {
+    {"||", 1, DBG_C_LOR}, {"&&", 2, DBG_C_LAND}, {"==", 6, DBG_C_EQ},
+    {"!=", 6, DBG_C_NE},  {"<=", 7, DBG_C_LE},   {">=", 7, DBG_C_GE},
+    {"<<", 8, DBG_C_SHL}, {">>", 8, DBG_C_SHR},  {"|", 3, DBG_C_OR},
+    {"^", 4, DBG_C_XOR},  {"&", 5, DBG_C_AND},   {"<", 7, DBG_C_LT},
+    {">", 7, DBG_C_GT},   {"+", 9, DBG_C_ADD},   {"-", 9, DBG_C_SUB},
+    {"*", 10, DBG_C_MUL},
+};
+
+// an expression whose operators all bind at least as tight as
+// <min_prec>.
+static int cc_expr(cc_t *c, unsigned min_prec) {
+  if (!cc_unary(c))
+    return 0;
+  while (1) {
+    skip_ws(c);
+    unsigned i;
+    for (i = 0; i < sizeof binops / sizeof binops[0]; i++)
+      if (prefix_cmp(c->s, binops[i].s))
+        break;
+    if (i == sizeof binops / sizeof binops[0] || binops[i].prec < min_prec)
+      return 1;
+    c->s += strlen(binops[i].s);
+    // left associative: the right side only takes tighter operators.
+    if (!cc_expr(c, binops[i].prec + 1) || !emit(c, binops[i].op, -1))
+      return 0;
+  }
+}
+
+int pi_cond_compile(uint8_t *code, const char *expr, char *err,
+                    unsigned errlen) {
+  cc_t c = {.s = expr, .code = code, .err = err, .errlen = errlen};
+  *err = 0;
+  if (!cc_expr(&c, 1))
+    return -1;
+  skip_ws(&c);
+  if (*c.s) {
+    cc_err(&c, "junk after the expression");
+    return -1;
+  }
+  assert(c.depth == 1);
+  return c.n;
+}
@@ -0,0 +1,24 @@
+#ifndef __PI_COND_H__
+#define __PI_COND_H__
+// compile break and watchpoint conditions for the pi (<dbg-cond.h>)
+// from C-ish expressions, eg:
+//
+//      r0 == 0x1234 && *(sp + 8) > 3
+//      (hits & 1023) == 0
+//      cpsr >> 28 == 4              (just Z)
+//
+// operands: numbers (strtoul: 0x.., 0.., decimal), registers r0-r15,
+// fp, ip, sp, lr, pc, cpsr, and <hits> (times the point was reached,
+// this time included).  operators are C's, with C's precedence:
+//      unary: ! - ~ *(load a word)
+//      * + - << >> < <= > >= == != & ^ | && ||
+// everything is unsigned 32-bit; && and || don't short circuit.
+#include <stdint.h>
+#include "dbg-cond.h"
+
+// compile <expr> into <code> (DBG_COND_MAX bytes).  returns its
+// length, or -1 with why in <err>.
+int pi_cond_compile(uint8_t *code, const char *expr, char *err,
+                    unsigned errlen);
+
+#endif
@@ -0,0 +1,210 @@
+// unix side of the debugger wire protocol: see <pi-dbg.h>
+#include <string.h>
+
+#include "libunix.h"
+#include "pi-dbg.h"
+#include "dbg-cond.h"
+
+void pi_dbg_init(pi_dbg_t *d, pi_frame_t *f) {
+  memset(d, 0, sizeof *d);
+  d->f = f;
+  memset(d->wp, 0xff, sizeof d->wp);
+}
+
+static void send_msg(pi_dbg_t *d, unsigned op, const void *data,
+                     unsigned nbytes) {
+  uint8_t buf[sizeof(dbg_hdr_t) + 12 + DBG_MEM_MAX];
+  assert(nbytes <= sizeof buf - sizeof(dbg_hdr_t));
+  dbg_hdr_t h = {.op = op, .nbytes = nbytes};
+  memcpy(buf, &h, sizeof h);
+  memcpy(buf + sizeof h, data, nbytes);
+  if (!pi_frame_write(d->f, buf, sizeof h + nbytes))
+    panic("debugger: pi stopped acking\n");
+}
+
+static uint32_t get32(pi_dbg_t *d) {
+  uint32_t x;
+  pi_frame_read(d->f, &x, sizeof x);
+  return x;
+}
+
+// apply a register delta: <mask>, then one word per set bit.
+static void read_delta(pi_dbg_t *d, uint32_t mask, int *changed) {
+  for (unsigned i = 0; i < DBG_NREGS; i++) {
+    int c = (mask >> i) & 1;
+    if (c)
+      d->regs[i] = get32(d);
+    if (changed)
+      changed[i] = c;
+  }
+}
+
+// read one message and apply it if it's pi state.  returns its op;
+// <payload> gets the payload of anything else (must fit).
+static unsigned next_msg(pi_dbg_t *d, void *payload, unsigned max,
+                         pi_dbg_trace_fn trace_fn, void *arg) {
+  dbg_hdr_t h;
+  pi_frame_read(d->f, &h, sizeof h);
+
+  switch (h.op) {
+  case DBG_STOP:
+    pi_frame_read(d->f, &d->stop, sizeof d->stop);
+    read_delta(d, d->stop.mask, d->changed);
+    d->stopped_p = 1;
+    if (d->hist)
+      pi_trace_add(d->hist, d->regs);
+    break;
+  case DBG_TRACE_ENTS: {
+    static uint8_t buf[DBG_TRACE_BUF];
+    uint32_t nent = get32(d), nbytes = get32(d);
+    if (nbytes > sizeof buf)
+      panic("debugger: %u bytes of trace, expected at most %u\n", nbytes,
+            (unsigned)sizeof buf);
+    pi_frame_read(d->f, buf, nbytes);
+    if (d->hist)
+      pi_trace_append(d->hist, buf, nbytes, nent);
+
+    unsigned off = 0;
+    for (unsigned i = 0; i < nent; i++) {
+      off += dbg_trace_dec(buf + off, d->regs);
+      if (trace_fn)
+        trace_fn(arg, d->regs);
+    }
+    if (off != nbytes)
+      panic("debugger: %u trace entries used %u of %u bytes\n", nent, off,
+            nbytes);
+    break;
+  }
+  case DBG_POINTS:
+    pi_frame_read(d->f, d->bp, sizeof d->bp);
+    pi_frame_read(d->f, d->wp, sizeof d->wp);
+    break;
+  default:
+    if (h.nbytes > max)
+      panic("debugger: op=%x with %u bytes, expected at most %u\n", h.op,
+            h.nbytes, max);
+    pi_frame_read(d->f, payload, h.nbytes);
+    break;
+  }
+  return h.op;
+}
+
+int pi_dbg_wait(pi_dbg_t *d, unsigned usec, pi_dbg_trace_fn trace_fn,
+                void *arg) {
+  while (!d->stopped_p) {
+    if (!pi_frame_poll(d->f, usec))
+      return 0;
+    uint32_t junk[4];
+    next_msg(d, junk, sizeof junk, trace_fn, arg);
+  }
+  return 1;
+}
+
+// send a non-resume command and wait for the reply.
+static unsigned call(pi_dbg_t *d, unsigned op, const void *data,
+                     unsigned nbytes, void *reply, unsigned max) {
+  if (!d->stopped_p)
+    panic("debugger: op=%x while the pi is running\n", op);
+  send_msg(d, op, data, nbytes);
+  while (1) {
+    unsigned r = next_msg(d, reply, max, 0, 0);
+    if (r == DBG_POINTS || r == DBG_OK || r == DBG_ERR || r == DBG_MEM)
+      return r;
+  }
+}
+
+static int call_ok(pi_dbg_t *d, unsigned op, const void *data,
+                   unsigned nbytes) {
+  uint32_t err = 0;
+  if (call(d, op, data, nbytes, &err, sizeof err) == DBG_OK)
+    return 1;
+  d->err = err;
+  return 0;
+}
+
+static void resume(pi_dbg_t *d, unsigned op, uint32_t arg) {
+  if (!d->stopped_p)
+    panic("debugger: resume while the pi is running\n");
+  send_msg(d, op, &arg, op == DBG_CONTINUE ? 0 : sizeof arg);
+  d->stopped_p = 0;
+}
+
+void pi_dbg_step(pi_dbg_t *d, uint32_t n) { resume(d, DBG_STEP, n); }
+void pi_dbg_trace(pi_dbg_t *d, uint32_t n) { resume(d, DBG_TRACE, n); }
+void pi_dbg_until(pi_dbg_t *d, uint32_t pc) { resume(d, DBG_UNTIL, pc); }
+void pi_dbg_continue(pi_dbg_t *d) { resume(d, DBG_CONTINUE, 0); }
+
+static void point(pi_dbg_t *d, unsigned op, uint32_t addr) {
+  uint32_t err;
+  if (call(d, op, &addr, sizeof addr, &err, sizeof err) != DBG_POINTS)
+    panic("debugger: op=%x: pi said error %u\n", op, err);
+}
+
+void pi_dbg_bp_set(pi_dbg_t *d, uint32_t addr) { point(d, DBG_BP_SET, addr); }
+void pi_dbg_bp_clr(pi_dbg_t *d, uint32_t addr) { point(d, DBG_BP_CLR, addr); }
+void pi_dbg_wp_set(pi_dbg_t *d, uint32_t addr) { point(d, DBG_WP_SET, addr); }
+void pi_dbg_wp_clr(pi_dbg_t *d, uint32_t addr) { point(d, DBG_WP_CLR, addr); }
+
+int pi_dbg_cond_set(pi_dbg_t *d, unsigned kind, uint32_t addr,
+                    uint32_t ignore, const uint8_t *code, unsigned n) {
+  uint8_t m[16 + DBG_COND_MAX];
+  uint32_t hdr[4] = {kind, addr, ignore, n};
+  assert(n <= DBG_COND_MAX);
+  memcpy(m, hdr, sizeof hdr);
+  memcpy(m + sizeof hdr, code, n);
+  return call_ok(d, DBG_COND_SET, m, sizeof hdr + n);
+}
+
+int pi_dbg_reg_write(pi_dbg_t *d, unsigned reg, uint32_t val) {
+  uint32_t m[2] = {reg, val};
+  if (!call_ok(d, DBG_REG_WRITE, m, sizeof m))
+    return 0;
+  d->regs[reg] = val;
+  return 1;
+}
+
+int pi_dbg_mem_read(pi_dbg_t *d, uint32_t addr, void *data, unsigned n) {
+  static uint8_t reply[12 + DBG_MEM_MAX];
+  uint8_t *p = data;
+  while (n) {
+    uint32_t len = n < DBG_MEM_MAX ? n : DBG_MEM_MAX;
+    uint32_t m[2] = {addr, len};
+    unsigned r = call(d, DBG_MEM_READ, m, sizeof m, reply, sizeof reply);
+    if (r != DBG_MEM) {
+      memcpy(&d->err, reply, sizeof d->err);
+      return 0;
+    }
+    uint32_t hdr[3];
+    memcpy(hdr, reply, sizeof hdr);
+    if (hdr[0] != addr || hdr[1] != len)
+      panic("debugger: asked for %u bytes at %x, got %u at %x\n", len, addr,
+            hdr[1], hdr[0]);
+    if (our_crc32(reply + 12, len) != hdr[2]) {
+      d->err = DBG_E_BAD_CRC;
+      return 0;
+    }
+    memcpy(p, reply + 12, len);
+    p += len;
+    addr += len;
+    n -= len;
+  }
+  return 1;
+}
+
+int pi_dbg_mem_write(pi_dbg_t *d, uint32_t addr, const void *data,
+                     unsigned n) {
+  static uint8_t m[12 + DBG_MEM_MAX];
+  const uint8_t *p = data;
+  while (n) {
+    uint32_t len = n < DBG_MEM_MAX ? n : DBG_MEM_MAX;
+    uint32_t hdr[3] = {addr, len, our_crc32(p, len)};
+    memcpy(m, hdr, sizeof hdr);
+    memcpy(m + 12, p, len);
+    if (!call_ok(d, DBG_MEM_WRITE, m, sizeof hdr + len))
+      return 0;
+    p += len;
+    addr += len;
+    n -= len;
+  }
+  return 1;
+}
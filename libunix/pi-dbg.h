@@ -0,0 +1,64 @@
+#ifndef __PI_DBG_H__
+#define __PI_DBG_H__
+// unix side of the debugger wire protocol (<dbg-proto.h>).  keeps a
+// copy of the pi's registers up to date from the deltas it sends.
+//
+// the resume calls (step, trace, until, continue) return right away;
+// call <pi_dbg_wait> to get the next stop.  everything else is a
+// round trip and must only be done while the pi is stopped.
+#include <stdint.h>
+#include "pi-frame.h"
+#include "dbg-proto.h"
+#include "pi-trace.h"
+
+typedef struct {
+  pi_frame_t *f;
+  int stopped_p;
+  dbg_stop_t stop; // the last stop.
+
+  uint32_t regs[DBG_NREGS];
+  int changed[DBG_NREGS]; // changed at the last stop.
+  uint32_t bp[DBG_NBP];   // 0 = off
+  uint32_t wp[DBG_NWP];   // ~0 = off
+
+  uint32_t err; // DBG_E_* of the last failed call.
+
+  // if set, every traced instruction and stop is recorded here.
+  pi_trace_t *hist;
+} pi_dbg_t;
+
+// called for every traced instruction with the registers after it.
+typedef void (*pi_dbg_trace_fn)(void *arg, const uint32_t *regs);
+
+void pi_dbg_init(pi_dbg_t *d, pi_frame_t *f);
+
+// wait up to <usec> (0 = forever) for the pi to stop.  trace entries
+// that arrive first are handed to <trace_fn> (can be 0).  returns 1
+// once stopped, 0 on timeout.
+int pi_dbg_wait(pi_dbg_t *d, unsigned usec, pi_dbg_trace_fn trace_fn,
+                void *arg);
+
+// resume.
+void pi_dbg_step(pi_dbg_t *d, uint32_t n);
+void pi_dbg_trace(pi_dbg_t *d, uint32_t n);
+void pi_dbg_until(pi_dbg_t *d, uint32_t pc);
+void pi_dbg_continue(pi_dbg_t *d);
+
+// break and watchpoints: update <d->bp> and <d->wp>.
+void pi_dbg_bp_set(pi_dbg_t *d, uint32_t addr);
+void pi_dbg_bp_clr(pi_dbg_t *d, uint32_t addr);
+void pi_dbg_wp_set(pi_dbg_t *d, uint32_t addr);
+void pi_dbg_wp_clr(pi_dbg_t *d, uint32_t addr);
+// only stop at the point at <addr> (kind is DBG_COND_BP or _WP) when
+// <code> (<pi-cond.h>, n = 0 for none) holds, and not the first
+// <ignore> times.  returns 1 on success, 0 with the reason in <d->err>.
+int pi_dbg_cond_set(pi_dbg_t *d, unsigned kind, uint32_t addr,
+                    uint32_t ignore, const uint8_t *code, unsigned n);
+
+// these return 1 on success, 0 with the reason in <d->err>.
+int pi_dbg_reg_write(pi_dbg_t *d, unsigned reg, uint32_t val);
+// any size: split into DBG_MEM_MAX pieces, each crc checked.
+int pi_dbg_mem_read(pi_dbg_t *d, uint32_t addr, void *data, unsigned n);
+int pi_dbg_mem_write(pi_dbg_t *d, uint32_t addr, const void *data, unsigned n);
+
+#endif
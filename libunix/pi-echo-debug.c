@@ -1,4 +1,7 @@
 #include "libunix.h"
+#include "list-index.h"
+#include "pi-cond.h"
+#include "pi-dbg.h"
 #include <assert.h>
 #include <ctype.h>
 #include <stdlib.h>
@@ -6,342 +9,332 @@
 #include <unistd.h>
 
 static const char *progname;
+// <progname> with .bin replaced by .list, and its parsed index.
+static char *list_name;
+static list_index_t *list_ix;
+// most lines of a function to print around the pc.
+enum { MAX_FN_LINES = 200 };
 static int num_lines_last_printed = 0;
-typedef struct debugger_state {
-  int regs[17];
-  int changed_regs[17];
-  int breakpoints[5];
-  int watchpoints[2];
-} debugger_state_t;
-
-enum debugger_action {
-  ADD_BP,
-  REMOVE_BP,
-  STEP,
-  CONTINUE,
-  EXIT,
-  ADD_WP,
-  REMOVE_WP,
-  WRITE_REG,
-  READ_ADDR,
-  WRITE_ADDR
+
+static const char *stop_names[] = {
+    [DBG_STOP_START] = "start",        [DBG_STOP_STEP] = "step",
+    [DBG_STOP_UNTIL] = "reached pc",   [DBG_STOP_BP] = "breakpoint",
+    [DBG_STOP_WP] = "watchpoint",
 };
 
-unsigned parse_input(char *input) {
-  // Assuming input is some big buffer we can modify in place
-  char workspace[100];
-  if (input[0] == '\n' || strncmp(input, "s\n", 2) == 0) {
-    input[0] = STEP;
-    input[1] = 0;
-    return 2;
-  }
+// parsed once; only re-parsed if the .list changes underneath us.
+static list_index_t *load_list(void) {
+  if (!list_ix)
+    list_ix = list_index_load(list_name);
+  else
+    list_index_refresh(list_ix);
+  return list_ix;
+}
 
-  if (strncmp(input, "b ", 2) == 0) {
-    input[0] = ADD_BP;
-    // write 1,2,3,4 with the int
-    unsigned *addr = (unsigned *)(input + 1);
-    *addr = (unsigned)strtol(input + 2, NULL, 0);
-    unsigned addr_sending = *(unsigned *)(input + 1);
-    input[5] = 0;
-    return 6;
-  }
-  // bc - breakpoint clear
-  if (strncmp(input, "bc ", 3) == 0) {
-    input[0] = REMOVE_BP;
-    unsigned *addr = (unsigned *)(input + 1);
-    *addr = (unsigned)strtol(input + 3, NULL, 0);
-    input[5] = 0;
-    return 6;
-  }
-  if (strncmp(input, "w ", 2) == 0) {
-    input[0] = ADD_WP;
-    unsigned *addr = (unsigned *)(input + 1);
-    *addr = (unsigned)strtol(input + 2, NULL, 0);
-    input[5] = 0;
-    return 6;
-  }
-  // wc - watchpoint clear
-  if (strncmp(input, "wc ", 3) == 0) {
-    input[0] = REMOVE_WP;
-    unsigned *addr = (unsigned *)(input + 1);
-    *addr = (unsigned)strtol(input + 3, NULL, 0);
-    input[5] = 0;
-    return 6;
+// one line per traced instruction: "  8010 <fn+16>  add r0, r0, #1"
+static void print_trace(void *arg, const uint32_t *regs) {
+  uint32_t pc = regs[15];
+  list_index_t *ix = load_list();
+  const list_fn_t *fn = ix ? list_index_fn(ix, pc) : 0;
+  int l = ix ? list_index_line(ix, pc) : -1;
+
+  const char *inst = "";
+  if (l >= 0) {
+    // skip "addr:", the encoding and the whitespace around them.
+    inst = strchr(ix->lines[l], ':') + 1;
+    while (*inst && isspace(*inst))
+      inst++;
+    while (*inst && !isspace(*inst))
+      inst++;
+    while (*inst && isspace(*inst))
+      inst++;
   }
+  printf("  %08x <%s+%u>  %s\n", pc, fn ? fn->name : "?",
+         fn ? pc - fn->addr : 0, inst);
+}
+
+static void print_debugger_state(pi_dbg_t *db);
 
-  if (strncmp(input, "c", 1) == 0) {
-    input[0] = CONTINUE;
-    input[1] = 0;
-    return 2;
+static uint32_t arg_num(const char *s) { return strtoul(s, NULL, 0); }
+
+// every traced instruction and stop, for stepping backwards without
+// the pi.  <view> is the entry we're showing, -1 when it's the pi's
+// live state.
+static pi_trace_t hist;
+static int view = -1;
+
+// show history entry <i> as if the pi were stopped there.
+static void show_past(pi_dbg_t *d, int i) {
+  if (i < 0 || i >= (int)hist.n - 1) {
+    view = -1;
+    print_debugger_state(d);
+    return;
   }
+  view = i;
+  pi_dbg_t past = *d;
+  uint32_t before[DBG_NREGS] = {0};
+  pi_trace_get(&hist, i, past.regs);
+  if (i)
+    pi_trace_get(&hist, i - 1, before);
+  for (unsigned r = 0; r < DBG_NREGS; r++)
+    past.changed[r] = past.regs[r] != before[r];
+  print_debugger_state(&past);
+  printf("██  history: entry %d of %u (rf/rs to move, any run command "
+         "goes live)\n",
+         i, hist.n);
+}
 
-  //*(addr) = (value)
-  // If first character is * and contains =, then it's a write to memory
-  if (strncmp(input, "*", 1) == 0 && strchr(input, '=') != NULL) {
-    input[0] = WRITE_ADDR;
-    unsigned addr = strtol(input + 1, NULL, 0);
-    char *equals_char = strchr(input, '=');
-    unsigned value = strtol(equals_char + 1, NULL, 0);
-    // bytes 1-4 are addr, bytes 5-8 are value
-    unsigned *addr_ptr = (unsigned *)(input + 1);
-    *addr_ptr = addr;
-    unsigned *value_ptr = (unsigned *)(input + 5);
-    *value_ptr = value;
-    input[9] = 0;
-    return 10;
+// rs [N]: N back, rf [N]: N forward, rc: back to the last breakpoint.
+static int do_history(pi_dbg_t *d, const char *input) {
+  int at = view < 0 ? (int)hist.n - 1 : view;
+  uint32_t n = input[2] ? arg_num(input + 2) : 1;
+
+  if (strncmp(input, "rs", 2) == 0 && (!input[2] || input[2] == ' ')) {
+    show_past(d, at > (int)n ? at - n : 0);
+    return 1;
   }
-  //*(addr)
-  // If first character is * and didn't hit other case, then it's a read from
-  // memory
-  if (strncmp(input, "*", 1) == 0) {
-    input[0] = READ_ADDR;
-    unsigned addr = strtol(input + 1, NULL, 0);
-    unsigned *addr_ptr = (unsigned *)(input + 1);
-    *addr_ptr = addr;
-    input[5] = 0;
-    return 10;
+  if (strncmp(input, "rf", 2) == 0 && (!input[2] || input[2] == ' ')) {
+    show_past(d, view < 0 ? -1 : at + n);
+    return 1;
   }
-  // r[1-15] = (value)
-  // If first character is r and contains =, then it's a write to register
-  if (strncmp(input, "r", 1) == 0 && strchr(input, '=') != NULL) {
-    input[0] = WRITE_REG;
-    unsigned reg = strtol(input + 1, NULL, 0);
-    unsigned value = strtol(strchr(input, '=') + 1, NULL, 0);
-    unsigned *reg_ptr = (unsigned *)(input + 1);
-    *reg_ptr = reg;
-    unsigned *value_ptr = (unsigned *)(input + 5);
-    *value_ptr = value;
-    input[9] = 0;
-    return 10;
+  if (strcmp(input, "rc") == 0) {
+    int best = -1;
+    for (unsigned i = 0; i < DBG_NBP; i++) {
+      int j = d->bp[i] ? pi_trace_find_pc(&hist, at, d->bp[i]) : -1;
+      if (j > best)
+        best = j;
+    }
+    if (best < 0)
+      printf("UNIX: no breakpoint hit in the recorded history\n");
+    else
+      show_past(d, best);
+    return 1;
   }
-  printf("UNIX: when parsing input \"%s\", couldn't find command\n", input);
   return 0;
 }
 
-void wait_and_send_input(int unix_fd, int pi_fd) {
-  // Wait until the user sends input
-  // If no input after 1000 usec, returns
-  char buf[4096];
-  int n;
-  if ((n = read_timeout(unix_fd, buf, sizeof buf, 100))) {
-    buf[n] = 0;
-    int parsed_len = parse_input((char *)buf);
-    if (parsed_len == 0) {
-      printf("UNIX: Unrecognized input!\n");
-      return;
-    }
-    // printf("UNIX: user provided input that was parsed to be %u bytes long\n",
-    // parsed_len);
+// the rest of "b addr [ignore N] [if expr]" (or "w ..."): the point's
+// condition, checked on the pi.
+static void set_cond(pi_dbg_t *d, unsigned kind, uint32_t addr,
+                     const char *rest) {
+  while (isspace(*rest))
+    rest++;
+  if (!*rest)
+    return;
 
-    put_uint8(pi_fd, parsed_len);
-    for (int i = 0; i < parsed_len; i++) {
-      put_uint8(pi_fd, buf[i]);
+  uint32_t ignore = 0;
+  if (strncmp(rest, "ignore ", 7) == 0) {
+    char *end;
+    ignore = strtoul(rest + 7, &end, 0);
+    for (rest = end; isspace(*rest);)
+      rest++;
+  }
+
+  uint8_t code[DBG_COND_MAX];
+  int n = 0;
+  if (strncmp(rest, "if ", 3) == 0) {
+    char err[128];
+    if ((n = pi_cond_compile(code, rest + 3, err, sizeof err)) < 0) {
+      printf("UNIX: bad condition: %s\n", err);
+      return;
     }
+  } else if (*rest) {
+    printf("UNIX: expected \"ignore N\" or \"if <expr>\", got \"%s\"\n",
+           rest);
+    return;
   }
+  if (!pi_dbg_cond_set(d, kind, addr, ignore, code, n))
+    printf("UNIX: setting the condition failed: error %u\n", d->err);
 }
 
-void print_debugger_state(debugger_state_t *db) {
-  // clear terminal
-  printf("\033c");
-  // Process program
-  // Replace the final .bin in the path with .list
-  unsigned pc = db->regs[15];
-  unsigned len = strlen(progname);
-  char new_progname[300];
-  strcpy(new_progname, progname);
-  char new_end[4] = "list";
-  for (int i = len; i > len - 4; i--) {
-    new_progname[i] = new_end[i - len + 3];
-  }
+// run one command line.  the resume commands (step, trace, until,
+// continue) just send it; the rest wait for the pi's answer.
+static void do_command(pi_dbg_t *d, char *input) {
+  // Assuming input is some big buffer we can modify in place
+  input[strcspn(input, "\n")] = 0;
 
-  // Read the list file
-  FILE *list_file = fopen(new_progname, "r");
-  if (!list_file) {
-    printf("UNIX: Error opening list file\n");
+  if (do_history(d, input))
     return;
-  }
+  // everything else is about the live state.
+  view = -1;
 
-  // Buffer to store each line from the list file
-  char line[256];
-
-  // Arrays to store function lines
-  char function_lines[200][256];
-  int line_count = 0;
-  int pc_line_index = -1;
-
-  // Store the function name
-  char function_name[64] = "unknown";
-  int in_target_function = 0;
-  unsigned int function_start_addr = 0;
-  unsigned int function_end_addr = 0xFFFFFFFF;
-
-  // First pass: find the function containing PC
-  rewind(list_file);
-  while (fgets(line, sizeof(line), list_file)) {
-    // Check if this is a function header line (format like "00008574 <fib>:")
-    if (strlen(line) > 12 && line[8] == ' ' && line[9] == '<' &&
-        strchr(line, '>') != NULL) {
-      // Extract function address
-      char addr_str[9] = {0};
-      strncpy(addr_str, line, 8);
-      unsigned int func_addr = 0;
-      sscanf(addr_str, "%x", &func_addr);
-
-      // If PC is greater than or equal to this function's address
-      // and less than the next function's address (which we don't know yet),
-      // this might be our function
-      if (pc >= func_addr && func_addr > function_start_addr) {
-        function_start_addr = func_addr;
-
-        // Extract function name between < and >
-        char *start = strchr(line, '<') + 1;
-        char *end = strchr(line, '>');
-        if (start && end && end > start) {
-          int name_len = end - start;
-          if (name_len < sizeof(function_name)) {
-            strncpy(function_name, start, name_len);
-            function_name[name_len] = '\0';
-          }
-        }
-      } else if (func_addr > function_start_addr &&
-                 func_addr < function_end_addr) {
-        // This is the next function after our target function
-        function_end_addr = func_addr;
-      }
-    }
+  if (!*input || strcmp(input, "s") == 0) {
+    pi_dbg_step(d, 1);
+    return;
+  }
+  // s N: N instructions, stepped on the pi.
+  if (strncmp(input, "s ", 2) == 0) {
+    pi_dbg_step(d, arg_num(input + 2));
+    return;
+  }
+  // t N: same, printing every instruction.
+  if (strncmp(input, "t ", 2) == 0) {
+    pi_dbg_trace(d, arg_num(input + 2));
+    return;
+  }
+  // u addr: run until about to execute <addr>.
+  if (strncmp(input, "u ", 2) == 0) {
+    pi_dbg_until(d, arg_num(input + 2));
+    return;
+  }
+  if (strcmp(input, "c") == 0) {
+    pi_dbg_continue(d);
+    return;
   }
 
-  // Second pass: collect all lines of the target function
-  rewind(list_file);
-  in_target_function = 0;
-  line_count = 0;
-
-  while (fgets(line, sizeof(line), list_file) && line_count < 200) {
-    // Check if this is a function header line
-    if (strlen(line) > 12 && line[8] == ' ' && line[9] == '<' &&
-        strchr(line, '>') != NULL) {
-      char addr_str[9] = {0};
-      strncpy(addr_str, line, 8);
-      unsigned int func_addr = 0;
-      sscanf(addr_str, "%x", &func_addr);
-
-      if (func_addr == function_start_addr) {
-        // We've found the start of our target function
-        in_target_function = 1;
-        // Store the function header
-        strcpy(function_lines[line_count++], line);
-      } else if (func_addr == function_end_addr) {
-        // We've reached the next function, stop collecting
-        break;
-      }
-    } else if (in_target_function) {
-      // This is a line in our target function
-
-      // Check if this is an instruction line
-      if (strlen(line) > 9 && line[8] == ':' && isspace(line[0]) &&
-          isspace(line[1]) && isspace(line[2]) && isspace(line[3]) &&
-          isxdigit(line[4]) && isxdigit(line[5]) && isxdigit(line[6]) &&
-          isxdigit(line[7])) {
+  // b addr [ignore N] [if expr]
+  if (strncmp(input, "b ", 2) == 0) {
+    char *end;
+    uint32_t addr = strtoul(input + 2, &end, 0);
+    pi_dbg_bp_set(d, addr);
+    set_cond(d, DBG_COND_BP, addr, end);
+  }
+  // bc - breakpoint clear
+  else if (strncmp(input, "bc ", 3) == 0)
+    pi_dbg_bp_clr(d, arg_num(input + 3));
+  // w addr [ignore N] [if expr]: stops after the access.
+  else if (strncmp(input, "w ", 2) == 0) {
+    char *end;
+    uint32_t addr = strtoul(input + 2, &end, 0);
+    pi_dbg_wp_set(d, addr);
+    set_cond(d, DBG_COND_WP, addr, end);
+  }
+  // wc - watchpoint clear
+  else if (strncmp(input, "wc ", 3) == 0)
+    pi_dbg_wp_clr(d, arg_num(input + 3));
 
-        // Extract the address part
-        char addr_str[5] = {0};
-        strncpy(addr_str, line + 4, 4);
+  //*(addr) = (value)
+  else if (input[0] == '*' && strchr(input, '=')) {
+    uint32_t addr = arg_num(input + 1);
+    uint32_t val = arg_num(strchr(input, '=') + 1);
+    if (!pi_dbg_mem_write(d, addr, &val, sizeof val))
+      printf("UNIX: write to %x failed: error %u\n", addr, d->err);
+  }
+  //*(addr)
+  else if (input[0] == '*') {
+    uint32_t addr = arg_num(input + 1), val;
+    if (!pi_dbg_mem_read(d, addr, &val, sizeof val))
+      printf("UNIX: read of %x failed: error %u\n", addr, d->err);
+    else
+      printf("UNIX: *%x = %x\n", addr, val);
+    return;
+  }
+  // x addr n: hex dump <n> bytes.
+  else if (strncmp(input, "x ", 2) == 0) {
+    char *end;
+    uint32_t addr = strtoul(input + 2, &end, 0);
+    uint32_t n = arg_num(end);
+    uint8_t *buf = malloc(n + 1);
+    if (!pi_dbg_mem_read(d, addr, buf, n))
+      printf("UNIX: read of %u bytes at %x failed: error %u\n", n, addr,
+             d->err);
+    else
+      for (uint32_t i = 0; i < n; i++)
+        printf("%s%02x%s", i % 16 ? "" : "  ", buf[i],
+               i % 16 == 15 || i == n - 1 ? "\n" : " ");
+    free(buf);
+    return;
+  }
+  // r[0-16] = (value)
+  else if (input[0] == 'r' && strchr(input, '=')) {
+    unsigned reg = arg_num(input + 1);
+    uint32_t val = arg_num(strchr(input, '=') + 1);
+    if (!pi_dbg_reg_write(d, reg, val))
+      printf("UNIX: write of r%u failed: error %u\n", reg, d->err);
+  } else {
+    printf("UNIX: when parsing input \"%s\", couldn't find command\n", input);
+    return;
+  }
+  print_debugger_state(d);
+}
 
-        // Convert to integer for proper comparison
-        unsigned int line_addr = 0;
-        sscanf(addr_str, "%x", &line_addr);
+static void print_debugger_state(pi_dbg_t *db) {
+  // clear terminal
+  printf("\033c");
+  unsigned pc = db->regs[15];
 
-        // Get the lower 16 bits of PC for comparison
-        unsigned int pc_lower = pc & 0xFFFF;
+  if (!load_list()) {
+    printf("UNIX: Error opening list file <%s>\n", list_name);
+    return;
+  }
 
-        // Check if we found the PC
-        if (line_addr == pc_lower) {
-          pc_line_index = line_count;
-        }
-      }
+  // Print the function context
+  printf("████████████████████████████████████████████████████████\n");
 
-      // Store the line
-      strcpy(function_lines[line_count++], line);
+  const list_fn_t *fn = list_index_fn(list_ix, pc);
+  int pc_line = list_index_line(list_ix, pc);
+  if (fn && pc_line >= 0) {
+    // big functions: just show a window around the pc.
+    unsigned first = fn->first_line, last = fn->first_line + fn->nlines;
+    if (fn->nlines > MAX_FN_LINES) {
+      first = pc_line > MAX_FN_LINES / 2 ? pc_line - MAX_FN_LINES / 2 : 0;
+      if (first < fn->first_line)
+        first = fn->first_line;
+      if (first + MAX_FN_LINES < last)
+        last = first + MAX_FN_LINES;
     }
-  }
 
-  fclose(list_file);
+    for (unsigned i = first; i < last; i++) {
+      const char *line_ptr = list_ix->lines[i];
+      uint32_t line_addr;
 
-  // Print the function context
-  printf("████████████████████████████████████████████████████████\n");
+      // For non-instruction lines (like function headers), print as is
+      if (!list_line_is_inst(line_ptr, &line_addr)) {
+        if (*line_ptr)
+          printf("██%s\n", line_ptr);
+        continue;
+      }
 
-  if (pc_line_index >= 0) {
-    // Print the entire function
-    for (int i = 0; i < line_count; i++) {
-      char *line_ptr = function_lines[i];
-
-      // Check if this is an instruction line
-      if (strlen(line_ptr) > 9 && line_ptr[8] == ':' && isspace(line_ptr[0]) &&
-          isspace(line_ptr[1]) && isspace(line_ptr[2]) &&
-          isspace(line_ptr[3]) && isxdigit(line_ptr[4]) &&
-          isxdigit(line_ptr[5]) && isxdigit(line_ptr[6]) &&
-          isxdigit(line_ptr[7])) {
-
-        // Format: extract address and instruction text, skip raw bytes
-        char addr[9];
-        strncpy(addr, line_ptr + 4, 5); // Copy "XXXX:"
-        addr[5] = '\0';
-
-        // Find the start of the instruction text (after the raw bytes)
-        char *instr_text = line_ptr + 9; // Start after the colon
-        while (*instr_text && isspace(*instr_text))
-          instr_text++; // Skip spaces
-        while (*instr_text && !isspace(*instr_text))
-          instr_text++; // Skip raw bytes
-        while (*instr_text && isspace(*instr_text))
-          instr_text++; // Skip spaces
-
-        // Extract the full address for breakpoint comparison
-        char full_addr_str[9] = {0};
-        strncpy(full_addr_str, line_ptr + 4, 4);
-        unsigned int line_addr = 0;
-        sscanf(full_addr_str, "%x", &line_addr);
-
-        // Check if this line has a breakpoint
-        int has_breakpoint = 0;
-        for (int bp = 0; bp < 5; bp++) {
-          // Compare the lower 16 bits of the breakpoint address with the line
-          // address
-          if (db->breakpoints[bp] != 0 &&
-              (db->breakpoints[bp] & 0xFFFF) == line_addr) {
-            has_breakpoint = 1;
-            break;
-          }
+      // Find the start of the instruction text (after the raw bytes)
+      const char *instr_text = strchr(line_ptr, ':') + 1;
+      while (*instr_text && isspace(*instr_text))
+        instr_text++; // Skip spaces
+      while (*instr_text && !isspace(*instr_text))
+        instr_text++; // Skip raw bytes
+      while (*instr_text && isspace(*instr_text))
+        instr_text++; // Skip spaces
+
+      char addr[16];
+      sprintf(addr, "%04x:", line_addr & 0xffff);
+
+      // Check if this line has a breakpoint
+      int has_breakpoint = 0;
+      for (int bp = 0; bp < DBG_NBP; bp++) {
+        if (db->bp[bp] != 0 && db->bp[bp] == line_addr) {
+          has_breakpoint = 1;
+          break;
         }
+      }
 
-        // Print formatted line
-        if (i == pc_line_index) {
-          if (has_breakpoint) {
-            printf("██⏺>%s %s", addr,
-                   instr_text); // Mark the PC line with breakpoint
-          } else {
-            printf("██=>%s %s", addr, instr_text); // Mark the PC line
-          }
+      // Print formatted line
+      if (i == pc_line) {
+        if (has_breakpoint) {
+          printf("██⏺>%s %s\n", addr,
+                 instr_text); // Mark the PC line with breakpoint
         } else {
-          if (has_breakpoint) {
-            printf("██\033[47m\033[0;30m⏺ %s %s", addr, instr_text);
-            printf("\033[0m");
-          } else {
-            printf("██\033[47m\033[0;30m  %s %s", addr, instr_text);
-            printf("\033[0m");
-          }
+          printf("██=>%s %s\n", addr, instr_text); // Mark the PC line
         }
       } else {
-        // For non-instruction lines (like function headers), print as is
-        if (strlen(line_ptr) > 0) {
-          printf("██%s", line_ptr);
+        if (has_breakpoint) {
+          printf("██\033[47m\033[0;30m⏺ %s %s", addr, instr_text);
+          printf("\033[0m\n");
+        } else {
+          printf("██\033[47m\033[0;30m  %s %s", addr, instr_text);
+          printf("\033[0m\n");
         }
       }
     }
   } else {
-    printf("PC 0x%08x not found in function '%s'\n", pc, function_name);
+    printf("PC 0x%08x not found in function '%s'\n", pc,
+           fn ? fn->name : "unknown");
   }
 
+  if (db->stop.reason == DBG_STOP_WP)
+    printf("██  stopped: watchpoint at 0x%08x\n", db->stop.addr);
+  else if (db->stop.reason < sizeof stop_names / sizeof stop_names[0])
+    printf("██  stopped: %s after %u instructions\n",
+           stop_names[db->stop.reason], db->stop.nsteps);
+
   // printf("----------------------------------------\n\n");
 
   char buf[1024];
@@ -351,7 +344,7 @@ void print_debugger_state(debugger_state_t *db) {
               "████████████████████████████████████████████████████████\n");
   for (int i = 0; i < 17; i++) {
     if (i <= 12) {
-      if (!db->changed_regs[i]) {
+      if (!db->changed[i]) {
         offset += sprintf(buf + offset,
                           "██  r%-2d : \033[47m\033[0;30m%11d  0x%08x\033[0m\n",
                           i, db->regs[i], db->regs[i]);
@@ -360,7 +353,7 @@ void print_debugger_state(debugger_state_t *db) {
                           db->regs[i], db->regs[i]);
       }
     } else if (i == 13) {
-      if (!db->changed_regs[i]) {
+      if (!db->changed[i]) {
         offset += sprintf(buf + offset,
                           "██  sp  : \033[47m\033[0;30m%11d  0x%08x\033[0m\n",
                           db->regs[i], db->regs[i]);
@@ -369,7 +362,7 @@ void print_debugger_state(debugger_state_t *db) {
                           db->regs[i]);
       }
     } else if (i == 14) {
-      if (!db->changed_regs[i]) {
+      if (!db->changed[i]) {
         offset += sprintf(buf + offset,
                           "██  lr  : \033[47m\033[0;30m%11d  0x%08x\033[0m\n",
                           db->regs[i], db->regs[i]);
@@ -378,7 +371,7 @@ void print_debugger_state(debugger_state_t *db) {
                           db->regs[i]);
       }
     } else if (i == 15) {
-      if (!db->changed_regs[i]) {
+      if (!db->changed[i]) {
         offset += sprintf(buf + offset,
                           "██  pc  : \033[47m\033[0;30m%11d  0x%08x\033[0m\n",
                           db->regs[i], db->regs[i]);
@@ -387,7 +380,7 @@ void print_debugger_state(debugger_state_t *db) {
                           db->regs[i]);
       }
     } else if (i == 16) {
-      if (!db->changed_regs[i]) {
+      if (!db->changed[i]) {
         offset += sprintf(buf + offset,
                           "██  cpsr: \033[47m\033[0;30m%11d  0x%08x\033[0m\n",
                           db->regs[i], db->regs[i]);
@@ -403,10 +396,10 @@ void print_debugger_state(debugger_state_t *db) {
 
   // Print breakpoints, any that isn't 0x0
   int has_bps = 0;
-  for (int i = 0; i < 5; i++) {
-    if (db->breakpoints[i] != 0x0) {
+  for (int i = 0; i < DBG_NBP; i++) {
+    if (db->bp[i] != 0x0) {
       offset += sprintf(buf + offset, "██  bp%-2d: 0x%08x\n", i + 1,
-                        db->breakpoints[i]);
+                        db->bp[i]);
       has_bps = 1;
     }
   }
@@ -418,10 +411,10 @@ void print_debugger_state(debugger_state_t *db) {
 
   // Print watchpoints, any that isn't 0xffffffff
   int has_wps = 0;
-  for (int i = 0; i < 2; i++) {
-    if (db->watchpoints[i] != 0xffffffff) {
+  for (int i = 0; i < DBG_NWP; i++) {
+    if (db->wp[i] != 0xffffffff) {
       offset += sprintf(buf + offset, "██  wp%-2d: 0x%08x\n", i + 1,
-                        db->watchpoints[i]);
+                        db->wp[i]);
       has_wps = 1;
     }
   }
@@ -437,84 +430,6 @@ void print_debugger_state(debugger_state_t *db) {
   // printf("asdf\n");
 }
 
-unsigned parse_debugger_state(debugger_state_t *db, char *buf) {
-  // If string starts with "DS"
-  char buf2[5] = "_D_S_";
-  if (strncmp(buf, buf2, 5) != 0) {
-    return 0;
-  }
-  // printf("UNIX: RECEIVED DEBUGGER STATE PACKET %u\n", buf[5]);
-  if (buf[5] == 0) {
-    buf += 8;
-    // Unserialize
-    for (int i = 0; i < 14; i++) {
-      unsigned *reg_ptr = (unsigned *)buf;
-      db->changed_regs[i] = (*reg_ptr != db->regs[i]);
-      db->regs[i] = *reg_ptr;
-      buf += 4;
-    }
-    return 1;
-  }
-
-  if (buf[5] == 1) {
-    buf += 8;
-    // Unserialize
-    for (int i = 14; i < 17; i++) {
-      unsigned *reg_ptr = (unsigned *)buf;
-      db->changed_regs[i] = (*reg_ptr != db->regs[i]);
-      db->regs[i] = *reg_ptr;
-      buf += 4;
-    }
-    return 1;
-  }
-  if (buf[5] == 2) {
-    buf += 8;
-    // Unserialize
-    for (int i = 0; i < 5; i++) {
-      db->breakpoints[i] = *(int *)buf;
-      buf += 4;
-    }
-    return 1;
-  }
-  if (buf[5] == 3) {
-    buf += 8;
-    // Unserialize
-    for (int i = 0; i < 2; i++) {
-      db->watchpoints[i] = *(int *)buf;
-      buf += 4;
-    }
-    return 1;
-  }
-  if (buf[5] == 9) {
-    // done
-    print_debugger_state(db);
-    return 1;
-  }
-  return 0;
-}
-
-int min(int a, int b) { return a < b ? a : b; }
-
-// hack-y state machine to indicate when we've seen the special string
-// 'DONE!!!' from the pi telling us to shutdown.
-int pi_done(unsigned char *s) {
-  static unsigned pos = 0;
-  const char exit_string[] = "DONE!!!\n";
-  const int n = sizeof exit_string - 1;
-
-  for (; *s; s++) {
-    assert(pos < n);
-    if (*s != exit_string[pos++]) {
-      pos = 0;
-      return pi_done(s + 1); // check remainder
-    }
-    // maybe should check if "DONE!!!" is last thing printed?
-    if (pos == sizeof exit_string - 1)
-      return 1;
-  }
-  return 0;
-}
-
 // overwrite any unprintable characters with a space.
 // otherwise terminals can go haywire/bizarro.
 // note, the string can contain 0's, so we send the
@@ -535,72 +450,57 @@ void pi_echo_debug(int unix_fd, int pi_fd, const char *portname,
   assert(pi_fd);
   progname = _progname;
 
-  // Protocol:
-  //  Pi is debugging and gets to a stall state where it needs user input.
-  //  1. Pi->host "GET_USER_INPUT" and a package of all debugger state data
-  //  2. host prints all the debugger state data, then prints a pidb> prompt
-  //  3. user types their input
-  //  4. host processes input
-  //* if user types b 0x1234, host tells pi to add bp at 0x1234
-  //  c: host tells pi to continue without single stepping
-  //  s/n: single step one step
-  //* q: exit
-  //* w 0x1234: watchpoint at 0x1234
-  //* r[1-15] = [value]: write value to register
-  //  *[addr] = [value]: write value to memory
-  //  *addr: read value from memory
-  // 5. once host figures out what it wants pi to do, sends corresponding
-  // command back to pi which is waiting
-  // 6. pi executes command, then runs until it next needs input (while keeping
-  // track of debugger state)
-
-  // Every message has following format: byte 1 is command, bytes 2-5 are
-  // length, bytes 6-end are message
-
-  // Debugger state has following values:
-  // registers 1-16
-  // Backtrace?
-  // watchpoints
-  // breakpoints
-
-  // Additional state that the laptop will have access to:
-  // program assembly
-  // program code
-  // Can use the value of pc (r15) to figure out which function we're in and get
-  // that function from program code if it exists Display register values as
-  // hex, binary, decimal, and ascii
-  debugger_state_t db;
+  // Replace the final .bin in the path with .list
+  unsigned len = strlen(progname);
+  if (len > 4 && suffix_cmp(progname, ".bin"))
+    len -= 4;
+  list_name = strdupf("%.*s.list", len, progname);
+
+  // everything from the pi comes over the frame layer: printk output
+  // outside frames is echoed by pi_frame, the debugger's messages
+  // (<dbg-proto.h>) come as data.  the pi stops at the first
+  // instruction, then after each command that resumes it.
+  pi_frame_t f;
+  pi_dbg_t d;
+  pi_frame_init(&f, pi_fd, FRAME_DEFAULT_BAUD, stdout);
+  pi_dbg_init(&d, &f);
+  pi_trace_init(&hist);
+  d.hist = &hist;
+
+  int fast_p = 0;
   while (1) {
-    char buf[4096];
-
-    int n;
-
-    wait_and_send_input(unix_fd, pi_fd);
+    if (f.done_p)
+      clean_exit("\nbootloader: pi exited.  cleaning up\n");
+
+    if (!d.stopped_p) {
+      if (!pi_dbg_wait(&d, 100 * 1000, print_trace, 0)) {
+        // this isn't the program's fault.  so we exit(0).
+        if (!f.done_p && portname && tty_gone(portname))
+          clean_exit("pi ttyusb connection closed.  cleaning up\n");
+        continue;
+      }
+      // the single-step traffic is the bulk of what we send: once the
+      // debugger is up, move to the fast rate.
+      if (!fast_p) {
+        fast_p = 1;
+        if (!pi_frame_set_baud(&f, DBG_FAST_BAUD))
+          output("UNIX: could not switch to %u baud, staying at %u\n",
+                 DBG_FAST_BAUD, FRAME_DEFAULT_BAUD);
+      }
+      print_debugger_state(&d);
+      printf("pidb> ");
+      fflush(stdout);
+    }
 
-    if (!can_read_timeout(pi_fd, 100))
+    char line[1024];
+    int n = read_timeout(unix_fd, line, sizeof line - 1, 100);
+    if (n <= 0)
       continue;
-    n = read(pi_fd, buf, sizeof buf - 1);
-    if (!n) {
-      // this isn't the program's fault.  so we exit(0).
-      if (!portname || tty_gone(portname))
-        clean_exit("pi ttyusb connection closed.  cleaning up\n");
-      // so we don't keep banging on the CPU.
-      usleep(1000);
-      // } else if(n < 0) {
-      //     sys_die(read, "pi connection closed.  cleaning up\n");
-    } else if (parse_debugger_state(&db, buf)) {
-      // do nothing, parse takes care of printing
-    } else {
-      buf[n] = 0;
-      // if you keep getting "" "" "" it's b/c of the GET_CODE message from
-      // bootloader
-      remove_nonprint((unsigned char *)buf, n);
-      output("%s ", buf);
-
-      if (pi_done((unsigned char *)buf)) {
-        // output("\nSaw done\n");
-        clean_exit("\nbootloader: pi exited.  cleaning up\n");
-      }
+    line[n] = 0;
+    do_command(&d, line);
+    if (d.stopped_p) {
+      printf("pidb> ");
+      fflush(stdout);
     }
   }
   notreached();
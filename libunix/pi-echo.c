@@ -3,6 +3,8 @@
 #include <ctype.h>
 #include <unistd.h>
 
+#include "pi-ktrace.h"
+
 int min(int a, int b) { return a < b ? a : b; }
 
 // hack-y state machine to indicate when we've seen the special string
@@ -82,8 +84,11 @@ void pi_echo(int unix_fd, int pi_fd, const char *portname) {
   // that function from program code if it exists Display register values as
   // hex, binary, decimal, and ascii
 
+  // binary trace dumps (<ktrace_dump>) get decoded, not echoed.
+  pi_ktrace_scan_t kt = {0};
   while (1) {
-    unsigned char buf[4096];
+    // <buf> gets the text of <raw>: up to 3 more bytes, and a 0.
+    unsigned char buf[4096], raw[sizeof buf - 4];
 
     int n;
     if ((n = read_timeout(unix_fd, buf, sizeof buf, 1000))) {
@@ -100,7 +105,7 @@ void pi_echo(int unix_fd, int pi_fd, const char *portname) {
 
     if (!can_read_timeout(pi_fd, 1000))
       continue;
-    n = read(pi_fd, buf, sizeof buf - 1);
+    n = read(pi_fd, raw, sizeof raw);
 
     if (!n) {
       // this isn't the program's fault.  so we exit(0).
@@ -111,6 +116,7 @@ void pi_echo(int unix_fd, int pi_fd, const char *portname) {
     } else if (n < 0) {
       sys_die(read, "pi connection closed.  cleaning up\n");
     } else {
+      n = pi_ktrace_scan(&kt, raw, n, buf, stderr, PI_KTRACE_CYC_PER_USEC);
       buf[n] = 0;
       // if you keep getting "" "" "" it's b/c of the GET_CODE message from
       // bootloader
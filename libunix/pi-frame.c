@@ -0,0 +1,302 @@
+// unix side of the framed uart protocol: see <pi-frame.h>.
+#include <errno.h>
+#include <string.h>
+#include <sys/select.h>
+
+#include "libunix.h"
+#include "pi-frame.h"
+
+void pi_frame_init(pi_frame_t *f, int fd, unsigned baud, FILE *echo) {
+  memset(f, 0, sizeof *f);
+  f->fd = fd;
+  f->baud = baud;
+  f->echo = echo;
+}
+
+// wait until <fd> is readable; returns 0 if more than <usec> passed
+// since <start>.  <usec>=0 means wait forever.
+static int wait_readable(int fd, time_usec_t start, unsigned usec) {
+  while (1) {
+    unsigned left = 999999;
+    if (usec) {
+      time_usec_t t = time_get_usec() - start;
+      if (t >= usec)
+        return 0;
+      if (usec - t < left)
+        left = usec - t;
+    }
+    if (can_read_timeout(fd, left))
+      return 1;
+  }
+}
+
+// read exactly <n> bytes, as many at a time as are there.
+static int read_by(int fd, void *data, unsigned n, time_usec_t start,
+                   unsigned usec) {
+  uint8_t *p = data;
+  while (n) {
+    if (!wait_readable(fd, start, usec))
+      return 0;
+    int r = read(fd, p, n);
+    if (r < 0) {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      sys_die(read, "read failed");
+    }
+    if (r == 0)
+      panic("tty closed?\n");
+    p += r;
+    n -= r;
+  }
+  return 1;
+}
+
+void pi_frame_send(pi_frame_t *f, unsigned type, unsigned seq,
+                   const void *data, unsigned n) {
+  assert(n <= FRAME_MAXLEN);
+  frame_hdr_t h = {.type = type, .seq = seq, .len = n};
+
+  uint32_t crc = our_crc32_inc(&h, sizeof h, 0);
+  crc = our_crc32_inc(data, n, crc);
+
+  // one write per frame: much cheaper than byte-at-a-time.
+  uint8_t buf[FRAME_MAXLEN + FRAME_OVERHEAD], *p = buf;
+  uint32_t magic = FRAME_MAGIC;
+  memcpy(p, &magic, 4);
+  p += 4;
+  memcpy(p, &h, sizeof h);
+  p += sizeof h;
+  memcpy(p, data, n);
+  p += n;
+  memcpy(p, &crc, 4);
+  p += 4;
+  write_exact(f->fd, buf, p - buf);
+}
+
+// a byte that isn't part of a frame.
+static void skip_byte(pi_frame_t *f, uint8_t c) {
+  static const char done[] = "DONE!!!\n";
+  if (f->echo)
+    fputc(c, f->echo);
+  if (c != done[f->done_pos])
+    f->done_pos = (c == done[0]);
+  else if (!done[++f->done_pos]) {
+    f->done_p = 1;
+    f->done_pos = 0;
+  }
+}
+
+int pi_frame_recv(pi_frame_t *f, frame_hdr_t *h, void *buf, unsigned usec) {
+  time_usec_t start = time_get_usec();
+
+  // slide a 4-byte window until we hit the magic, echoing what falls
+  // out.  bytes come in at the top: with <n> < 4 they are the top <n>.
+  uint32_t w = 0;
+  unsigned n = 0;
+  while (n < 4 || w != FRAME_MAGIC) {
+    uint8_t b;
+    if (!read_by(f->fd, &b, 1, start, usec)) {
+      // nothing more coming: what we hold isn't a frame (if it was
+      // the start of one, the sender will resend).
+      if (n)
+        for (w >>= (4 - n) * 8; n; n--, w >>= 8)
+          skip_byte(f, w & 0xff);
+      if (f->echo)
+        fflush(f->echo);
+      return FRAME_TIMEOUT;
+    }
+    if (n == 4)
+      skip_byte(f, w & 0xff);
+    else
+      n++;
+    w = (w >> 8) | (uint32_t)b << 24;
+  }
+  if (f->echo)
+    fflush(f->echo);
+
+  if (!read_by(f->fd, h, sizeof *h, start, usec))
+    return FRAME_TIMEOUT;
+  if (h->len > FRAME_MAXLEN) {
+    f->nbad++;
+    return FRAME_BAD;
+  }
+
+  uint32_t crc;
+  if (!read_by(f->fd, buf, h->len, start, usec) ||
+      !read_by(f->fd, &crc, sizeof crc, start, usec))
+    return FRAME_TIMEOUT;
+
+  uint32_t exp = our_crc32_inc(h, sizeof *h, 0);
+  if (crc != our_crc32_inc(buf, h->len, exp)) {
+    f->nbad++;
+    return FRAME_BAD;
+  }
+  return FRAME_OK;
+}
+
+// send <data> as frame <type> and wait for a reply of type <ack> with
+// our seq, resending on a nak or timeout.  returns the reply type or 0.
+static int send_acked(pi_frame_t *f, unsigned type, const void *data,
+                      unsigned n, unsigned ack) {
+  unsigned usec = FRAME_TIMEOUT_USEC + frame_wire_usec(f->baud, n);
+  uint8_t buf[FRAME_MAXLEN];
+
+  for (unsigned i = 0; i < FRAME_RETRIES; i++) {
+    if (i)
+      f->nresend++;
+    pi_frame_send(f, type, f->tx_seq, data, n);
+
+    time_usec_t start = time_get_usec();
+    while (1) {
+      time_usec_t t = time_get_usec() - start;
+      if (t >= usec)
+        break;
+
+      frame_hdr_t h;
+      int r = pi_frame_recv(f, &h, buf, usec - t);
+      if (r == FRAME_TIMEOUT)
+        break;
+      if (r != FRAME_OK)
+        continue;
+      if (h.type == FRAME_NAK)
+        break;
+      if (h.seq != f->tx_seq)
+        continue; // stale reply to an earlier resend.
+      if (h.type == ack || (ack == FRAME_BAUD_ACK && h.type == FRAME_BAUD_NAK)) {
+        if (type == FRAME_DATA)
+          f->tx_seq++;
+        return h.type;
+      }
+    }
+  }
+  return 0;
+}
+
+int pi_frame_write(pi_frame_t *f, const void *data, unsigned n) {
+  const uint8_t *p = data;
+  while (n) {
+    unsigned len = n < FRAME_MAXLEN ? n : FRAME_MAXLEN;
+    if (!send_acked(f, FRAME_DATA, p, len, FRAME_ACK))
+      return 0;
+    p += len;
+    n -= len;
+  }
+  return 1;
+}
+
+int pi_frame_set_baud(pi_frame_t *f, unsigned baud) {
+  unsigned old = f->baud;
+  if (baud == old)
+    return 1;
+
+  uint32_t b = baud;
+  if (send_acked(f, FRAME_BAUD_REQ, &b, sizeof b, FRAME_BAUD_ACK) !=
+      FRAME_BAUD_ACK)
+    return 0;
+
+  // drains anything still queued at the old rate first.
+  set_tty_speed(f->fd, baud);
+  f->baud = baud;
+
+  // responder waits FRAME_BAUD_TIMEOUT_USEC for this, which covers
+  // all our retries.
+  if (send_acked(f, FRAME_PING, 0, 0, FRAME_PING))
+    return 1;
+
+  set_tty_speed(f->fd, old);
+  f->baud = old;
+  return 0;
+}
+
+// other side asked us to switch: same as the pi's <baud_req>.
+static void baud_req(pi_frame_t *f, frame_hdr_t *h, const void *payload) {
+  uint32_t old = f->baud, baud;
+  if (h->len != sizeof baud)
+    return;
+  memcpy(&baud, payload, sizeof baud);
+
+  pi_frame_send(f, FRAME_BAUD_ACK, h->seq, &baud, sizeof baud);
+  set_tty_speed(f->fd, baud);
+  f->baud = baud;
+
+  time_usec_t start = time_get_usec();
+  while (time_get_usec() - start < FRAME_BAUD_TIMEOUT_USEC) {
+    frame_hdr_t p;
+    if (pi_frame_recv(f, &p, f->rx_buf, FRAME_TIMEOUT_USEC) == FRAME_OK &&
+        p.type == FRAME_PING) {
+      pi_frame_send(f, FRAME_PING, p.seq, 0, 0);
+      return;
+    }
+  }
+  set_tty_speed(f->fd, old);
+  f->baud = old;
+}
+
+int pi_frame_ctl(pi_frame_t *f, frame_hdr_t *h, const void *payload) {
+  switch (h->type) {
+  case FRAME_BAUD_REQ:
+    baud_req(f, h, payload);
+    return 1;
+  case FRAME_PING:
+    pi_frame_send(f, FRAME_PING, h->seq, 0, 0);
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+// wait up to <usec> (0 = forever) for the next new data frame to be
+// in <rx_buf>.  returns 0 on timeout.
+static int next_data_frame(pi_frame_t *f, unsigned usec) {
+  time_usec_t start = time_get_usec();
+  while (1) {
+    unsigned left = 0;
+    if (usec) {
+      time_usec_t t = time_get_usec() - start;
+      if (t >= usec)
+        return 0;
+      left = usec - t;
+    }
+
+    frame_hdr_t h;
+    int r = pi_frame_recv(f, &h, f->rx_buf, left);
+    if (r == FRAME_TIMEOUT)
+      return 0;
+    if (r != FRAME_OK) {
+      pi_frame_send(f, FRAME_NAK, h.seq, 0, 0);
+      continue;
+    }
+
+    if (h.type != FRAME_DATA) {
+      pi_frame_ctl(f, &h, f->rx_buf);
+      continue;
+    }
+    pi_frame_send(f, FRAME_ACK, h.seq, 0, 0);
+    // our ack got lost and they resent: already have it.
+    if (h.seq != f->rx_seq)
+      continue;
+    f->rx_seq++;
+    f->rx_off = 0;
+    f->rx_len = h.len;
+    return 1;
+  }
+}
+
+int pi_frame_poll(pi_frame_t *f, unsigned usec) {
+  return f->rx_off < f->rx_len || next_data_frame(f, usec);
+}
+
+void pi_frame_read(pi_frame_t *f, void *data, unsigned n) {
+  uint8_t *p = data;
+  while (n) {
+    if (f->rx_off == f->rx_len)
+      next_data_frame(f, 0);
+    unsigned len = f->rx_len - f->rx_off;
+    if (len > n)
+      len = n;
+    memcpy(p, &f->rx_buf[f->rx_off], len);
+    f->rx_off += len;
+    p += len;
+    n -= len;
+  }
+}
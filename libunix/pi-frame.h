@@ -0,0 +1,69 @@
+#ifndef __PI_FRAME_H__
+#define __PI_FRAME_H__
+// unix side of the framed uart protocol (libpi/include/uart-frame.h).
+// wire format is in <frame-proto.h>.
+//
+// this side normally starts the baud switch (<pi_frame_set_baud>) but
+// will also answer one, so both ends of a pty loopback can be driven
+// with this code.
+#include <stdio.h>
+#include <stdint.h>
+#include "frame-proto.h"
+
+typedef struct {
+  int fd;
+  unsigned baud;
+
+  // next seq we send and the next one we expect.
+  uint8_t tx_seq, rx_seq;
+
+  // if non-null, bytes that aren't part of a frame (e.g., printk
+  // output from the pi) get written here instead of dropped.
+  FILE *echo;
+  // set once those bytes included "DONE!!!\n": the pi rebooted.
+  int done_p;
+  unsigned done_pos;
+
+  // current incoming data frame: <rx_off> bytes of <rx_len> consumed.
+  unsigned rx_off, rx_len;
+  uint8_t rx_buf[FRAME_MAXLEN];
+
+  // stats.
+  unsigned nresend; // frames we had to resend.
+  unsigned nbad;    // frames we got with a bad crc or length.
+} pi_frame_t;
+
+// <fd> should already be setup with <set_tty_to_8n1> at <baud>.
+void pi_frame_init(pi_frame_t *f, int fd, unsigned baud, FILE *echo);
+
+// send a single frame.  no ack.
+void pi_frame_send(pi_frame_t *f, unsigned type, unsigned seq,
+                   const void *data, unsigned n);
+
+// receive a single frame into <h> and <buf> (which must hold
+// FRAME_MAXLEN bytes).  <usec>=0 means wait forever.
+// returns FRAME_OK, FRAME_TIMEOUT or FRAME_BAD.
+int pi_frame_recv(pi_frame_t *f, frame_hdr_t *h, void *buf, unsigned usec);
+
+// reliably send <n> bytes, split into as many frames as needed.
+// returns 1 on success, 0 if the other side stopped acking.
+int pi_frame_write(pi_frame_t *f, const void *data, unsigned n);
+
+// read exactly <n> bytes from incoming data frames.  blocks.
+void pi_frame_read(pi_frame_t *f, void *data, unsigned n);
+
+// wait up to <usec> (0 = forever) for incoming data.  returns 1 if
+// <pi_frame_read> has at least one byte it can return right away.
+int pi_frame_poll(pi_frame_t *f, unsigned usec);
+
+// ask the other side to switch to <baud>, switch ourselves and check
+// the link works at the new rate.  returns 1 on success; on failure
+// both sides stay at (or go back to) the old rate and we return 0.
+int pi_frame_set_baud(pi_frame_t *f, unsigned baud);
+
+// handle a control frame (baud switch request, ping) that showed up
+// while running your own protocol on top of <pi_frame_recv>.
+// returns 1 if <h> was one, 0 otherwise.
+int pi_frame_ctl(pi_frame_t *f, frame_hdr_t *h, const void *payload);
+
+#endif
@@ -0,0 +1,207 @@
+// gdb <-> pi bridge: see <pi-gdb.h>
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libunix.h"
+#include "pi-gdb.h"
+
+int pi_gdb_pty(char **name) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0)
+    sys_die(posix_openpt, "can't open pty");
+  if (grantpt(master) < 0 || unlockpt(master) < 0)
+    sys_die(grantpt, "can't setup pty");
+  *name = strdup(ptsname(master));
+
+  // we hold the slave open for good: otherwise reads of the master
+  // fail with EIO until gdb attaches, and again each time it leaves.
+  int slave = open(*name, O_RDWR | O_NOCTTY);
+  if (slave < 0)
+    sys_die(open, "can't open pty slave");
+  set_tty_to_8n1(slave, FRAME_DEFAULT_BAUD, 1);
+  return master;
+}
+
+// gdb writes a packet at a time: read that way too, not a syscall
+// per byte.  one gdb at a time, so one buffer.
+static struct {
+  int fd;
+  unsigned off, n;
+  uint8_t buf[4096];
+} rx = {.fd = -1};
+
+static int get8(int fd) {
+  if (rx.fd != fd)
+    rx.fd = fd, rx.off = rx.n = 0;
+  if (rx.off == rx.n) {
+    int n = read(fd, rx.buf, sizeof rx.buf);
+    // EIO: the last one with the pty open closed it.
+    if (n == 0 || (n < 0 && errno == EIO))
+      return -1;
+    if (n < 0)
+      sys_die(read, "read of gdb's pty failed");
+    rx.off = 0;
+    rx.n = n;
+  }
+  return rx.buf[rx.off++];
+}
+
+static int gdb_can_read(int fd, unsigned usec) {
+  return (rx.fd == fd && rx.off < rx.n) || can_read_timeout(fd, usec);
+}
+
+static void put8(int fd, uint8_t c) { write_exact(fd, &c, 1); }
+
+int pi_gdb_pkt_read(int fd, char *buf, unsigned max, int ack_p) {
+  while (1) {
+    int c;
+    while ((c = get8(fd)) != '$')
+      if (c < 0)
+        return -1;
+
+    unsigned n = 0, sum = 0, too_big_p = 0;
+    while ((c = get8(fd)) != '#') {
+      if (c < 0)
+        return -1;
+      sum += c;
+      if (n < max - 1)
+        buf[n++] = c;
+      else
+        too_big_p = 1;
+    }
+    buf[n] = 0;
+
+    char cs[3] = {0};
+    if ((c = get8(fd)) < 0)
+      return -1;
+    cs[0] = c;
+    if ((c = get8(fd)) < 0)
+      return -1;
+    cs[1] = c;
+
+    if (!too_big_p && strtoul(cs, 0, 16) == (sum & 0xff)) {
+      if (ack_p)
+        put8(fd, '+');
+      return n;
+    }
+    // gdb resends on a nak.  without acks there's nothing to do but
+    // drop it.
+    output("UNIX: bad packet from gdb: <%s>\n", buf);
+    if (ack_p)
+      put8(fd, '-');
+  }
+}
+
+void pi_gdb_pkt_write(int fd, const char *body) {
+  static char buf[DBG_GDB_MAX + 8];
+  unsigned n = strlen(body), sum = 0;
+  assert(n <= DBG_GDB_MAX);
+  for (unsigned i = 0; i < n; i++)
+    sum += (uint8_t)body[i];
+  buf[0] = '$';
+  memcpy(buf + 1, body, n);
+  sprintf(buf + 1 + n, "#%02x", sum & 0xff);
+  write_exact(fd, buf, n + 4);
+}
+
+static void pi_send(pi_frame_t *f, const char *body, unsigned n) {
+  static uint8_t buf[sizeof(dbg_hdr_t) + DBG_GDB_MAX];
+  dbg_hdr_t h = {.op = DBG_GDB, .nbytes = n};
+  assert(n <= DBG_GDB_MAX);
+  memcpy(buf, &h, sizeof h);
+  memcpy(buf + sizeof h, body, n);
+  if (!pi_frame_write(f, buf, sizeof h + n))
+    panic("gdb bridge: pi stopped acking\n");
+}
+
+// wait for the pi's next packet, echoing its output meanwhile.
+// returns -1 if it exited or its tty went away.
+static int pi_recv(pi_frame_t *f, char *buf, const char *portname) {
+  while (!pi_frame_poll(f, 100 * 1000))
+    if (f->done_p || (portname && tty_gone(portname)))
+      return -1;
+
+  dbg_hdr_t h;
+  pi_frame_read(f, &h, sizeof h);
+  if (h.op != DBG_GDB || h.nbytes > DBG_GDB_MAX)
+    panic("gdb bridge: pi sent op=%x (%u bytes): is it running gdb-stub.h?\n",
+          h.op, h.nbytes);
+  pi_frame_read(f, buf, h.nbytes);
+  buf[h.nbytes] = 0;
+  return h.nbytes;
+}
+
+// gdb is gone: echo the pi's output until it's done.
+static int pi_drain(pi_frame_t *f, const char *portname) {
+  static char junk[DBG_GDB_MAX + 1];
+  while (pi_recv(f, junk, portname) >= 0)
+    ;
+  return f->done_p;
+}
+
+int pi_gdb_bridge(pi_frame_t *f, int gdb_fd, const char *portname) {
+  static char pkt[DBG_GDB_MAX + 1], reply[DBG_GDB_MAX + 1];
+
+  // the stub reports a stop as soon as it starts.  gdb asks again
+  // with "?" once it attaches, so this one just says the pi is there.
+  if (pi_recv(f, reply, portname) < 0)
+    return f->done_p;
+  if (!pi_frame_set_baud(f, DBG_FAST_BAUD))
+    output("UNIX: could not switch to %u baud, staying at %u\n",
+           DBG_FAST_BAUD, f->baud);
+
+  int ack_p = 1;
+  while (1) {
+    if (!gdb_can_read(gdb_fd, 10 * 1000)) {
+      // the pi is stopped unless gdb detached: then it runs on its
+      // own and we keep echoing.
+      if (pi_frame_poll(f, 10 * 1000))
+        pi_recv(f, reply, portname);
+      if (f->done_p)
+        return 1;
+      if (portname && tty_gone(portname))
+        return 0;
+      continue;
+    }
+
+    int n = pi_gdb_pkt_read(gdb_fd, pkt, sizeof pkt, ack_p);
+    if (n < 0)
+      return pi_drain(f, portname);
+
+    // acks are ours: the pi never sees them.
+    if (strcmp(pkt, "QStartNoAckMode") == 0) {
+      pi_gdb_pkt_write(gdb_fd, "OK");
+      ack_p = 0;
+      continue;
+    }
+
+    pi_send(f, pkt, n);
+    // kill: the pi reboots without answering.
+    if (pkt[0] == 'k')
+      return pi_drain(f, portname);
+    if (pi_recv(f, reply, portname) < 0)
+      return f->done_p;
+    pi_gdb_pkt_write(gdb_fd, reply);
+  }
+}
+
+void pi_echo_gdb(int pi_fd, const char *portname, const char *progname) {
+  char *name;
+  int gdb_fd = pi_gdb_pty(&name);
+
+  // gdb wants the .elf next to the .bin.
+  unsigned len = strlen(progname);
+  if (len > 4 && suffix_cmp(progname, ".bin"))
+    len -= 4;
+  output("UNIX: attach with: gdb-multiarch %.*s.elf -ex 'target remote %s'\n",
+         len, progname, name);
+
+  pi_frame_t f;
+  pi_frame_init(&f, pi_fd, FRAME_DEFAULT_BAUD, stdout);
+  if (!pi_gdb_bridge(&f, gdb_fd, portname))
+    clean_exit("pi ttyusb connection closed.  cleaning up\n");
+  clean_exit("\nbootloader: pi exited.  cleaning up\n");
+}
@@ -0,0 +1,32 @@
+#ifndef __PI_GDB_H__
+#define __PI_GDB_H__
+// pty bridge between gdb and the pi's gdb stub
+// (debugger/code/gdb-stub.h):
+//
+//      gdb-multiarch prog.elf -ex 'target remote /dev/pts/N'
+//
+// gdb's side is the plain remote serial protocol: $<body>#<checksum>
+// with +/- acks.  that layer ends here.  only packet bodies go to the
+// pi, one DBG_GDB message each (<dbg-proto.h>), over the frame layer,
+// so the pi's printk output still gets echoed around them.
+#include "pi-frame.h"
+#include "dbg-proto.h"
+
+// open a pty for gdb.  returns the master side: <*name> gets the
+// path to give gdb.
+int pi_gdb_pty(char **name);
+
+// read one packet from gdb into <buf> (0-terminated, at most <max>-1
+// bytes) and ack it with '+' if <ack_p>.  anything between packets
+// (acks, ^C) is skipped and bad checksums are nak'd.  returns the
+// body's length, or -1 if <fd> closed.
+int pi_gdb_pkt_read(int fd, char *buf, unsigned max, int ack_p);
+
+// send <body> as a packet.
+void pi_gdb_pkt_write(int fd, const char *body);
+
+// forward between gdb on <gdb_fd> and the pi on <f> until the pi
+// exits (returns 1) or its tty at <portname> goes away (returns 0).
+int pi_gdb_bridge(pi_frame_t *f, int gdb_fd, const char *portname);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef __PI_KTRACE_H__
+#define __PI_KTRACE_H__
+// unix side of the pi's binary kernel trace ring (libpi/include/ktrace.h).
+// the pi ships the ring with <ktrace_dump>; we pull it off the tty,
+// check it and render a timeline.
+#include <stdio.h>
+#include <stdint.h>
+
+// must match <libpi/include/ktrace.h>
+#define KTRACE_MAGIC 0x4b545243
+
+// clock of a stock pi zero: what the echo loops print times with.
+#define PI_KTRACE_CYC_PER_USEC 700
+
+enum {
+#define XX(name, str, a0_str, a1_str) name,
+#define KTRACE_GET_EVENTS
+#include "ktrace-events.h"
+#undef KTRACE_GET_EVENTS
+#undef XX
+  KT_NEVENTS
+};
+
+typedef struct {
+  uint32_t cyc;
+  uint32_t id;
+  uint32_t a0, a1;
+} pi_ktrace_ent_t;
+
+typedef struct {
+  unsigned nent;     // number of entries in <ents>
+  unsigned ndropped; // events overwritten on the pi before the dump.
+  pi_ktrace_ent_t *ents;
+} pi_ktrace_t;
+
+// skip bytes on <fd> until we see a dump, then read and crc check it.
+// any bytes skipped are echoed to <echo> if it is non-null.
+pi_ktrace_t pi_ktrace_read(int fd, FILE *echo);
+
+// find dumps in output read off the tty in chunks (the echo loops in
+// pi-cat.c and pi-echo.c).  zero-initialize.
+typedef struct {
+  unsigned nmagic; // bytes of the magic seen so far.
+  int in_dump_p;   // the magic was seen: collecting the rest.
+  uint8_t *dump;   // everything after the magic.
+  unsigned ndump, dump_nbytes, ndumps;
+} pi_ktrace_scan_t;
+
+// scan <n> bytes read from the pi.  each complete dump is checked and
+// printed to <trace> with <pi_ktrace_print>, or an error is printed
+// if it's bad.  the other bytes are copied to <text>, which needs room
+// for <n>+3: bytes that could start the magic are held back until we
+// know.  returns how many bytes went to <text>.
+unsigned pi_ktrace_scan(pi_ktrace_scan_t *s, const uint8_t *buf, unsigned n,
+                        uint8_t *text, FILE *trace, unsigned cyc_per_usec);
+
+// print the timeline: one line per event, time relative to the first
+// event and to the previous one.  <cyc_per_usec> is the pi's clock
+// (700 for a stock pi zero); 0 means print raw cycles.
+void pi_ktrace_print(FILE *out, pi_ktrace_t *t, unsigned cyc_per_usec);
+
+// printable name of event <id>.
+const char *pi_ktrace_name(uint32_t id);
+
+void pi_ktrace_free(pi_ktrace_t *t);
+
+#endif
@@ -0,0 +1,183 @@
+// fold the pi's pc-sampling profile with the .list: see <pi-prof.h>
+#include <string.h>
+
+#include "libunix.h"
+#include "pi-prof.h"
+
+#define PCPROF "PCPROF:"
+
+static void prof_add(pi_prof_ent_t **v, unsigned *n, unsigned *cap,
+                     uint32_t addr, uint32_t count) {
+  if (*n == *cap) {
+    *cap = *cap ? *cap * 2 : 256;
+    *v = realloc(*v, *cap * sizeof **v);
+    if (!*v)
+      sys_die(realloc, "out of memory");
+  }
+  (*v)[(*n)++] = (pi_prof_ent_t){.addr = addr, .count = count};
+}
+
+int pi_prof_read(FILE *in, FILE *echo, pi_prof_t *p) {
+  memset(p, 0, sizeof *p);
+
+  char line[1024];
+  int in_dump = 0;
+  unsigned pc_cap = 0, lr_cap = 0;
+  while (fgets(line, sizeof line, in)) {
+    // the pi may prefix its output (e.g., the bootloader's):
+    // look for the tag anywhere.
+    char *s = strstr(line, PCPROF);
+    if (!s) {
+      if (echo && !in_dump)
+        fputs(line, echo);
+      continue;
+    }
+    s += strlen(PCPROF);
+
+    uint32_t addr, count;
+    if (sscanf(s, "begin lo=%x hi=%x nsamples=%u nmiss=%u", &p->lo, &p->hi,
+               &p->nsamples, &p->nmiss) == 4) {
+      // a later dump replaces an earlier one.
+      p->npcs = p->nlrs = 0;
+      in_dump = 1;
+    } else if (!in_dump) {
+      continue;
+    } else if (sscanf(s, "pc %x %u", &addr, &count) == 2) {
+      prof_add(&p->pcs, &p->npcs, &pc_cap, addr, count);
+    } else if (sscanf(s, "lr %x %u", &addr, &count) == 2) {
+      prof_add(&p->lrs, &p->nlrs, &lr_cap, addr, count);
+    } else if (strncmp(s, "end", 3) == 0) {
+      return 1;
+    } else
+      panic("bad profile line: <%s>\n", line);
+  }
+  if (in_dump)
+    output("profile dump was truncated\n");
+  return 0;
+}
+
+static double pct(uint32_t n, uint32_t total) {
+  return total ? 100.0 * n / total : 0;
+}
+
+// skip the address and the encoding: "    8010:\te3a00001 \tmov\tr0, #1"
+// becomes "mov\tr0, #1".
+static const char *inst_text(const list_index_t *ix, uint32_t addr) {
+  int l = list_index_line(ix, addr);
+  if (l < 0)
+    return "?";
+  const char *s = ix->lines[l];
+  for (unsigned tabs = 0; *s && tabs < 2; s++)
+    if (*s == '\t')
+      tabs++;
+  while (*s == ' ' || *s == '\t')
+    s++;
+  return s;
+}
+
+typedef struct {
+  const list_fn_t *fn; // 0 = not in any function.
+  uint32_t count;
+  uint32_t hot_addr, hot_count;
+} fn_total_t;
+
+static int fn_total_cmp(const void *_a, const void *_b) {
+  const fn_total_t *a = _a, *b = _b;
+  if (a->count != b->count)
+    return a->count < b->count ? 1 : -1;
+  return 0;
+}
+
+static int ent_count_cmp(const void *_a, const void *_b) {
+  const pi_prof_ent_t *a = _a, *b = _b;
+  if (a->count != b->count)
+    return a->count < b->count ? 1 : -1;
+  return a->addr < b->addr ? -1 : a->addr > b->addr;
+}
+
+static const char *fn_name(const list_fn_t *f) { return f ? f->name : "???"; }
+
+void pi_prof_print_flat(FILE *out, const pi_prof_t *p, const list_index_t *ix,
+                        unsigned max_fns) {
+  // the pi prints buckets in address order, so a function's
+  // buckets are adjacent: one pass folds them.
+  fn_total_t *t = calloc(p->npcs + 1, sizeof *t);
+  unsigned n = 0;
+  for (unsigned i = 0; i < p->npcs; i++) {
+    const pi_prof_ent_t *e = &p->pcs[i];
+    const list_fn_t *f = list_index_fn(ix, e->addr);
+    if (!n || t[n - 1].fn != f)
+      t[n++] = (fn_total_t){.fn = f};
+    fn_total_t *cur = &t[n - 1];
+    cur->count += e->count;
+    if (e->count > cur->hot_count) {
+      cur->hot_count = e->count;
+      cur->hot_addr = e->addr;
+    }
+  }
+  qsort(t, n, sizeof *t, fn_total_cmp);
+
+  fprintf(out, "flat profile: %u samples, %u (%.1f%%) outside [%x,%x)\n",
+          p->nsamples, p->nmiss, pct(p->nmiss, p->nsamples), p->lo, p->hi);
+  fprintf(out, "%7s %9s  %-24s %s\n", "%time", "samples", "function",
+          "hottest instruction");
+  if (max_fns && max_fns < n)
+    n = max_fns;
+  for (unsigned i = 0; i < n; i++)
+    fprintf(out, "%6.2f%% %9u  %-24s %x: %s (%u)\n",
+            pct(t[i].count, p->nsamples), t[i].count, fn_name(t[i].fn),
+            t[i].hot_addr, inst_text(ix, t[i].hot_addr), t[i].hot_count);
+  free(t);
+}
+
+void pi_prof_print_callsites(FILE *out, const pi_prof_t *p,
+                             const list_index_t *ix, unsigned max_sites) {
+  pi_prof_ent_t *s = calloc(p->nlrs + 1, sizeof *s);
+  memcpy(s, p->lrs, p->nlrs * sizeof *s);
+  qsort(s, p->nlrs, sizeof *s, ent_count_cmp);
+
+  fprintf(out, "call sites (from lr: leaf time only):\n");
+  fprintf(out, "%7s %9s  %-32s %s\n", "%time", "samples", "caller+off",
+          "call");
+  unsigned n = p->nlrs;
+  if (max_sites && max_sites < n)
+    n = max_sites;
+  for (unsigned i = 0; i < n; i++) {
+    // <lr> is the instruction after the call.
+    uint32_t call = s[i].addr - 4;
+    const list_fn_t *f = list_index_fn(ix, call);
+    char where[64];
+    snprintf(where, sizeof where, "%s+%u", fn_name(f),
+             f ? call - f->addr : call);
+    fprintf(out, "%6.2f%% %9u  %-32s %s\n", pct(s[i].count, p->nsamples),
+            s[i].count, where, inst_text(ix, call));
+  }
+  free(s);
+}
+
+int pi_prof_report(FILE *out, const char *log_path, const char *list_path) {
+  FILE *in = fopen(log_path, "r");
+  if (!in)
+    sys_die(fopen, "can't open log <%s>", log_path);
+  list_index_t *ix = list_index_load(list_path);
+  if (!ix)
+    panic("can't load <%s>\n", list_path);
+
+  pi_prof_t p;
+  int ok = pi_prof_read(in, 0, &p);
+  fclose(in);
+  if (ok) {
+    pi_prof_print_flat(out, &p, ix, 0);
+    fprintf(out, "\n");
+    pi_prof_print_callsites(out, &p, ix, 0);
+  }
+  pi_prof_free(&p);
+  list_index_free(ix);
+  return ok;
+}
+
+void pi_prof_free(pi_prof_t *p) {
+  free(p->pcs);
+  free(p->lrs);
+  memset(p, 0, sizeof *p);
+}
@@ -0,0 +1,47 @@
+#ifndef __PI_PROF_H__
+#define __PI_PROF_H__
+// unix side of the pi's pc-sampling profiler (libpi/include/pc-prof.h):
+// pull the "PCPROF:" dump out of a run's output and fold the raw
+// per-instruction counts with the program's .list into per-function
+// (flat) and per-call-site reports.
+#include <stdio.h>
+#include <stdint.h>
+#include "list-index.h"
+
+typedef struct {
+  uint32_t addr, count;
+} pi_prof_ent_t;
+
+typedef struct {
+  uint32_t lo, hi;
+  uint32_t nsamples, nmiss;
+
+  pi_prof_ent_t *pcs; // sampled pcs.
+  unsigned npcs;
+  pi_prof_ent_t *lrs; // sampled return addresses.
+  unsigned nlrs;
+} pi_prof_t;
+
+// scan <in> for a dump and parse it into <p>.  lines before it are
+// echoed to <echo> if non-null.  returns 0 if there was no (complete)
+// dump.
+int pi_prof_read(FILE *in, FILE *echo, pi_prof_t *p);
+
+// flat profile: samples per function, most first.  prints at most
+// <max_fns> functions (0 = all) with the hottest instruction of each.
+void pi_prof_print_flat(FILE *out, const pi_prof_t *p, const list_index_t *ix,
+                        unsigned max_fns);
+
+// call-site profile: samples whose <lr> pointed just after a given
+// call instruction, i.e., time in the callee charged to the call.
+// only a hint: non-leaf functions overwrite <lr>.
+void pi_prof_print_callsites(FILE *out, const pi_prof_t *p,
+                             const list_index_t *ix, unsigned max_sites);
+
+// read the dump in <log_path>, fold it with <list_path> and print both
+// reports.  returns 0 if there was no dump.
+int pi_prof_report(FILE *out, const char *log_path, const char *list_path);
+
+void pi_prof_free(pi_prof_t *p);
+
+#endif
@@ -0,0 +1,170 @@
+// run a pi program under qemu: see <pi-qemu.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include "libunix.h"
+#include "pi-qemu.h"
+
+enum { MAX_ALTS = 16 };
+
+// split 'A:\|B:' into its alternatives.  returns how many.
+static unsigned grep_split(char *s, char *alts[]) {
+  unsigned n = 0;
+  if (*s == '\'') {
+    s++;
+    char *e = strrchr(s, '\'');
+    if (e)
+      *e = 0;
+  }
+  while (*s) {
+    if (n == MAX_ALTS)
+      panic("more than %d alternatives in the grep string\n", MAX_ALTS);
+    alts[n++] = s;
+    char *bar = strstr(s, "\\|");
+    if (!bar)
+      break;
+    *bar = 0;
+    s = bar + 2;
+  }
+  return n;
+}
+
+static void run_qemu(const pi_qemu_t *q, int out_fd) {
+  const char *argv[32];
+  unsigned n = 0;
+  argv[n++] = q->qemu;
+  argv[n++] = "-M";
+  argv[n++] = q->machine;
+  argv[n++] = "-kernel";
+  argv[n++] = q->kernel;
+  // serial0 is the pl011; libpi uses the mini-uart.
+  argv[n++] = "-serial";
+  argv[n++] = "null";
+  argv[n++] = "-serial";
+  argv[n++] = "stdio";
+  argv[n++] = "-display";
+  argv[n++] = "none";
+  argv[n++] = "-monitor";
+  argv[n++] = "none";
+  argv[n++] = "-no-reboot";
+  char *drive = 0;
+  if (q->sd_img) {
+    drive = strdupf("file=%s,if=sd,format=raw", q->sd_img);
+    argv[n++] = "-drive";
+    argv[n++] = drive;
+  }
+  argv[n] = 0;
+
+  int null_fd = open("/dev/null", O_RDONLY);
+  if (null_fd < 0)
+    sys_die(open, "can't open /dev/null");
+  no_fail(dup2(null_fd, 0));
+  no_fail(dup2(out_fd, 1));
+  no_fail(dup2(out_fd, 2));
+  execvp(argv[0], (char **)argv);
+  sys_die(execvp, "can't run <%s>", argv[0]);
+}
+
+static void line_check(const char *line, pi_qemu_res_t *r) {
+  r->nlines++;
+  if (strstr(line, "SUCCESS:"))
+    r->nsuccess++;
+  if (strstr(line, "ERROR:"))
+    r->nerror++;
+  if (strstr(line, "PANIC:"))
+    r->npanic++;
+  if (strstr(line, "DONE!!!"))
+    r->done_p = 1;
+}
+
+static int line_match(const char *line, char *alts[], unsigned nalts) {
+  if (!nalts)
+    return 1;
+  for (unsigned i = 0; i < nalts; i++)
+    if (strstr(line, alts[i]))
+      return 1;
+  return 0;
+}
+
+pi_qemu_res_t pi_qemu_run(const pi_qemu_t *_q, FILE *out) {
+  pi_qemu_t q = *_q;
+  if (!q.qemu)
+    q.qemu = "qemu-system-arm";
+  if (!q.machine)
+    q.machine = "raspi1ap";
+  if (!q.kernel)
+    panic("no kernel to boot\n");
+  if (!q.timeout_sec)
+    q.timeout_sec = 30;
+
+  char *grep = q.grep_str ? strdup(q.grep_str) : 0;
+  char *alts[MAX_ALTS];
+  unsigned nalts = grep ? grep_split(grep, alts) : 0;
+
+  int fds[2];
+  no_fail(pipe(fds));
+  pid_t pid = fork();
+  if (pid < 0)
+    sys_die(fork, "can't fork");
+  if (!pid) {
+    close(fds[0]);
+    run_qemu(&q, fds[1]);
+  }
+  close_nofail(fds[1]);
+
+  pi_qemu_res_t r = {0};
+  char line[4096];
+  unsigned nline = 0;
+  time_usec_t start = time_get_usec();
+  int eof_p = 0;
+  while (!r.done_p && !eof_p) {
+    if (time_get_usec() - start > q.timeout_sec * 1000000ULL) {
+      r.timeout_p = 1;
+      break;
+    }
+    if (!can_read_timeout(fds[0], 100 * 1000))
+      continue;
+
+    char buf[1024];
+    int n = read(fds[0], buf, sizeof buf);
+    if (n < 0)
+      sys_die(read, "reading qemu's output");
+    if (!n)
+      eof_p = 1;
+
+    // split into lines; flush a partial one at eof.
+    for (int i = 0; i < n || (eof_p && nline); i++) {
+      char c = i < n ? buf[i] : '\n';
+      if (nline < sizeof line - 1)
+        line[nline++] = c;
+      if (c != '\n')
+        continue;
+      line[nline] = 0;
+      nline = 0;
+      line_check(line, &r);
+      if (q.log)
+        fputs(line, q.log);
+      if (line_match(line, alts, nalts))
+        fputs(line, out);
+      if (i >= n)
+        break;
+    }
+  }
+  fflush(out);
+
+  // qemu doesn't exit on the pi's reboot unless it models the
+  // watchdog: just stop it.
+  kill(pid, SIGKILL);
+  int status;
+  no_fail(waitpid(pid, &status, 0));
+  close_nofail(fds[0]);
+
+  // eg, it isn't installed or doesn't know the machine.
+  if (!r.done_p && WIFEXITED(status) && WEXITSTATUS(status))
+    output("<%s> exited with %d\n", q.qemu, WEXITSTATUS(status));
+  free(grep);
+  return r;
+}
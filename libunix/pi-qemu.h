@@ -0,0 +1,44 @@
+#ifndef __PI_QEMU_H__
+#define __PI_QEMU_H__
+// boot a pi program under qemu instead of on a pi, and check its
+// output the way the makefiles' GREP_STR does.
+//
+// qemu's raspi0/raspi1ap machines load a raw .bin at 0x8000 like the
+// firmware.  the mini-uart libpi uses is qemu's second serial port,
+// so that's the one we capture.  an sd image (see os/qemu/mk-sd-img)
+// goes on the sdhci controller.
+//
+// a run passes if the program shuts down cleanly (DONE!!! from
+// <clean_reboot>) without printing ERROR: or PANIC:.
+//
+// only tested against fake qemus (tests/11-qemu-runner.c).  programs
+// that use the tlb lockdown registers (os/vm/pinned-vm.c) won't get
+// far: qemu's arm1176 reads them as zero.
+#include <stdio.h>
+
+typedef struct {
+  const char *qemu;    // default: qemu-system-arm
+  const char *machine; // default: raspi1ap
+  const char *kernel;  // the .bin
+  const char *sd_img;  // 0 = no sd card.
+  unsigned timeout_sec;
+  // lines to echo, in the makefiles' form: 'A:\|B:\|C:' (the quotes
+  // are optional).  0 = echo everything.
+  const char *grep_str;
+  FILE *log; // if non-null, gets every line.
+} pi_qemu_t;
+
+typedef struct {
+  unsigned nlines, nsuccess, nerror, npanic;
+  int done_p;    // saw DONE!!!
+  int timeout_p; // killed after <timeout_sec>.
+} pi_qemu_res_t;
+
+// run <q> and echo the lines that match its grep string to <out>.
+pi_qemu_res_t pi_qemu_run(const pi_qemu_t *q, FILE *out);
+
+static inline int pi_qemu_ok(const pi_qemu_res_t *r) {
+  return r->done_p && !r->timeout_p && !r->nerror && !r->npanic;
+}
+
+#endif
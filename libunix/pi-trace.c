@@ -0,0 +1,113 @@
+// execution history: see <pi-trace.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libunix.h"
+#include "pi-trace.h"
+
+void pi_trace_init(pi_trace_t *t) { memset(t, 0, sizeof *t); }
+
+void pi_trace_free(pi_trace_t *t) {
+  free(t->data);
+  free(t->keys);
+  pi_trace_init(t);
+}
+
+void pi_trace_append(pi_trace_t *t, const uint8_t *data, unsigned nbytes,
+                     unsigned n) {
+  if (t->nbytes + nbytes > t->cap) {
+    t->cap = 2 * (t->nbytes + nbytes);
+    if (!(t->data = realloc(t->data, t->cap)))
+      panic("out of memory for %u bytes of trace\n", t->cap);
+  }
+
+  // walk them to keep <t->regs> current and drop a key every
+  // PI_TRACE_KEY entries.
+  unsigned off = 0;
+  for (unsigned i = 0; i < n; i++, t->n++) {
+    if (t->n % PI_TRACE_KEY == 0) {
+      t->keys = realloc(t->keys, (t->nkeys + 1) * sizeof *t->keys);
+      if (!t->keys)
+        panic("out of memory for trace keys\n");
+      struct pi_trace_key *k = &t->keys[t->nkeys++];
+      k->off = t->nbytes + off;
+      memcpy(k->regs, t->regs, sizeof k->regs);
+    }
+    if (off >= nbytes)
+      panic("trace: %u entries ran past %u bytes\n", n, nbytes);
+    off += dbg_trace_dec(data + off, t->regs);
+  }
+  if (off != nbytes)
+    panic("trace: %u entries used %u bytes of %u\n", n, off, nbytes);
+
+  memcpy(t->data + t->nbytes, data, nbytes);
+  t->nbytes += nbytes;
+}
+
+void pi_trace_add(pi_trace_t *t, const uint32_t *regs) {
+  uint8_t buf[DBG_TRACE_ENT_MAX];
+  uint32_t last[DBG_NREGS];
+  memcpy(last, t->regs, sizeof last);
+  pi_trace_append(t, buf, dbg_trace_enc(buf, last, regs), 1);
+}
+
+int pi_trace_get(const pi_trace_t *t, unsigned i, uint32_t *regs) {
+  if (i >= t->n)
+    return 0;
+  // from the key before it.
+  const struct pi_trace_key *k = &t->keys[i / PI_TRACE_KEY];
+  memcpy(regs, k->regs, sizeof k->regs);
+  unsigned off = k->off;
+  for (unsigned j = i / PI_TRACE_KEY * PI_TRACE_KEY; j <= i; j++)
+    off += dbg_trace_dec(t->data + off, regs);
+  return 1;
+}
+
+// latest entry before <i> where <match> holds: scans back a key's
+// worth of entries at a time, decoding each block forward.
+static int find_back(const pi_trace_t *t, unsigned i,
+                     int (*match)(const uint32_t *before, const uint32_t *after,
+                                  uint32_t arg),
+                     uint32_t arg) {
+  if (i > t->n)
+    i = t->n;
+  if (!i)
+    return -1;
+  for (int k = (i - 1) / PI_TRACE_KEY; k >= 0; k--) {
+    uint32_t regs[DBG_NREGS], before[DBG_NREGS];
+    memcpy(regs, t->keys[k].regs, sizeof regs);
+    unsigned off = t->keys[k].off;
+    int found = -1;
+
+    unsigned end = (k + 1) * PI_TRACE_KEY;
+    if (end > i)
+      end = i;
+    for (unsigned j = k * PI_TRACE_KEY; j < end; j++) {
+      memcpy(before, regs, sizeof before);
+      off += dbg_trace_dec(t->data + off, regs);
+      if (match(before, regs, arg))
+        found = j;
+    }
+    if (found >= 0)
+      return found;
+  }
+  return -1;
+}
+
+static int pc_is(const uint32_t *before, const uint32_t *after, uint32_t pc) {
+  return after[15] == pc;
+}
+
+static int reg_changed(const uint32_t *before, const uint32_t *after,
+                       uint32_t reg) {
+  return before[reg] != after[reg];
+}
+
+int pi_trace_find_pc(const pi_trace_t *t, unsigned i, uint32_t pc) {
+  return find_back(t, i, pc_is, pc);
+}
+
+int pi_trace_find_write(const pi_trace_t *t, unsigned i, unsigned reg) {
+  assert(reg < DBG_NREGS);
+  return find_back(t, i, reg_changed, reg);
+}
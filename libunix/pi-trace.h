@@ -0,0 +1,56 @@
+#ifndef __PI_TRACE_H__
+#define __PI_TRACE_H__
+// execution history from the pi's compressed instruction trace
+// (<dbg-trace.h>): keeps the entries compressed, as they came, plus a
+// full register snapshot every PI_TRACE_KEY entries, so any past
+// state is a snapshot and at most that many decodes away.  reverse
+// stepping is then a lookup: nothing re-runs on the pi.
+//
+// give <pi_dbg_t> one (<d->hist>) and it records every traced
+// instruction and every stop.  instructions run without tracing
+// (plain step N, continue) aren't in it: across those the history
+// jumps from one stop to the next.
+#include <stdint.h>
+#include "dbg-trace.h"
+
+enum { PI_TRACE_KEY = 1024 };
+
+typedef struct {
+  uint8_t *data; // the entries, back to back.
+  unsigned nbytes, cap;
+  unsigned n; // entries.
+
+  // keys[k]: the registers before entry k*PI_TRACE_KEY and where it
+  // starts in <data>.
+  struct pi_trace_key {
+    unsigned off;
+    uint32_t regs[DBG_NREGS];
+  } *keys;
+  unsigned nkeys;
+
+  uint32_t regs[DBG_NREGS]; // after the last entry.
+} pi_trace_t;
+
+void pi_trace_init(pi_trace_t *t);
+void pi_trace_free(pi_trace_t *t);
+
+// append <n> encoded entries (<nbytes> of them), continuing from the
+// last one: a DBG_TRACE_ENTS payload.
+void pi_trace_append(pi_trace_t *t, const uint8_t *data, unsigned nbytes,
+                     unsigned n);
+
+// append one state (e.g., a stop), encoding it ourselves.
+void pi_trace_add(pi_trace_t *t, const uint32_t *regs);
+
+// registers after entry <i> into <regs>.  returns 0 if there's no
+// such entry.
+int pi_trace_get(const pi_trace_t *t, unsigned i, uint32_t *regs);
+
+// latest entry before <i> with pc <pc> (reverse continue to a
+// breakpoint), or -1.
+int pi_trace_find_pc(const pi_trace_t *t, unsigned i, uint32_t pc);
+
+// latest entry before <i> that changed register <reg>, or -1.
+int pi_trace_find_write(const pi_trace_t *t, unsigned i, unsigned reg);
+
+#endif
@@ -62,3 +62,18 @@ int set_tty_to_8n1(int fd, unsigned speed, double timeout) {
     panic("tcsetattr failed\n");
   return fd;
 }
+
+// change just the baud rate of an already-setup tty.  waits for any
+// pending output to go out at the old rate first.
+int set_tty_speed(int fd, unsigned speed) {
+  struct termios tty;
+  if (tcdrain(fd) < 0)
+    sys_die(tcdrain, "tcdrain failed");
+  if (tcgetattr(fd, &tty) != 0)
+    panic("tcgetattr failed\n");
+  if (cfsetspeed(&tty, speed) < 0)
+    panic("cfsetspeed(%u) failed\n", speed);
+  if (tcsetattr(fd, TCSANOW, &tty) != 0)
+    panic("tcsetattr failed\n");
+  return fd;
+}
@@ -0,0 +1,125 @@
+// loopback test for the framed uart protocol (<pi-frame.h>) over a
+// pseudo-tty pair: a child plays the pi on the slave end, we play unix
+// on the master end.  exercises resync past junk, a baud switch, a
+// bad-crc resend and transfers that do and don't line up with frame
+// boundaries.  linux only (posix_openpt).
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include "libunix.h"
+#include "pi-frame.h"
+
+enum { FAST_BAUD = 921600 };
+
+// what the pi would do: read <n>, then <n> bytes, send back their crc.
+static void child(int fd) {
+  // what a real pi prints before it starts talking frames.
+  const char junk[] = "boot: hello from the fake pi\n";
+  write_exact(fd, junk, sizeof junk - 1);
+
+  pi_frame_t f;
+  pi_frame_init(&f, fd, FRAME_DEFAULT_BAUD, 0);
+
+  static uint8_t buf[1024 * 1024];
+  while (1) {
+    uint32_t n;
+    pi_frame_read(&f, &n, sizeof n);
+    if (!n)
+      break;
+    assert(n <= sizeof buf);
+    pi_frame_read(&f, buf, n);
+
+    uint32_t crc = our_crc32(buf, n);
+    if (!pi_frame_write(&f, &crc, sizeof crc))
+      panic("child: write of crc failed\n");
+  }
+  exit(0);
+}
+
+// a data frame with a bad crc: should get nak'd and resent.
+static void send_corrupt(pi_frame_t *f) {
+  uint8_t buf[4 + sizeof(frame_hdr_t) + 4 + 4];
+  uint32_t magic = FRAME_MAGIC, x = 0xdeadbeef, crc = 0;
+  frame_hdr_t h = {.type = FRAME_DATA, .seq = f->tx_seq, .len = sizeof x};
+  memcpy(buf, &magic, 4);
+  memcpy(buf + 4, &h, sizeof h);
+  memcpy(buf + 8, &x, 4);
+  memcpy(buf + 12, &crc, 4);
+  write_exact(f->fd, buf, sizeof buf);
+}
+
+static void xfer(pi_frame_t *f, const uint8_t *data, uint32_t n) {
+  if (!pi_frame_write(f, &n, sizeof n) || !pi_frame_write(f, data, n))
+    panic("write of %d bytes failed\n", n);
+
+  uint32_t crc;
+  pi_frame_read(f, &crc, sizeof crc);
+  if (crc != our_crc32(data, n))
+    panic("crc mismatch for %d bytes: have %x, expected %x\n", n, crc,
+          our_crc32(data, n));
+  trace("sent %d bytes, crc=%x\n", n, crc);
+}
+
+int main(void) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0)
+    sys_die(posix_openpt, "can't open pty");
+  if (grantpt(master) < 0 || unlockpt(master) < 0)
+    sys_die(grantpt, "can't setup pty");
+  int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  if (slave < 0)
+    sys_die(open, "can't open pty slave");
+  set_tty_to_8n1(slave, FRAME_DEFAULT_BAUD, 1);
+
+  int pid = fork();
+  if (pid < 0)
+    sys_die(fork, "fork failed");
+  if (!pid) {
+    close(master);
+    child(slave);
+  }
+  close(slave);
+
+  pi_frame_t f;
+  pi_frame_init(&f, master, FRAME_DEFAULT_BAUD, stdout);
+
+  if (!pi_frame_set_baud(&f, FAST_BAUD))
+    panic("baud switch to %d failed\n", FAST_BAUD);
+  trace("switched to %d baud\n", f.baud);
+
+  send_corrupt(&f);
+  static uint8_t data[1024 * 1024];
+  for (unsigned i = 0; i < sizeof data; i++)
+    data[i] = random();
+
+  uint32_t sizes[] = {1, FRAME_MAXLEN - 1, FRAME_MAXLEN, FRAME_MAXLEN + 1,
+                      64 * 1024, sizeof data};
+  unsigned nsizes = sizeof sizes / sizeof sizes[0];
+  time_usec_t start = time_get_usec();
+  unsigned total = 0;
+  for (unsigned i = 0; i < nsizes; i++) {
+    xfer(&f, data, sizes[i]);
+    total += sizes[i];
+  }
+  time_usec_t usec = time_get_usec() - start;
+
+  uint32_t done = 0;
+  if (!pi_frame_write(&f, &done, sizeof done))
+    panic("write of done failed\n");
+
+  int status;
+  if (!child_clean_exit(pid, &status) || status)
+    panic("child crashed: status=%d\n", status);
+  if (!f.nresend)
+    panic("corrupt frame should have caused a resend\n");
+
+  trace("resent %d frames, %d bad frames\n", f.nresend, f.nbad);
+  trace("%d bytes in %dusec (%d KB/sec)\n", total, usec,
+        usec ? (unsigned)((uint64_t)total * 1000 / usec) : 0);
+  printf("SUCCESS: frame loopback\n");
+  return 0;
+}
@@ -0,0 +1,98 @@
+// pull benchmark results out of a fake run (<pi-bench.h>), round trip
+// them through a csv and diff against a baseline.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libunix.h"
+#include "pi-bench.h"
+
+static const char *log_name = "/tmp/10-bench-csv.log";
+static const char *csv_name = "/tmp/10-bench-csv.csv";
+static const char *base_name = "/tmp/10-bench-csv.base.csv";
+
+static void write_file(const char *name, const char *s) {
+  FILE *f = fopen(name, "w");
+  if (!f)
+    sys_die(fopen, "can't create %s", name);
+  fputs(s, f);
+  fclose(f);
+}
+
+int main(void) {
+  // noise, a bootloader-style prefix and a rerun of one benchmark.
+  write_file(log_name, "hello from the pi\n"
+                       "BENCH:uart_put8,100,120,400,256,3\n"
+                       "PI:BENCH:memcpy/64/a0,40,44,60,256,0\n"
+                       "BENCH:kmalloc/16,20,22,30,256,1\n"
+                       "BENCH:uart_put8,101,121,401,256,2\n"
+                       "DONE!!!\n");
+  write_file(base_name, "name,min,median,p99,n,nreject\n"
+                        "uart_put8,100,120,400,256,3\n"
+                        "memcpy/64/a0,40,40,50,256,0\n"
+                        "fork,900,1000,1100,64,0\n");
+
+  FILE *in = fopen(log_name, "r");
+  pi_bench_set_t cur = {0};
+  unsigned n = pi_bench_read(in, 0, &cur);
+  fclose(in);
+  if (n != 4 || cur.n != 3)
+    panic("read %u lines, %u benchmarks: expected 4, 3\n", n, cur.n);
+  const pi_bench_t *u = pi_bench_find(&cur, "uart_put8");
+  if (!u || u->median != 121 || u->nreject != 2)
+    panic("the rerun didn't replace the first result\n");
+
+  // write it out and read it back.
+  FILE *csv = fopen(csv_name, "w");
+  pi_bench_write_csv(csv, &cur);
+  fclose(csv);
+  pi_bench_set_t again = {0};
+  csv = fopen(csv_name, "r");
+  if (pi_bench_read_csv(csv, &again) != cur.n)
+    panic("csv round trip lost rows\n");
+  fclose(csv);
+  for (unsigned i = 0; i < cur.n; i++)
+    if (memcmp(&cur.v[i], &again.v[i], sizeof cur.v[i]))
+      panic("csv round trip changed <%s>\n", cur.v[i].name);
+
+  // memcpy is 10% slower: a regression at 5%, not at 20%.
+  pi_bench_set_t base = {0};
+  in = fopen(base_name, "r");
+  pi_bench_read_csv(in, &base);
+  fclose(in);
+
+  char *buf;
+  size_t nbuf;
+  FILE *out = open_memstream(&buf, &nbuf);
+  unsigned nslower = pi_bench_diff(out, &base, &cur, 5);
+  fclose(out);
+  fputs(buf, stdout);
+  if (nslower != 1)
+    panic("expected 1 regression, got %u\n", nslower);
+  char *m = strstr(buf, "memcpy/64/a0");
+  if (!m || !strstr(m, "SLOWER") || strchr(m, '\n') < strstr(m, "SLOWER"))
+    panic("memcpy wasn't marked slower\n");
+  if (!strstr(buf, "kmalloc/16") || !strstr(strstr(buf, "kmalloc/16"), "(new)"))
+    panic("kmalloc wasn't marked new\n");
+  if (!strstr(buf, "fork") || !strstr(strstr(buf, "fork"), "(gone)"))
+    panic("fork wasn't marked gone\n");
+  free(buf);
+
+  out = fopen("/dev/null", "w");
+  if (pi_bench_diff(out, &base, &cur, 20) != 0)
+    panic("10%% shouldn't be a regression at 20%%\n");
+  fclose(out);
+
+  // the whole thing from files.
+  if (pi_bench_report(stdout, log_name, csv_name, base_name, 5) != 1)
+    panic("report disagrees with diff\n");
+
+  pi_bench_free(&cur);
+  pi_bench_free(&again);
+  pi_bench_free(&base);
+  unlink(log_name);
+  unlink(csv_name);
+  unlink(base_name);
+  printf("SUCCESS: benchmark csv and diff\n");
+  return 0;
+}
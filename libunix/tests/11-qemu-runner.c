@@ -0,0 +1,77 @@
+// run fake qemus (<pi-qemu.h>) that print a clean run, a panic and a
+// hang, and check what the runner makes of them.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "libunix.h"
+#include "pi-qemu.h"
+
+static const char *fake = "/tmp/11-qemu-runner.sh";
+
+// a "qemu" that ignores its arguments and prints <body>.
+static void fake_qemu(const char *body) {
+  FILE *f = fopen(fake, "w");
+  if (!f)
+    sys_die(fopen, "can't create %s", fake);
+  fprintf(f, "#!/bin/sh\n%s", body);
+  fclose(f);
+  no_fail(chmod(fake, 0755));
+}
+
+static pi_qemu_res_t run(const char *grep, unsigned timeout, char **echo) {
+  pi_qemu_t q = {.qemu = fake,
+                 .kernel = "kernel.bin",
+                 .sd_img = "sd.img",
+                 .grep_str = grep,
+                 .timeout_sec = timeout};
+  size_t n;
+  FILE *out = open_memstream(echo, &n);
+  pi_qemu_res_t r = pi_qemu_run(&q, out);
+  fclose(out);
+  return r;
+}
+
+int main(void) {
+  char *echo;
+
+  // a clean run: the sleep after DONE!!! must not be waited for.
+  fake_qemu("echo 'noise'\n"
+            "echo 'TRACE:booted'\n"
+            "printf 'SUCCESS: it worked\\nDONE!!!\\n'\n"
+            "sleep 20\n");
+  time_usec_t start = time_get_usec();
+  pi_qemu_res_t r = run("'TRACE:\\|SUCCESS:\\|ERROR:\\|PANIC:'", 10, &echo);
+  if (time_get_usec() - start > 5 * 1000 * 1000)
+    panic("runner waited for qemu after DONE!!!\n");
+  if (!pi_qemu_ok(&r) || r.nsuccess != 1 || r.nlines != 4)
+    panic("clean run: ok=%d nsuccess=%u nlines=%u\n", pi_qemu_ok(&r),
+          r.nsuccess, r.nlines);
+  if (strcmp(echo, "TRACE:booted\nSUCCESS: it worked\n"))
+    panic("grep echoed the wrong lines: <%s>\n", echo);
+  free(echo);
+
+  // a panic, then a clean shutdown: still a failure.  no grep string
+  // echoes everything; the last line has no newline.
+  fake_qemu("echo 'PI:PANIC:os.c:1:bad'\n"
+            "printf 'DONE!!!'\n");
+  r = run(0, 10, &echo);
+  if (pi_qemu_ok(&r) || r.npanic != 1 || !r.done_p)
+    panic("panic run: ok=%d npanic=%u\n", pi_qemu_ok(&r), r.npanic);
+  if (strcmp(echo, "PI:PANIC:os.c:1:bad\nDONE!!!\n"))
+    panic("wrong echo: <%s>\n", echo);
+  free(echo);
+
+  // a hang.
+  fake_qemu("echo 'TRACE:stuck'\n"
+            "sleep 20\n");
+  r = run(0, 1, &echo);
+  if (pi_qemu_ok(&r) || !r.timeout_p || r.done_p)
+    panic("hang wasn't a timeout\n");
+  free(echo);
+
+  unlink(fake);
+  printf("SUCCESS: qemu runner\n");
+  return 0;
+}
@@ -0,0 +1,141 @@
+// loopback test for the kernel trace decoder (<pi-ktrace.h>) over a
+// pseudo-tty pair: a child plays the pi and prints text with two
+// <ktrace_dump>s mixed in (one with a bad crc), we scan the output
+// the way the echo loops in pi-cat.c and pi-echo.c do.  checks the
+// text comes through unchanged, including bytes that look like the
+// start of the magic, and that the good dump decodes.  linux only
+// (posix_openpt).
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include "libunix.h"
+#include "pi-ktrace.h"
+
+enum { NENT = 300, NDROPPED = 5, BAUD = 115200 };
+
+// the text the pi prints around the dumps: "CRT" is the first three
+// bytes of the magic.
+static const char *text[] = {
+    "boot: hello from the fake pi\n",
+    "CRTX is not a dump, and neither is CR\n",
+    "between the dumps\n",
+    "DONE!!!\n",
+};
+
+static void put32(int fd, uint32_t x) { write_exact(fd, &x, 4); }
+
+// what <ktrace_dump> sends: cycles start just below the wrap and the
+// events are 700 cycles (1usec) apart.
+static void dump(int fd, int bad_crc_p) {
+  static const uint32_t ids[] = {KT_IRQ_TIMER, KT_SCHED_RUN, KT_SYSCALL};
+  pi_ktrace_ent_t e[NENT];
+  for (unsigned i = 0; i < NENT; i++)
+    e[i] = (pi_ktrace_ent_t){.cyc = 0xffffff00 + i * PI_KTRACE_CYC_PER_USEC,
+                             .id = ids[i % 3],
+                             .a0 = i,
+                             .a1 = i * 2};
+  put32(fd, KTRACE_MAGIC);
+  put32(fd, sizeof e[0]);
+  put32(fd, NENT);
+  put32(fd, NDROPPED);
+  write_exact(fd, e, sizeof e);
+  put32(fd, our_crc32(e, sizeof e) ^ bad_crc_p);
+}
+
+static void child(int fd) {
+  write_exact(fd, text[0], strlen(text[0]));
+  write_exact(fd, text[1], strlen(text[1]));
+  dump(fd, 0);
+  write_exact(fd, text[2], strlen(text[2]));
+  dump(fd, 1);
+  write_exact(fd, text[3], strlen(text[3]));
+  exit(0);
+}
+
+int main(void) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0)
+    sys_die(posix_openpt, "can't open pty");
+  if (grantpt(master) < 0 || unlockpt(master) < 0)
+    sys_die(grantpt, "can't setup pty");
+  int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  if (slave < 0)
+    sys_die(open, "can't open pty slave");
+  set_tty_to_8n1(slave, BAUD, 1);
+
+  int pid = fork();
+  if (pid < 0)
+    sys_die(fork, "fork failed");
+  if (!pid) {
+    close(master);
+    child(slave);
+  }
+  close(slave);
+
+  char *trace_buf;
+  size_t trace_nbytes;
+  FILE *trace = open_memstream(&trace_buf, &trace_nbytes);
+
+  static char out[64 * 1024];
+  unsigned nout = 0;
+  pi_ktrace_scan_t s = {0};
+  while (!strstr(out, "DONE!!!\n")) {
+    uint8_t raw[4096];
+    int n = read(master, raw, sizeof raw);
+    if (n <= 0)
+      panic("pty closed before DONE!!!\n");
+    // feed it in small pieces so the magic and the dumps get split.
+    for (int i = 0; i < n;) {
+      int m = 1 + random() % 13;
+      if (m > n - i)
+        m = n - i;
+      assert(nout + m + 3 < sizeof out);
+      nout += pi_ktrace_scan(&s, raw + i, m, (uint8_t *)out + nout, trace,
+                             PI_KTRACE_CYC_PER_USEC);
+      out[nout] = 0;
+      i += m;
+    }
+  }
+  fclose(trace);
+
+  int status;
+  if (!child_clean_exit(pid, &status) || status)
+    panic("child crashed: status=%d\n", status);
+
+  char expect[1024] = {0};
+  for (unsigned i = 0; i < sizeof text / sizeof text[0]; i++)
+    strcat(expect, text[i]);
+  if (strcmp(out, expect) != 0)
+    panic("text changed: have <%s>, expected <%s>\n", out, expect);
+  if (s.ndumps != 2)
+    panic("expected 2 dumps, have %u\n", s.ndumps);
+
+  const char *want[] = {
+      "ktrace: 5 oldest events were overwritten\n",
+      // the cycle counter wrapped between the first and last event.
+      "299.000us (+    1.000) syscall      tid=299 sysno=598\n",
+      "---- 300 events ----\n",
+      "  irq-timer    100\n",
+      "  sched-run    100\n",
+      "  syscall      100\n",
+      "ktrace: crc mismatch",
+  };
+  for (unsigned i = 0; i < sizeof want / sizeof want[0]; i++)
+    if (!strstr(trace_buf, want[i]))
+      panic("trace is missing <%s>:\n%s", want[i], trace_buf);
+  // only the good dump prints a timeline.
+  unsigned ntimeline = 0;
+  for (char *p = trace_buf; (p = strstr(p, "---- ")); p++)
+    ntimeline++;
+  if (ntimeline != 1)
+    panic("expected 1 timeline, have %u:\n%s", ntimeline, trace_buf);
+
+  trace("decoded %u events, %zu bytes of timeline\n", NENT, trace_nbytes);
+  free(trace_buf);
+  printf("SUCCESS: ktrace loopback\n");
+  return 0;
+}
@@ -0,0 +1,128 @@
+// cross-check the crc32 and fast_hash implementations against simple
+// byte-at-a-time references over every small size, every alignment and
+// split incremental calls; then time them on a large buffer.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libunix.h"
+
+typedef uint32_t (*crc_fn_t)(const void *, unsigned, uint32_t);
+
+static struct {
+  const char *name;
+  crc_fn_t fn;
+} crcs[] = {
+    {"byte", our_crc32_inc_byte},
+    {"slice8", our_crc32_inc_slice8},
+    {"pclmul", our_crc32_inc_pclmul},
+    {"default", our_crc32_inc},
+};
+enum { NCRC = sizeof crcs / sizeof crcs[0] };
+
+// the original get16bits loop, before the word-at-a-time change.
+static uint32_t ref_fast_hash(const void *_data, uint32_t len) {
+  const uint8_t *data = _data;
+  uint32_t hash = len, tmp;
+  int rem = len & 3;
+#define get16(d) ((uint32_t)(d)[1] << 8 | (d)[0])
+  for (len >>= 2; len > 0; len--, data += 4) {
+    hash += get16(data);
+    tmp = (get16(data + 2) << 11) ^ hash;
+    hash = (hash << 16) ^ tmp;
+    hash += hash >> 11;
+  }
+  switch (rem) {
+  case 3:
+    hash += get16(data);
+    hash ^= hash << 16;
+    hash ^= ((signed char)data[2]) << 18;
+    hash += hash >> 11;
+    break;
+  case 2:
+    hash += get16(data);
+    hash ^= hash << 11;
+    hash += hash >> 17;
+    break;
+  case 1:
+    hash += (signed char)*data;
+    hash ^= hash << 10;
+    hash += hash >> 1;
+  }
+#undef get16
+  hash ^= hash << 3;
+  hash += hash >> 5;
+  hash ^= hash << 4;
+  hash += hash >> 17;
+  hash ^= hash << 25;
+  hash += hash >> 6;
+  return hash;
+}
+
+static int usable(unsigned i) {
+  return crcs[i].fn != our_crc32_inc_pclmul || our_crc32_pclmul_ok();
+}
+
+static void check(const uint8_t *p, unsigned n) {
+  uint32_t exp = our_crc32_inc_byte(p, n, 0);
+  // split point exercises the incremental interface.
+  unsigned split = n ? random() % (n + 1) : 0;
+
+  for (unsigned i = 0; i < NCRC; i++) {
+    if (!usable(i))
+      continue;
+    uint32_t got = crcs[i].fn(p, n, 0);
+    uint32_t inc = crcs[i].fn(p + split, n - split, crcs[i].fn(p, split, 0));
+    if (got != exp || inc != exp)
+      panic("%s: n=%d, align=%d: have %x (inc %x), expected %x\n",
+            crcs[i].name, n, (int)((uintptr_t)p & 7), got, inc, exp);
+  }
+  if (fast_hash(p, n) != ref_fast_hash(p, n))
+    panic("fast_hash: n=%d, align=%d: have %x, expected %x\n", n,
+          (int)((uintptr_t)p & 7), fast_hash(p, n), ref_fast_hash(p, n));
+}
+
+enum { BIG = 16 * 1024 * 1024 };
+// so the timed calls don't get thrown away.
+static volatile uint32_t sink;
+
+int main(void) {
+  uint8_t *buf = malloc(BIG + 8);
+  for (unsigned i = 0; i < BIG + 8; i++)
+    buf[i] = random();
+
+  // known answer.
+  if (our_crc32("123456789", 9) != 0xcbf43926)
+    panic("crc32 check value wrong: %x\n", our_crc32("123456789", 9));
+
+  for (unsigned align = 0; align < 8; align++) {
+    for (unsigned n = 0; n < 1024; n++)
+      check(buf + align, n);
+    for (unsigned i = 0; i < 64; i++)
+      check(buf + align, random() % (1024 * 1024));
+  }
+  trace("all implementations agree (pclmul %s)\n",
+        our_crc32_pclmul_ok() ? "checked" : "not available");
+
+  for (unsigned i = 0; i < NCRC; i++) {
+    if (!usable(i))
+      continue;
+    time_usec_t s = time_get_usec();
+    sink = crcs[i].fn(buf, BIG, 0);
+    time_usec_t t = time_get_usec() - s;
+    trace("crc32 %-8s: %d MB/sec\n", crcs[i].name,
+          t ? (unsigned)((uint64_t)BIG / t) : 0);
+  }
+  time_usec_t s = time_get_usec();
+  sink = ref_fast_hash(buf, BIG);
+  time_usec_t t0 = time_get_usec() - s;
+  s = time_get_usec();
+  sink = fast_hash(buf, BIG);
+  time_usec_t t1 = time_get_usec() - s;
+  trace("fast_hash byte: %d MB/sec, word: %d MB/sec\n",
+        t0 ? (unsigned)((uint64_t)BIG / t0) : 0,
+        t1 ? (unsigned)((uint64_t)BIG / t1) : 0);
+
+  printf("SUCCESS: crc/hash implementations agree\n");
+  return 0;
+}
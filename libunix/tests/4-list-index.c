@@ -0,0 +1,89 @@
+// check the .list index (<list-index.h>): generate a fake objdump
+// listing, look up every address, then rewrite it and check that
+// refresh picks up the change.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libunix.h"
+#include "list-index.h"
+
+enum { NFNS = 2000, NINST = 50, BASE = 0x8000 };
+
+static const char *name = "/tmp/4-list-index.list";
+
+// NFNS functions of NINST instructions each, <fn_prefix><n>.
+static void gen(const char *fn_prefix) {
+  FILE *f = fopen(name, "w");
+  if (!f)
+    sys_die(fopen, "can't create %s", name);
+  fprintf(f, "\nfoo.elf:     file format elf32-littlearm\n\n\n");
+  fprintf(f, "Disassembly of section .text:\n\n");
+  uint32_t addr = BASE;
+  for (unsigned i = 0; i < NFNS; i++) {
+    fprintf(f, "%08x <%s%d>:\n", addr, fn_prefix, i);
+    for (unsigned j = 0; j < NINST; j++, addr += 4)
+      fprintf(f, "%8x:\te1a00000 \tnop\t\t\t; (mov r0, r0)\n", addr);
+    fprintf(f, "\n");
+  }
+  fclose(f);
+}
+
+static void check(list_index_t *ix, const char *fn_prefix) {
+  if (ix->nfns != NFNS || ix->ninsts != NFNS * NINST)
+    panic("expected %d fns, %d insts: have %d, %d\n", NFNS, NFNS * NINST,
+          ix->nfns, ix->ninsts);
+
+  for (unsigned i = 0; i < NFNS; i++) {
+    char fn_name[64];
+    sprintf(fn_name, "%s%d", fn_prefix, i);
+    for (unsigned j = 0; j < NINST; j++) {
+      uint32_t addr = BASE + (i * NINST + j) * 4;
+      const list_fn_t *f = list_index_fn(ix, addr);
+      if (!f || strcmp(f->name, fn_name) != 0)
+        panic("%x: expected fn <%s>, have <%s>\n", addr, fn_name,
+              f ? f->name : "none");
+      // header + instructions, without the trailing blank.
+      if (f->nlines != NINST + 1)
+        panic("<%s>: expected %d lines, have %d\n", fn_name, NINST + 1,
+              f->nlines);
+
+      uint32_t a;
+      int line = list_index_line(ix, addr);
+      if (line < 0 || !list_line_is_inst(ix->lines[line], &a) || a != addr)
+        panic("%x: wrong line %d\n", addr, line);
+    }
+  }
+  if (list_index_fn(ix, BASE - 4) || list_index_line(ix, BASE + 2) >= 0)
+    panic("found addresses that aren't there\n");
+}
+
+int main(void) {
+  gen("fn");
+  list_index_t *ix = list_index_load(name);
+  if (!ix)
+    panic("could not load %s\n", name);
+  check(ix, "fn");
+  if (list_index_refresh(ix))
+    panic("refresh without a change?\n");
+
+  // a rebuild: different names, new file.
+  unlink(name);
+  gen("new_fn");
+  if (!list_index_refresh(ix))
+    panic("refresh missed the rewrite\n");
+  check(ix, "new_fn");
+
+  // the point: lookups are cheap.
+  time_usec_t s = time_get_usec();
+  unsigned n = 1000 * 1000;
+  for (unsigned i = 0; i < n; i++)
+    list_index_fn(ix, BASE + (random() % (NFNS * NINST)) * 4);
+  trace("%d lookups in %dusec\n", n, time_get_usec() - s);
+
+  list_index_free(ix);
+  unlink(name);
+  printf("SUCCESS: list index\n");
+  return 0;
+}
@@ -0,0 +1,93 @@
+// fold a fake pc-sampling dump (<pi-prof.h>) with a fake .list and
+// check the per-function and call-site totals.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libunix.h"
+#include "pi-prof.h"
+
+static const char *list_name = "/tmp/5-prof-fold.list";
+static const char *log_name = "/tmp/5-prof-fold.log";
+
+static void write_file(const char *name, const char *s) {
+  FILE *f = fopen(name, "w");
+  if (!f)
+    sys_die(fopen, "can't create %s", name);
+  fputs(s, f);
+  fclose(f);
+}
+
+int main(void) {
+  write_file(list_name,
+             "Disassembly of section .text:\n\n"
+             "00008000 <notmain>:\n"
+             "    8000:\te92d4010 \tpush\t{r4, lr}\n"
+             "    8004:\teb000003 \tbl\t8018 <fib>\n"
+             "    8008:\teb000006 \tbl\t8028 <leaf>\n"
+             "    800c:\te8bd8010 \tpop\t{r4, pc}\n\n"
+             "00008018 <fib>:\n"
+             "    8018:\te2500001 \tsubs\tr0, r0, #1\n"
+             "    801c:\tebfffffd \tbl\t8028 <leaf>\n"
+             "    8020:\t1afffffc \tbne\t8018 <fib>\n"
+             "    8024:\te12fff1e \tbx\tlr\n\n"
+             "00008028 <leaf>:\n"
+             "    8028:\te2800001 \tadd\tr0, r0, #1\n"
+             "    802c:\te12fff1e \tbx\tlr\n");
+
+  // noise before, and a bootloader-style prefix on the dump.
+  write_file(log_name, "hello from the pi\n"
+                       "PCPROF:begin lo=0x8000 hi=0x8030 nsamples=100 "
+                       "nmiss=10\n"
+                       "PCPROF:pc 0x8004 5\n"
+                       "PCPROF:pc 0x8018 20\n"
+                       "PCPROF:pc 0x8020 25\n"
+                       "PCPROF:pc 0x8028 30\n"
+                       "PCPROF:pc 0x802c 10\n"
+                       "PCPROF:lr 0x8008 12\n"
+                       "PCPROF:lr 0x8020 28\n"
+                       "PI:PCPROF:end\n"
+                       "DONE!!!\n");
+
+  FILE *in = fopen(log_name, "r");
+  pi_prof_t p;
+  if (!pi_prof_read(in, 0, &p))
+    panic("didn't find the dump\n");
+  fclose(in);
+  if (p.nsamples != 100 || p.nmiss != 10 || p.npcs != 5 || p.nlrs != 2)
+    panic("parsed wrong: nsamples=%u nmiss=%u npcs=%u nlrs=%u\n", p.nsamples,
+          p.nmiss, p.npcs, p.nlrs);
+
+  list_index_t *ix = list_index_load(list_name);
+  char *buf;
+  size_t n;
+  FILE *out = open_memstream(&buf, &n);
+  pi_prof_print_flat(out, &p, ix, 0);
+  pi_prof_print_callsites(out, &p, ix, 0);
+  fclose(out);
+  fputs(buf, stdout);
+
+  // sorted by samples: fib (45), leaf (40), notmain (5).
+  char *fib = strstr(buf, " 45  fib ");
+  char *leaf = strstr(buf, " 40  leaf ");
+  char *nm = strstr(buf, " 5  notmain ");
+  if (!fib || !leaf || !nm || !(fib < leaf && leaf < nm))
+    panic("wrong flat profile\n");
+  // lr=0x8020 -> the call at fib+4; lr=0x8008 -> notmain+4.
+  char *c1 = strstr(buf, "fib+4");
+  char *c2 = strstr(buf, "notmain+4");
+  if (!c1 || !c2 || c1 > c2 || !strstr(c1, "bl\t8028 <leaf>"))
+    panic("wrong call-site profile\n");
+  free(buf);
+
+  if (!pi_prof_report(stdout, log_name, list_name))
+    panic("report didn't find the dump\n");
+
+  pi_prof_free(&p);
+  list_index_free(ix);
+  unlink(list_name);
+  unlink(log_name);
+  printf("SUCCESS: profile fold\n");
+  return 0;
+}
@@ -0,0 +1,307 @@
+// loopback test for the debugger protocol (<pi-dbg.h>): a child plays
+// the pi with a fake cpu (each "instruction" bumps the pc and r0, and
+// r1 every 8th) on a pty, we drive it from unix.  checks that register
+// deltas, tracing, run-until, breakpoints and crc-checked memory
+// transfers all land.  linux only (posix_openpt).
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include "libunix.h"
+#include "pi-dbg.h"
+
+enum { START_PC = 0x8000, MEM_ADDR = 0x100000, MEM_NBYTES = 64 * 1024 };
+
+/*************************************************************
+ * the fake pi: same protocol handling as debugger/code/debugger.h
+ */
+static pi_frame_t pf;
+static uint32_t regs[DBG_NREGS], last[DBG_NREGS];
+static uint32_t bp[DBG_NBP], wp[DBG_NWP] = {~0u, ~0u};
+static uint8_t mem[MEM_NBYTES];
+static int started_p;
+
+static void pi_send(unsigned op, const void *data, unsigned n) {
+  static uint8_t buf[sizeof(dbg_hdr_t) + 8 + DBG_TRACE_BUF + DBG_MEM_MAX];
+  dbg_hdr_t h = {.op = op, .nbytes = n};
+  memcpy(buf, &h, sizeof h);
+  memcpy(buf + sizeof h, data, n);
+  if (!pi_frame_write(&pf, buf, sizeof h + n))
+    panic("fake pi: write failed\n");
+}
+
+static uint32_t delta(uint32_t *out, unsigned *n) {
+  uint32_t mask = 0;
+  for (unsigned i = 0; i < DBG_NREGS; i++) {
+    if (started_p && regs[i] == last[i])
+      continue;
+    mask |= 1 << i;
+    out[(*n)++] = last[i] = regs[i];
+  }
+  return mask;
+}
+
+static void send_points(void) {
+  uint32_t p[DBG_NBP + DBG_NWP];
+  memcpy(p, bp, sizeof bp);
+  memcpy(p + DBG_NBP, wp, sizeof wp);
+  pi_send(DBG_POINTS, p, sizeof p);
+}
+
+static int is_bp(uint32_t pc) {
+  for (unsigned i = 0; i < DBG_NBP; i++)
+    if (bp[i] == pc)
+      return 1;
+  return 0;
+}
+
+static void exec1(void) {
+  regs[15] += 4;
+  regs[0]++;
+  if (regs[15] % 32 == 0)
+    regs[1]++;
+}
+
+static void child(int fd) {
+  pi_frame_init(&pf, fd, FRAME_DEFAULT_BAUD, 0);
+  regs[15] = START_PC;
+  regs[16] = 0x10;
+
+  unsigned reason = DBG_STOP_START, nsteps = 0;
+  while (1) {
+    uint32_t s[4 + DBG_NREGS];
+    unsigned n = 4;
+    s[0] = reason;
+    s[1] = 0;
+    s[2] = nsteps;
+    if (!started_p)
+      send_points();
+    s[3] = delta(s, &n);
+    started_p = 1;
+    pi_send(DBG_STOP, s, n * 4);
+
+    // take commands until we resume.
+    unsigned op = 0;
+    uint32_t arg = 0;
+    while (!op) {
+      static uint32_t buf[(12 + DBG_MEM_MAX) / 4];
+      dbg_hdr_t h;
+      pi_frame_read(&pf, &h, sizeof h);
+      assert(h.nbytes <= sizeof buf);
+      pi_frame_read(&pf, buf, h.nbytes);
+
+      switch (h.op) {
+      case DBG_STEP:
+      case DBG_TRACE:
+      case DBG_UNTIL:
+        arg = buf[0];
+      case DBG_CONTINUE:
+        op = h.op;
+        break;
+      case DBG_BP_SET:
+        for (unsigned i = 0; i < DBG_NBP; i++)
+          if (!bp[i]) {
+            bp[i] = buf[0];
+            break;
+          }
+        send_points();
+        break;
+      case DBG_BP_CLR:
+        for (unsigned i = 0; i < DBG_NBP; i++)
+          if (bp[i] == buf[0])
+            bp[i] = 0;
+        send_points();
+        break;
+      case DBG_REG_WRITE:
+        regs[buf[0]] = buf[1];
+        pi_send(DBG_OK, 0, 0);
+        break;
+      case DBG_MEM_READ: {
+        uint32_t off = buf[0] - MEM_ADDR, nb = buf[1];
+        uint8_t r[12 + DBG_MEM_MAX];
+        uint32_t hdr[3] = {buf[0], nb, our_crc32(&mem[off], nb)};
+        memcpy(r, hdr, 12);
+        memcpy(r + 12, &mem[off], nb);
+        pi_send(DBG_MEM, r, 12 + nb);
+        break;
+      }
+      case DBG_MEM_WRITE: {
+        uint32_t off = buf[0] - MEM_ADDR, nb = buf[1];
+        if (our_crc32(&buf[3], nb) != buf[2]) {
+          uint32_t e = DBG_E_BAD_CRC;
+          pi_send(DBG_ERR, &e, 4);
+          break;
+        }
+        memcpy(&mem[off], &buf[3], nb);
+        pi_send(DBG_OK, 0, 0);
+        break;
+      }
+      default:
+        panic("fake pi: bad op %x\n", h.op);
+      }
+    }
+    if (op == DBG_CONTINUE && !bp[0])
+      exit(0); // no breakpoint: "runs to completion".
+
+    // run.  traced entries are batched like the real one.
+    static struct {
+      uint32_t nent, nbytes;
+      uint8_t data[DBG_TRACE_BUF];
+    } tr;
+    for (nsteps = 1;; nsteps++) {
+      exec1();
+      reason = 0;
+      if (is_bp(regs[15]))
+        reason = DBG_STOP_BP;
+      else if (op == DBG_UNTIL && regs[15] == arg)
+        reason = DBG_STOP_UNTIL;
+      else if ((op == DBG_STEP || op == DBG_TRACE) && nsteps == arg)
+        reason = DBG_STOP_STEP;
+      if (reason)
+        break;
+      if (op == DBG_TRACE) {
+        if (tr.nbytes + DBG_TRACE_ENT_MAX > DBG_TRACE_BUF) {
+          pi_send(DBG_TRACE_ENTS, &tr, 8 + tr.nbytes);
+          tr.nent = tr.nbytes = 0;
+        }
+        tr.nbytes += dbg_trace_enc(&tr.data[tr.nbytes], last, regs);
+        tr.nent++;
+      }
+    }
+    if (tr.nent)
+      pi_send(DBG_TRACE_ENTS, &tr, 8 + tr.nbytes);
+    tr.nent = tr.nbytes = 0;
+  }
+}
+
+/*************************************************************
+ * unix side.
+ */
+static unsigned ntraced;
+static uint32_t traced_pc;
+
+static void on_trace(void *arg, const uint32_t *r) {
+  // every traced instruction should be the one after the last.
+  if (r[15] != traced_pc + 4)
+    panic("trace: pc=%x after %x\n", r[15], traced_pc);
+  if (r[0] != (r[15] - START_PC) / 4)
+    panic("trace: r0=%u at pc=%x\n", r[0], r[15]);
+  traced_pc = r[15];
+  ntraced++;
+}
+
+static void wait_stop(pi_dbg_t *d, unsigned reason, uint32_t pc) {
+  if (!pi_dbg_wait(d, 5 * 1000 * 1000, on_trace, 0))
+    panic("pi never stopped\n");
+  if (d->stop.reason != reason || d->regs[15] != pc)
+    panic("expected stop %u at %x, have %u at %x\n", reason, pc,
+          d->stop.reason, d->regs[15]);
+  if (d->regs[0] != (pc - START_PC) / 4)
+    panic("r0=%u at pc=%x\n", d->regs[0], pc);
+}
+
+int main(void) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0)
+    sys_die(posix_openpt, "can't open pty");
+  if (grantpt(master) < 0 || unlockpt(master) < 0)
+    sys_die(grantpt, "can't setup pty");
+  int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  if (slave < 0)
+    sys_die(open, "can't open pty slave");
+  set_tty_to_8n1(slave, FRAME_DEFAULT_BAUD, 1);
+
+  int pid = fork();
+  if (pid < 0)
+    sys_die(fork, "fork failed");
+  if (!pid) {
+    close(master);
+    child(slave);
+  }
+  close(slave);
+
+  pi_frame_t f;
+  pi_frame_init(&f, master, FRAME_DEFAULT_BAUD, stdout);
+  pi_dbg_t d;
+  pi_dbg_init(&d, &f);
+  pi_trace_t hist;
+  pi_trace_init(&hist);
+  d.hist = &hist;
+
+  wait_stop(&d, DBG_STOP_START, START_PC);
+  if (d.stop.mask != (1 << DBG_NREGS) - 1)
+    panic("first stop should carry every register: mask=%x\n", d.stop.mask);
+
+  // one step: only pc and r0 change.
+  pi_dbg_step(&d, 1);
+  wait_stop(&d, DBG_STOP_STEP, START_PC + 4);
+  if (d.stop.mask != (1 << 15 | 1 << 0))
+    panic("step delta should be pc+r0: mask=%x\n", d.stop.mask);
+
+  // many steps on the pi side: one round trip.
+  pi_dbg_step(&d, 1000);
+  wait_stop(&d, DBG_STOP_STEP, START_PC + 4 * 1001);
+  if (d.stop.nsteps != 1000 || d.regs[0] != 1001)
+    panic("step 1000: nsteps=%u r0=%u\n", d.stop.nsteps, d.regs[0]);
+
+  // trace: every instruction but the last comes back as a delta.
+  traced_pc = d.regs[15];
+  time_usec_t s = time_get_usec();
+  pi_dbg_trace(&d, 5000);
+  wait_stop(&d, DBG_STOP_STEP, START_PC + 4 * 6001);
+  if (ntraced != 4999)
+    panic("traced %u instructions, expected 4999\n", ntraced);
+  trace("traced %u instructions in %dusec\n", ntraced + 1,
+        time_get_usec() - s);
+
+  // the history has all of them: step back without asking the pi.
+  uint32_t past[DBG_NREGS];
+  unsigned last_i = hist.n - 1;
+  if (!pi_trace_get(&hist, last_i - 100, past) ||
+      past[15] != d.regs[15] - 400 || past[0] != d.regs[0] - 100)
+    panic("history: 100 back has pc=%x r0=%u\n", past[15], past[0]);
+  if (pi_trace_find_pc(&hist, last_i, d.regs[15] - 4000) != last_i - 1000)
+    panic("history: can't find pc %x\n", d.regs[15] - 4000);
+  trace("trace used %u bytes for %u entries\n", hist.nbytes, hist.n);
+
+  // run until, then a breakpoint before it.
+  uint32_t pc = d.regs[15];
+  pi_dbg_until(&d, pc + 400);
+  wait_stop(&d, DBG_STOP_UNTIL, pc + 400);
+  pi_dbg_bp_set(&d, pc + 800);
+  if (d.bp[0] != pc + 800)
+    panic("bp not set: bp[0]=%x\n", d.bp[0]);
+  pi_dbg_until(&d, pc + 1200);
+  wait_stop(&d, DBG_STOP_BP, pc + 800);
+  pi_dbg_bp_clr(&d, pc + 800);
+  if (d.bp[0])
+    panic("bp not cleared\n");
+
+  // register write shows up in our copy.
+  if (!pi_dbg_reg_write(&d, 5, 0xdeadbeef) || d.regs[5] != 0xdeadbeef)
+    panic("reg write failed\n");
+
+  // bulk memory: bigger than one message.
+  static uint8_t out[MEM_NBYTES], in[MEM_NBYTES];
+  for (unsigned i = 0; i < sizeof out; i++)
+    out[i] = random();
+  s = time_get_usec();
+  if (!pi_dbg_mem_write(&d, MEM_ADDR, out, sizeof out))
+    panic("mem write failed: err=%u\n", d.err);
+  if (!pi_dbg_mem_read(&d, MEM_ADDR, in, sizeof in))
+    panic("mem read failed: err=%u\n", d.err);
+  if (memcmp(in, out, sizeof in) != 0)
+    panic("mem read back differs\n");
+  trace("wrote and read back %u bytes in %dusec\n", (unsigned)sizeof in,
+        time_get_usec() - s);
+
+  pi_dbg_continue(&d);
+  int status;
+  if (!child_clean_exit(pid, &status) || status)
+    panic("child crashed: status=%d\n", status);
+  printf("SUCCESS: debugger protocol loopback\n");
+  return 0;
+}
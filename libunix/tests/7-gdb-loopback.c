@@ -0,0 +1,262 @@
+// loopback test for the gdb bridge (<pi-gdb.h>): one child plays the
+// pi running a cut down gdb stub over a fake cpu (each "instruction"
+// bumps the pc and r0), another plays gdb on the bridge's pty, and we
+// run the bridge between them.  checks the ack layer, registers, bulk
+// memory, breakpoints, stepping and the exit.  linux only
+// (posix_openpt).
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include "libunix.h"
+#include "pi-gdb.h"
+
+enum { START_PC = 0x8000, MEM_ADDR = 0x100000, MEM_NBYTES = 64 * 1024 };
+enum { EXIT_PC = START_PC + 4 * 1000 };
+
+/*************************************************************
+ * the fake pi.
+ */
+static pi_frame_t pf;
+static uint32_t regs[DBG_NREGS], bp;
+static uint8_t mem[MEM_NBYTES];
+
+static void pi_send(const char *s) {
+  uint8_t buf[sizeof(dbg_hdr_t) + DBG_GDB_MAX];
+  dbg_hdr_t h = {.op = DBG_GDB, .nbytes = strlen(s)};
+  memcpy(buf, &h, sizeof h);
+  memcpy(buf + sizeof h, s, h.nbytes);
+  if (!pi_frame_write(&pf, buf, sizeof h + h.nbytes))
+    panic("fake pi: write failed\n");
+}
+
+static char *hex(char *out, const void *data, unsigned n) {
+  const uint8_t *p = data;
+  for (unsigned i = 0; i < n; i++)
+    out += sprintf(out, "%02x", p[i]);
+  return out;
+}
+
+static void unhex(void *data, const char *s, unsigned n) {
+  uint8_t *p = data;
+  for (unsigned i = 0; i < n; i++) {
+    unsigned x;
+    sscanf(s + 2 * i, "%2x", &x);
+    p[i] = x;
+  }
+}
+
+static void child_pi(int fd) {
+  pi_frame_init(&pf, fd, FRAME_DEFAULT_BAUD, 0);
+  regs[15] = START_PC;
+  regs[16] = 0x10;
+
+  pi_send("S05");
+  while (1) {
+    static char in[DBG_GDB_MAX + 1], out[DBG_GDB_MAX + 1];
+    dbg_hdr_t h;
+    pi_frame_read(&pf, &h, sizeof h);
+    assert(h.op == DBG_GDB && h.nbytes <= DBG_GDB_MAX);
+    pi_frame_read(&pf, in, h.nbytes);
+    in[h.nbytes] = 0;
+
+    unsigned a, n, step_p = 0;
+    *out = 0;
+    switch (in[0]) {
+    case '?':
+      strcpy(out, "S05");
+      break;
+    case 'g':
+      hex(out, regs, sizeof regs);
+      break;
+    case 'p':
+      sscanf(in + 1, "%x", &n);
+      hex(out, &regs[n], 4);
+      break;
+    case 'm':
+      sscanf(in + 1, "%x,%x", &a, &n);
+      hex(out, mem + a - MEM_ADDR, n);
+      break;
+    case 'M':
+      sscanf(in + 1, "%x,%x", &a, &n);
+      unhex(mem + a - MEM_ADDR, strchr(in, ':') + 1, n);
+      strcpy(out, "OK");
+      break;
+    case 'Z':
+    case 'z':
+      sscanf(in + 1, "0,%x", &a);
+      bp = in[0] == 'Z' ? a : 0;
+      strcpy(out, "OK");
+      break;
+    case 'q':
+      if (prefix_cmp(in, "qSupported"))
+        sprintf(out, "PacketSize=%x;QStartNoAckMode+", DBG_GDB_MAX);
+      break;
+    case 's':
+      step_p = 1;
+    case 'c':
+      // run.
+      do {
+        regs[15] += 4;
+        regs[0]++;
+      } while (!step_p && regs[15] != bp && regs[15] != EXIT_PC);
+      if (regs[15] == EXIT_PC) {
+        pi_send("W00");
+        // what clean_reboot prints.  a real pi's tty stays around
+        // after it reboots: hold ours open until the bridge has seen it.
+        write_exact(fd, "DONE!!!\n", 8);
+        usleep(200 * 1000);
+        exit(0);
+      }
+      strcpy(out, "S05");
+      break;
+    }
+    pi_send(out);
+  }
+}
+
+/*************************************************************
+ * the fake gdb.
+ */
+static int gdb_fd;
+
+static char *call(const char *pkt) {
+  static char reply[DBG_GDB_MAX + 1];
+  pi_gdb_pkt_write(gdb_fd, pkt);
+  if (pi_gdb_pkt_read(gdb_fd, reply, sizeof reply, 0) < 0)
+    panic("bridge closed on <%s>\n", pkt);
+  return reply;
+}
+
+static void expect(const char *pkt, const char *want) {
+  char *got = call(pkt);
+  if (strcmp(got, want) != 0)
+    panic("<%s>: expected <%s>, got <%s>\n", pkt, want, got);
+}
+
+static uint32_t get_pc(void) {
+  uint32_t pc;
+  unhex(&pc, call("pf"), 4);
+  return pc;
+}
+
+static void child_gdb(const char *name) {
+  gdb_fd = open(name, O_RDWR | O_NOCTTY);
+  if (gdb_fd < 0)
+    sys_die(open, "can't open bridge pty");
+  set_tty_to_8n1(gdb_fd, FRAME_DEFAULT_BAUD, 1);
+
+  // with acks: a good packet gets '+', a corrupted one '-'.
+  write_exact(gdb_fd, "$?#00", 5);
+  char c;
+  read_exact(gdb_fd, &c, 1);
+  if (c != '-')
+    panic("bad checksum should get '-', got '%c'\n", c);
+  pi_gdb_pkt_write(gdb_fd, "qSupported:swbreak+");
+  read_exact(gdb_fd, &c, 1);
+  if (c != '+')
+    panic("good packet should get '+', got '%c'\n", c);
+  char reply[256];
+  pi_gdb_pkt_read(gdb_fd, reply, sizeof reply, 1);
+  if (!prefix_cmp(reply, "PacketSize="))
+    panic("qSupported: got <%s>\n", reply);
+
+  // the rest without.
+  pi_gdb_pkt_write(gdb_fd, "QStartNoAckMode");
+  read_exact(gdb_fd, &c, 1);
+  pi_gdb_pkt_read(gdb_fd, reply, sizeof reply, 0);
+  if (c != '+' || strcmp(reply, "OK") != 0)
+    panic("QStartNoAckMode: got '%c' <%s>\n", c, reply);
+  expect("?", "S05");
+
+  // all registers: pc is 15, cpsr is last.
+  char *g = call("g");
+  if (strlen(g) != DBG_NREGS * 8)
+    panic("g: %u hex digits\n", (unsigned)strlen(g));
+  if (get_pc() != START_PC)
+    panic("pc=%x\n", get_pc());
+
+  // bulk memory in PacketSize pieces, as gdb would.
+  static uint8_t out[MEM_NBYTES], in[MEM_NBYTES];
+  for (unsigned i = 0; i < sizeof out; i++)
+    out[i] = random();
+  enum { CHUNK = (DBG_GDB_MAX - 32) / 2 };
+  static char pkt[DBG_GDB_MAX + 1];
+  time_usec_t s = time_get_usec();
+  for (unsigned off = 0; off < sizeof out; off += CHUNK) {
+    unsigned n = sizeof out - off < CHUNK ? sizeof out - off : CHUNK;
+    int k = sprintf(pkt, "M%x,%x:", MEM_ADDR + off, n);
+    hex(pkt + k, out + off, n);
+    expect(pkt, "OK");
+  }
+  for (unsigned off = 0; off < sizeof in; off += CHUNK) {
+    unsigned n = sizeof in - off < CHUNK ? sizeof in - off : CHUNK;
+    sprintf(pkt, "m%x,%x", MEM_ADDR + off, n);
+    unhex(in + off, call(pkt), n);
+  }
+  if (memcmp(in, out, sizeof in) != 0)
+    panic("memory read back differs\n");
+  trace("wrote and read back %u bytes in %dusec\n", (unsigned)sizeof in,
+        time_get_usec() - s);
+
+  // breakpoint, then a step off it.
+  sprintf(pkt, "Z0,%x,4", START_PC + 40);
+  expect(pkt, "OK");
+  expect("c", "S05");
+  if (get_pc() != START_PC + 40)
+    panic("breakpoint: pc=%x\n", get_pc());
+  sprintf(pkt, "z0,%x,4", START_PC + 40);
+  expect(pkt, "OK");
+  expect("s", "S05");
+  if (get_pc() != START_PC + 44)
+    panic("step: pc=%x\n", get_pc());
+
+  // run off the end.
+  expect("c", "W00");
+  exit(0);
+}
+
+int main(void) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0)
+    sys_die(posix_openpt, "can't open pty");
+  if (grantpt(master) < 0 || unlockpt(master) < 0)
+    sys_die(grantpt, "can't setup pty");
+  int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  if (slave < 0)
+    sys_die(open, "can't open pty slave");
+  set_tty_to_8n1(slave, FRAME_DEFAULT_BAUD, 1);
+
+  int pi_pid = fork();
+  if (pi_pid < 0)
+    sys_die(fork, "fork failed");
+  if (!pi_pid) {
+    close(master);
+    child_pi(slave);
+  }
+  close(slave);
+
+  char *name;
+  int gdb_master = pi_gdb_pty(&name);
+  int gdb_pid = fork();
+  if (gdb_pid < 0)
+    sys_die(fork, "fork failed");
+  if (!gdb_pid)
+    child_gdb(name);
+
+  pi_frame_t f;
+  pi_frame_init(&f, master, FRAME_DEFAULT_BAUD, stdout);
+  if (!pi_gdb_bridge(&f, gdb_master, 0))
+    panic("bridge should have seen the pi exit\n");
+
+  int status;
+  if (!child_clean_exit(gdb_pid, &status) || status)
+    panic("gdb child failed: status=%d\n", status);
+  if (!child_clean_exit(pi_pid, &status) || status)
+    panic("pi child failed: status=%d\n", status);
+  printf("SUCCESS: gdb bridge loopback\n");
+  return 0;
+}
@@ -0,0 +1,136 @@
+// compressed instruction trace (<dbg-trace.h>) and the history built
+// from it (<pi-trace.h>): encode a made up but program-shaped run
+// (straight line code, loops, calls, flag setting compares, the odd
+// big constant), ship it in DBG_TRACE_BUF sized pieces like the pi
+// does, then check every state can be replayed and the reverse
+// searches agree with a brute force scan.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libunix.h"
+#include "pi-trace.h"
+
+enum { N = 200 * 1000 };
+
+static uint32_t truth[N][DBG_NREGS];
+
+// next instruction's registers from <r>.
+static void step(uint32_t *r, unsigned i) {
+  unsigned x = random();
+  uint32_t pc = r[15];
+
+  switch (x % 16) {
+  case 0: // call far away.
+    r[14] = pc + 4;
+    r[15] = 0x8000 + (random() % 0x10000) * 4;
+    r[13] -= 8;
+    return;
+  case 1: // loop back.
+    r[15] = pc - 4 * (x / 16 % 32);
+    return;
+  case 2: // compare: flags.
+    r[16] ^= (x / 16 % 16) << 28;
+    break;
+  case 3: // load a big value.
+    r[x / 16 % 13] = random();
+    break;
+  default: // add/sub small.
+    r[x / 16 % 13] += (int)(x / 256 % 64) - 32;
+    break;
+  }
+  r[15] = pc + 4;
+}
+
+int main(void) {
+  uint32_t r[DBG_NREGS] = {0};
+  r[13] = 0x8000000;
+  r[15] = 0x8000;
+  r[16] = 0x60000010;
+  for (unsigned i = 0; i < N; i++) {
+    step(r, i);
+    memcpy(truth[i], r, sizeof r);
+  }
+
+  // the first entry is a stop (everything new), the rest are shipped
+  // the way debugger.h does.
+  pi_trace_t t;
+  pi_trace_init(&t);
+  pi_trace_add(&t, truth[0]);
+
+  static uint8_t buf[DBG_TRACE_BUF];
+  uint32_t last[DBG_NREGS];
+  memcpy(last, truth[0], sizeof last);
+  unsigned nbytes = 0, nent = 0, old_bytes = 0;
+  for (unsigned i = 1; i < N; i++) {
+    if (nbytes + DBG_TRACE_ENT_MAX > sizeof buf) {
+      pi_trace_append(&t, buf, nbytes, nent);
+      nbytes = nent = 0;
+    }
+    // what the uncompressed format (mask + changed registers) took.
+    old_bytes += 4;
+    for (unsigned j = 0; j < DBG_NREGS; j++)
+      old_bytes += truth[i][j] != truth[i - 1][j] ? 4 : 0;
+
+    nbytes += dbg_trace_enc(&buf[nbytes], last, truth[i]);
+    nent++;
+  }
+  pi_trace_append(&t, buf, nbytes, nent);
+  if (t.n != N)
+    panic("history has %u entries, expected %u\n", t.n, N);
+  if (memcmp(t.regs, truth[N - 1], sizeof t.regs) != 0)
+    panic("final state differs\n");
+  trace("%u entries: %u bytes (%.2f/entry), uncompressed %u (%.1fx)\n", N,
+        t.nbytes, (double)t.nbytes / N, old_bytes,
+        (double)old_bytes / t.nbytes);
+
+  // every state, by replay.
+  time_usec_t s = time_get_usec();
+  for (unsigned i = 0; i < N; i++) {
+    uint32_t got[DBG_NREGS];
+    if (!pi_trace_get(&t, i, got))
+      panic("no entry %u\n", i);
+    if (memcmp(got, truth[i], sizeof got) != 0)
+      panic("entry %u differs: pc=%x, expected %x\n", i, got[15],
+            truth[i][15]);
+  }
+  trace("replayed all %u states in %dusec\n", N, time_get_usec() - s);
+  uint32_t junk[DBG_NREGS];
+  if (pi_trace_get(&t, N, junk))
+    panic("got an entry past the end\n");
+
+  // reverse searches against brute force.
+  for (unsigned k = 0; k < 200; k++) {
+    unsigned from = random() % (N + 1);
+    uint32_t pc = truth[random() % N][15];
+    unsigned reg = random() % DBG_NREGS;
+
+    int want = -1;
+    for (int i = (int)from - 1; i >= 0; i--)
+      if (truth[i][15] == pc) {
+        want = i;
+        break;
+      }
+    int got = pi_trace_find_pc(&t, from, pc);
+    if (got != want)
+      panic("find_pc(%u, %x): got %d, expected %d\n", from, pc, got, want);
+
+    want = -1;
+    for (int i = (int)from - 1; i >= 1; i--)
+      if (truth[i][reg] != truth[i - 1][reg]) {
+        want = i;
+        break;
+      }
+    // entry 0 "changes" whatever isn't zero.
+    if (want < 0 && from && truth[0][reg])
+      want = 0;
+    got = pi_trace_find_write(&t, from, reg);
+    if (got != want)
+      panic("find_write(%u, r%u): got %d, expected %d\n", from, reg, got,
+            want);
+  }
+
+  pi_trace_free(&t);
+  printf("SUCCESS: trace replay\n");
+  return 0;
+}
@@ -0,0 +1,134 @@
+// break and watchpoint conditions: compile expressions with
+// <pi-cond.h>, run them with the pi's evaluator (<dbg-cond.h>) over
+// random registers and memory, and check against the same expression
+// compiled by the C compiler.  then the errors.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libunix.h"
+#include "pi-cond.h"
+
+// the expressions below lean on C precedence on purpose.
+#pragma GCC diagnostic ignored "-Wparentheses"
+
+enum { MEM_ADDR = 0x8000, MEM_WORDS = 16 };
+static uint32_t mem[MEM_WORDS];
+
+static uint32_t load(uint32_t addr, int *ok) {
+  if (addr % 4 || addr < MEM_ADDR || addr >= MEM_ADDR + 4 * MEM_WORDS) {
+    *ok = 0;
+    return 0;
+  }
+  return mem[(addr - MEM_ADDR) / 4];
+}
+
+#define M(a) load(a, &ok)
+
+static uint32_t *R, hits;
+static int ok;
+
+#define r0 R[0]
+#define r1 R[1]
+#define r2 R[2]
+#define r7 R[7]
+#define sp R[13]
+#define lr R[14]
+#define pc R[15]
+#define cpsr R[16]
+
+// each expression twice: as a string for us and as C for gcc.  loads
+// are spelled M(x) for C, *(x) for us.  pi && and || don't short
+// circuit, so no loads under them.
+#define EXPRS(X)                                                               \
+  X(0, r0 == r1)                                                               \
+  X(1, r0 < r1 && r1 <= r2 || r7 == 3)                                         \
+  X(2, (r0 & 0xff) == (r1 & 0xff))                                             \
+  X(3, r0 + r1 * 3 - r2 > r7)                                                  \
+  X(4, r0 << (r1 & 31) >> 3 != r2)                                             \
+  X(5, !(r0 ^ r1) | ~r2 == 0)                                                  \
+  X(6, -r0 >= r1 || !r2)                                                       \
+  X(7, (cpsr >> 28) == 4)                                                      \
+  X(8, r0 + 1 == r1 + 2 - 1)                                                   \
+  X(9, (hits & 3) == 0 && pc > 0x8000)                                         \
+  X(10, sp - lr == 0x100 || lr & 1)                                            \
+  X(11, r0 > 5 == r1 > 5)                                                      \
+  X(12, r0 | r1 ^ r2 & r7)                                                     \
+  X(13, M(0x8000 + (r0 & 0x3c)) == r1)                                         \
+  X(14, M(M(0x8008)) != r0 + 0x8000)
+
+#define STR(i, e) #e,
+#define CASE(i, e)                                                             \
+  case i:                                                                      \
+    return !!(e);
+
+static const char *exprs[] = {EXPRS(STR)};
+
+static int c_eval(unsigned i) {
+  switch (i) { EXPRS(CASE) }
+  panic("no expression %u\n", i);
+}
+
+static void check(unsigned i, const uint8_t *code, unsigned n,
+                  uint32_t *regs) {
+  R = regs;
+  ok = 1;
+  int want = c_eval(i);
+  if (!ok)
+    want = -1;
+  int got = dbg_cond_eval(code, n, regs, hits, load);
+  if (got != want)
+    panic("<%s>: got %d, expected %d\n", exprs[i], got, want);
+}
+
+int main(void) {
+  uint8_t code[DBG_COND_MAX];
+  char err[128];
+
+  for (unsigned i = 0; i < sizeof exprs / sizeof exprs[0]; i++) {
+    char s[128], *p;
+    strcpy(s, exprs[i]);
+    while ((p = strstr(s, "M(")))
+      *p = '*';
+    int n = pi_cond_compile(code, s, err, sizeof err);
+    if (n < 0)
+      panic("<%s>: %s\n", s, err);
+
+    for (unsigned k = 0; k < 10000; k++) {
+      uint32_t regs[DBG_NREGS];
+      // small values too, so the compares go both ways.
+      for (unsigned r = 0; r < DBG_NREGS; r++)
+        regs[r] = random() % 2 ? random() % 8 : random() * 2654435761u;
+      // some pointers into <mem>, some not.
+      for (unsigned j = 0; j < MEM_WORDS; j++)
+        mem[j] = random() % 2 ? random() % 8 : MEM_ADDR + 4 * (random() % 20);
+      hits = k;
+      check(i, code, n, regs);
+    }
+    trace("%-40s %d bytes\n", s, n);
+  }
+
+  // errors.
+  static const char *bad[] = {
+      "r0 ==",       "r16 == 1",  "(r0",      "r0 ) ",       "foo > 1",
+      "r0 == 1 1",   "",          "r0 % 2",
+      "((((((((r0+r1)+r1)+r1)+r1)+r1)+r1)+r1)+(r1+(r1+(r1+(r1+(r1+(r1+(r1+(r1+r1))))))))",
+      "1+2+3+4+5+6+7+8+9+10+11+12+13",
+  };
+  for (unsigned i = 0; i < sizeof bad / sizeof bad[0]; i++) {
+    if (pi_cond_compile(code, bad[i], err, sizeof err) >= 0)
+      panic("<%s> should not compile\n", bad[i]);
+    trace("<%s>: %s\n", bad[i], err);
+  }
+
+  // truncated or unbalanced code stops rather than passing.
+  int n = pi_cond_compile(code, "r0 == 0x12345678", err, sizeof err);
+  uint32_t regs[DBG_NREGS] = {0};
+  for (int i = 0; i < n; i++)
+    // (the first two bytes are a whole program: "r0".)
+    if (i != 2 && dbg_cond_eval(code, i, regs, 0, load) != -1)
+      panic("%d bytes of %d: expected -1\n", i, n);
+
+  printf("SUCCESS: conditions\n");
+  return 0;
+}
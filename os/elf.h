@@ -0,0 +1,78 @@
+#ifndef __EQX_ELF_H__
+#define __EQX_ELF_H__
+// the parts of 32-bit arm elf that <eqx_exec_elf> needs: the file
+// header and the program (segment) headers.  section headers,
+// symbols and relocations are ignored.
+
+typedef struct {
+    uint8_t  ident[16];     // "\177ELF", class, data, version, ...
+    uint16_t type;          // ET_EXEC
+    uint16_t machine;       // EM_ARM
+    uint32_t version;
+    uint32_t entry;         // va of the first instruction.
+    uint32_t phoff;         // file offset of the program headers.
+    uint32_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;     // size of one program header.
+    uint16_t phnum;         // how many.
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} elf32_ehdr_t;
+
+typedef struct {
+    uint32_t type;          // only PT_LOAD is loaded.
+    uint32_t offset;        // where the bytes are in the file.
+    uint32_t vaddr;         // where they go.
+    uint32_t paddr;         // load address: ignored.
+    uint32_t filesz;        // bytes in the file ...
+    uint32_t memsz;         // ... and in memory: the rest is zeroed (bss).
+    uint32_t flags;         // PF_X | PF_W | PF_R
+    uint32_t align;
+} elf32_phdr_t;
+
+enum {
+    ELF_CLASS32 = 1,
+    ELF_DATA_LSB = 2,
+    ET_EXEC = 2,
+    EM_ARM = 40,
+    PT_LOAD = 1,
+    PF_X = 1,
+    PF_W = 2,
+    PF_R = 4,
+};
+
+// sanity check the header of the <nbytes> elf file at <image>.
+static inline elf32_ehdr_t
+elf_hdr_mk(const char *name, const void *image, uint32_t nbytes) {
+    if(nbytes < sizeof(elf32_ehdr_t))
+        panic("<%s>: %d bytes is too small for an elf header\n", name, nbytes);
+    elf32_ehdr_t h = *(elf32_ehdr_t *)image;
+
+    const uint8_t *id = h.ident;
+    if(id[0] != 0x7f || id[1] != 'E' || id[2] != 'L' || id[3] != 'F')
+        panic("<%s>: not an elf file\n", name);
+    if(id[4] != ELF_CLASS32 || id[5] != ELF_DATA_LSB)
+        panic("<%s>: not 32-bit little endian\n", name);
+    if(h.machine != EM_ARM)
+        panic("<%s>: machine=%d, expected arm\n", name, h.machine);
+    // we don't relocate: the program has to be linked at the
+    // addresses it runs at (e.g., with user-progs/small-proc.ld).
+    if(h.type != ET_EXEC)
+        panic("<%s>: type=%d: only static executables are supported\n",
+            name, h.type);
+    if(h.phentsize != sizeof(elf32_phdr_t))
+        panic("<%s>: program header size=%d, expected %d\n",
+            name, h.phentsize, sizeof(elf32_phdr_t));
+    if(h.phoff + h.phnum * sizeof(elf32_phdr_t) > nbytes)
+        panic("<%s>: program headers past end of file\n", name);
+    return h;
+}
+
+static inline const elf32_phdr_t *
+elf_phdrs(const void *image, elf32_ehdr_t h) {
+    return (const void *)((const char *)image + h.phoff);
+}
+
+#endif
@@ -2,9 +2,12 @@
 #define __EQX_INTERNAL_H__
 
 #include "eqx-threads.h"
+#include "ktrace.h"
 
+// silent while the <ktrace> ring is recording: the ring logs the same
+// events without the printk cost.
 #define eqx_trace(args...) do {                                 \
-    if(eqx_verbose_p) {                                         \
+    if(eqx_verbose_p && !ktrace_on_p) {                         \
         printk("TRACE:%s:", __FUNCTION__); printk(args);    \
     }                                                       \
 } while(0)
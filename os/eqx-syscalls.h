@@ -8,6 +8,7 @@
 #define EQX_SYS_FORK 2
 #define EQX_SYS_EXEC 3
 #define EQX_SYS_WAITPID 4
+// r1 = signed increment: returns the old break or -1.
 #define EQX_SYS_SBRK 5
 
 #define EQX_SYS_OPEN 6
@@ -20,6 +21,56 @@
 
 #define EQX_SYS_GET_PID 15
 
+// blocking primitives (see os.c).  _NEW returns a small integer id,
+// or -1 if the table is full; the rest take it in r1 and return 0,
+// or -1 for a bad id (or not owning the mutex).  fork shares them.
+#define EQX_SYS_MUTEX_NEW 20
+#define EQX_SYS_MUTEX_LOCK 21
+#define EQX_SYS_MUTEX_UNLOCK 22
+// r1 = cond, r2 = mutex (held).
+#define EQX_SYS_COND_NEW 23
+#define EQX_SYS_COND_WAIT 24
+#define EQX_SYS_COND_SIGNAL 25
+#define EQX_SYS_COND_BROADCAST 26
+// r1 = initial count.
+#define EQX_SYS_SEM_NEW 27
+#define EQX_SYS_SEM_WAIT 28
+#define EQX_SYS_SEM_POST 29
+// r1 = priority: higher runs first, default 0.
+#define EQX_SYS_SET_PRIO 30
+
+// message passing (see os.c).  a message is four words in r2-r5.
+//   send: r1 = tid (| EQX_IPC_GRANT to hand over our window).  blocks
+//         until received.  0 or -1.
+//   post: r1 = tid.  doesn't block: -1 if their mailbox is full.
+//   recv: blocks for a message, returns the sender's tid (|
+//         EQX_IPC_GRANT if our window is now theirs).
+//   window: the va of our 1MB window, allocated on first use.
+#define EQX_SYS_IPC_SEND 31
+#define EQX_SYS_IPC_POST 32
+#define EQX_SYS_IPC_RECV 33
+#define EQX_SYS_IPC_WINDOW 34
+#define EQX_IPC_GRANT (1u << 31)
+
+// shared memory (see os.c): map r1 = name (a string, or 0 for a new
+// anonymous region that only forked children share).  returns the
+// va of the 1MB region or -1.  at most one at a time.
+#define EQX_SYS_SHM_MAP 35
+#define EQX_SYS_SHM_UNMAP 36
+
+// let another thread run.
+#define EQX_SYS_YIELD 37
+
+// many calls in one trap (see os.c).  only calls that neither block
+// nor switch threads can go in one; the rest complete with -1.
+//   ring_setup: r1 = our <eqx_ring_t>.  0 or -1.
+//   ring_enter: run what's been submitted.  returns how many.
+//   batch: r1 = array of <eqx_call_t>, r2 = count.  runs them in
+//          order, setting each <res>.  returns how many.
+#define EQX_SYS_RING_SETUP 38
+#define EQX_SYS_RING_ENTER 39
+#define EQX_SYS_BATCH 40
+
 // not Unix core syscalls.
 // #define EQX_SYS_PUTC            128
 #define EQX_SYS_GET_CPSR 129
@@ -29,7 +80,39 @@
 #define EQX_SYS_PUT_INT 131
 #define EQX_SYS_PUT_PID 132
 
+// read the calling thread's pmu counts (<perf.h>): r1 = pointer to
+// four words {nsched, cycles, event0, event1}.
+#define EQX_SYS_PERF_READ 133
+
+// microseconds since boot (the free running system timer).
+#define EQX_SYS_GET_USEC 134
+
 #define EQX_SYS_MAX 256
 
 #define WNOHANG (1 << 2)
+
+#ifndef __ASSEMBLER__
+typedef struct {
+  uint32_t sysno, a1, a2, a3;
+  int32_t res;
+} eqx_call_t;
+
+// submission and completion rings shared by a process and the
+// kernel.  the indices run free: the user bumps <sq_tail> and
+// <cq_head>, the kernel <sq_head> and <cq_tail>.
+#define EQX_RING_N 64
+typedef struct {
+  uint32_t sysno, a1, a2, a3;
+  uint32_t user_data; // handed back in the completion.
+} eqx_sqe_t;
+typedef struct {
+  uint32_t user_data;
+  int32_t res;
+} eqx_cqe_t;
+typedef struct {
+  volatile uint32_t sq_head, sq_tail, cq_head, cq_tail;
+  eqx_sqe_t sq[EQX_RING_N];
+  eqx_cqe_t cq[EQX_RING_N];
+} eqx_ring_t;
+#endif
 #endif
@@ -7,16 +7,24 @@
 #include "switchto.h" // needed for <regs_t>
 
 #include "vm/pinned-vm.h"
+#include "perf.h"
 typedef struct {
   uint32_t va, pa;
   pin_t attr;
 } map_t;
 
+// simple thread queue.
+//  - should make so you can delete from the middle.
+typedef struct rq {
+  struct eqx_th *head, *tail;
+} rq_t;
+
 typedef struct eqx_th {
   // thread's registers.
   regs_t regs;
 
   struct eqx_th *next;
+  struct eqx_th *all_next; // every live thread, for lookup by tid.
 
   // if non-zero: the hash we expect to get when
   // the thread exits
@@ -35,10 +43,41 @@ typedef struct eqx_th {
   uint32_t arg;
   uint32_t stack_start;
   uint32_t stack_end;
+  // non-null if the stack came from the pool (<eqx_fork_sized>).
+  struct eqx_stack *stack;
   uint32_t refork_cnt;
 
+  // scheduling priority (higher runs first): <prio> is <base_prio>
+  // raised by whatever waits on a mutex in <held>.
+  uint32_t prio, base_prio;
+  struct eqx_mutex *held;       // mutexes we own.
+  struct eqx_mutex *blocked_on; // waiting to lock this.
+  struct eqx_mutex *cv_mutex;   // relock on condition variable wakeup.
+
+  // message passing (see os.c): our 1MB window section (pa = 0 if
+  // none), senders blocked until we receive, and async messages.
+  map_t ipc_pin;
+  rq_t ipc_sendq;
+  struct eqx_mbox *mbox;
+  unsigned ipc_recv_p; // blocked in recv.
+
+  // a process's heap (<sys_sbrk>): [heap_start, brk), and everything
+  // below <brk_max> has been zeroed.  0 for threads.
+  uint32_t heap_start, brk, brk_max;
+
+  // user va of our submission/completion rings, or 0.
+  uint32_t ring;
+
+  // shared memory region we have mapped, if any.
+  struct eqx_shm *shm;
+  map_t shm_pin;
+
   // how many instructions we executed.
   uint32_t inst_cnt;
+
+  // pmu counts while this thread (and the kernel work it caused) ran:
+  // <n> is the number of times it was scheduled.  see <perf.h>.
+  perf_acc_t perf;
   unsigned verbose_p; // if you want alot of information.
 } eqx_th_t;
 
@@ -56,6 +95,10 @@ eqx_th_t *eqx_fork(void (*fn)(void *), void *arg);
 eqx_th_t *eqx_fork_nostack(void (*fn)(void *), void *arg);
 eqx_th_t *eqx_fork_stack(void (*fn)(void *), void *arg, void *stack,
                          uint32_t nbytes);
+// fork with a pooled, guarded stack of at least <nbytes>: rounded up
+// to 4k, 64k or 1mb.  with pinned vm an overflow faults on the spot
+// and kills the thread.  without vm it's a plain heap stack.
+eqx_th_t *eqx_fork_sized(void (*fn)(void *), void *arg, uint32_t nbytes);
 
 // 1 = chatty, 0 = quiet
 // note: should have more levels so can be precise about
@@ -63,6 +106,15 @@ eqx_th_t *eqx_fork_stack(void (*fn)(void *), void *arg, void *stack,
 extern int eqx_verbose_p;
 static inline void eqx_verbose(int v_p) { eqx_verbose_p = v_p; }
 
+// how many threads have exited with a non-zero code (a user <die>
+// exits with 1): lets a caller of <eqx_run_threads> check a test.
+extern unsigned eqx_nexit_fail;
+
+// 1 (default) = calls that can't block or switch threads take the
+// fast path; 0 = everything takes the full one (for comparison).
+extern int eqx_fast_syscall_p;
+static inline void eqx_fast_syscalls(int on_p) { eqx_fast_syscall_p = on_p; }
+
 // default stack size.
 enum { eqx_stack_size = 8192 * 8 };
 _Static_assert(eqx_stack_size > 1024, "too small");
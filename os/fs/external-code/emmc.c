@@ -775,18 +775,9 @@ int emmc_write(u32 sector, u8 *buffer, u32 size) {
 }
 
 bool emmc_init() {
-  gpio_set_function(34, GPIO_FUNC_INPUT);
-  gpio_set_function(35, GPIO_FUNC_INPUT);
-  gpio_set_function(36, GPIO_FUNC_INPUT);
-  gpio_set_function(37, GPIO_FUNC_INPUT);
-  gpio_set_function(38, GPIO_FUNC_INPUT);
-  gpio_set_function(39, GPIO_FUNC_INPUT);
-
-  gpio_set_function(48, GPIO_FUNC_ALT3);
-  gpio_set_function(49, GPIO_FUNC_ALT3);
-  gpio_set_function(50, GPIO_FUNC_ALT3);
-  gpio_set_function(51, GPIO_FUNC_ALT3);
-  gpio_set_function(52, GPIO_FUNC_ALT3);
+  // the sd pins (34..39 input, 48..52 alt3) are left as the firmware
+  // set them up for the card.  the per-pin <gpio_set_function> calls
+  // that were here never did anything: it ignores pins past 31.
 
   device.transfer_blocks = 0;
   device.last_command_value = 0;
@@ -88,8 +88,8 @@ static uint32_t cluster_to_lba(fat32_fs_t *f, uint32_t cluster_num) {
   // sectors_per_cluster
   unsigned lba =
       f->cluster_begin_lba + (cluster_num - 2) * f->sectors_per_cluster;
-  if (trace_p)
-    trace("cluster %d to lba: %d\n", cluster_num, lba);
+  // called for every cluster of every file: too hot to printk.
+  ktrace(KT_FAT_CLUSTER, cluster_num, lba);
   return lba;
 }
 
@@ -224,6 +224,7 @@ static fat32_dirent_t *get_dirents(fat32_fs_t *fs, uint32_t cluster_start,
 pi_directory_t fat32_readdir(fat32_fs_t *fs, pi_dirent_t *dirent) {
   demand(init_p, "fat32 not initialized!");
   demand(dirent->is_dir_p, "tried to readdir a file!");
+  perf_path_begin(s);
   // TODO: use `get_dirents` to read the raw dirent structures from the disk
   uint32_t n_dirents;
   fat32_dirent_t *dirents = get_dirents(fs, dirent->cluster_id, &n_dirents);
@@ -247,6 +248,8 @@ pi_directory_t fat32_readdir(fat32_fs_t *fs, pi_dirent_t *dirent) {
     num_valid++;
   }
 
+  perf_path_end(PERF_FAT32_READDIR, s);
+
   // TODO: create a pi_directory_t using the dirents and the number of valid
   // dirents we found
   return (pi_directory_t){
@@ -310,8 +313,10 @@ pi_file_t *fat32_read(fat32_fs_t *fs, pi_dirent_t *directory, char *filename) {
 
   // TODO: read the dirents of the provided directory and look for one matching
   // the provided name
+  perf_path_begin(s);
   pi_dirent_t *dirent = fat32_stat(fs, directory, filename);
   if (!dirent->nbytes) {
+    perf_path_end(PERF_FAT32_READ, s);
     return NULL;
   }
 
@@ -325,6 +330,8 @@ pi_file_t *fat32_read(fat32_fs_t *fs, pi_dirent_t *directory, char *filename) {
   // read in the whole file (if it's not empty)
   read_cluster_chain(fs, dirent->cluster_id, buf);
 
+  perf_path_end(PERF_FAT32_READ, s);
+
   // fill the pi_file_t
   pi_file_t *file = kmalloc(sizeof(pi_file_t));
   *file = (pi_file_t){
@@ -11,8 +11,10 @@
 static int trace_p = 0;
 static int init_p = 0;
 
+// text tracing: checksums every sector read/written, so it is
+// slow.  the binary <ktrace> events below are always recorded.
 int pi_sd_trace(int on_p) {
-  int old = on_p;
+  int old = trace_p;
   trace_p = on_p;
   return old;
 }
@@ -29,9 +31,12 @@ int pi_sd_init(void) {
 int pi_sd_read(void *data, uint32_t lba, uint32_t nsec) {
   demand(init_p, "SD card not initialized!\n");
   int res;
+  perf_path_begin(s);
   if ((res = sd_readblock(lba, data, nsec)) != 512 * nsec)
     panic("could not read from sd card: result = %d\n", res);
+  perf_path_end(PERF_SD_READ, s);
 
+  ktrace(KT_SD_READ, lba, nsec);
   if (trace_p)
     trace("sd_read: lba=<%x>, cksum=%x\n", lba, fast_hash(data, nsec * 512));
   return 1;
@@ -53,9 +58,12 @@ void *pi_sec_read(uint32_t lba, uint32_t nsec) {
 int pi_sd_write(void *data, uint32_t lba, uint32_t nsec) {
   demand(init_p, "SD card not initialized!\n");
   int res;
+  perf_path_begin(s);
   if ((res = sd_writeblock(data, lba, nsec)) != 512 * nsec)
     panic("could not write to sd card: result = %d\n", res);
+  perf_path_end(PERF_SD_WRITE, s);
 
+  ktrace(KT_SD_WRITE, lba, nsec);
   if (trace_p)
     trace("sd_write: lba=<%x>, cksum=%x\n", lba, our_crc32(data, nsec * 512));
   return 1;
@@ -4,12 +4,18 @@
 #include "libc/crc.h"
 #include "libc/fast-hash32.h"
 #include "rpi.h"
+#include "ktrace.h"
+#include "perf.h"
 
 #define NBYTES_PER_SECTOR 512
 
 // initialize the PI SD driver
 int pi_sd_init(void);
 
+// turn on/off printing a checksum of each sector read/written.
+// returns the old value.
+int pi_sd_trace(int on_p);
+
 // read `nsec` sectors of the SD card starting at `lba` into a buffer
 int pi_sd_read(void *data, uint32_t lba, uint32_t nsec);
 
@@ -5,10 +5,54 @@
 #include "rpi.h"
 #include "user-progs/byte-array-0-printk-hello.h"
 
+// the user-progs tests, under the 8.3 names the sd.img rule in the
+// Makefile gives them on the card.  each runs by itself and has to
+// exit 0: <die> exits 1.
+static const struct {
+  char *name;
+  unsigned no_fast_p; // run with <eqx_fast_syscalls> off.
+} user_tests[] = {
+    {"WRITE.ELF"},
+    {"PRODCONS.ELF"},
+    {"IPC.ELF"},
+    {"SHMRING.ELF"},
+    {"MALLOC.ELF"},
+    {"BATCH.ELF"},
+    // again, with every call taking the full system call path.
+    {"BATCH.ELF", .no_fast_p = 1},
+    {"PRIO.ELF"},
+};
+
+static void run_user_tests(fat32_fs_t *fs, pi_dirent_t *root) {
+  unsigned n = sizeof user_tests / sizeof user_tests[0], npass = 0;
+  for (unsigned i = 0; i < n; i++) {
+    char *name = user_tests[i].name;
+    if (!fat32_stat(fs, root, name)) {
+      output("ERROR: test <%s> is not on the card\n", name);
+      continue;
+    }
+    unsigned nfail = eqx_nexit_fail;
+    eqx_fast_syscalls(!user_tests[i].no_fast_p);
+    eqx_exec_file(fs, root, name);
+    eqx_run_threads();
+    eqx_fast_syscalls(1);
+    if (eqx_nexit_fail != nfail)
+      output("ERROR: test <%s> failed\n", name);
+    else
+      npass++;
+  }
+  output("%d of %d user tests passed\n", npass, n);
+}
+
+// set by the Makefile's KTRACE.
+#ifndef EQX_KTRACE
+#define EQX_KTRACE 0
+#endif
+
 void notmain(void) {
   eqx_verbose(1);
 
-  eqx_config_t c = {.ramMB = 512, .vm_use_pin_p = 1};
+  eqx_config_t c = {.ramMB = 512, .vm_use_pin_p = 1, .ktrace_p = EQX_KTRACE};
   eqx_init_config(c);
 
   pi_sd_init();
@@ -55,33 +99,21 @@ void notmain(void) {
   }
   printk("--------------------\n");
 
-  // Read HELLO.BIN from SD card
-  char *filename = "0-PRIN~4.BIN";
-  pi_file_t *hello_file = fat32_read(&fs, &root, filename);
-  if (!hello_file) {
-    panic("Could not find %s on SD card\n", filename);
+  // the elf next to user-progs/0-printk-hello.bin: see the sd.img
+  // rule in the Makefile.  a card without it gets the copy compiled
+  // into the kernel.
+  char *filename = "HELLO.ELF";
+  if (fat32_stat(&fs, &root, filename)) {
+    output("about to load: <%s>\n", filename);
+    eqx_exec_file(&fs, &root, filename);
+  } else {
+    output("no <%s> on the card: loading <%s>\n", filename,
+           bytes_0_printk_hello.name);
+    eqx_exec_internal(&bytes_0_printk_hello);
   }
-  output("Read %s: %d bytes\n", filename, hello_file->n_data);
-  printk("hello_file->data: %s\n", hello_file->data);
-
-  // Create a program structure for the loaded file
-  struct prog hello_prog = {
-      .name = filename, .nbytes = hello_file->n_data,
-      // The code field is a flexible array, so we copy the data after it
-  };
-  printk("hello_prog: %s, %d\n", hello_prog.name, hello_prog.nbytes);
-
-  // Allocate memory for the program structure plus the code data
-  struct prog *p = kmalloc(sizeof(struct prog) + hello_file->n_data);
-  memcpy(p, &hello_prog, sizeof(struct prog));
-  memcpy(p->code, hello_file->data, hello_file->n_data);
-
-  struct prog *p2 = &bytes_0_printk_hello;
-
-  output("about to load: <%s>\n", p2->name);
-
-  let th = eqx_exec_internal(p2);
 
   output("about to run\n");
   eqx_run_threads();
+
+  run_user_tests(&fs, &root);
 }
@@ -29,22 +29,149 @@ static inline void tlb_flush_asid(uint32_t asid) {
 static int eqx_init_p = 0;
 static unsigned ntids = 1;
 int eqx_verbose_p = 1;
+unsigned eqx_nexit_fail;
 
 #define TIMER_4MS_LOAD 30
 
-// simple thread queue.
-//  - should make so you can delete from the middle.
-typedef struct rq {
-  eqx_th_t *head, *tail;
-} rq_t;
+// the timer can tick faster than we switch threads when it is
+// also the profiler's sample clock: see <prof_per_quantum>.
+static unsigned ticks_per_quantum = 1, ntick;
 
 // will define eqx_pop, eqx_push, eqx_append, etc
 gen_queue_T(eqx_th, rq_t, head, tail, eqx_th_t, next) static rq_t eqx_runq;
 
+// remove the highest <prio> thread: the first among equals, so with
+// no priorities set it's just <eqx_th_pop>.
+static eqx_th_t *rq_pop_best(rq_t *q) {
+  eqx_th_t *best = 0, *best_prev = 0, *prev = 0;
+  for (eqx_th_t *e = eqx_th_start(q); e; prev = e, e = eqx_th_next(e)) {
+    if (!best || e->prio > best->prio) {
+      best = e;
+      best_prev = prev;
+    }
+  }
+  if (best)
+    eqx_th_remove(q, best_prev, best);
+  return best;
+}
+
 // pointer to current thread.  not null when running
 // threads, null when not.
 static eqx_th_t *volatile cur_thread;
 
+// every thread that hasn't exited, linked by <all_next>.
+static eqx_th_t *eqx_all;
+
+// threads waiting on a mutex, condition variable or semaphore: if
+// they're all that's left, it's a deadlock.
+static unsigned sync_nblocked;
+
+// threads waiting in <sys_read> for console input.  the timer
+// interrupt and the scheduler make them runnable once a byte has
+// arrived, and each retries its read.
+static rq_t con_waitq;
+
+static void con_wake(void) {
+  if (!con_waitq.head || !uart_has_data())
+    return;
+  eqx_th_t *th;
+  while ((th = eqx_th_pop(&con_waitq))) {
+    ktrace(KT_WAKE, th->tid, 0);
+    eqx_th_append(&eqx_runq, th);
+  }
+}
+
+/****************************************************************
+ * pmu accounting (<perf.h>).
+ *
+ * the counters are global, so we virtualize them: whatever ran since
+ * the last switch (the thread plus the exceptions and system calls
+ * it caused) is charged to <perf_owner>.  system calls are also
+ * charged to their number, from handler entry to when it returns or
+ * switches away.
+ */
+static eqx_th_t *perf_owner;
+static perf_cnt_t perf_owner_start;
+
+static int perf_sysno = -1;
+static perf_cnt_t perf_sys_start;
+static perf_acc_t perf_sys[EQX_SYS_MAX];
+
+// totals of exited threads, for the summary.
+enum { PERF_MAX_EXITED = 64 };
+static struct {
+  uint32_t tid;
+  perf_acc_t acc;
+} perf_exited[PERF_MAX_EXITED];
+static unsigned perf_nexited, perf_nexited_dropped;
+
+// stop charging the current owner and start charging <th> (can be 0).
+static void perf_switch(eqx_th_t *th) {
+  if (!perf_on_p)
+    return;
+  perf_cnt_t now = perf_read();
+  if (perf_owner)
+    perf_acc_add(&perf_owner->perf, perf_owner_start, now);
+  perf_owner = th;
+  perf_owner_start = now;
+}
+
+static void perf_sys_begin(unsigned sysno) {
+  if (!perf_on_p || sysno >= EQX_SYS_MAX)
+    return;
+  perf_sysno = sysno;
+  perf_sys_start = perf_read();
+}
+
+static void perf_sys_end(void) {
+  if (perf_sysno < 0)
+    return;
+  perf_acc(&perf_sys[perf_sysno], perf_sys_start);
+  perf_sysno = -1;
+}
+
+static void perf_exit(eqx_th_t *th) {
+  if (!perf_on_p)
+    return;
+  perf_switch(0);
+  if (perf_nexited == PERF_MAX_EXITED) {
+    perf_nexited_dropped++;
+    return;
+  }
+  perf_exited[perf_nexited].tid = th->tid;
+  perf_exited[perf_nexited].acc = th->perf;
+  perf_nexited++;
+}
+
+static void perf_start(unsigned group) {
+  perf_init(group);
+  memset(perf_sys, 0, sizeof perf_sys);
+  perf_nexited = perf_nexited_dropped = 0;
+  perf_owner = 0;
+  perf_sysno = -1;
+}
+
+static void perf_dump(void) {
+  char name[32];
+
+  perf_print_hdr("threads");
+  for (unsigned i = 0; i < perf_nexited; i++) {
+    snprintk(name, sizeof name, "tid=%d", perf_exited[i].tid);
+    perf_print(name, &perf_exited[i].acc);
+  }
+  if (perf_nexited_dropped)
+    printk("PERF:  (%d more threads not recorded)\n", perf_nexited_dropped);
+
+  perf_print_hdr("system calls");
+  for (unsigned i = 0; i < EQX_SYS_MAX; i++) {
+    if (!perf_sys[i].n)
+      continue;
+    snprintk(name, sizeof name, "sysno=%d", i);
+    perf_print(name, &perf_sys[i]);
+  }
+  perf_paths_dump();
+}
+
 void interrupt_full_except(regs_t *r) {
   dev_barrier();
   unsigned pending = GET32(IRQ_basic_pending);
@@ -67,14 +194,20 @@ void interrupt_full_except(regs_t *r) {
     not_reached();
   }
 
+  pc_prof_sample(r->regs[REGS_PC], r->regs[REGS_LR]);
+  if (++ntick < ticks_per_quantum) {
+    switchto(r);
+    not_reached();
+  }
+  ntick = 0;
+
   cur_thread->regs = *r;
+  con_wake();
 
-  uint32_t this_thread_pid = cur_thread->tid;
-  uint32_t next_thread_pid = cur_thread->tid;
-  if (eqx_th_len(&eqx_runq) > 0)
-    next_thread_pid = eqx_th_top(&eqx_runq)->tid;
-  printk("[INTERRUPT %d -> %d, |runq|=%d]", this_thread_pid, next_thread_pid,
-         eqx_th_len(&eqx_runq));
+  // binary trace: printing here would perturb the schedule we
+  // are trying to observe.
+  eqx_th_t *next = eqx_th_top(&eqx_runq);
+  ktrace(KT_IRQ_TIMER, cur_thread->tid, next ? next->tid : cur_thread->tid);
   eqx_th_append(&eqx_runq, cur_thread);
   eqx_pick_next_and_run();
 }
@@ -140,6 +273,9 @@ static __attribute__((noreturn)) void eqx_run_current(void) {
   assert(cur_thread);
   // Ensure the pinned mappings correspond to cur_thread before executing it.
   vm_switch(cur_thread);
+  perf_sys_end();
+  if (perf_owner != cur_thread)
+    perf_switch(cur_thread);
   prefetch_flush();
   switchto(&cur_thread->regs);
   not_reached();
@@ -169,17 +305,15 @@ eqx_th_t *eqx_fork_stack(void (*fn)(void *), void *arg, void *stack,
     panic("stack is not 8 byte aligned: mod 8 = %d\n", rem);
 
   eqx_regs_init(th);
+  th->all_next = eqx_all;
+  eqx_all = th;
   eqx_th_push(&eqx_runq, th);
   return th;
 }
 
 // fork + allocate a 8-byte aligned stack.
 eqx_th_t *eqx_fork(void (*fn)(void *), void *arg) {
-
-  void *stack = kmalloc_aligned(eqx_stack_size, 8);
-  assert((uint32_t)stack % 8 == 0);
-
-  return eqx_fork_stack(fn, arg, stack, eqx_stack_size);
+  return eqx_fork_sized(fn, arg, eqx_stack_size);
 }
 
 // fork with no stack: this is used as a debugging
@@ -193,27 +327,586 @@ eqx_th_t *eqx_fork_nostack(void (*fn)(void *), void *arg) {
 // The only "scheduler" action is to pick the next thread after exit.
 static __attribute__((noreturn)) void eqx_pick_next_and_run(void) {
   // Choose the next runnable.
-  cur_thread = eqx_th_pop(&eqx_runq);
+  con_wake();
+  cur_thread = rq_pop_best(&eqx_runq);
+  if (!cur_thread && con_waitq.head) {
+    // nothing to do until someone types.
+    while (!uart_has_data())
+      ;
+    con_wake();
+    cur_thread = rq_pop_best(&eqx_runq);
+  }
   if (!cur_thread) {
+    if (sync_nblocked)
+      panic("deadlock: %d threads blocked and none runnable\n",
+            sync_nblocked);
     // No runnable threads: return to kernel/start_regs.
     switchto(&start_regs);
   }
+  ktrace(KT_SCHED_RUN, cur_thread->tid, cur_thread->regs.regs[REGS_PC]);
   eqx_run_current();
   not_reached();
 }
 
+/****************************************************************
+ * blocking primitives: mutexes, condition variables and counting
+ * semaphores.
+ *
+ * each object is a slot in a fixed table, named by its index.  they
+ * live in the kernel so forked threads share them; they are never
+ * freed.  a thread that has to wait comes off the run queue and goes
+ * on the object's wait queue (its <next> link is free while it isn't
+ * runnable).  whoever wakes it sets its r0 and appends it to
+ * <eqx_runq>, and switches to it right away if it outranks them.
+ *
+ * the scheduler runs the highest <prio> thread first, so a low
+ * priority mutex owner could be starved by a middling thread while a
+ * high priority one waits for it.  to prevent that, mutexes do
+ * priority inheritance: a waiter lends its priority to the owner and
+ * on down the chain of owners it's waiting on, until the unlock.
+ * unlock hands the mutex straight to its best waiter.
+ */
+enum { EQX_NMUTEX = 32, EQX_NCOND = 32, EQX_NSEM = 32 };
+
+typedef struct eqx_mutex {
+  unsigned used_p;
+  eqx_th_t *owner;
+  struct eqx_mutex *next_held; // the owner's other mutexes.
+  rq_t waiters;
+} eqx_mutex_t;
+
+typedef struct {
+  unsigned used_p;
+  rq_t waiters;
+} eqx_cond_t;
+
+typedef struct {
+  unsigned used_p;
+  int count;
+  rq_t waiters;
+} eqx_sem_t;
+
+static eqx_mutex_t sync_mutexes[EQX_NMUTEX];
+static eqx_cond_t sync_conds[EQX_NCOND];
+static eqx_sem_t sync_sems[EQX_NSEM];
+
+// the calling thread <th> waits on <q>.  its registers were saved
+// on entry: the waker sets its r0.
+static __attribute__((noreturn)) void sync_block(eqx_th_t *th, rq_t *q,
+                                                 unsigned sysno,
+                                                 uint32_t id) {
+  ktrace(KT_BLOCK, th->tid, sysno << 16 | id);
+  sync_nblocked++;
+  eqx_th_append(q, th);
+  eqx_pick_next_and_run();
+}
+
+// make waiter <w> runnable with system call result <ret>.
+static void sync_wake(eqx_th_t *w, int ret) {
+  assert(sync_nblocked);
+  sync_nblocked--;
+  ktrace(KT_WAKE, w->tid, cur_thread ? cur_thread->tid : 0);
+  w->regs.regs[REGS_R0] = ret;
+  eqx_th_append(&eqx_runq, w);
+}
+
+// if a thread we woke outranks <th>, <th> returns <ret> later.
+static void sync_preempt(eqx_th_t *th, int ret) {
+  for (eqx_th_t *e = eqx_th_start(&eqx_runq); e; e = eqx_th_next(e)) {
+    if (e->prio > th->prio) {
+      th->regs.regs[REGS_R0] = ret;
+      eqx_th_append(&eqx_runq, th);
+      eqx_pick_next_and_run();
+    }
+  }
+}
+
+// <th>'s own priority raised to that of anyone waiting on a mutex it
+// holds.  waiters already carry what they inherited.
+static uint32_t prio_inherited(eqx_th_t *th) {
+  uint32_t p = th->base_prio;
+  for (eqx_mutex_t *m = th->held; m; m = m->next_held)
+    for (eqx_th_t *w = eqx_th_start(&m->waiters); w; w = eqx_th_next(w))
+      if (w->prio > p)
+        p = w->prio;
+  return p;
+}
+
+// <th> is about to wait on <m>: lend its priority to <m>'s owner, the
+// owner of what that one waits on, etc.  -1 if the chain gets back to
+// <th>: it would wait forever.
+static int prio_lend(eqx_th_t *th, eqx_mutex_t *m) {
+  for (eqx_mutex_t *x = m; x && x->owner; x = x->owner->blocked_on)
+    if (x->owner == th)
+      return -1;
+  for (eqx_mutex_t *x = m; x && x->owner; x = x->owner->blocked_on)
+    if (x->owner->prio < th->prio)
+      x->owner->prio = th->prio;
+  return 0;
+}
+
+static void mutex_take(eqx_mutex_t *m, eqx_th_t *th) {
+  assert(!m->owner);
+  m->owner = th;
+  m->next_held = th->held;
+  th->held = m;
+  th->blocked_on = 0;
+}
+
+// <m>'s owner gives it up and drops what it inherited through it.  the
+// best waiter (if any) becomes the owner and is made runnable.
+static void mutex_release(eqx_mutex_t *m) {
+  eqx_th_t *o = m->owner;
+  eqx_mutex_t **p = &o->held;
+  while (*p != m)
+    p = &(*p)->next_held;
+  *p = m->next_held;
+  m->next_held = 0;
+  m->owner = 0;
+  o->prio = prio_inherited(o);
+
+  eqx_th_t *w = rq_pop_best(&m->waiters);
+  if (!w)
+    return;
+  mutex_take(m, w);
+  // the rest of the waiters now lend to <w>.
+  w->prio = prio_inherited(w);
+  sync_wake(w, 0);
+}
+
+// condition variable waiter <w> was signalled: it has to get its
+// mutex back before it can return.
+static void cond_wake(eqx_th_t *w) {
+  eqx_mutex_t *m = w->cv_mutex;
+  w->cv_mutex = 0;
+  if (!m->owner) {
+    mutex_take(m, w);
+    sync_wake(w, 0);
+    return;
+  }
+  // still blocked, just somewhere else.  if <prio_lend> finds a
+  // cycle the program has deadlocked: nothing to lend.
+  prio_lend(w, m);
+  w->blocked_on = m;
+  eqx_th_append(&m->waiters, w);
+}
+
+// an exiting thread unlocks whatever it still holds.
+static void sync_exit(eqx_th_t *th) {
+  assert(!th->blocked_on && !th->cv_mutex);
+  while (th->held)
+    mutex_release(th->held);
+}
+
+static eqx_mutex_t *mutex_get(uint32_t id) {
+  return id < EQX_NMUTEX && sync_mutexes[id].used_p ? &sync_mutexes[id] : 0;
+}
+static eqx_cond_t *cond_get(uint32_t id) {
+  return id < EQX_NCOND && sync_conds[id].used_p ? &sync_conds[id] : 0;
+}
+static eqx_sem_t *sem_get(uint32_t id) {
+  return id < EQX_NSEM && sync_sems[id].used_p ? &sync_sems[id] : 0;
+}
+
+// claim the first free slot in table <tab>: its index, or -1.
+#define sync_new(tab, n)                                                       \
+  ({                                                                           \
+    int _id = -1;                                                              \
+    for (unsigned _i = 0; _i < (n); _i++) {                                    \
+      if (!(tab)[_i].used_p) {                                                 \
+        memset(&(tab)[_i], 0, sizeof (tab)[_i]);                               \
+        (tab)[_i].used_p = 1;                                                  \
+        _id = _i;                                                              \
+        break;                                                                 \
+      }                                                                        \
+    }                                                                          \
+    _id;                                                                       \
+  })
+
+// returns the result, or doesn't return if <th> blocks or a woken
+// thread outranks it.
+static int sync_syscall(eqx_th_t *th, unsigned sysno, uint32_t a1,
+                        uint32_t a2) {
+  switch (sysno) {
+  case EQX_SYS_MUTEX_NEW:
+    return sync_new(sync_mutexes, EQX_NMUTEX);
+  case EQX_SYS_MUTEX_LOCK: {
+    eqx_mutex_t *m = mutex_get(a1);
+    if (!m || m->owner == th)
+      return -1;
+    if (!m->owner) {
+      mutex_take(m, th);
+      return 0;
+    }
+    if (prio_lend(th, m) < 0)
+      return -1;
+    th->blocked_on = m;
+    sync_block(th, &m->waiters, sysno, a1);
+  }
+  case EQX_SYS_MUTEX_UNLOCK: {
+    eqx_mutex_t *m = mutex_get(a1);
+    if (!m || m->owner != th)
+      return -1;
+    mutex_release(m);
+    sync_preempt(th, 0);
+    return 0;
+  }
+
+  case EQX_SYS_COND_NEW:
+    return sync_new(sync_conds, EQX_NCOND);
+  case EQX_SYS_COND_WAIT: {
+    eqx_cond_t *c = cond_get(a1);
+    eqx_mutex_t *m = mutex_get(a2);
+    if (!c || !m || m->owner != th)
+      return -1;
+    mutex_release(m);
+    th->cv_mutex = m;
+    sync_block(th, &c->waiters, sysno, a1);
+  }
+  case EQX_SYS_COND_SIGNAL:
+  case EQX_SYS_COND_BROADCAST: {
+    eqx_cond_t *c = cond_get(a1);
+    if (!c)
+      return -1;
+    eqx_th_t *w;
+    while ((w = rq_pop_best(&c->waiters))) {
+      cond_wake(w);
+      if (sysno == EQX_SYS_COND_SIGNAL)
+        break;
+    }
+    sync_preempt(th, 0);
+    return 0;
+  }
+
+  case EQX_SYS_SEM_NEW: {
+    if ((int)a1 < 0)
+      return -1;
+    int id = sync_new(sync_sems, EQX_NSEM);
+    if (id >= 0)
+      sync_sems[id].count = a1;
+    return id;
+  }
+  case EQX_SYS_SEM_WAIT: {
+    eqx_sem_t *s = sem_get(a1);
+    if (!s)
+      return -1;
+    if (s->count > 0) {
+      s->count--;
+      return 0;
+    }
+    sync_block(th, &s->waiters, sysno, a1);
+  }
+  case EQX_SYS_SEM_POST: {
+    eqx_sem_t *s = sem_get(a1);
+    if (!s)
+      return -1;
+    eqx_th_t *w = rq_pop_best(&s->waiters);
+    if (!w) {
+      s->count++;
+      return 0;
+    }
+    sync_wake(w, 0);
+    sync_preempt(th, 0);
+    return 0;
+  }
+
+  case EQX_SYS_SET_PRIO:
+    th->base_prio = a1;
+    th->prio = prio_inherited(th);
+    // we may have lowered ourselves below someone runnable.
+    sync_preempt(th, 0);
+    return 0;
+  default:
+    panic("not a blocking primitive: %d\n", sysno);
+  }
+}
+
+/****************************************************************
+ * message passing.
+ *
+ * a message is four words plus the sender's tid, and it travels in
+ * registers: the sender's saved r2-r5 are copied straight into the
+ * receiver's (see <ipc_invoke_asm> in user-progs/libos-asm.S).
+ *  - send blocks until the receiver takes the message.  a receiver
+ *    waiting in recv is woken on the spot, otherwise the sender
+ *    queues on its <ipc_sendq>.
+ *  - post never blocks: if the receiver isn't waiting, the message
+ *    goes in its mailbox, or fails if that's full.
+ *  - recv takes the mailbox first, then queued senders, else blocks.
+ *
+ * big buffers aren't copied.  a process can have one 1MB window
+ * section at <IPC_WINDOW_VA>, pinned in the slot a pooled stack
+ * would use (processes don't have those).  a send with
+ * EQX_IPC_GRANT swaps the sender's and receiver's window sections:
+ * the receiver sees the data at the same va, and the sender gets
+ * the receiver's old window, or none.
+ */
+enum { IPC_WINDOW_VA = 0x600000, IPC_MBOX_N = 16 };
+
+typedef struct eqx_mbox {
+  unsigned head, tail; // free running: tail - head messages.
+  struct {
+    uint32_t from, w[4];
+  } msg[IPC_MBOX_N];
+} eqx_mbox_t;
+
+// threads blocked in recv.
+static rq_t ipc_recvq;
+
+static eqx_th_t *ipc_find(uint32_t tid) {
+  for (eqx_th_t *t = eqx_all; t; t = t->all_next)
+    if (t->tid == tid)
+      return t;
+  return 0;
+}
+
+static void rq_remove_th(rq_t *q, eqx_th_t *th) {
+  eqx_th_t *prev = 0;
+  for (eqx_th_t *e = eqx_th_start(q); e != th; prev = e, e = eqx_th_next(e))
+    assert(e);
+  eqx_th_remove(q, prev, th);
+}
+
+// put message <w> into <to>'s saved r2-r5, and with <grant> swap
+// windows.  returns what <to>'s recv returns.
+static uint32_t ipc_deliver(eqx_th_t *to, eqx_th_t *from, const uint32_t *w,
+                            int grant) {
+  memcpy(&to->regs.regs[2], w, 4 * sizeof *w);
+  if (!grant)
+    return from->tid;
+
+  uint32_t to_pa = to->ipc_pin.pa;
+  to->ipc_pin = map_mk(IPC_WINDOW_VA, from->ipc_pin.pa, to->data_pin.attr);
+  if (to_pa)
+    from->ipc_pin = map_mk(IPC_WINDOW_VA, to_pa, from->data_pin.attr);
+  else
+    from->ipc_pin = (map_t){0};
+  return from->tid | EQX_IPC_GRANT;
+}
+
+static int ipc_mbox_put(eqx_th_t *to, uint32_t from, const uint32_t *w) {
+  if (!to->mbox)
+    to->mbox = kmalloc(sizeof *to->mbox);
+  eqx_mbox_t *b = to->mbox;
+  if (b->tail - b->head == IPC_MBOX_N)
+    return -1;
+  let m = &b->msg[b->tail++ % IPC_MBOX_N];
+  m->from = from;
+  memcpy(m->w, w, sizeof m->w);
+  return 0;
+}
+
+// the calling thread is <th>: its saved registers hold the
+// arguments, and recv leaves the message in them.
+static int ipc_syscall(eqx_th_t *th, unsigned sysno) {
+  uint32_t *regs = th->regs.regs;
+
+  switch (sysno) {
+  case EQX_SYS_IPC_WINDOW:
+    // shares the pin slot with a shared region.
+    if (!th->code_pin.pa || th->shm)
+      return -1;
+    if (!th->ipc_pin.pa) {
+      uint32_t pa = sec_to_addr(sec_alloc());
+      th->ipc_pin = map_mk(IPC_WINDOW_VA, pa, th->data_pin.attr);
+      vm_switch(th);
+    }
+    return IPC_WINDOW_VA;
+
+  case EQX_SYS_IPC_SEND:
+  case EQX_SYS_IPC_POST: {
+    int grant = (regs[1] & EQX_IPC_GRANT) != 0;
+    eqx_th_t *to = ipc_find(regs[1] & ~EQX_IPC_GRANT);
+    if (!to || to == th)
+      return -1;
+    if (grant && (sysno == EQX_SYS_IPC_POST || !th->ipc_pin.pa ||
+                  !to->code_pin.pa || to->shm))
+      return -1;
+
+    if (to->ipc_recv_p) {
+      to->ipc_recv_p = 0;
+      rq_remove_th(&ipc_recvq, to);
+      sync_wake(to, ipc_deliver(to, th, &regs[2], grant));
+      if (grant)
+        vm_switch(th);
+      sync_preempt(th, 0);
+      return 0;
+    }
+    if (sysno == EQX_SYS_IPC_POST)
+      return ipc_mbox_put(to, th->tid, &regs[2]);
+    // the receiver takes the message (and the grant bit) from our
+    // saved registers.
+    sync_block(th, &to->ipc_sendq, sysno, to->tid);
+  }
+
+  case EQX_SYS_IPC_RECV: {
+    eqx_mbox_t *b = th->mbox;
+    if (b && b->tail != b->head) {
+      let m = &b->msg[b->head++ % IPC_MBOX_N];
+      memcpy(&regs[2], m->w, sizeof m->w);
+      return m->from;
+    }
+    // a window and a shared region share a pin slot: a grant queued
+    // before we mapped a region can't be taken, so it fails.
+    eqx_th_t *s;
+    int grant;
+    while ((s = rq_pop_best(&th->ipc_sendq))) {
+      grant = (s->regs.regs[1] & EQX_IPC_GRANT) != 0;
+      if (!grant || !th->shm)
+        break;
+      sync_wake(s, -1);
+    }
+    if (!s) {
+      th->ipc_recv_p = 1;
+      sync_block(th, &ipc_recvq, sysno, 0);
+    }
+    uint32_t ret = ipc_deliver(th, s, &s->regs.regs[2], grant);
+    if (grant)
+      vm_switch(th);
+    sync_wake(s, 0);
+    sync_preempt(th, ret);
+    return ret;
+  }
+  default:
+    panic("not a message passing call: %d\n", sysno);
+  }
+}
+
+// <th> is exiting (or exec'ing): fail its blocked senders and give
+// back its window.
+static void ipc_exit(eqx_th_t *th) {
+  assert(!th->ipc_recv_p);
+  eqx_th_t *s;
+  while ((s = eqx_th_pop(&th->ipc_sendq)))
+    sync_wake(s, -1);
+  if (th->ipc_pin.pa)
+    sec_free(th->ipc_pin.pa >> 20);
+  th->ipc_pin = (map_t){0};
+
+  for (eqx_th_t **p = &eqx_all; *p; p = &(*p)->all_next) {
+    if (*p == th) {
+      *p = th->all_next;
+      break;
+    }
+  }
+}
+
+/****************************************************************
+ * shared memory.
+ *
+ * a region is one 1MB section that any number of processes map at
+ * <SHM_VA>.  its count in the section allocator is its reference
+ * count: one per process with it mapped, so it goes away with the
+ * last one.  a named region is found by name.  an anonymous one is
+ * only shared through fork, which gives the child the same section
+ * instead of a copy.
+ *
+ * it's pinned in the ipc window's slot, so a process has one or the
+ * other.  each process's pin is tagged with its own asid, as for its
+ * code and data.
+ */
+enum { SHM_VA = 0x700000, EQX_NSHM = 16, SHM_NAME_MAX = 16 };
+
+typedef struct eqx_shm {
+  unsigned used_p;
+  uint32_t sec;
+  char name[SHM_NAME_MAX]; // "" = anonymous.
+} eqx_shm_t;
+
+static eqx_shm_t shm_regions[EQX_NSHM];
+
+static void shm_attach(eqx_th_t *th, eqx_shm_t *s) {
+  th->shm = s;
+  th->shm_pin = map_mk(SHM_VA, sec_to_addr(s->sec), th->data_pin.attr);
+}
+
+static void shm_exit(eqx_th_t *th) {
+  eqx_shm_t *s = th->shm;
+  if (!s)
+    return;
+  if (!sec_free(s->sec))
+    s->used_p = 0;
+  th->shm = 0;
+  th->shm_pin = (map_t){0};
+}
+
+// copy the user's region name into <name>: 0 if it's missing, empty
+// or too long.
+static int shm_name_get(eqx_th_t *th, uint32_t uname, char *name) {
+  for (unsigned i = 0; i < SHM_NAME_MAX; i++) {
+    if (!user_range_ok(th, uname + i, 1, 0))
+      return 0;
+    if (!(name[i] = ((const char *)uname)[i]))
+      return i > 0;
+  }
+  return 0;
+}
+
+static int shm_map(eqx_th_t *th, uint32_t uname) {
+  if (!th->code_pin.pa || th->shm || th->ipc_pin.pa)
+    return -1;
+
+  char name[SHM_NAME_MAX] = {0};
+  if (uname) {
+    if (!shm_name_get(th, uname, name))
+      return -1;
+    for (unsigned i = 0; i < EQX_NSHM; i++) {
+      eqx_shm_t *s = &shm_regions[i];
+      if (s->used_p && strcmp(s->name, name) == 0) {
+        sec_ref(s->sec);
+        shm_attach(th, s);
+        vm_switch(th);
+        return SHM_VA;
+      }
+    }
+  }
+
+  eqx_shm_t *s = 0;
+  for (unsigned i = 0; i < EQX_NSHM && !s; i++)
+    if (!shm_regions[i].used_p)
+      s = &shm_regions[i];
+  if (!s)
+    return -1;
+  s->used_p = 1;
+  s->sec = sec_alloc();
+  memcpy(s->name, name, sizeof s->name);
+  shm_attach(th, s);
+  vm_switch(th);
+  // through the user mapping we just made.
+  memset((void *)SHM_VA, 0, MB(1));
+  return SHM_VA;
+}
+
+static int shm_unmap(eqx_th_t *th) {
+  if (!th->shm)
+    return -1;
+  shm_exit(th);
+  vm_switch(th);
+  return 0;
+}
+
 /****************************************************************
  * system calls.
  */
 
 static __attribute__((noreturn)) void sys_exit(eqx_th_t *th, int exitcode) {
   // eqx_trace("thread=%d exited with code=%d\n", th->tid, exitcode);
+  ktrace(KT_EXIT, th->tid, exitcode);
+  if (exitcode)
+    eqx_nexit_fail++;
+  perf_sys_end();
+  perf_exit(th);
   free_asid(th->code_pin.attr.asid);
   tlb_flush_asid(th->code_pin.attr.asid);
   if (th->code_pin.pa)
     sec_free(th->code_pin.pa >> 20);
   if (th->data_pin.pa)
     sec_free(th->data_pin.pa >> 20);
+  if (th->stack)
+    stack_free(th->stack);
+  sync_exit(th);
+  ipc_exit(th);
+  shm_exit(th);
 
   uint32_t this_thread_pid = th->tid;
   uint32_t next_thread_pid = 0;
@@ -226,10 +919,257 @@ static __attribute__((noreturn)) void sys_exit(eqx_th_t *th, int exitcode) {
   eqx_pick_next_and_run();
 }
 
+// 1 if [addr, addr+nbytes) is entirely inside one of <th>'s pinned
+// mappings (code, data, ipc window, shared region or stack).  the
+// thread's address space is still live while we handle its system
+// call, so the kernel can then use the user pointer as is.
+//
+// <write_p>: the kernel is going to store there.  a shared code
+// section is read-only to the user but not to us, so a store into it
+// would change the code of every process running the image: refuse.
+static int user_range_ok(eqx_th_t *th, uint32_t addr, uint32_t nbytes,
+                         int write_p) {
+  if (addr + nbytes < addr)
+    return 0;
+  map_t *maps[] = {&th->code_pin, &th->data_pin, &th->ipc_pin, &th->shm_pin};
+  for (unsigned i = 0; i < sizeof maps / sizeof maps[0]; i++) {
+    map_t *m = maps[i];
+    if (write_p && m == &th->code_pin && exec_code_shared(th))
+      continue;
+    if (m->pa && addr >= m->va && addr + nbytes <= m->va + MB(1))
+      return 1;
+  }
+  // its own stack: a process's is in its data section, a thread's
+  // (<eqx_fork_sized>, no code pin) is the pooled one <vm_switch> pins.
+  return addr >= th->stack_start && addr + nbytes <= th->stack_end;
+}
+
+// write <nbytes> from user address <buf> to <fd>.  the only fds atm
+// are the console (1 and 2), which we feed straight from the user's
+// buffer.  returns bytes written or -1.
+static int sys_write(eqx_th_t *th, int fd, uint32_t buf, uint32_t nbytes) {
+  if (fd != 1 && fd != 2)
+    return -1;
+  if (!user_range_ok(th, buf, nbytes, 0))
+    return -1;
+
+  const uint8_t *p = (const void *)buf;
+  for (unsigned i = 0; i < nbytes; i++)
+    uart_put8(p[i]);
+  return nbytes;
+}
+
+// read up to <nbytes> from <fd> (only the console, 0) into user
+// address <buf>: whatever has already arrived, like a unix tty.
+// never waits: returns 0 if nothing has, else bytes read or -1.
+// <sys_read_block> does the waiting.
+static int sys_read(eqx_th_t *th, int fd, uint32_t buf, uint32_t nbytes) {
+  if (fd != 0)
+    return -1;
+  if (!user_range_ok(th, buf, nbytes, 1))
+    return -1;
+
+  uint8_t *p = (void *)buf;
+  unsigned n = 0;
+  while (n < nbytes && uart_has_data())
+    p[n++] = uart_get8();
+  return n;
+}
+
+// the READ system call: if there's no input yet, <th> waits on
+// <con_waitq> instead of spinning here with interrupts off.  it's
+// rewound to its <swi> so it does the read again when woken.
+static int sys_read_block(eqx_th_t *th, int fd, uint32_t buf,
+                          uint32_t nbytes) {
+  int n = sys_read(th, fd, buf, nbytes);
+  if (n || !nbytes)
+    return n;
+  ktrace(KT_BLOCK, th->tid, EQX_SYS_READ << 16);
+  th->regs.regs[REGS_PC] -= 4;
+  eqx_th_append(&con_waitq, th);
+  eqx_pick_next_and_run();
+}
+
+// move <th>'s break by <incr> bytes, either way.  returns the old
+// break or -1.  the heap is what's left of the 1MB data section after
+// bss and the stack, and it isn't zeroed at exec: we zero each 4k page
+// the first time the break passes it, so shrinking and growing again
+// doesn't pay twice.
+static int sys_sbrk(eqx_th_t *th, int incr) {
+  if (!th->heap_start)
+    return -1;
+  uint32_t old = th->brk, brk = old + incr;
+  // the heap can grow to the end of the data section, or up to the
+  // stack if that sits above it (<eqx_exec_elf>).
+  uint32_t top = th->data_pin.va + MB(1);
+  if (th->stack_start > th->heap_start)
+    top = th->stack_start;
+  if (incr < 0 ? brk > old || brk < th->heap_start
+               : brk < old || brk > top)
+    return -1;
+
+  if (brk > th->brk_max) {
+    uint32_t max = pi_roundup(brk, 4096);
+    memset((void *)th->brk_max, 0, max - th->brk_max);
+    th->brk_max = max;
+  }
+  th->brk = brk;
+  return old;
+}
+
+// copy <th>'s pmu counts, including its current time slice, to user
+// address <buf>.  returns 0, or -1 if <buf> is bad or perf is off.
+static int sys_perf_read(eqx_th_t *th, uint32_t buf) {
+  // the user sees four words (libos.h:perf_t): the low 32 bits of the
+  // sums, which are fine for differences.
+  uint32_t u[4];
+  if (!perf_on_p || !user_range_ok(th, buf, sizeof u, 1))
+    return -1;
+  perf_acc_t a = th->perf;
+  if (perf_owner == th)
+    perf_acc_add(&a, perf_owner_start, perf_read());
+  u[0] = a.n;
+  u[1] = a.cyc;
+  u[2] = a.ev0;
+  u[3] = a.ev1;
+  memcpy((void *)buf, u, sizeof u);
+  return 0;
+}
+
+/****************************************************************
+ * batched system calls.
+ *
+ * a trap costs the exception entry, the checks in <equiv_syscall>
+ * and copying the registers out and back.  a program that does lots
+ * of tiny calls (a putc per character, small reads and writes) can
+ * pay that once for many calls instead: either an array of calls
+ * (EQX_SYS_BATCH) or submission/completion rings in its own memory
+ * (an <eqx_ring_t>) that EQX_SYS_RING_ENTER drains.
+ *
+ * batches run inside one system call, so only calls that return to
+ * the caller without blocking or switching threads are allowed.  a
+ * read in a batch doesn't wait: it returns 0 if there's no input.
+ */
+
+// one call from a batch, or the fast path: 0 if <sysno> isn't one
+// of the calls that always return to the caller.
+static int batch_call(eqx_th_t *th, uint32_t sysno, uint32_t a1, uint32_t a2,
+                      uint32_t a3, int32_t *res) {
+  switch (sysno) {
+  case EQX_SYS_PUTC:
+    uart_put8(a1);
+    *res = 0;
+    break;
+  case EQX_SYS_WRITE:
+    *res = sys_write(th, a1, a2, a3);
+    break;
+  case EQX_SYS_READ:
+    *res = sys_read(th, a1, a2, a3);
+    break;
+  case EQX_SYS_SBRK:
+    *res = sys_sbrk(th, a1);
+    break;
+  case EQX_SYS_GET_PID:
+    *res = th->tid;
+    break;
+  case EQX_SYS_PUT_HEX:
+    printk("%x", a1);
+    *res = 0;
+    break;
+  case EQX_SYS_PUT_INT:
+    printk("%d", a1);
+    *res = 0;
+    break;
+  case EQX_SYS_PERF_READ:
+    *res = sys_perf_read(th, a1);
+    break;
+  case EQX_SYS_GET_USEC:
+    *res = timer_get_usec();
+    break;
+  default:
+    return 0;
+  }
+  ktrace(KT_SYSCALL, th->tid, sysno);
+  return 1;
+}
+
+static int sys_batch(eqx_th_t *th, uint32_t calls, uint32_t n) {
+  if (n > MB(1) / sizeof(eqx_call_t) ||
+      !user_range_ok(th, calls, n * sizeof(eqx_call_t), 1))
+    return -1;
+  eqx_call_t *c = (void *)calls;
+  for (unsigned i = 0; i < n; i++)
+    if (!batch_call(th, c[i].sysno, c[i].a1, c[i].a2, c[i].a3, &c[i].res))
+      c[i].res = -1;
+  return n;
+}
+
+int eqx_fast_syscall_p = 1;
+
+// called from the trap (full-except-asm.S:syscall_full) with the
+// caller's r0-r3 and nothing saved.  the calls <batch_call> does
+// can't block or switch, so they don't need <equiv_syscall>'s
+// checks or a copy of the registers.  returns the result in the low
+// word and 1 in the high word, or 0 for the full path.
+uint64_t eqx_syscall_fast(uint32_t sysno, uint32_t a1, uint32_t a2,
+                          uint32_t a3) {
+  eqx_th_t *th = cur_thread;
+  if (!eqx_fast_syscall_p || !th)
+    return 0;
+  // a read that has to wait takes the full path.
+  if (sysno == EQX_SYS_READ && !uart_has_data())
+    return 0;
+  int32_t res;
+  perf_sys_begin(sysno);
+  int ok = batch_call(th, sysno, a1, a2, a3, &res);
+  perf_sys_end();
+  if (!ok)
+    return 0;
+  return 1ULL << 32 | (uint32_t)res;
+}
+
+static int sys_ring_setup(eqx_th_t *th, uint32_t ring) {
+  if (ring % 4 || !user_range_ok(th, ring, sizeof(eqx_ring_t), 1))
+    return -1;
+  th->ring = ring;
+  return 0;
+}
+
+// is <th>'s ring still mapped writable?  its window can be granted
+// away and a call can change the maps after <sys_ring_setup>.
+static int ring_ok(eqx_th_t *th) {
+  return th->ring && user_range_ok(th, th->ring, sizeof(eqx_ring_t), 1);
+}
+
+// run submissions until there are none or the completion ring is
+// full.  the ring is in user memory, so trust nothing but the
+// indices mod the size.
+static int sys_ring_enter(eqx_th_t *th) {
+  if (!ring_ok(th))
+    return -1;
+  eqx_ring_t *r = (void *)th->ring;
+  unsigned n = 0;
+  while (r->sq_head != r->sq_tail && r->cq_tail - r->cq_head < EQX_RING_N) {
+    eqx_sqe_t e = r->sq[r->sq_head % EQX_RING_N];
+    r->sq_head++;
+    eqx_cqe_t *c = &r->cq[r->cq_tail % EQX_RING_N];
+    c->user_data = e.user_data;
+    int32_t res;
+    if (!batch_call(th, e.sysno, e.a1, e.a2, e.a3, &res))
+      res = -1;
+    if (!ring_ok(th))
+      return -1;
+    c->res = res;
+    r->cq_tail++;
+    n++;
+  }
+  return n;
+}
+
 // our two system calls:
 //   - exit: get the next thread if there is one.
 //   - putc: so we can handle race conditions with prints
-static int equiv_syscall_handler(regs_t *r) {
+static int equiv_syscall(regs_t *r) {
   if (interrupts_on_p())
     panic("interrupts are enabled!\n");
 
@@ -251,6 +1191,7 @@ static int equiv_syscall_handler(regs_t *r) {
   th->regs = *r;
 
   unsigned sysno = r->regs[0];
+  ktrace(KT_SYSCALL, th->tid, sysno);
   switch (sysno) {
 
   case EQX_SYS_EXIT: {
@@ -268,16 +1209,29 @@ static int equiv_syscall_handler(regs_t *r) {
     eqx_th_t *child = kmalloc(sizeof(eqx_th_t));
     memcpy(child, th, sizeof(eqx_th_t));
     child->tid = ntids++;
+    child->perf = (perf_acc_t){0};
+    if (th->stack)
+      stack_dup(child, th);
+    child->held = 0;
+    child->prio = child->base_prio;
+    // no window, mail or senders of its own.
+    child->ipc_pin = (map_t){0};
+    child->ipc_sendq = (rq_t){0};
+    child->mbox = 0;
+    child->all_next = eqx_all;
+    eqx_all = child;
 
     uint32_t new_code_pa = 0, new_data_pa = 0;
-    if (th->code_pin.pa) {
+    if (exec_code_shared(th))
+      sec_ref(th->code_pin.pa >> 20);
+    else if (th->code_pin.pa) {
       new_code_pa = sec_to_addr(sec_alloc());
     }
     if (th->data_pin.pa) {
       new_data_pa = sec_to_addr(sec_alloc());
     }
 
-    if (th->code_pin.pa) {
+    if (new_code_pa) {
       memcpy((void *)new_code_pa, (void *)th->code_pin.pa, MB(1));
       child->code_pin.pa = new_code_pa;
     }
@@ -288,12 +1242,18 @@ static int equiv_syscall_handler(regs_t *r) {
     uint32_t child_asid = get_free_asid();
     child->code_pin.attr.asid = child_asid;
     child->data_pin.attr.asid = child_asid;
+    // shared, not copied.
+    if (th->shm) {
+      sec_ref(th->shm->sec);
+      child->shm_pin.attr.asid = child_asid;
+    }
 
     clean_dcache();
     prefetch_flush();
 
     child->regs.regs[REGS_R0] = 0;
     th->regs.regs[REGS_R0] = child->tid;
+    ktrace(KT_FORK, th->tid, child->tid);
 
     eqx_th_push(&eqx_runq, child);
     vm_on(child_asid);
@@ -304,7 +1264,15 @@ static int equiv_syscall_handler(regs_t *r) {
   case EQX_SYS_EXEC: {
     vm_off();
     struct prog *p = (void *)r->regs[0];
-    eqx_th_t *new_th = eqx_exec_internal(p);
+    // the old image is gone: give up its mutexes like exit does.
+    sync_exit(th);
+    ipc_exit(th);
+    shm_exit(th);
+    // the ring was in the old image's memory.
+    th->ring = 0;
+    // <p> is the caller's memory, which can change under the same
+    // address: don't cache it.
+    eqx_th_t *new_th = exec_prog(p, 0);
     vm_on(new_th->code_pin.attr.asid);
     new_th->tid = th->tid;
     cur_thread = eqx_th_pop(&eqx_runq);
@@ -319,8 +1287,13 @@ static int equiv_syscall_handler(regs_t *r) {
     break;
   }
   case EQX_SYS_SBRK: {
-    panic("sbrk not implemented\n");
-    break;
+    return sys_sbrk(th, r->regs[1]);
+  }
+  case EQX_SYS_WRITE: {
+    return sys_write(th, r->regs[1], r->regs[2], r->regs[3]);
+  }
+  case EQX_SYS_READ: {
+    return sys_read_block(th, r->regs[1], r->regs[2], r->regs[3]);
   }
   case EQX_SYS_ABORT: {
     panic("abort not implemented\n");
@@ -346,6 +1319,54 @@ static int equiv_syscall_handler(regs_t *r) {
     return th->tid;
     break;
   }
+  case EQX_SYS_PERF_READ: {
+    return sys_perf_read(th, r->regs[1]);
+  }
+  case EQX_SYS_GET_USEC: {
+    return timer_get_usec();
+  }
+  case EQX_SYS_MUTEX_NEW:
+  case EQX_SYS_MUTEX_LOCK:
+  case EQX_SYS_MUTEX_UNLOCK:
+  case EQX_SYS_COND_NEW:
+  case EQX_SYS_COND_WAIT:
+  case EQX_SYS_COND_SIGNAL:
+  case EQX_SYS_COND_BROADCAST:
+  case EQX_SYS_SEM_NEW:
+  case EQX_SYS_SEM_WAIT:
+  case EQX_SYS_SEM_POST:
+  case EQX_SYS_SET_PRIO: {
+    return sync_syscall(th, sysno, r->regs[1], r->regs[2]);
+  }
+  case EQX_SYS_IPC_SEND:
+  case EQX_SYS_IPC_POST:
+  case EQX_SYS_IPC_RECV:
+  case EQX_SYS_IPC_WINDOW: {
+    // recv writes the message into r2-r5.
+    int ret = ipc_syscall(th, sysno);
+    *r = th->regs;
+    return ret;
+  }
+  case EQX_SYS_SHM_MAP: {
+    return shm_map(th, r->regs[1]);
+  }
+  case EQX_SYS_SHM_UNMAP: {
+    return shm_unmap(th);
+  }
+  case EQX_SYS_RING_SETUP: {
+    return sys_ring_setup(th, r->regs[1]);
+  }
+  case EQX_SYS_RING_ENTER: {
+    return sys_ring_enter(th);
+  }
+  case EQX_SYS_BATCH: {
+    return sys_batch(th, r->regs[1], r->regs[2]);
+  }
+  case EQX_SYS_YIELD: {
+    th->regs.regs[REGS_R0] = 0;
+    eqx_th_append(&eqx_runq, th);
+    eqx_pick_next_and_run();
+  }
   default: {
     panic("illegal system call: %d\n", sysno);
     break;
@@ -360,11 +1381,22 @@ static int equiv_syscall_handler(regs_t *r) {
   return 0;
 }
 
+// charge each system call that returns here to its number: the ones
+// that switch away (exit, exec) are closed in <eqx_run_current>.
+static int equiv_syscall_handler(regs_t *r) {
+  perf_sys_begin(r->regs[0]);
+  int ret = equiv_syscall(r);
+  perf_sys_end();
+  return ret;
+}
+
 //******************************************************
 // simple 1MB allocation/deallocation.
 
 enum { MAX_SECS = 512 }; // can't ever be bigger than this.
 static uint32_t sections[MAX_SECS];
+// the kernel's identity mapped sections (<pin_ident>).
+static uint8_t sec_pinned[MAX_SECS];
 // actual number of 1mb sections [will be smaller than 512mb]
 static uint32_t nsec;
 
@@ -374,6 +1406,7 @@ void sec_alloc_init(unsigned n) {
   assert(n > 0 && n <= MAX_SECS);
   nsec = n;
   memset(sections, 0, sizeof sections);
+  memset(sec_pinned, 0, sizeof sec_pinned);
 }
 
 // within [0..nsec)
@@ -433,10 +1466,18 @@ static long sec_alloc(void) {
 static long sec_free(uint32_t s) {
   assert(sec_is_legal(s));
   if (!sections[s])
-    panic("section %d is not allocated!\n");
+    panic("section %d is not allocated!\n", s);
   return --sections[s];
 }
 
+// one more user of allocated section <s> (eg a shared region).
+static void sec_ref(uint32_t s) {
+  assert(sec_is_legal(s));
+  if (!sections[s])
+    panic("section %d is not allocated!\n", s);
+  sections[s]++;
+}
+
 /**********************************************************************
  * vm code.
  */
@@ -484,6 +1525,7 @@ void pin_ident(unsigned idx, uint32_t addr, pin_t attr) {
   if (attr.pagesize == PAGE_16MB) {
     assert(sec_is_legal(secn + 15));
     assert(sec_alloc_exact_16mb(secn));
+    memset(&sec_pinned[secn], 1, 16);
     pin_map(idx, addr, addr, attr);
     return;
   }
@@ -491,6 +1533,7 @@ void pin_ident(unsigned idx, uint32_t addr, pin_t attr) {
   if (attr.pagesize == PAGE_1MB) {
     assert(sec_is_legal(secn));
     assert(sec_alloc_exact_1mb(secn));
+    sec_pinned[secn] = 1;
     pin_map(idx, addr, addr, attr);
     return;
   }
@@ -504,6 +1547,25 @@ static void vm_switch(eqx_th_t *th) {
   if (!config.vm_use_pin_p)
     return;
 
+  // they share pin_idx+2: <shm_map> and the ipc calls keep a
+  // process from having both.
+  assert(!(th->ipc_pin.pa && th->shm));
+
+  // a pooled stack is pinned alone, without the user pins: a
+  // program's va could be one of the stack sections.
+  if (th->stack) {
+    pin_clear(pin_idx);
+    pin_clear(pin_idx + 1);
+    stack_pin(th->stack);
+  } else if (th->ipc_pin.pa) {
+    let p = &th->ipc_pin;
+    pin_map(pin_idx + 2, p->va, p->pa, p->attr);
+  } else if (th->shm) {
+    let p = &th->shm_pin;
+    pin_map(pin_idx + 2, p->va, p->pa, p->attr);
+  } else
+    pin_clear(pin_idx + 2);
+
   // right now don't have any pinning: just running an
   // idenity map.
   if (!th->code_pin.va)
@@ -553,8 +1615,10 @@ static void vm_init(void) {
   pin_t dev = pin_16mb(pin_mk_global(dom_kern, no_user, MEM_device));
   pin_mmu_sec(idx++, SEG_BCM_0, SEG_BCM_0, dev);
 
-  // next index avail
+  // next index avail: the user code and data pins, then a pooled
+  // stack's or (for a process) its ipc window or shared region.
   pin_idx = idx;
+  assert(pin_idx + 2 < 8);
 
 #if 0
     enum { ASID1 = 1, ASID2 = 2 };
@@ -571,6 +1635,145 @@ static void vm_init(void) {
 #endif
 }
 
+/**********************************************************************
+ * thread stacks.
+ *
+ * <eqx_fork_sized> stacks come from a pool instead of the heap.  each
+ * one is exactly one 4k, 64k or 1mb tlb page, carved out of 1MB
+ * sections (<sec_alloc>) that are never mapped globally: <vm_switch>
+ * pins just the running thread's stack.  so the rest of its section
+ * (and the unmapped section below it) is a guard, and an overflow
+ * faults on the first access past the end instead of being noticed
+ * at the next system call (<eqx_check_sp>).  the kernel doesn't
+ * touch pooled stacks except fork, which copies one with the mmu off.
+ *
+ * exit puts a stack back on its size's free list.  sections are
+ * never given back.
+ */
+typedef struct eqx_stack {
+  uint32_t base;
+  unsigned cls;
+  struct eqx_stack *next;
+} eqx_stack_t;
+
+enum { STK_4K, STK_64K, STK_1MB, STK_NCLASS };
+static const struct {
+  uint32_t nbytes;
+  unsigned pagesize;
+} stk_class[STK_NCLASS] = {
+    [STK_4K] = {_4k, PAGE_4K},
+    [STK_64K] = {_64k, PAGE_64K},
+    [STK_1MB] = {_1mb, PAGE_1MB},
+};
+static eqx_stack_t *stk_free[STK_NCLASS];
+static unsigned stk_nsec;
+
+static unsigned stack_class(uint32_t nbytes) {
+  for (unsigned c = 0; c < STK_NCLASS; c++)
+    if (nbytes <= stk_class[c].nbytes)
+      return c;
+  panic("stack of %d bytes: the biggest is 1MB\n", nbytes);
+}
+
+static eqx_stack_t *stack_alloc(uint32_t nbytes) {
+  unsigned c = stack_class(nbytes);
+  if (!stk_free[c]) {
+    // the section below must not be mapped or the bottom stack's
+    // guard would be kernel memory: keep any such section as a guard.
+    long sec;
+    while (sec_pinned[(sec = sec_alloc()) - 1])
+      ;
+    stk_nsec++;
+
+    uint32_t base = sec_to_addr(sec), sz = stk_class[c].nbytes;
+    unsigned n = MB(1) / sz;
+    eqx_stack_t *s = kmalloc(n * sizeof *s);
+    for (unsigned i = 0; i < n; i++) {
+      s[i] = (eqx_stack_t){.base = base + i * sz, .cls = c, .next = stk_free[c]};
+      stk_free[c] = &s[i];
+    }
+  }
+  eqx_stack_t *s = stk_free[c];
+  stk_free[c] = s->next;
+  s->next = 0;
+  return s;
+}
+
+static void stack_free(eqx_stack_t *s) {
+  assert(!s->next);
+  s->next = stk_free[s->cls];
+  stk_free[s->cls] = s;
+}
+
+// fork with a stack from the pool.
+eqx_th_t *eqx_fork_sized(void (*fn)(void *), void *arg, uint32_t nbytes) {
+  // no sections to carve without pinned vm.
+  if (!config.vm_use_pin_p) {
+    nbytes = pi_roundup(nbytes, 8);
+    void *stack = kmalloc_aligned(nbytes, 8);
+    return eqx_fork_stack(fn, arg, stack, nbytes);
+  }
+  eqx_stack_t *s = stack_alloc(nbytes);
+  eqx_th_t *th =
+      eqx_fork_stack(fn, arg, (void *)s->base, stk_class[s->cls].nbytes);
+  th->stack = s;
+  return th;
+}
+
+// give forked <child> its own copy of <parent>'s stack.  the copy is
+// at a different address: we move <sp> and <fp>, but any other
+// pointer into the stack still points at the parent's.
+static void stack_dup(eqx_th_t *child, eqx_th_t *parent) {
+  assert(!mmu_is_enabled());
+  eqx_stack_t *s = stack_alloc(stk_class[parent->stack->cls].nbytes);
+  uint32_t nbytes = parent->stack_end - parent->stack_start;
+  memcpy((void *)s->base, (void *)parent->stack_start, nbytes);
+
+  uint32_t delta = s->base - parent->stack_start;
+  child->stack = s;
+  child->stack_start += delta;
+  child->stack_end += delta;
+  child->regs.regs[REGS_SP] += delta;
+  uint32_t fp = child->regs.regs[11];
+  if (fp >= parent->stack_start && fp <= parent->stack_end)
+    child->regs.regs[11] += delta;
+}
+
+// the running thread's stack: user r/w, global since only one is
+// ever pinned.
+static void stack_pin(eqx_stack_t *s) {
+  pin_t attr = pin_mk_global(dom_user, perm_rw_user, MEM_uncached);
+  attr.pagesize = stk_class[s->cls].pagesize;
+  pin_map(pin_idx + 2, s->base, s->base, attr);
+}
+
+// an access just outside a pooled stack is an overflow (or
+// underflow): kill the thread rather than the kernel.
+cp_asm_get(eqx_far, p15, 0, c6, c0, 0);
+static full_except_t prev_data_abort;
+
+static void eqx_data_abort(regs_t *r) {
+  uint32_t far = eqx_far_get(), pc = r->regs[REGS_PC];
+  eqx_th_t *th = cur_thread;
+  if (th && th->stack && mode_get(r->regs[REGS_CPSR]) == USER_MODE) {
+    const char *what = 0;
+    if (far < th->stack_start && far >= th->stack_start - MB(1))
+      what = "overflowed";
+    else if (far >= th->stack_end && far < th->stack_end + MB(1))
+      what = "underflowed";
+    if (what) {
+      output("thread %d %s its %dk stack [%x,%x): addr=%x, pc=%x\n", th->tid,
+             what, stk_class[th->stack->cls].nbytes / 1024, th->stack_start,
+             th->stack_end, far, pc);
+      th->regs = *r;
+      sys_exit(th, -1);
+    }
+  }
+  if (!prev_data_abort)
+    panic("data abort: addr=%x, pc=%x\n", far, pc);
+  prev_data_abort(r);
+}
+
 static void vm_on(uint32_t asid) {
   if (!config.vm_use_pin_p)
     return;
@@ -606,7 +1809,7 @@ uint32_t eqx_run_threads(void) {
 
   // for today we don't expect an empty runqueue,
   // but you can certainly get rid of this if prefer.
-  cur_thread = eqx_th_pop(&eqx_runq);
+  cur_thread = rq_pop_best(&eqx_runq);
   if (!cur_thread)
     panic("empty run queue?\n");
 
@@ -625,10 +1828,22 @@ uint32_t eqx_run_threads(void) {
   vm_on(cur_thread->code_pin.attr.asid);
   vm_switch(cur_thread);
 
+  if (config.pc_prof_p && !pc_prof_on_p) {
+    let code = &cur_thread->code_pin;
+    demand(code->va, "no code section to profile: call pc_prof_init\n");
+    pc_prof_init(code->va, code->va + MB(1));
+  }
+  ticks_per_quantum = 1;
+  if (pc_prof_on_p && config.prof_per_quantum > 1)
+    ticks_per_quantum = config.prof_per_quantum;
+  demand(ticks_per_quantum <= TIMER_4MS_LOAD, "prof_per_quantum=%d too big\n",
+         ticks_per_quantum);
+  ntick = 0;
+
   // Initialize and start timer interrupts.
   PUT32(IRQ_Disable_Basic, ARM_Timer_IRQ);
   dev_barrier();
-  PUT32(ARM_Timer_Load, TIMER_4MS_LOAD);
+  PUT32(ARM_Timer_Load, TIMER_4MS_LOAD / ticks_per_quantum);
   // 32-bit timer, interrupt enabled, timer enabled, prescale 256
   PUT32(ARM_Timer_Control, (1 << 1) | (1 << 5) | (1 << 7) | (2 << 2));
   PUT32(IRQ_Enable_Basic, ARM_Timer_IRQ);
@@ -655,6 +1870,17 @@ uint32_t eqx_run_threads(void) {
   assert(!eqx_runq.tail);
 
   eqx_trace("done running threads\n");
+  // each run's dump holds only its own events.
+  if (config.ktrace_p) {
+    ktrace_dump();
+    ktrace_reset();
+  }
+  if (config.pc_prof_p)
+    pc_prof_dump(0);
+  if (config.perf_p) {
+    perf_on_p = 0;
+    perf_dump();
+  }
   return 0;
 }
 
@@ -685,6 +1911,14 @@ void eqx_init_config(eqx_config_t c) {
   // full_except_set_prefetch(equiv_single_step_handler);
   // for system calls (like many labs)
   full_except_set_syscall(equiv_syscall_handler);
+  prev_data_abort = full_except_set_data_abort(eqx_data_abort);
+
+  if (config.ktrace_p)
+    ktrace_init();
+  // start now so the fs work done before <eqx_run_threads> (loading
+  // programs) shows up in the path totals.
+  if (config.perf_p)
+    perf_start(config.perf_group);
 
   vm_init();
 }
@@ -706,9 +1940,108 @@ static inline map_t map_mk(uint32_t va, uint32_t pa, pin_t attr) {
 
 static inline uint32_t sec_to_addr(uint32_t sec) { return (sec << 20); }
 
-eqx_th_t *eqx_exec_internal(struct prog *prog) {
+/****************************************************************
+ * exec cache.
+ *
+ * exec used to copy a program's code into a fresh section every
+ * time, and <eqx_exec_file> re-read the whole file from the card.
+ * now:
+ *   - the code section of an image (keyed by where the image is in
+ *     kernel memory) is loaded once and kept: the cache holds a ref
+ *     on it.  only images nobody can change are keyed this way: the
+ *     compiled-in <struct prog>s and the files <exec_files> owns.
+ *     every process running the image maps it read-only under its
+ *     own asid, and fork shares it rather than copy it.  only data
+ *     and bss are copied per exec.
+ *   - files stay in memory keyed by name, first cluster and size,
+ *     so exec of a file we've read doesn't touch the card.  our fat32
+ *     has no modification times, so a rewrite that keeps all three
+ *     the same isn't noticed.  one that doesn't replaces the entry
+ *     and drops the old code section.
+ * otherwise nothing is evicted: once a table is full we stop caching.
+ */
+enum { EXEC_CACHE_N = 16 };
+
+static struct {
+  const void *image;
+  uint32_t code_sec;
+} exec_code[EXEC_CACHE_N];
+
+static struct {
+  char name[16];
+  uint32_t cluster, nbytes;
+  pi_file_t *f;
+} exec_files[EXEC_CACHE_N];
+
+static exec_cache_stats_t exec_stats;
+
+exec_cache_stats_t eqx_exec_cache_stats(void) { return exec_stats; }
+
+// forget the code section cached for <image>: processes running it
+// keep their own refs.
+static void exec_code_drop(const void *image) {
+  unsigned i, n;
+  for (n = 0; n < EXEC_CACHE_N && exec_code[n].image; n++)
+    ;
+  for (i = 0; i < n && exec_code[i].image != image; i++)
+    ;
+  if (i == n)
+    return;
+  sec_free(exec_code[i].code_sec);
+  // lookups stop at the first empty slot: keep the table packed.
+  exec_code[i] = exec_code[n - 1];
+  exec_code[n - 1].image = 0;
+}
+
+// is <th>'s code section a cached one that others share?
+static int exec_code_shared(eqx_th_t *th) {
+  return th->code_pin.pa && th->code_pin.attr.AP_perm == perm_ro_user;
+}
+
+// give process <p> a fresh data section and a code section, mapped
+// at <code_va> and <data_va> under a new asid.  the code section is
+// the cached one for <image> if there is one, and is cached if not
+// (<image> = 0: never).  returns 1 if the code still has to be
+// loaded.
+static int exec_map(eqx_th_t *p, const void *image, uint32_t code_va,
+                    uint32_t data_va) {
+  // we don't care which sectors we use.
+  uint32_t data = sec_to_addr(sec_alloc());
+  uint32_t asid = get_free_asid();
+  pin_t user_attr = pin_mk_user(dom_user, asid, perm_rw_user, MEM_uncached);
+  p->data_pin = map_mk(data_va, data, user_attr);
+
+  unsigned i = 0;
+  if (image)
+    for (; i < EXEC_CACHE_N && exec_code[i].image; i++)
+      if (exec_code[i].image == image)
+        break;
+  int cache_p = image && i < EXEC_CACHE_N;
+
+  if (!cache_p) {
+    p->code_pin = map_mk(code_va, sec_to_addr(sec_alloc()), user_attr);
+    return 1;
+  }
+
+  pin_t code_attr = pin_mk_user(dom_user, asid, perm_ro_user, MEM_uncached);
+  int load_p = !exec_code[i].image;
+  if (load_p) {
+    exec_code[i].image = image;
+    exec_code[i].code_sec = sec_alloc();
+    exec_stats.code_misses++;
+  } else
+    exec_stats.code_hits++;
+  // the cache keeps the ref <sec_alloc> gave it: this one is <p>'s.
+  sec_ref(exec_code[i].code_sec);
+  p->code_pin = map_mk(code_va, sec_to_addr(exec_code[i].code_sec), code_attr);
+  return load_p;
+}
+
+// exec <prog>: cached unless <cache_p> is 0.
+static eqx_th_t *exec_prog(struct prog *prog, int cache_p) {
   assert(prog);
-  output("EXEC: progname=<%s>, nbytes=%d\n", prog->name, prog->nbytes);
+  eqx_trace("progname=<%s>, nbytes=%d\n", prog->name, prog->nbytes);
+  ktrace(KT_EXEC, cur_thread ? cur_thread->tid : 0, prog->nbytes);
   small_prog_hdr_t s = small_prog_hdr_mk((void *)prog->code);
   // ensure that code and data are aligned to 1MB.
   assert(s.data_addr % MB(1) == 0);
@@ -725,6 +2058,7 @@ eqx_th_t *eqx_exec_internal(struct prog *prog) {
   // currently: vm not turned on, so we can copy whatever.
 
   uint32_t data = 0, code = 0;
+  int load_code = 1;
 
   // note: if we aren't going to turn on at all,
   // need to map the exact sections.
@@ -733,29 +2067,200 @@ eqx_th_t *eqx_exec_internal(struct prog *prog) {
     code = s.code_addr;
     panic("what\n");
   } else {
-    // we don't care which sectors we use.
-    data = sec_to_addr(sec_alloc());
-    code = sec_to_addr(sec_alloc());
-
-    uint32_t asid = get_free_asid();
-
-    pin_t user_attr = pin_mk_user(dom_user, asid, perm_rw_user, MEM_uncached);
-    p->data_pin = map_mk(s.data_addr, data, user_attr);
-    p->code_pin = map_mk(s.code_addr, code, user_attr);
-    p->code_pin.attr.asid = asid;
-    p->data_pin.attr.asid = asid;
+    load_code = exec_map(p, cache_p ? prog : 0, s.code_addr, s.data_addr);
+    data = p->data_pin.pa;
+    code = p->code_pin.pa;
   }
 
   unsigned offset = s.bss_addr - s.data_addr;
   assert(offset < MB(1));
 
+  // the heap starts past both bss and the stack.
+  uint32_t end = s.bss_addr + s.bss_nbytes;
+  if (end < p->stack_end)
+    end = p->stack_end;
+  p->heap_start = p->brk = p->brk_max = pi_roundup(end, 8);
+  assert(p->heap_start < s.data_addr + MB(1));
+
   // this either needs mmu off, or needs to turn it off.
   assert(!mmu_is_enabled());
   gcc_mb();
   memset((void *)data + offset, 0, s.bss_nbytes);
   memcpy((void *)data, data_src, s.data_nbytes);
-  memcpy((void *)code, code_src, s.code_nbytes);
+  if (load_code)
+    memcpy((void *)code, code_src, s.code_nbytes);
   gcc_mb();
 
   return p;
 }
+
+eqx_th_t *eqx_exec_internal(struct prog *prog) {
+  return exec_prog(prog, 1);
+}
+
+/****************************************************************
+ * elf executables.
+ *
+ * load a static elf executable (the .elf next to each user-progs
+ * .bin) instead of a byte array compiled into the kernel.  the
+ * PT_LOAD segments can be any number and any size, as long as each
+ * one is in the 1MB section holding the entry point (mapped as the
+ * code pin) or in one other section (the data pin).  the stack goes
+ * at the top of the data section and the heap starts past the last
+ * segment in it.
+ */
+
+// a section a process can't use: the kernel's pins, and the
+// windows <vm_switch> maps the ipc and shm regions at.  the heap is
+// one 16MB supersection, so every section in it is taken.
+static int exec_sec_ok(uint32_t va) {
+  if (va >= SEG_HEAP && va < SEG_HEAP + MB(16))
+    return 0;
+  switch (va) {
+  case SEG_CODE:
+  case SEG_STACK:
+  case SEG_INT_STACK:
+  case SEG_BCM_0:
+  case SEG_BCM_1:
+  case SEG_BCM_2:
+  case IPC_WINDOW_VA:
+  case SHM_VA:
+    return 0;
+  }
+  return 1;
+}
+
+// does segment <s> get loaded?  small-proc.ld links the header
+// <eqx_exec_internal> reads into its own segment at va 0: it's not
+// part of the program.
+static int elf_seg_loaded(const char *name, const void *image,
+                          uint32_t nbytes, const elf32_phdr_t *s) {
+  if (s->type != PT_LOAD || !s->memsz)
+    return 0;
+  if (s->filesz > s->memsz || s->offset + s->filesz < s->offset ||
+      s->offset + s->filesz > nbytes)
+    panic("<%s>: bad segment: offset=%d, filesz=%d, memsz=%d\n", name,
+          s->offset, s->filesz, s->memsz);
+  if (s->vaddr == 0 && s->filesz >= 4 &&
+      *(uint32_t *)(image + s->offset) == 0xfaf0faf0)
+    return 0;
+  return 1;
+}
+
+// <cache_p>: <image> is owned by <exec_files>, so its code can be
+// cached.
+static eqx_th_t *exec_elf(const char *name, const void *image,
+                          uint32_t nbytes, int cache_p) {
+  assert(image);
+  eqx_trace("elf=<%s>, nbytes=%d\n", name, nbytes);
+  ktrace(KT_EXEC, cur_thread ? cur_thread->tid : 0, nbytes);
+  demand(config.vm_use_pin_p, "elf exec needs pinned vm\n");
+
+  let h = elf_hdr_mk(name, image, nbytes);
+  let ph = elf_phdrs(image, h);
+  enum { SEC_MASK = ~(MB(1) - 1), PAGE = 4096 };
+
+  // pick the two sections and check every segment fits in one.
+  uint32_t code_va = h.entry & SEC_MASK, data_va = 0, data_end = 0;
+  unsigned nload = 0, code_w = 0;
+  for (unsigned i = 0; i < h.phnum; i++) {
+    let s = &ph[i];
+    if (!elf_seg_loaded(name, image, nbytes, s))
+      continue;
+    nload++;
+    uint32_t sec = s->vaddr & SEC_MASK, end = s->vaddr + s->memsz;
+    if (end < s->vaddr || end > sec + MB(1))
+      panic("<%s>: segment [%x,%x) crosses a 1MB section\n", name, s->vaddr,
+            end);
+    if (sec == code_va) {
+      code_w |= s->flags & PF_W;
+      continue;
+    }
+    if (data_va && sec != data_va)
+      panic("<%s>: segments in three sections: %x, %x and %x\n", name,
+            code_va, data_va, sec);
+    data_va = sec;
+    if (end > data_end)
+      data_end = end;
+  }
+  demand(nload, "<%s>: no segments to load\n", name);
+  if (!data_va)
+    data_end = data_va = code_va + MB(1);
+  if (!exec_sec_ok(code_va) || !exec_sec_ok(data_va))
+    panic("<%s>: sections %x and %x overlap the kernel's\n", name, code_va,
+          data_va);
+
+  uint32_t stack = data_va + MB(1) - eqx_stack_size;
+  if (data_end > stack)
+    panic("<%s>: data ends at %x, past the stack at %x\n", name, data_end,
+          stack);
+
+  let p = eqx_fork_stack((void *)h.entry, 0, (void *)stack, eqx_stack_size);
+  // a writable segment in the code section can't be shared.
+  int load_code =
+      exec_map(p, cache_p && !code_w ? image : 0, code_va, data_va);
+  p->heap_start = p->brk = p->brk_max = pi_roundup(data_end, 8);
+
+  // zero every page a segment touches, then copy: two segments can
+  // share a page, so can't zero as we go.
+  assert(!mmu_is_enabled());
+  for (unsigned pass = 0; pass < 2; pass++) {
+    for (unsigned i = 0; i < h.phnum; i++) {
+      let s = &ph[i];
+      if (!elf_seg_loaded(name, image, nbytes, s))
+        continue;
+      int code_p = (s->vaddr & SEC_MASK) == code_va;
+      if (code_p && !load_code)
+        continue;
+      let m = code_p ? &p->code_pin : &p->data_pin;
+      uint32_t pa = m->pa + (s->vaddr - m->va);
+      if (pass == 0) {
+        uint32_t lo = pa & ~(PAGE - 1), hi = pi_roundup(pa + s->memsz, PAGE);
+        memset((void *)lo, 0, hi - lo);
+      } else
+        memcpy((void *)pa, image + s->offset, s->filesz);
+    }
+  }
+  gcc_mb();
+  return p;
+}
+
+// the caller's buffer can be reused for something else: don't cache.
+eqx_th_t *eqx_exec_elf(const char *name, const void *image,
+                       uint32_t nbytes) {
+  return exec_elf(name, image, nbytes, 0);
+}
+
+// read <name> from directory <dir> (or the exec cache) and exec it.
+eqx_th_t *eqx_exec_file(fat32_fs_t *fs, pi_dirent_t *dir, char *name) {
+  pi_dirent_t *d = fat32_stat(fs, dir, name);
+  if (!d)
+    panic("can't find <%s>\n", name);
+
+  unsigned i;
+  for (i = 0; i < EXEC_CACHE_N && exec_files[i].f; i++)
+    if (strcmp(exec_files[i].name, name) == 0)
+      break;
+  let e = i < EXEC_CACHE_N ? &exec_files[i] : 0;
+  if (e && e->f && e->cluster == d->cluster_id && e->nbytes == d->nbytes) {
+    exec_stats.file_hits++;
+    return exec_elf(name, e->f->data, e->f->n_data, 1);
+  }
+
+  pi_file_t *f = fat32_read(fs, dir, name);
+  if (!f)
+    panic("can't read <%s>\n", name);
+  exec_stats.file_misses++;
+  // no room, or the name doesn't fit: exec it uncached.
+  if (!e || strlen(name) >= sizeof e->name)
+    return exec_elf(name, f->data, f->n_data, 0);
+
+  // rewritten since we read it.
+  if (e->f)
+    exec_code_drop(e->f->data);
+  memcpy(e->name, name, strlen(name) + 1);
+  e->cluster = d->cluster_id;
+  e->nbytes = d->nbytes;
+  e->f = f;
+  return exec_elf(name, f->data, f->n_data, 1);
+}
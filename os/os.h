@@ -5,6 +5,8 @@
 //libpi
 #include "rpi.h"
 #include "full-except.h"
+#include "ktrace.h"
+#include "pc-prof.h"
 
 //os
 #include "eqx-threads.h"
@@ -17,6 +19,10 @@
 //vm
 #include "vm/memmap-default.h"
 
+//fs
+#include "fs/fat32.h"
+#include "elf.h"
+
 
 // #include "rpi-interrupts.h"
 
@@ -63,11 +69,35 @@ typedef struct {
              // exclusive: use pin, use pt, or use nothing.
              vm_off_p:1,    // implies the others are off.
              vm_use_pin_p:1,
-             vm_use_pt_p:1
+             vm_use_pt_p:1,
+
+             // record scheduling/syscall events in the binary
+             // trace ring and dump it when <eqx_run_threads> is done.
+             ktrace_p:1,
+
+             // sample user pcs from the timer interrupt (<pc-prof.h>)
+             // and dump the profile when <eqx_run_threads> is done.
+             // profiles the first thread's code section unless
+             // <pc_prof_init> was already called.
+             pc_prof_p:1,
+
+             // count pmu events per thread, per system call and for
+             // the sd/fat32 paths and print them when
+             // <eqx_run_threads> is done.
+             perf_p:1
 
             ;
     unsigned ramMB;           // default is 128MB
 
+    // pc samples per scheduling quantum when profiling (0 = 1): the
+    // timer runs this many times faster but we only switch threads
+    // once per quantum.
+    unsigned prof_per_quantum;
+
+    // which pair of events to count with <perf_p>: PERF_GROUP_CACHE
+    // (default) or PERF_GROUP_TLB.  the pmu only has two counters.
+    unsigned perf_group;
+
     // unsigned user_idx;
 } eqx_config_t;
 
@@ -85,6 +115,11 @@ eqx_th_t *eqx_fork(void (*fn)(void *), void *arg);
 eqx_th_t *eqx_fork_nostack(void (*fn)(void *), void *arg);
 static __attribute__((noreturn)) void eqx_pick_next_and_run(void);
 static __attribute__((noreturn)) void sys_exit(eqx_th_t *th, int exitcode);
+static void ipc_exit(eqx_th_t *th);
+static void shm_exit(eqx_th_t *th);
+static int user_range_ok(eqx_th_t *th, uint32_t addr, uint32_t nbytes,
+                         int write_p);
+static int equiv_syscall(regs_t *r);
 static int equiv_syscall_handler(regs_t *r);
 void sec_alloc_init(unsigned n);
 static int sec_is_legal(uint32_t s);
@@ -93,19 +128,38 @@ static int sec_alloc_exact_16mb(uint32_t s);
 static int sec_is_alloced(uint32_t pa);
 static long sec_alloc(void);
 static long sec_free(uint32_t s);
+static void sec_ref(uint32_t s);
 static void init_asid_map(void);
 static uint32_t get_free_asid(void);
 static void free_asid(uint32_t asid);
 static void pin_map(unsigned idx, uint32_t va, uint32_t pa, pin_t attr);
 void pin_ident(unsigned idx, uint32_t addr, pin_t attr);
+static struct eqx_stack *stack_alloc(uint32_t nbytes);
+static void stack_free(struct eqx_stack *s);
+static void stack_dup(eqx_th_t *child, eqx_th_t *parent);
+static void stack_pin(struct eqx_stack *s);
 static void vm_switch(eqx_th_t *th);
 static void vm_init(void);
 static void vm_on(uint32_t asid);
 static void vm_off(void);
+static int exec_code_shared(eqx_th_t *th);
+static eqx_th_t *exec_prog(struct prog *prog, int cache_p);
 uint32_t eqx_run_threads(void);
 void eqx_init_config(eqx_config_t c);
 void eqx_init(void);
 static inline map_t map_mk(uint32_t va, uint32_t pa, pin_t attr);
 static inline uint32_t sec_to_addr(uint32_t sec);
 eqx_th_t* eqx_exec_internal(struct prog *prog);
+// exec the static elf executable <image>, or the file <name> in
+// directory <dir>.  see the "elf executables" section of os.c.
+eqx_th_t *eqx_exec_elf(const char *name, const void *image, uint32_t nbytes);
+eqx_th_t *eqx_exec_file(fat32_fs_t *fs, pi_dirent_t *dir, char *name);
+
+// how often exec found a program's code section already loaded, and
+// <eqx_exec_file> found the file already read.
+typedef struct {
+    uint32_t code_hits, code_misses,
+             file_hits, file_misses;
+} exec_cache_stats_t;
+exec_cache_stats_t eqx_exec_cache_stats(void);
 #endif
@@ -0,0 +1,58 @@
+// usage: pi-qemu-run [-M <machine>] [-sd <img>] [-timeout <sec>]
+//                    [-grep <str>] [-log <file>] [-qemu <path>] <prog.bin>
+//
+// boot <prog.bin> under qemu, echo the lines matching <str> (the
+// makefiles' GREP_STR) and exit 0 if it shut down cleanly without an
+// ERROR: or PANIC:.  see libunix/pi-qemu.h
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libunix.h"
+#include "pi-qemu.h"
+
+static void usage(const char *prog) {
+  die("usage: %s [-M <machine>] [-sd <img>] [-timeout <sec>] [-grep <str>] "
+      "[-log <file>] [-qemu <path>] <prog.bin>\n",
+      prog);
+}
+
+int main(int argc, char *argv[]) {
+  pi_qemu_t q = {0};
+  int i;
+  for (i = 1; i < argc - 1; i += 2) {
+    const char *opt = argv[i], *arg = argv[i + 1];
+    if (strcmp(opt, "-M") == 0)
+      q.machine = arg;
+    else if (strcmp(opt, "-sd") == 0)
+      q.sd_img = arg;
+    else if (strcmp(opt, "-timeout") == 0)
+      q.timeout_sec = atoi(arg);
+    else if (strcmp(opt, "-grep") == 0)
+      q.grep_str = arg;
+    else if (strcmp(opt, "-qemu") == 0)
+      q.qemu = arg;
+    else if (strcmp(opt, "-log") == 0) {
+      if (!(q.log = fopen(arg, "w")))
+        sys_die(fopen, "can't create <%s>", arg);
+    } else
+      usage(argv[0]);
+  }
+  if (i != argc - 1)
+    usage(argv[0]);
+  q.kernel = argv[i];
+
+  pi_qemu_res_t r = pi_qemu_run(&q, stdout);
+  if (q.log)
+    fclose(q.log);
+
+  if (pi_qemu_ok(&r)) {
+    output("qemu: <%s> passed: %u lines, %u SUCCESS\n", q.kernel, r.nlines,
+           r.nsuccess);
+    return 0;
+  }
+  output("qemu: <%s> FAILED: %u ERROR, %u PANIC%s%s\n", q.kernel, r.nerror,
+         r.npanic, r.timeout_p ? ", timed out" : "",
+         r.done_p ? "" : ", no clean shutdown");
+  return 1;
+}
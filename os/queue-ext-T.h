@@ -74,6 +74,21 @@
     static inline E_T *pfx ## _top(Q_T *q) {                            \
         demand(q, bad input);                                           \
         return q->head;                                                 \
-    }                                                                  
+    }                                                                   \
+                                                                        \
+    /* remove <e> from anywhere in the list: <prev> is the element      \
+       before it, or 0 if it's the head. */                             \
+    static inline void pfx ## _remove(Q_T *q, E_T *prev, E_T *e) {      \
+        if(!prev) {                                                     \
+            assert(q->head == e);                                       \
+            q->head = e->next;                                          \
+        } else {                                                        \
+            assert(prev->next == e);                                    \
+            prev->next = e->next;                                       \
+        }                                                               \
+        if(q->tail == e)                                                \
+            q->tail = prev;                                             \
+        e->next = 0;                                                    \
+    }
 
 #endif
@@ -0,0 +1,30 @@
+// tests sys_write/sys_read range checking and that a long message
+// goes out in a single write.
+#include "libos.h"
+
+static char msg[1024];
+
+void notmain(void) {
+    // one trap for the whole kilobyte.
+    for(int i = 0; i < sizeof msg - 1; i++)
+        msg[i] = (i % 64 == 63) ? '\n' : 'a' + i % 26;
+    msg[sizeof msg - 1] = '\n';
+    int n = sys_write(1, msg, sizeof msg);
+    if(n != sizeof msg)
+        die("ERROR: write returned %d, expected %d\n", n, sizeof msg);
+
+    // kernel memory and a range that runs off the end of our data
+    // section should both be refused.
+    if((n = sys_write(1, (void*)0x8000, 16)) != -1)
+        die("ERROR: write of kernel memory returned %d\n", n);
+    if((n = sys_write(1, msg, 0x200000)) != -1)
+        die("ERROR: write past the end of data returned %d\n", n);
+    if((n = sys_read(0, (void*)0x8000, 16)) != -1)
+        die("ERROR: read into kernel memory returned %d\n", n);
+    // no such fd.
+    if((n = sys_write(7, msg, 1)) != -1)
+        die("ERROR: write to fd 7 returned %d\n", n);
+
+    output("SUCCESS: pid=$pid: write checks passed\n");
+    sys_exit(0);
+}
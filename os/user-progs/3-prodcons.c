@@ -0,0 +1,122 @@
+// producer/consumer over the kernel's blocking primitives: throughput
+// through a bounded buffer and the latency of one wakeup.
+//
+// fork copies our memory, so the two sides share no buffer: the
+// "items" are just the semaphore counts.  what we time is the
+// blocking and handoff, which is the point.  the times come from
+// <sys_get_usec> around the whole run, so they include the traps.
+#include "libunix.h"
+
+enum { NSLOT = 8, NITEM = 4096, NPING = 1024 };
+
+static int new_or_die(int id, const char *what) {
+  if (id < 0)
+    die("ERROR: can't make a %s\n", what);
+  return id;
+}
+
+// per-operation cost in nanoseconds.
+static unsigned ns_per(unsigned usec, unsigned n) {
+  return usec * 1000 / n;
+}
+
+// a bounded buffer of NSLOT: the child produces, we consume.
+static void bounded_buffer(void) {
+  int empty = new_or_die(sys_sem_new(NSLOT), "semaphore");
+  int full = new_or_die(sys_sem_new(0), "semaphore");
+  int done = new_or_die(sys_sem_new(0), "semaphore");
+
+  unsigned start = sys_get_usec();
+  if (!fork()) {
+    for (int i = 0; i < NITEM; i++) {
+      sys_sem_wait(empty);
+      sys_sem_post(full);
+    }
+    sys_sem_post(done);
+    exit(0);
+  }
+  for (int i = 0; i < NITEM; i++) {
+    sys_sem_wait(full);
+    sys_sem_post(empty);
+  }
+  sys_sem_wait(done);
+  unsigned usec = sys_get_usec() - start;
+
+  unsigned ns = ns_per(usec, NITEM);
+  output("PRODCONS: %d items through %d slots: %d usec, %d ns/item, "
+         "%d items/sec\n",
+         NITEM, NSLOT, usec, ns, ns ? 1000 * 1000 * 1000 / ns : 0);
+}
+
+// ping-pong on two semaphores: each post wakes the other side, which
+// runs once we block, so a round trip is two wakeups and switches.
+static void sem_pingpong(void) {
+  int ping = new_or_die(sys_sem_new(0), "semaphore");
+  int pong = new_or_die(sys_sem_new(0), "semaphore");
+
+  if (!fork()) {
+    for (int i = 0; i < NPING; i++) {
+      sys_sem_wait(ping);
+      sys_sem_post(pong);
+    }
+    exit(0);
+  }
+  unsigned start = sys_get_usec();
+  for (int i = 0; i < NPING; i++) {
+    sys_sem_post(ping);
+    sys_sem_wait(pong);
+  }
+  unsigned usec = sys_get_usec() - start;
+  output("PRODCONS: semaphore wakeup: %d round trips in %d usec, "
+         "%d ns/wakeup\n",
+         NPING, usec, ns_per(usec, 2 * NPING));
+}
+
+// the same with a condition variable.  each side signals and then
+// waits while holding the mutex, so no signal is lost: the waiter
+// wakes, queues for the mutex and gets it when the signaller waits.
+static void cond_pingpong(void) {
+  int m = new_or_die(sys_mutex_new(), "mutex");
+  int cv = new_or_die(sys_cond_new(), "condition variable");
+
+  // hold it across the fork so the child can't signal before we wait.
+  if (sys_mutex_lock(m) < 0)
+    die("ERROR: can't lock a new mutex\n");
+  if (!fork()) {
+    sys_mutex_lock(m);
+    for (int i = 0; i < NPING; i++) {
+      sys_cond_signal(cv);
+      sys_cond_wait(cv, m);
+    }
+    sys_mutex_unlock(m);
+    exit(0);
+  }
+  unsigned start = sys_get_usec();
+  for (int i = 0; i < NPING; i++) {
+    sys_cond_wait(cv, m);
+    sys_cond_signal(cv);
+  }
+  sys_mutex_unlock(m);
+  unsigned usec = sys_get_usec() - start;
+  output("PRODCONS: condvar wakeup: %d round trips in %d usec, "
+         "%d ns/wakeup\n",
+         NPING, usec, ns_per(usec, 2 * NPING));
+}
+
+void notmain(void) {
+  // misuse is an error, not a hang.
+  int m = new_or_die(sys_mutex_new(), "mutex");
+  if (sys_mutex_unlock(m) != -1)
+    die("ERROR: unlocked a mutex we don't hold\n");
+  if (sys_mutex_lock(m) != 0 || sys_mutex_lock(m) != -1)
+    die("ERROR: locked a mutex twice\n");
+  sys_mutex_unlock(m);
+  if (sys_sem_wait(-1) != -1)
+    die("ERROR: waited on a bogus semaphore\n");
+
+  bounded_buffer();
+  sem_pingpong();
+  cond_pingpong();
+  output("SUCCESS: pid=$pid: producer/consumer done\n");
+  exit(0);
+}
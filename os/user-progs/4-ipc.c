@@ -0,0 +1,122 @@
+// message passing between a parent and a forked echo server:
+//   - round trip latency of a small (register) message.
+//   - how many async posts fit before the mailbox fills.
+//   - bandwidth of 1MB transfers that remap our window instead of
+//     copying it, next to what copying a 1MB buffer costs.
+#include "libunix.h"
+
+enum { NPING = 1024, NGRANT = 256, NPOST = 64 };
+enum { PING = 1, POST, GRANT, QUIT };
+enum { WINDOW_WORDS = 1024 * 1024 / 4 };
+
+// until QUIT: echo pings back incremented, count posts, and return
+// granted windows after checking and marking them.
+static void echo_server(void) {
+  unsigned nposts = 0;
+  while (1) {
+    ipc_msg_t m;
+    uint32_t from = sys_ipc_recv(&m);
+    uint32_t tid = from & ~EQX_IPC_GRANT;
+
+    switch (m.w[0]) {
+    case PING:
+      m.w[1]++;
+      sys_ipc_send(tid, &m);
+      break;
+    case POST:
+      nposts++;
+      break;
+    case GRANT: {
+      if (!(from & EQX_IPC_GRANT))
+        die("ERROR: expected a window from %d\n", tid);
+      volatile uint32_t *win = sys_ipc_window();
+      if (win[0] != m.w[1] || win[WINDOW_WORDS - 1] != m.w[1])
+        die("ERROR: window has %x, expected %x\n", win[0], m.w[1]);
+      win[1] = ~m.w[1];
+      sys_ipc_send(tid | EQX_IPC_GRANT, &m);
+      break;
+    }
+    case QUIT:
+      m.w[1] = nposts;
+      sys_ipc_send(tid, &m);
+      exit(0);
+    default:
+      die("ERROR: bogus message %d\n", m.w[0]);
+    }
+  }
+}
+
+static void ping(uint32_t child) {
+  unsigned start = sys_get_usec();
+  for (unsigned i = 0; i < NPING; i++) {
+    ipc_msg_t m = {{PING, i}};
+    if (sys_ipc_send(child, &m) < 0)
+      die("ERROR: send failed\n");
+    if (sys_ipc_recv(&m) != child || m.w[1] != i + 1)
+      die("ERROR: ping %d came back as %d\n", i, m.w[1]);
+  }
+  unsigned usec = sys_get_usec() - start;
+  output("IPC: %d small round trips in %d usec: %d ns each\n", NPING, usec,
+         usec * 1000 / NPING);
+}
+
+// returns how many went through.
+static unsigned post(uint32_t child) {
+  unsigned n;
+  for (n = 0; n < NPOST; n++) {
+    ipc_msg_t m = {{POST, n}};
+    if (sys_ipc_post(child, &m) < 0)
+      break;
+  }
+  if (n == NPOST)
+    die("ERROR: mailbox never filled\n");
+  output("IPC: %d posts before the mailbox filled\n", n);
+  return n;
+}
+
+static void grant(uint32_t child) {
+  volatile uint32_t *win = sys_ipc_window();
+  if (!win)
+    die("ERROR: no window\n");
+
+  unsigned start = sys_get_usec();
+  for (unsigned i = 0; i < NGRANT; i++) {
+    win[0] = win[WINDOW_WORDS - 1] = i;
+    ipc_msg_t m = {{GRANT, i}};
+    if (sys_ipc_send(child | EQX_IPC_GRANT, &m) < 0)
+      die("ERROR: grant failed\n");
+    if (!(sys_ipc_recv(&m) & EQX_IPC_GRANT))
+      die("ERROR: didn't get the window back\n");
+    if (win[1] != ~i)
+      die("ERROR: server didn't see our window\n");
+  }
+  unsigned usec = sys_get_usec() - start;
+  output("IPC: %d 1MB round trips in %d usec: %d MB/s\n", NGRANT, usec,
+         usec ? 2 * NGRANT * 1000 * 1000 / usec : 0);
+
+  // what it would cost to copy instead: half the window into the
+  // other half, twice.
+  start = sys_get_usec();
+  for (unsigned rep = 0; rep < 2; rep++)
+    for (unsigned i = 0; i < WINDOW_WORDS / 2; i++)
+      win[WINDOW_WORDS / 2 + i] = win[i];
+  usec = sys_get_usec() - start;
+  output("IPC: copying 1MB instead takes %d usec\n", usec);
+}
+
+void notmain(void) {
+  int child = fork();
+  if (!child)
+    echo_server();
+
+  ping(child);
+  unsigned nposts = post(child);
+  grant(child);
+
+  ipc_msg_t m = {{QUIT}};
+  sys_ipc_send(child, &m);
+  if (sys_ipc_recv(&m) != child || m.w[1] != nposts)
+    die("ERROR: server counted %d posts, expected %d\n", m.w[1], nposts);
+  output("SUCCESS: pid=$pid: message passing done\n");
+  exit(0);
+}
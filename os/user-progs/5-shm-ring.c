@@ -0,0 +1,95 @@
+// a producer and consumer passing words through a ring in a shared
+// region.  neither traps into the kernel per message, only to yield
+// when the ring is full or empty.  the ring is libpi's
+// <gen_circular_T>, which is lock free for one producer and one
+// consumer.
+#include "libunix.h"
+
+// <circular-T.h> pulls in the kernel's "rpi.h": skip it and stand in
+// for the few things the ring uses.
+#define __RPI_H__
+#define gcc_mb() asm volatile("" ::: "memory")
+#define panic libos_panic
+#define assert(x)                                                              \
+  do {                                                                         \
+    if (!(x))                                                                  \
+      libos_panic("assert failed: %s\n", #x);                                 \
+  } while (0)
+#include "circular-T.h"
+
+enum { NSLOT = 1024, NMSG = 256 * 1024, MAGIC = 0xfeedface };
+gen_circular_T(ring, ring_t, uint32_t, NSLOT)
+
+typedef struct {
+  uint32_t magic;
+  char msg[32];
+  ring_t ring;
+  volatile unsigned done, consumer_yields;
+} shared_t;
+
+static void consumer(void) {
+  // the region we inherited is the one we get by name.
+  if (sys_shm_unmap() < 0)
+    die("ERROR: unmap failed\n");
+  shared_t *s = sys_shm_map("ring");
+  if (s == (void *)-1 || s->magic != MAGIC)
+    die("ERROR: remapping the ring by name failed\n");
+
+  unsigned nyield = 0;
+  for (uint32_t i = 0; i < NMSG; i++) {
+    uint32_t x;
+    while (!ring_pop_nonblk(&s->ring, &x)) {
+      nyield++;
+      sys_yield();
+    }
+    if (x != i)
+      die("ERROR: popped %d, expected %d\n", x, i);
+  }
+  s->consumer_yields = nyield;
+  s->done = 1;
+  exit(0);
+}
+
+void notmain(void) {
+  shared_t *s = sys_shm_map("ring");
+  if (s == (void *)-1)
+    die("ERROR: can't map a shared region\n");
+  // a second region while we have one is refused.
+  if (sys_shm_map(0) != (void *)-1)
+    die("ERROR: mapped two regions\n");
+  s->magic = MAGIC;
+
+  // system calls take buffers in the region.
+  const char msg[] = "SHM: write from the region\n";
+  for (unsigned i = 0; i < sizeof msg; i++)
+    s->msg[i] = msg[i];
+  int n = sys_write(1, s->msg, sizeof msg - 1);
+  if (n != sizeof msg - 1)
+    die("ERROR: write from the region returned %d\n", n);
+
+  if (!fork())
+    consumer();
+
+  unsigned nyield = 0, start = sys_get_usec();
+  for (uint32_t i = 0; i < NMSG; i++) {
+    while (!ring_push(&s->ring, i)) {
+      nyield++;
+      sys_yield();
+    }
+  }
+  while (!s->done)
+    sys_yield();
+  unsigned usec = sys_get_usec() - start;
+
+  output("SHM: %d words through a %d slot ring in %d usec: %d ns/word, "
+         "%d words/sec\n",
+         NMSG, NSLOT, usec, usec * 1000 / NMSG,
+         usec ? NMSG * 1000 / usec * 1000 : 0);
+  output("SHM: yields: producer=%d, consumer=%d\n", nyield,
+         s->consumer_yields);
+
+  if (sys_shm_unmap() < 0)
+    die("ERROR: unmap failed\n");
+  output("SUCCESS: pid=$pid: shared ring done\n");
+  exit(0);
+}
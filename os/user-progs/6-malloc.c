@@ -0,0 +1,82 @@
+// what heap growth costs, and <malloc>/<free> under a random mix of
+// sizes with a bounded number of live blocks.
+#include "libunix.h"
+
+enum { NGROW = 64, PAGE = 4096, NLIVE = 256, NOPS = 16 * 1024 };
+
+static uint32_t seed = 1;
+static uint32_t rand(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+// mostly small, sometimes big.
+static unsigned rand_size(void) {
+    uint32_t r = rand();
+    if(r % 64 == 0)
+        return 2048 + r % 8192;
+    return 1 + r % 256;
+}
+
+// the kernel zeroes a page the first time the break passes it: time
+// that, then shrink and grow over the same pages again.
+static void sbrk_cost(void) {
+    unsigned start = sys_get_usec();
+    for(int i = 0; i < NGROW; i++)
+        if(sys_sbrk(PAGE) == (void *)-1)
+            die("ERROR: sbrk failed after %d pages\n", i);
+    unsigned first = sys_get_usec() - start;
+
+    if(sys_sbrk(-NGROW * PAGE) == (void *)-1)
+        die("ERROR: can't shrink the heap\n");
+    start = sys_get_usec();
+    for(int i = 0; i < NGROW; i++)
+        sys_sbrk(PAGE);
+    unsigned again = sys_get_usec() - start;
+    sys_sbrk(-NGROW * PAGE);
+
+    output("MALLOC: sbrk(4k): %d ns first time, %d ns once zeroed\n",
+        first * 1000 / NGROW, again * 1000 / NGROW);
+
+    // past the end of the data section.
+    if(sys_sbrk(0x100000) != (void *)-1)
+        die("ERROR: sbrk past the data section worked\n");
+}
+
+void notmain(void) {
+    sbrk_cost();
+
+    static unsigned char *live[NLIVE];
+    static unsigned live_n[NLIVE];
+
+    unsigned start = sys_get_usec();
+    for(int i = 0; i < NOPS; i++) {
+        unsigned k = rand() % NLIVE;
+        unsigned char *p = live[k];
+        if(p) {
+            // check that nothing else scribbled on it.
+            if(p[0] != (k & 0xff) || p[live_n[k] - 1] != (k & 0xff))
+                die("ERROR: block %d was corrupted\n", k);
+            free(p);
+        }
+        unsigned n = rand_size();
+        if(!(p = malloc(n)))
+            die("ERROR: out of memory after %d ops\n", i);
+        if((uint32_t)p % 8)
+            die("ERROR: malloc returned unaligned %x\n", p);
+        p[0] = p[n - 1] = k;
+        live[k] = p;
+        live_n[k] = n;
+    }
+    unsigned usec = sys_get_usec() - start;
+    for(int k = 0; k < NLIVE; k++)
+        free(live[k]);
+
+    malloc_stats_t s = malloc_stats();
+    output("MALLOC: %d malloc + %d free in %d usec: %d ns per pair\n",
+        s.nmalloc, s.nfree, usec, usec * 1000 / NOPS);
+    output("MALLOC: %d sbrk calls for %d bytes of heap\n",
+        s.nsbrk, s.heap_nbytes);
+    output("SUCCESS: pid=$pid: malloc done\n");
+    exit(0);
+}
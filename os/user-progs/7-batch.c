@@ -0,0 +1,85 @@
+// traps per call: one system call per trap, against the same calls
+// in a batch array and through the submission/completion ring.
+//
+// the uart sets the pace for output however it's issued, so the
+// times use a call that does no work (get_pid) and the per-character
+// output just shows the trap counts.
+#include "libunix.h"
+
+enum { NCALL = 1024, NCHAR = 256 };
+
+static eqx_ring_t ring;
+static eqx_call_t calls[NCALL];
+
+// submit <n> calls, entering the kernel whenever the ring fills and
+// once at the end.  checks every result is <expect>.  returns traps.
+static unsigned ring_run(unsigned n, uint32_t sysno, uint32_t (*arg)(unsigned),
+        int expect) {
+    unsigned ntrap = 0, ndone = 0;
+    for(unsigned i = 0; i < n || ndone < n; ) {
+        if(i < n && ring_submit(&ring, sysno, arg(i), 0, 0, i)) {
+            i++;
+            continue;
+        }
+        sys_ring_enter();
+        ntrap++;
+        eqx_cqe_t c;
+        while(ring_reap(&ring, &c)) {
+            if(c.res != expect || c.user_data != ndone)
+                die("ERROR: completion %d: res=%d, user_data=%d\n",
+                    ndone, c.res, c.user_data);
+            ndone++;
+        }
+    }
+    return ntrap;
+}
+
+static uint32_t no_arg(unsigned i) { return 0; }
+static uint32_t dot(unsigned i) { return i % 64 == 63 ? '\n' : '.'; }
+
+static void report(const char *how, unsigned ntrap, unsigned usec) {
+    output("BATCH: %d get_pid %s: %d traps, %d usec, %d ns/call\n",
+        NCALL, how, ntrap, usec, usec * 1000 / NCALL);
+}
+
+void notmain(void) {
+    int pid = sys_get_pid();
+    if(sys_ring_setup(&ring) < 0)
+        die("ERROR: ring setup failed\n");
+
+    unsigned start = sys_get_usec();
+    for(unsigned i = 0; i < NCALL; i++)
+        if(sys_get_pid() != pid)
+            die("ERROR: bad pid\n");
+    report("one per trap", NCALL, sys_get_usec() - start);
+
+    for(unsigned i = 0; i < NCALL; i++)
+        calls[i] = (eqx_call_t){ .sysno = EQX_SYS_GET_PID };
+    start = sys_get_usec();
+    if(sys_batch(calls, NCALL) != NCALL)
+        die("ERROR: batch failed\n");
+    report("in one batch", 1, sys_get_usec() - start);
+    for(unsigned i = 0; i < NCALL; i++)
+        if(calls[i].res != pid)
+            die("ERROR: batch call %d returned %d\n", i, calls[i].res);
+
+    start = sys_get_usec();
+    unsigned ntrap = ring_run(NCALL, EQX_SYS_GET_PID, no_arg, pid);
+    report("through the ring", ntrap, sys_get_usec() - start);
+
+    // per-character output.
+    for(unsigned i = 0; i < NCHAR; i++)
+        sys_putc(dot(i));
+    output("BATCH: %d putc one per trap: %d traps\n", NCHAR, NCHAR);
+    ntrap = ring_run(NCHAR, EQX_SYS_PUTC, dot, 0);
+    output("BATCH: %d putc through the ring: %d traps\n", NCHAR, ntrap);
+
+    // can't fork or exit from inside a batch.
+    calls[0] = (eqx_call_t){ .sysno = EQX_SYS_FORK };
+    calls[1] = (eqx_call_t){ .sysno = EQX_SYS_EXIT };
+    if(sys_batch(calls, 2) != 2 || calls[0].res != -1 || calls[1].res != -1)
+        die("ERROR: batch ran a call that switches threads\n");
+
+    output("SUCCESS: pid=$pid: batching done\n");
+    exit(0);
+}
@@ -0,0 +1,83 @@
+// priority inheritance: we (low, prio 0) hold a mutex that a high
+// priority child (2) blocks on, then wake a medium child (1) that
+// spins without blocking.  the high child lends us its priority, so
+// we get to unlock before the medium one runs: the log must be
+// "lhmu".  without inheritance the medium child starves us until it
+// gives up spinning, and the log is "mlhu".
+//
+// fork copies our memory: the log is in an anonymous shared region
+// the children keep.
+#include "libunix.h"
+
+enum { SPIN_USEC = 200 * 1000 };
+
+typedef struct {
+  volatile unsigned n, h_locked;
+  volatile char log[8];
+} shared_t;
+
+static shared_t *s;
+
+static void log_event(char c) { s->log[s->n++] = c; }
+
+static int new_or_die(int id, const char *what) {
+  if (id < 0)
+    die("ERROR: can't make a %s\n", what);
+  return id;
+}
+
+void notmain(void) {
+  s = sys_shm_map(0);
+  if (s == (void *)-1)
+    die("ERROR: can't map a shared region\n");
+  int m = new_or_die(sys_mutex_new(), "mutex");
+  int ready = new_or_die(sys_sem_new(0), "semaphore");
+  int go_h = new_or_die(sys_sem_new(0), "semaphore");
+  int go_m = new_or_die(sys_sem_new(0), "semaphore");
+
+  if (sys_mutex_lock(m) < 0)
+    die("ERROR: can't lock a new mutex\n");
+
+  // high: block on the mutex we hold.
+  if (!fork()) {
+    sys_set_prio(2);
+    sys_sem_post(ready);
+    sys_sem_wait(go_h);
+    if (sys_mutex_lock(m) < 0)
+      die("ERROR: high can't lock\n");
+    s->h_locked = 1;
+    log_event('h');
+    sys_mutex_unlock(m);
+    exit(0);
+  }
+  // medium: spin until the high child got the mutex, or give up.
+  if (!fork()) {
+    sys_set_prio(1);
+    sys_sem_post(ready);
+    sys_sem_wait(go_m);
+    unsigned start = sys_get_usec();
+    while (!s->h_locked && sys_get_usec() - start < SPIN_USEC)
+      ;
+    log_event('m');
+    exit(0);
+  }
+  // both children are waiting to go.
+  sys_sem_wait(ready);
+  sys_sem_wait(ready);
+
+  // the high child runs right away and blocks on <m>, lending us 2:
+  // the medium child (1) can't get in before our unlock.
+  sys_sem_post(go_h);
+  sys_sem_post(go_m);
+  log_event('l');
+  sys_mutex_unlock(m);
+  log_event('u');
+
+  s->log[s->n] = 0;
+  if (s->n != 4 || s->log[0] != 'l' || s->log[1] != 'h' ||
+      s->log[2] != 'm' || s->log[3] != 'u')
+    die("ERROR: ran in the order <%s>, expected <lhmu>\n",
+        (char *)s->log);
+  output("SUCCESS: pid=$pid: priority inheritance ran <lhmu>\n");
+  exit(0);
+}
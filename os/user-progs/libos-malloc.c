@@ -0,0 +1,104 @@
+// size class malloc over <sys_sbrk>: see libos.h.
+//
+// a block is a power of two from 16 to 2048 bytes, including an
+// 8-byte header that holds its size.  each size has a free list, and
+// an empty one is refilled by carving up a 16k chunk from sbrk, so
+// most calls never trap.  bigger blocks are sbrk'd at their rounded
+// up size and reused first fit once freed.  nothing is given back to
+// the kernel and nothing is coalesced.
+#include "libos.h"
+
+enum {
+    MIN_SHIFT = 4,      // 16 bytes.
+    NCLASS = 8,         // up to 2048.
+    MAX_SMALL = 1 << (MIN_SHIFT + NCLASS - 1),
+    CHUNK = 16 * 1024,
+    HDR = 8,            // keeps the payload 8-byte aligned.
+};
+
+typedef struct blk {
+    uint32_t nbytes;    // whole block, header included.
+    uint32_t pad;
+    struct blk *next;   // on a free list: overlaps the payload.
+} blk_t;
+
+static blk_t *free_small[NCLASS];
+static blk_t *free_big;
+static malloc_stats_t stats;
+
+static void *sbrk_or_0(unsigned nbytes) {
+    void *p = sys_sbrk(nbytes);
+    if(p == (void *)-1)
+        return 0;
+    stats.nsbrk++;
+    stats.heap_nbytes += nbytes;
+    return p;
+}
+
+static unsigned class_of(unsigned nbytes) {
+    unsigned c = 0;
+    while((1u << (MIN_SHIFT + c)) < nbytes)
+        c++;
+    return c;
+}
+
+// carve a chunk into blocks of class <c>.
+static int refill(unsigned c) {
+    unsigned sz = 1 << (MIN_SHIFT + c);
+    char *p = sbrk_or_0(CHUNK);
+    if(!p)
+        return 0;
+    for(unsigned off = 0; off + sz <= CHUNK; off += sz) {
+        blk_t *b = (void *)(p + off);
+        b->nbytes = sz;
+        b->next = free_small[c];
+        free_small[c] = b;
+    }
+    return 1;
+}
+
+void *malloc(unsigned n) {
+    stats.nmalloc++;
+    unsigned nbytes = (n + HDR + 7) & ~7;
+    if(nbytes < n)
+        return 0;
+
+    blk_t *b;
+    if(nbytes <= MAX_SMALL) {
+        unsigned c = class_of(nbytes);
+        if(!free_small[c] && !refill(c))
+            return 0;
+        b = free_small[c];
+        free_small[c] = b->next;
+    } else {
+        blk_t **p;
+        for(p = &free_big; *p && (*p)->nbytes < nbytes; p = &(*p)->next)
+            ;
+        if((b = *p))
+            *p = b->next;
+        else if((b = sbrk_or_0(nbytes)))
+            b->nbytes = nbytes;
+        else
+            return 0;
+    }
+    return (char *)b + HDR;
+}
+
+void free(void *p) {
+    if(!p)
+        return;
+    stats.nfree++;
+    blk_t *b = (void *)((char *)p - HDR);
+    if(b->nbytes <= MAX_SMALL) {
+        unsigned c = class_of(b->nbytes);
+        b->next = free_small[c];
+        free_small[c] = b;
+    } else {
+        b->next = free_big;
+        free_big = b;
+    }
+}
+
+malloc_stats_t malloc_stats(void) {
+    return stats;
+}
@@ -21,6 +21,101 @@ int syscall_invoke_asm(uint32_t sysno, ...);
 #define sys_fork()          syscall_invoke_asm(EQX_SYS_FORK)
 #define sys_waitpid(pid,nonblock_p) \
     syscall_invoke_asm(EQX_SYS_WAITPID, pid, nonblock_p)
+// <buf> is a user pointer: the kernel checks it's mapped.
+// return bytes written/read or -1.
+#define sys_write(fd,buf,n) syscall_invoke_asm(EQX_SYS_WRITE, fd, buf, n)
+#define sys_read(fd,buf,n)  syscall_invoke_asm(EQX_SYS_READ, fd, buf, n)
+
+// this thread's pmu counts so far: which two events they are is the
+// kernel's <perf_group> config.  -1 if the kernel isn't counting.
+// the counts are the low 32 bits of the kernel's: subtract them.
+typedef struct {
+    uint32_t nsched;    // times we were scheduled.
+    uint32_t cycles;
+    uint32_t event0, event1;
+} perf_t;
+#define sys_perf_read(p)    syscall_invoke_asm(EQX_SYS_PERF_READ, p)
+#define sys_get_usec()      syscall_invoke_asm(EQX_SYS_GET_USEC)
+
+// blocking primitives: the _new calls return an id (-1 if the kernel
+// is out), which a forked child shares.  the rest return 0 or -1.
+// a higher <prio> runs first; mutex owners inherit their waiters'.
+#define sys_mutex_new()     syscall_invoke_asm(EQX_SYS_MUTEX_NEW)
+#define sys_mutex_lock(m)   syscall_invoke_asm(EQX_SYS_MUTEX_LOCK, m)
+#define sys_mutex_unlock(m) syscall_invoke_asm(EQX_SYS_MUTEX_UNLOCK, m)
+#define sys_cond_new()      syscall_invoke_asm(EQX_SYS_COND_NEW)
+#define sys_cond_wait(c,m)  syscall_invoke_asm(EQX_SYS_COND_WAIT, c, m)
+#define sys_cond_signal(c)  syscall_invoke_asm(EQX_SYS_COND_SIGNAL, c)
+#define sys_cond_broadcast(c) syscall_invoke_asm(EQX_SYS_COND_BROADCAST, c)
+#define sys_sem_new(n)      syscall_invoke_asm(EQX_SYS_SEM_NEW, n)
+#define sys_sem_wait(s)     syscall_invoke_asm(EQX_SYS_SEM_WAIT, s)
+#define sys_sem_post(s)     syscall_invoke_asm(EQX_SYS_SEM_POST, s)
+#define sys_set_prio(p)     syscall_invoke_asm(EQX_SYS_SET_PRIO, p)
+
+// message passing: four words that travel in registers.  send blocks
+// until <tid> receives; post queues in its mailbox (-1 if full).
+// recv returns the sender's tid.  to move a big buffer, fill the 1MB
+// at <sys_ipc_window()> and send with EQX_IPC_GRANT: the receiver's
+// window becomes ours and ours theirs, with nothing copied.  a grant
+// to a process with a shared region mapped fails (-1).
+typedef struct { uint32_t w[4]; } ipc_msg_t;
+int ipc_invoke_asm(uint32_t sysno, uint32_t tid, ipc_msg_t *m);
+#define sys_ipc_send(tid,m) ipc_invoke_asm(EQX_SYS_IPC_SEND, tid, m)
+#define sys_ipc_post(tid,m) ipc_invoke_asm(EQX_SYS_IPC_POST, tid, m)
+#define sys_ipc_recv(m)     ipc_invoke_asm(EQX_SYS_IPC_RECV, 0, m)
+#define sys_ipc_window()    ((void *)syscall_invoke_asm(EQX_SYS_IPC_WINDOW))
+
+// shared memory: map the 1MB region <name> (made on first use), or a
+// new anonymous one if <name> is 0 that our forked children keep.
+// returns its address or -1.  we can have one region at a time, and
+// not while we have an ipc window.
+#define sys_shm_map(name)   ((void *)syscall_invoke_asm(EQX_SYS_SHM_MAP, name))
+#define sys_shm_unmap()     syscall_invoke_asm(EQX_SYS_SHM_UNMAP)
+#define sys_yield()         syscall_invoke_asm(EQX_SYS_YIELD)
+
+// grow (or shrink) the heap at the end of our data section by <n>
+// bytes: returns the old break or (void *)-1.  new memory is zeroed.
+static inline void *sys_sbrk(int n) {
+    return (void *)syscall_invoke_asm(EQX_SYS_SBRK, n);
+}
+
+// many calls per trap: an array of <eqx_call_t> (sys_batch), or a
+// ring we fill with <ring_submit> and the kernel drains on
+// <sys_ring_enter>.  calls that block or switch threads get -1.
+// <sys_ring_enter> returns -1 once the ring isn't mapped writable
+// (its window was granted away), and exec forgets the ring.
+#define sys_batch(calls,n)  syscall_invoke_asm(EQX_SYS_BATCH, calls, n)
+#define sys_ring_setup(r)   syscall_invoke_asm(EQX_SYS_RING_SETUP, r)
+#define sys_ring_enter()    syscall_invoke_asm(EQX_SYS_RING_ENTER)
+
+// 0 if the submission ring is full.
+static inline int ring_submit(eqx_ring_t *r, uint32_t sysno,
+        uint32_t a1, uint32_t a2, uint32_t a3, uint32_t user_data) {
+    if(r->sq_tail - r->sq_head == EQX_RING_N)
+        return 0;
+    r->sq[r->sq_tail % EQX_RING_N] = (eqx_sqe_t){ sysno, a1, a2, a3, user_data };
+    r->sq_tail++;
+    return 1;
+}
+
+// 0 if there are no completions.
+static inline int ring_reap(eqx_ring_t *r, eqx_cqe_t *c) {
+    if(r->cq_head == r->cq_tail)
+        return 0;
+    *c = r->cq[r->cq_head % EQX_RING_N];
+    r->cq_head++;
+    return 1;
+}
+
+// libos-malloc.c: power of two size classes (16..2048) over sbrk,
+// with big blocks reused first fit.  returns 0 when out of heap.
+void *malloc(unsigned n);
+void free(void *p);
+typedef struct {
+    unsigned nmalloc, nfree;
+    unsigned nsbrk, heap_nbytes;    // sbrk calls and bytes they got.
+} malloc_stats_t;
+malloc_stats_t malloc_stats(void);
 
 #define die(x...) do { output(x); sys_exit(1); } while(0)
 #define libos_panic(args...) do { output(args); sys_exit(1); } while(0)
@@ -43,14 +138,60 @@ strncmp(const char* _s1, const char* _s2, size_t n) {
     return 0;
 }
 
+static inline void *memset(void *dst, int c, size_t n) {
+    unsigned char *p = dst;
+    while(n--)
+        *p++ = c;
+    return dst;
+}
+
+static inline size_t strlen(const char *s) {
+    size_t n = 0;
+    while(s[n])
+        n++;
+    return n;
+}
+
 // simplest routine to put a string.  mainly useful for minimizing
 // the code that runs when debugging weird errors.
 static inline void user_putk(const char *msg) {
-    while(*msg)
-        sys_putc(*msg++);
+    sys_write(1, msg, strlen(msg));
+}
+
+// output is buffered so that a message costs one <sys_write> rather
+// than a trap per character.  the buffer lives on the caller's stack.
+enum { LIBOS_BUF_NBYTES = 1024 };
+typedef struct {
+    unsigned n;
+    char buf[LIBOS_BUF_NBYTES];
+} libos_buf_t;
+
+static inline void libos_flush(libos_buf_t *b) {
+    if(b->n)
+        sys_write(1, b->buf, b->n);
+    b->n = 0;
+}
+static inline void libos_putc(libos_buf_t *b, char c) {
+    if(b->n == sizeof b->buf)
+        libos_flush(b);
+    b->buf[b->n++] = c;
+}
+static inline void libos_puts(libos_buf_t *b, const char *s) {
+    while(*s)
+        libos_putc(b, *s++);
+}
+static inline void libos_putu(libos_buf_t *b, unsigned x, unsigned base) {
+    char digits[32];
+    int n = 0;
+    do {
+        digits[n++] = "0123456789abcdef"[x % base];
+        x /= base;
+    } while(x);
+    while(n)
+        libos_putc(b, digits[--n]);
 }
 
-// simple printk that only takes %x as a format 
+// simple printk that only takes %x, %d and %s.
 // we need a seperate routine since when actually at user level
 // can't call kernel stuff.
 //
@@ -59,29 +200,46 @@ static inline void user_putk(const char *msg) {
 static inline void output(const char *fmt, ...) {
     unsigned chr;
     va_list ap;
+    libos_buf_t b;
+    b.n = 0;
 
     va_start(ap, fmt);
     while((chr = *fmt++)) {
         switch(chr) {
         case '%':
             switch((chr = *fmt++)) {
-            case 'x': sys_put_hex(va_arg(ap, unsigned)); break;
-            case 'd': sys_put_int(va_arg(ap, int)); break;
-            case 's': user_putk(va_arg(ap, char *)); break;
-            default: die("bad character\n"); break;
+            // same as the kernel printk.
+            case 'x': 
+                libos_puts(&b, "0x");
+                libos_putu(&b, va_arg(ap, unsigned), 16); 
+                break;
+            case 'd': {
+                int v = va_arg(ap, int);
+                if(v < 0) {
+                    libos_putc(&b, '-');
+                    v = -v;
+                }
+                libos_putu(&b, v, 10); 
+                break;
+            }
+            case 's': libos_puts(&b, va_arg(ap, char *)); break;
+            default: libos_flush(&b); die("bad character\n"); break;
             }
             break;
         case '$':
-            if(strncmp(fmt, "pid", 3) != 0)
+            if(strncmp(fmt, "pid", 3) != 0) {
+                libos_flush(&b);
                 libos_panic("unknown format: <%s>\n", fmt);
-            sys_put_pid();
+            }
+            libos_putu(&b, sys_get_pid(), 10);
             fmt += 3;
             break;
         default:
-            sys_putc(chr);
+            libos_putc(&b, chr);
         }
     }
     va_end(ap);
+    libos_flush(&b);
 }
 
 #endif
@@ -0,0 +1,92 @@
+// range watchpoints (<range-watch.h>): check they catch exactly the
+// writes in the range, that the writes still happen, and time a plain
+// write, a non-matching write in a watched section and a watched one.
+#include "rpi.h"
+#include "cycle-count.h"
+#include "memmap-default.h"
+#include "procmap.h"
+#include "range-watch.h"
+
+enum { dom_watch = 3, N = 1000 };
+
+static unsigned nhits;
+static uint32_t last_addr, last_pc;
+
+static void handler(void *data, rw_fault_t *f) {
+  nhits++;
+  last_addr = f->addr;
+  last_pc = f->pc;
+}
+
+// cycles per write, over N writes to <p>.
+static uint32_t time_writes(volatile uint32_t *p) {
+  uint32_t s = cycle_cnt_read();
+  for (unsigned i = 0; i < N; i++)
+    *p = i;
+  return (cycle_cnt_read() - s) / N;
+}
+
+static volatile uint32_t plain;
+
+void notmain(void) {
+  kmalloc_init(1);
+  full_except_install(0);
+
+  procmap_t p = {};
+  procmap_push(&p, pr_ent_mk(SEG_BCM_0, MB(1), MEM_DEVICE, dom_kern));
+  procmap_push(&p, pr_ent_mk(SEG_BCM_1, MB(1), MEM_DEVICE, dom_kern));
+  procmap_push(&p, pr_ent_mk(SEG_BCM_2, MB(1), MEM_DEVICE, dom_kern));
+  procmap_push(&p, pr_ent_mk(SEG_CODE, MB(1), MEM_RW, dom_kern));
+  procmap_push(&p, pr_ent_mk(SEG_HEAP, MB(1), MEM_RW, dom_kern));
+  procmap_push(&p, pr_ent_mk(SEG_STACK, MB(1), MEM_RW, dom_kern));
+  procmap_push(&p, pr_ent_mk(SEG_INT_STACK, MB(1), MEM_RW, dom_kern));
+  vm_pt_t *pt = vm_map_kernel(&p, 1);
+  rw_init(pt, dom_watch);
+
+  // the heap section gets watched: <other> is in it, but not in the
+  // range.
+  uint32_t *buf = kmalloc(4096);
+  volatile uint32_t *watched = &buf[512], *other = &buf[0];
+
+  uint32_t base = time_writes(&plain);
+  rw_watch((uint32_t)watched, 64, handler, 0);
+
+  uint32_t nomatch = time_writes(other);
+  if (nhits)
+    panic("%d writes outside the range were caught\n", nhits);
+  if (*other != N - 1)
+    panic("non-matching stores didn't happen: %d\n", *other);
+
+  uint32_t match = time_writes(watched);
+  if (nhits != N)
+    panic("caught %d of %d watched writes\n", nhits, N);
+  if (last_addr != (uint32_t)watched)
+    panic("fault addr=%x, expected %p\n", last_addr, watched);
+  if (*watched != N - 1)
+    panic("watched stores didn't happen: %d\n", *watched);
+  trace("watched store at pc=%x\n", last_pc);
+
+  // the edges.
+  nhits = 0;
+  watched[15] = 1;
+  if (nhits != 1)
+    panic("last word of the range wasn't caught\n");
+  watched[16] = 1;
+  watched[-1] = 1;
+  if (nhits != 1)
+    panic("words just outside the range were caught\n");
+
+  trace("plain write: %d cycles\n", base);
+  trace("non-matching write in a watched section: %d cycles (+%d)\n",
+        nomatch, nomatch - base);
+  trace("watched write: %d cycles (+%d)\n", match, match - base);
+  rw_stats_print();
+
+  rw_unwatch((uint32_t)watched);
+  unsigned nfaults = rw_stats().nfaults;
+  time_writes(watched);
+  if (rw_stats().nfaults != nfaults)
+    panic("unwatched section still faults\n");
+
+  printk("SUCCESS: range watchpoints\n");
+}
@@ -26,6 +26,10 @@ typedef enum {
   // perm_rw_priv = perm_na_user,
   perm_rw_priv = perm_na_user,
   perm_na_priv = 0b000,
+
+  // read-only for kernel and user alike: APX=1, AP=11.  (0b110 is
+  // the same on the arm1176 but deprecated, b4-9.)
+  perm_ro_all = 0b111,
 } mem_perm_t;
 
 static inline int mem_perm_islegal(mem_perm_t p) {
@@ -36,6 +40,7 @@ static inline int mem_perm_islegal(mem_perm_t p) {
   case perm_ro_priv:
   case perm_rw_priv:
   case perm_na_priv:
+  case perm_ro_all:
     return 1;
   default:
     // for today just die.
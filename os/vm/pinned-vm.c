@@ -57,9 +57,9 @@ int tlb_contains_va(uint32_t *result, uint32_t va) {
 void pin_mmu_sec(unsigned idx, uint32_t va, uint32_t pa, pin_t e) {
 
   demand(idx < 8, lockdown index too large);
-  // lower 20 bits should be 0.
-  demand(bits_get(va, 0, 19) == 0, only handling 1MB sections);
-  demand(bits_get(pa, 0, 19) == 0, only handling 1MB sections);
+  // aligned to the page size: 4k, 64k, 1mb or 16mb.
+  demand(pin_aligned(va, e), "va=%x not aligned to its page size\n", va);
+  demand(pin_aligned(pa, e), "pa=%x not aligned to its page size\n", pa);
 
   // debug("about to map %x->%x\n", va, pa);
 
@@ -181,4 +181,20 @@ vm_pt_t *vm_map_kernel(procmap_t *p, int enable_p) {
 
   assert(pt);
   return pt;
-}
\ No newline at end of file
+}
+
+// set the <AP> permissions in <pt> for [va, va+1MB*<nsec>) to
+// <perm.AP_perm>.  the other fields of <perm> are ignored.
+void vm_mprotect(vm_pt_t *pt, unsigned va, unsigned nsec, pin_t perm) {
+  assert(aligned(va, OneMB));
+
+  for (unsigned i = 0; i < nsec; i++) {
+    vm_pte_t *pte = vm_lookup(pt, va + i * OneMB);
+    if (!pte)
+      panic("vm_mprotect: no mapping for %x\n", va + i * OneMB);
+    pte->AP = perm.AP_perm & 0b11;
+    pte->APX = (perm.AP_perm & 0b100) >> 2;
+  }
+  // the old permissions can be in the tlb.
+  mmu_sync_pte_mods();
+}
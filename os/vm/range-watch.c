@@ -0,0 +1,257 @@
+// mmu range watchpoints: see <range-watch.h>
+#include "range-watch.h"
+#include "cycle-count.h"
+
+// the fault registers (3-66, 3-69) and debug breakpoint pair 5 (13-5).
+cp_asm_get(rw_dfsr, p15, 0, c5, c0, 0);
+cp_asm_get(rw_ifsr, p15, 0, c5, c0, 1);
+cp_asm_get(rw_far, p15, 0, c6, c0, 0);
+cp_asm(rw_dscr, p14, 0, c0, c1, 0);
+cp_asm(rw_bvr5, p14, 0, c0, c5, 4);
+cp_asm(rw_bcr5, p14, 0, c0, c5, 5);
+
+enum { OneMB = 1024 * 1024 };
+
+static vm_pt_t *rw_pt;
+static unsigned rw_dom;
+static full_except_t prev_data_abort, prev_prefetch;
+
+// the watched ranges, sorted by <lo>.  the interval tree is implicit:
+// the root of [l,r) is the middle element, and <max_hi[m]> is the
+// largest <hi> in the subtree rooted at <m>.  ranges change rarely
+// and faults are the hot path, so we just rebuild it on a change.
+static struct rw_range {
+  uint32_t lo, hi;
+  rw_handler_t h;
+  void *data;
+} ranges[RW_MAX];
+static uint32_t max_hi[RW_MAX];
+static unsigned nranges;
+
+// the sections we've protected: what to put back.
+static struct rw_sec {
+  uint32_t va;
+  unsigned nranges; // in it.
+  unsigned dom;
+  pin_t perm;
+} secs[RW_MAX];
+static unsigned nsecs;
+
+// the store we're stepping over: its fault, and when it started.
+static uint32_t step_pc, step_start;
+static int step_match_p;
+
+static rw_stats_t stats;
+
+static uint32_t tree_build(unsigned l, unsigned r) {
+  if (l >= r)
+    return 0;
+  unsigned m = (l + r) / 2;
+  uint32_t hi = ranges[m].hi, x;
+  if ((x = tree_build(l, m)) > hi)
+    hi = x;
+  if ((x = tree_build(m + 1, r)) > hi)
+    hi = x;
+  return max_hi[m] = hi;
+}
+
+// call the handler of every range in [l,r) that has <f->addr>.
+// returns how many.
+static unsigned tree_stab(unsigned l, unsigned r, rw_fault_t *f) {
+  if (l >= r)
+    return 0;
+  unsigned m = (l + r) / 2;
+  // nothing in this subtree reaches <addr>.
+  if (max_hi[m] <= f->addr)
+    return 0;
+
+  unsigned n = tree_stab(l, m, f);
+  // everything right of <m> starts later still.
+  if (ranges[m].lo > f->addr)
+    return n;
+  if (f->addr < ranges[m].hi) {
+    f->lo = ranges[m].lo;
+    f->hi = ranges[m].hi;
+    ranges[m].h(ranges[m].data, f);
+    n++;
+  }
+  return n + tree_stab(m + 1, r, f);
+}
+
+// manager: permissions ignored, so the store (and we) can write.
+// client: writes to the watched sections fault.
+static void rw_dom_set(unsigned how) {
+  uint32_t d = domain_access_ctrl_get();
+  d &= ~(0b11 << rw_dom * 2);
+  domain_access_ctrl_set(d | how << rw_dom * 2);
+}
+
+static struct rw_sec *sec_lookup(uint32_t va) {
+  for (unsigned i = 0; i < nsecs; i++)
+    if (secs[i].va == va)
+      return &secs[i];
+  return 0;
+}
+
+static void sec_protect(uint32_t va) {
+  struct rw_sec *s = sec_lookup(va);
+  if (s) {
+    s->nranges++;
+    return;
+  }
+  assert(nsecs < RW_MAX);
+  vm_pte_t *pte = vm_lookup(rw_pt, va);
+  if (!pte)
+    panic("rw_watch: section %x isn't mapped\n", va);
+
+  s = &secs[nsecs++];
+  s->va = va;
+  s->nranges = 1;
+  s->dom = pte->domain;
+  s->perm.AP_perm = pte->APX << 2 | pte->AP;
+
+  // keep user read access if it had it.
+  pin_t ro = s->perm;
+  ro.AP_perm = (pte->AP & 0b10) ? perm_ro_all : perm_ro_priv;
+  pte->domain = rw_dom;
+  vm_mprotect(rw_pt, va, 1, ro);
+}
+
+static void sec_unprotect(uint32_t va) {
+  struct rw_sec *s = sec_lookup(va);
+  assert(s && s->nranges);
+  if (--s->nranges)
+    return;
+  vm_lookup(rw_pt, va)->domain = s->dom;
+  vm_mprotect(rw_pt, va, 1, s->perm);
+  *s = secs[--nsecs];
+}
+
+// a write to a protected section.
+static void rw_data_abort(regs_t *r) {
+  uint32_t start = cycle_cnt_read();
+  uint32_t dfsr = rw_dfsr_get(), far = rw_far_get();
+  // b4-20: status is bits 10,3:0.  section permission fault = 0b01101.
+  unsigned status = bits_get(dfsr, 0, 3) | bit_get(dfsr, 10) << 4;
+
+  if (status != 0b01101 || !sec_lookup(far & ~(OneMB - 1))) {
+    if (!prev_data_abort)
+      panic("data abort at pc=%x, addr=%x, dfsr=%x\n", r->regs[15], far,
+            dfsr);
+    prev_data_abort(r);
+    return;
+  }
+  // first: our own writes (and the handlers') must not fault.
+  rw_dom_set(DOM_manager);
+
+  rw_fault_t f = {.addr = far, .pc = r->regs[15], .regs = r};
+  step_match_p = tree_stab(0, nranges, &f) != 0;
+  step_start = start;
+
+  // a store falls through: stop right after it.
+  step_pc = r->regs[15] + 4;
+  rw_bvr5_set(step_pc);
+  // match, any mode, all bytes, enabled.
+  rw_bcr5_set(0b1111 << 5 | 0b11 << 1 | 1);
+  switchto(r);
+}
+
+// the store is done: protect the sections again.
+static void rw_prefetch(regs_t *r) {
+  // 3-66: ifsr status 0b0010 = debug event.
+  if (!step_pc || r->regs[15] != step_pc ||
+      bits_get(rw_ifsr_get(), 0, 3) != 0b0010) {
+    if (!prev_prefetch)
+      panic("prefetch abort at pc=%x\n", r->regs[15]);
+    prev_prefetch(r);
+    return;
+  }
+  rw_bcr5_set(0);
+  step_pc = 0;
+
+  uint32_t cyc = cycle_cnt_read() - step_start;
+  stats.nfaults++;
+  if (step_match_p) {
+    stats.nmatch++;
+    stats.match_cyc += cyc;
+  } else
+    stats.nomatch_cyc += cyc;
+
+  rw_dom_set(DOM_client);
+  switchto(r);
+}
+
+void rw_init(vm_pt_t *pt, unsigned dom) {
+  demand(dom < 16, "illegal domain %d\n", dom);
+  rw_pt = pt;
+  rw_dom = dom;
+  rw_dom_set(DOM_client);
+
+  // monitor debug mode: bit 15 set, 14 clear (13-9).
+  uint32_t dscr = rw_dscr_get();
+  rw_dscr_set(bit_clr(bit_set(dscr, 15), 14));
+
+  cycle_cnt_init();
+  prev_data_abort = full_except_set_data_abort(rw_data_abort);
+  prev_prefetch = full_except_set_prefetch(rw_prefetch);
+}
+
+// the page table can be in a watched section: change things as
+// manager.
+void rw_watch(uint32_t addr, uint32_t nbytes, rw_handler_t h, void *data) {
+  assert(rw_pt);
+  demand(nbytes && addr + nbytes > addr, "bad range %x+%d\n", addr, nbytes);
+  demand(nranges < RW_MAX, "too many ranges\n");
+  rw_dom_set(DOM_manager);
+
+  unsigned i = nranges++;
+  for (; i && ranges[i - 1].lo > addr; i--)
+    ranges[i] = ranges[i - 1];
+  ranges[i] = (struct rw_range){
+      .lo = addr, .hi = addr + nbytes, .h = h, .data = data};
+  tree_build(0, nranges);
+
+  uint32_t last = (addr + nbytes - 1) & ~(OneMB - 1);
+  for (uint32_t va = addr & ~(OneMB - 1);; va += OneMB) {
+    sec_protect(va);
+    if (va == last)
+      break;
+  }
+  rw_dom_set(DOM_client);
+}
+
+void rw_unwatch(uint32_t addr) {
+  unsigned i;
+  for (i = 0; i < nranges; i++)
+    if (ranges[i].lo == addr)
+      break;
+  if (i == nranges)
+    panic("rw_unwatch: no range at %x\n", addr);
+  rw_dom_set(DOM_manager);
+
+  uint32_t last = (ranges[i].hi - 1) & ~(OneMB - 1);
+  for (uint32_t va = addr & ~(OneMB - 1);; va += OneMB) {
+    sec_unprotect(va);
+    if (va == last)
+      break;
+  }
+  for (nranges--; i < nranges; i++)
+    ranges[i] = ranges[i + 1];
+  tree_build(0, nranges);
+  rw_dom_set(DOM_client);
+}
+
+rw_stats_t rw_stats(void) { return stats; }
+
+void rw_stats_print(void) {
+  rw_stats_t s = stats;
+  unsigned nomatch = s.nfaults - s.nmatch;
+  output("range watch: %d faults, %d in a watched range\n", s.nfaults,
+         s.nmatch);
+  if (s.nmatch)
+    output("\tper watched write: %d cycles in the handlers\n",
+           s.match_cyc / s.nmatch);
+  if (nomatch)
+    output("\tper non-matching write: %d cycles in the handlers\n",
+           s.nomatch_cyc / nomatch);
+}
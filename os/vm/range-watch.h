@@ -0,0 +1,64 @@
+#ifndef __RANGE_WATCH_H__
+#define __RANGE_WATCH_H__
+// watchpoints on arbitrary ranges of memory, using the mmu instead of
+// the two word-sized debug watchpoints in <mini-watch.h>.
+//
+// how:
+//   - every 1MB section with a watched range in it is moved into its
+//     own domain and made read-only (<vm_mprotect>).
+//   - a write anywhere in such a section takes a permission fault.
+//     we flip the domain to manager (permissions ignored), look up
+//     the address in an interval tree of the watched ranges and
+//     call the handlers of the ones it's in.
+//   - then we let the store run, stopping on a breakpoint on the
+//     next instruction, and flip the domain back to client.
+//
+// so a watched range costs nothing until its section is written, but
+// then every write to the section faults twice, watched or not.
+// <rw_stats_print> gives the cost per fault and per non-matching
+// write.
+//
+// limits:
+//   - only writes are watched.
+//   - page table vm only (<pt-vm.h>): the sections must be mapped.
+//   - uses debug breakpoint pair 5, so don't use it together with
+//     all five of <mini-step.h>'s breakpoints.
+//   - handlers run with the watched sections writeable: their own
+//     writes to them aren't seen.
+//   - don't watch the exception stack's section: the handlers push
+//     onto it before they can turn protection off.
+#include "pt-vm.h"
+
+typedef struct {
+  uint32_t addr; // being written.
+  uint32_t pc;   // of the store: it hasn't happened yet.
+  regs_t *regs;
+  uint32_t lo, hi; // the watched range it's in: [lo, hi)
+} rw_fault_t;
+
+typedef void (*rw_handler_t)(void *data, rw_fault_t *f);
+
+// most ranges watched at once.
+enum { RW_MAX = 64 };
+
+// <pt> must be the current page table.  <dom> must be free for us:
+// the watched sections are moved into it.  call after
+// <full_except_install>: we chain to the data abort and prefetch
+// handlers that are there.
+void rw_init(vm_pt_t *pt, unsigned dom);
+
+// call <h> before each write to [addr, addr+nbytes).
+void rw_watch(uint32_t addr, uint32_t nbytes, rw_handler_t h, void *data);
+// stop watching the range that starts at <addr>.
+void rw_unwatch(uint32_t addr);
+
+typedef struct {
+  unsigned nfaults, nmatch;    // faults, and how many hit a range.
+  uint32_t match_cyc;          // cycles in our handlers for those,
+  uint32_t nomatch_cyc;        // and for the rest.
+} rw_stats_t;
+
+rw_stats_t rw_stats(void);
+void rw_stats_print(void);
+
+#endif